@@ -0,0 +1,44 @@
+#! /bin/sh
+
+# Time the text formatting of textDump for a given number of events, 100M by
+# default. The text is written to /dev/null. The trace is dumped as many
+# times as needed to reach the number of events, so a small trace can be
+# used. LTTV is run in place in the build directory, see runlttv.
+#
+# The events of the trace are counted with the babeltrace command, or can be
+# given as the third argument.
+
+BUILDPATH=$(dirname $0)
+trace=$1
+events=${2:-100000000}
+traceEvents=$3
+
+if [ -z "$trace" ]; then
+  echo "Usage: $0 trace [events [trace events]]"
+  exit 1
+fi
+
+if [ -z "$traceEvents" ]; then
+  traceEvents=$(babeltrace "$trace" | wc -l)
+fi
+
+if [ -z "$traceEvents" -o "$traceEvents" -eq 0 ]; then
+  echo "$0: no event in $trace"
+  exit 1
+fi
+
+runs=$(( (events + traceEvents - 1) / traceEvents ))
+echo "Dumping $trace ($traceEvents events) $runs times, $(( runs * traceEvents )) events"
+
+start=$(date +%s.%N)
+i=0
+while [ $i -lt $runs ]; do
+  "$BUILDPATH/runlttv" -m text -a "-o /dev/null" "$trace" || exit 1
+  i=$(( i + 1 ))
+done
+end=$(date +%s.%N)
+
+echo "$start $end $(( runs * traceEvents ))" | awk '{
+  time = $2 - $1
+  printf "%.3f s, %.0f events/s\n", time, $3 / time
+}'
@@ -3,11 +3,12 @@
 
 #include <lttv/event.h>
 #include <lttv/time.h>
+#include <lttv/traceset.h>
 #include <babeltrace/ctf/events.h>
 
 LttTime lttv_event_get_timestamp(LttvEvent *event)
 {
-  return ltt_time_from_uint64(bt_ctf_get_timestamp(event->bt_event));
+  return ltt_time_from_uint64(event->timestamp);
 }
 
 //TODO ybrosseau find a way to return an error code
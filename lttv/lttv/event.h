@@ -30,6 +30,11 @@ typedef struct
 {
   struct bt_ctf_event *bt_event;
   LttvTraceState *state;
+  /* Timestamp in ns with the synchronization correction of the trace
+     applied, computed once by the event loop. The events are delivered in
+     raw time order, so the timestamps of different traces are not ordered
+     when the corrections differ. */
+  guint64 timestamp;
 } LttvEvent;
 
 LttTime lttv_event_get_timestamp(LttvEvent *event);
@@ -257,206 +257,233 @@ void lttv_print_field(LttEvent *e, struct marker_field *f, GString *s,
 	}
 }
 #endif
-int getProcessInfosFromEvent(LttvEvent *event, GString* processInfos)
-{
-	int pid=0, tid=0, ppid=0;
-	const char *procname;
-
-	unsigned long timestamp;
-
-	int ret = 0;
-
-	gboolean noError = TRUE;
-
-	guint cpu;
-	LttvTraceState *state = event->state;
-	LttvProcessState *process;
-	struct bt_ctf_event *ctf_event = event->bt_event;
+/* Field layout of an event class, built from its first printed event. The
+   fields of the later events of the class are printed from the same
+   positions of their field list, without looking up their declarations. */
+typedef struct {
+	const char *name;
+	gsize name_len;
+	enum ctf_type_id type;
+	int is_signed;
+} LttvPrintField;
+
+typedef struct {
+	unsigned int count;
+	LttvPrintField fields[];
+} LttvPrintLayout;
 
-	cpu = lttv_traceset_get_cpuid_from_event(event);
+/* The formatting functions append to the caller's string. Once it has grown
+   to the size of the longest event, printing an event does not allocate. */
 
-	process = state->running_process[cpu];
+static inline void append_string(GString *s, const char *str)
+{
+	/* Same output as printf for a NULL string */
+	g_string_append(s, str != NULL ? str : "(null)");
+}
 
-	timestamp = bt_ctf_get_timestamp(ctf_event);
+static inline void append_uint64(GString *s, guint64 value)
+{
+	char buf[20];
+	char *p = buf + sizeof(buf);
+
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	g_string_append_len(s, p, buf + sizeof(buf) - p);
+}
 
-	pid = process->pid;
-	tid = process->tgid;
-	ppid = process->ppid;
-	procname = g_quark_to_string(process->name);
-	if (timestamp == -1ULL) {
-		noError = FALSE;
-	}
-#if 0
-	if (noError) {
-		scope = bt_ctf_get_top_level_scope(ctf_event, BT_STREAM_EVENT_CONTEXT);
-		if (bt_ctf_field_get_error()) {
-			noError = FALSE;
-		}
-	}
-	if (noError) {
-		pid = bt_ctf_get_int64(bt_ctf_get_field(ctf_event, scope, "_pid"));
-		if (bt_ctf_field_get_error()) {
-			noError = FALSE;
-		}
-	}
-	if (noError) {
-		tid = bt_ctf_get_int64(bt_ctf_get_field(ctf_event, scope, "_tid"));
-		if (bt_ctf_field_get_error()) {
-			noError = FALSE;
-		}
-	}
-	if (noError) {
-		ppid = bt_ctf_get_int64(bt_ctf_get_field(ctf_event, scope, "_ppid"));
-		if (bt_ctf_field_get_error()) {
-			noError = FALSE;
-		}
-	}
-	if (noError) {
-		procname = bt_ctf_get_char_array(bt_ctf_get_field(ctf_event, scope, "_procname"));
-		if (bt_ctf_field_get_error()) {
-			noError = FALSE;
-		}
-	}
-#endif
-	if (noError||1) {
-		g_string_append_printf(processInfos, "%u, %u, %s, %u. %s, %s", pid, tid, procname, ppid, g_quark_to_string(process->state->t), g_quark_to_string(process->state->s));
-	}
-	else {
-		ret = -1;
+static inline void append_int64(GString *s, gint64 value)
+{
+	if (value < 0) {
+		g_string_append_c(s, '-');
+		append_uint64(s, -(guint64) value);
+	} else {
+		append_uint64(s, value);
 	}
+}
 
-	return ret;
+static void append_process_infos(GString *s, LttvEvent *event, guint cpu)
+{
+	LttvProcessState *process = event->state->running_process[cpu];
+
+	append_uint64(s, process->pid);
+	g_string_append_len(s, ", ", 2);
+	append_uint64(s, process->tgid);
+	g_string_append_len(s, ", ", 2);
+	append_string(s, g_quark_to_string(process->name));
+	g_string_append_len(s, ", ", 2);
+	append_uint64(s, process->ppid);
+	g_string_append_len(s, ". ", 2);
+	append_string(s, g_quark_to_string(process->state->t));
+	g_string_append_len(s, ", ", 2);
+	append_string(s, g_quark_to_string(process->state->s));
 }
 
-static
-int getCPUIdFromEvent(LttvEvent *event, GString* cpuId_str)
+static void append_field(GString *s, const struct bt_ctf_event *ctf_event,
+		const struct bt_definition *field, enum ctf_type_id type,
+		int is_signed);
+
+static void append_field_generic(GString *s,
+		const struct bt_ctf_event *ctf_event,
+		const struct bt_definition *field)
 {
-	gint cpuid;
+	const struct bt_declaration *decl = bt_ctf_get_decl_from_def(field);
+	enum ctf_type_id type = bt_ctf_field_type(decl);
 
-	cpuid = lttv_traceset_get_cpuid_from_event(event);
-	if (cpuid < 0) {
-		return -1;
-	}
-	g_string_append_printf(cpuId_str, "%u", cpuid);
-	return 0;
+	append_field(s, ctf_event, field, type, type == CTF_TYPE_INTEGER ?
+		bt_ctf_get_int_signedness(decl) : -1);
 }
 
-int getFields(struct bt_ctf_event *ctf_event, struct bt_definition const *fields, GString* fieldsStr)
+static void append_field(GString *s, const struct bt_ctf_event *ctf_event,
+		const struct bt_definition *field, enum ctf_type_id type,
+		int is_signed)
 {
-	enum ctf_type_id fieldType = bt_ctf_field_type(bt_ctf_get_decl_from_def(fields));
-	int ret = 0, isSigned = -1, len = 0, i = 0;
-	const struct bt_definition *index_def; 
-	switch (fieldType) {
+	int len, i;
+
+	switch (type) {
 	case CTF_TYPE_INTEGER:
-		isSigned = bt_ctf_get_int_signedness(bt_ctf_get_decl_from_def(fields));
-		if (isSigned == 1) {
-			g_string_append_printf(fieldsStr, "%lu", bt_ctf_get_int64(fields));
-		}
-		else if (isSigned == 0) {
-			g_string_append_printf(fieldsStr, "%" PRIu64 , bt_ctf_get_uint64(fields));
-		}
+		if (is_signed == 1)
+			append_int64(s, bt_ctf_get_int64(field));
+		else if (is_signed == 0)
+			append_uint64(s, bt_ctf_get_uint64(field));
 		break;
 	case CTF_TYPE_STRING:
-		g_string_append_printf(fieldsStr, "%s", bt_ctf_get_string(fields));
+		append_string(s, bt_ctf_get_string(field));
 		break;
 
 	case CTF_TYPE_ARRAY:
-		g_string_append_printf(fieldsStr, "[ ");
-		len = bt_ctf_get_array_len(bt_ctf_get_decl_from_def(fields));
-		if ((index_def = bt_ctf_get_index(ctf_event, fields, i))) {
+		g_string_append_len(s, "[ ", 2);
+		len = bt_ctf_get_array_len(bt_ctf_get_decl_from_def(field));
+		if (bt_ctf_get_index(ctf_event, field, 0)) {
 			for (i = 0; i < len; i++) {
-				if (i > 0) {
-					g_string_append_printf(fieldsStr, ", ");
-				}
-				//bt_ctf_field_type( bt_ctf_get_index(ctf_event, fields, i));
-				g_string_append_printf(fieldsStr, " ");
-				g_string_append_printf(fieldsStr, "[%d] = ",i);
-				getFields(ctf_event, bt_ctf_get_index(ctf_event, fields, i), fieldsStr);
+				if (i > 0)
+					g_string_append_len(s, ", ", 2);
+				g_string_append_len(s, " [", 2);
+				append_uint64(s, i);
+				g_string_append_len(s, "] = ", 4);
+				append_field_generic(s, ctf_event,
+					bt_ctf_get_index(ctf_event, field, i));
 			}
+		} else {
+			append_string(s, bt_ctf_get_char_array(field));
 		}
-		else {
-			g_string_append_printf(fieldsStr, "%s", bt_ctf_get_char_array(fields));
-		}
-		g_string_append_printf(fieldsStr, " ]");
-
+		g_string_append_len(s, " ]", 2);
 		break;
 	case CTF_TYPE_UNKNOWN:
-		g_string_append_printf(fieldsStr, "TYPE UNKNOWN");
+		g_string_append(s, "TYPE UNKNOWN");
 	default:
-		g_string_append_printf(fieldsStr, "TYPE UNIMP %i",fieldType );
+		g_string_append(s, "TYPE UNIMP ");
+		append_int64(s, type);
 		break;
 	}
-	return ret;
 }
 
-int getFieldsFromEvent(struct bt_ctf_event *ctf_event, GString* fields, gboolean field_names)
+static const LttvPrintLayout *get_layout(LttvTrace *trace,
+		const struct bt_ctf_event *ctf_event,
+		struct bt_definition const * const *list, unsigned int count)
+{
+	const struct bt_ctf_event_decl *event_decl;
+	LttvPrintLayout *layout;
+	unsigned int i;
+
+	if (trace->print_layouts == NULL)
+		trace->print_layouts = g_hash_table_new_full(g_direct_hash,
+				g_direct_equal, NULL, g_free);
+
+	event_decl = bt_ctf_event_get_decl(ctf_event);
+	layout = g_hash_table_lookup(trace->print_layouts, event_decl);
+	if (layout != NULL && layout->count == count)
+		return layout;
+
+	layout = g_malloc(sizeof(LttvPrintLayout) +
+			count * sizeof(LttvPrintField));
+	layout->count = count;
+	for (i = 0; i < count; i++) {
+		const struct bt_declaration *decl =
+			bt_ctf_get_decl_from_def(list[i]);
+		LttvPrintField *f = &layout->fields[i];
+
+		f->name = bt_ctf_field_name(list[i]);
+		f->name_len = f->name != NULL ? strlen(f->name) : 0;
+		f->type = bt_ctf_field_type(decl);
+		f->is_signed = f->type == CTF_TYPE_INTEGER ?
+			bt_ctf_get_int_signedness(decl) : -1;
+	}
+	g_hash_table_replace(trace->print_layouts, (gpointer) event_decl,
+			layout);
+
+	return layout;
+}
+
+static void append_fields(GString *s, LttvEvent *event, gboolean field_names)
 {
+	struct bt_ctf_event *ctf_event = event->bt_event;
 	struct bt_definition const * const *list = NULL;
-	unsigned int count;
-	int i = 0, ret = 0;
-	gboolean noError = TRUE;
 	const struct bt_definition *scope;
-	scope = bt_ctf_get_top_level_scope(ctf_event, BT_EVENT_FIELDS);
+	const LttvPrintLayout *layout;
+	unsigned int count, i;
 
-	if (!scope) {
-		noError = FALSE;
-	}
-	if (noError) {
-		ret = bt_ctf_get_field_list(ctf_event, scope, &list, &count);
-		if (ret < 0) {
-			noError = TRUE;
-		}
-		else {
-			for (i = 0; i < count; i++) {
-				if (i > 0) {
-					g_string_append_printf(fields, ", ");
-				}
-				const char *name = bt_ctf_field_name(list[i]);
-				if (field_names) {
-					g_string_append_printf(fields, "%s = ", name);
-				}
-				getFields(ctf_event, list[i] ,fields);
-				if (bt_ctf_field_get_error()) {
-					continue;
-				}
-			}
+	scope = bt_ctf_get_top_level_scope(ctf_event, BT_EVENT_FIELDS);
+	if (!scope)
+		return;
+	if (bt_ctf_get_field_list(ctf_event, scope, &list, &count) < 0)
+		return;
+
+	layout = get_layout(event->state->trace, ctf_event, list, count);
+	for (i = 0; i < count; i++) {
+		const LttvPrintField *f = &layout->fields[i];
+
+		if (i > 0)
+			g_string_append_len(s, ", ", 2);
+		if (field_names) {
+			append_string(s, f->name);
+			g_string_append_len(s, " = ", 3);
 		}
+		append_field(s, ctf_event, list[i], f->type, f->is_signed);
 	}
-	if (!noError) {
-			ret = -1;
-	}
-	return ret;
+}
+
+void lttv_string_append_uint64(GString *a_string, guint64 value)
+{
+	append_uint64(a_string, value);
+}
+
+void lttv_event_append_fields(LttvEvent *event, GString *a_string,
+				gboolean field_names)
+{
+	append_fields(a_string, event, field_names);
 }
 
 void lttv_event_to_string(LttvEvent *event, GString *a_string,
 				gboolean field_names, gboolean long_version)
 {
-	GString* processInfos = g_string_new("");
-	GString* fields = g_string_new("");
-	GString* cpuId_str = g_string_new("");
+	guint cpu;
+	gsize len;
 
-	getProcessInfosFromEvent(event, processInfos);
-	getFieldsFromEvent(event->bt_event, fields, field_names);
-	getCPUIdFromEvent(event, cpuId_str);
+	cpu = lttv_traceset_get_cpuid_from_event(event);
 
 	g_string_set_size(a_string,0);
 	if(long_version){
-		g_string_append_printf(a_string,"%" PRIu64 " %s: ", 
-				       bt_ctf_get_timestamp(event->bt_event), 
-				       bt_ctf_event_name(event->bt_event));
-	}
-	g_string_append_printf(a_string, "{ %s }", cpuId_str->str);
-	
-	if (strcmp("", processInfos->str) < 0) {
-		g_string_append_printf(a_string, ", { %s }", processInfos->str);
+		append_uint64(a_string, event->timestamp);
+		g_string_append_c(a_string, ' ');
+		append_string(a_string, bt_ctf_event_name(event->bt_event));
+		g_string_append_len(a_string, ": ", 2);
 	}
-	if (strcmp("", fields->str) < 0) {
-		g_string_append_printf(a_string, ", { %s }", fields->str);
-	}
-
-	g_string_free(fields, TRUE);
-	g_string_free(processInfos, TRUE);
-	g_string_free(cpuId_str, TRUE);
+	g_string_append_len(a_string, "{ ", 2);
+	append_uint64(a_string, cpu);
+	g_string_append_len(a_string, " }, { ", 6);
+	append_process_infos(a_string, event, cpu);
+	g_string_append_len(a_string, " }", 2);
+
+	/* The fields are written in place and removed if there are none */
+	len = a_string->len;
+	g_string_append_len(a_string, ", { ", 4);
+	append_fields(a_string, event, field_names);
+	if (a_string->len == len + 4)
+		g_string_truncate(a_string, len);
+	else
+		g_string_append_len(a_string, " }", 2);
 }
 void lttv_event_get_name(LttvEvent *event,GString *a_string)
 {
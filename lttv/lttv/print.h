@@ -38,3 +38,9 @@ void lttv_event_to_string(LttvEvent *event,
 			  gboolean long_version);
 void lttv_event_get_name(LttvEvent *event,GString *a_string);
 
+/* Append without going through printf, for formatters called per event */
+void lttv_string_append_uint64(GString *a_string, guint64 value);
+/* Append the payload fields of an event, separated by ", " */
+void lttv_event_append_fields(LttvEvent *event, GString *a_string,
+			      gboolean field_names);
+
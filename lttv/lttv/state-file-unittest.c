@@ -0,0 +1,481 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks of the state files, run by "make check". Snapshots are written,
+   then restored in another state that must be the same.
+
+   The test covers the serialization only: state-file.c is tested alone. The
+   functions of state.c and traceset.c that it calls are replaced by the
+   minimal versions below, so that the test does not need a trace. Whether
+   a restored state lets the state engine go on like the original one is
+   not checked here. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <lttv/state-file.h>
+
+#define NB_CPUS 2
+#define NB_IRQS 4
+#define NB_SOFT_IRQS 3
+#define NB_TRAPS 2
+
+static const guint8 trace_uuid[LTTV_STATE_FILE_UUID_LEN] = {
+	0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0,
+	0x0f, 0xed, 0xcb, 0xa9, 0x87, 0x65, 0x43, 0x21,
+};
+
+guint lttv_trace_get_num_cpu(LttvTrace *t)
+{
+	return NB_CPUS;
+}
+
+static guint process_hash(gconstpointer key)
+{
+	return ((const LttvProcessState *)key)->pid;
+}
+
+static gboolean process_equal(gconstpointer a, gconstpointer b)
+{
+	const LttvProcessState *process_a = a, *process_b = b;
+
+	return process_a->pid == process_b->pid &&
+		(process_a->pid != 0 || process_a->cpu == process_b->cpu);
+}
+
+LttvProcessState *lttv_state_find_process(LttvTraceState *ts, guint cpu,
+		guint pid)
+{
+	LttvProcessState key;
+
+	key.pid = pid;
+	key.cpu = cpu;
+	return g_hash_table_lookup(ts->processes, &key);
+}
+
+static void set_execution_state(LttvExecutionState *es, const char *mode,
+		const char *submode, const char *status, guint64 entry)
+{
+	es->t = g_quark_from_string(mode);
+	es->n = g_quark_from_string(submode);
+	es->s = g_quark_from_string(status);
+	es->entry = ltt_time_from_uint64(entry);
+	es->change = ltt_time_from_uint64(entry + 10);
+	es->cum_cpu_time = ltt_time_from_uint64(entry / 2);
+}
+
+LttvProcessState *lttv_state_create_process(LttvTraceState *tcs,
+		LttvProcessState *parent, guint cpu, guint pid, guint tgid,
+		GQuark name, const LttTime *timestamp)
+{
+	LttvProcessState *process = g_new0(LttvProcessState, 1);
+
+	process->pid = pid;
+	process->tgid = tgid;
+	process->cpu = cpu;
+	process->name = name;
+	process->insertion_time = *timestamp;
+	process->execution_stack = g_array_new(FALSE, FALSE,
+			sizeof(LttvExecutionState));
+	g_array_set_size(process->execution_stack, 1);
+	process->state = &g_array_index(process->execution_stack,
+			LttvExecutionState, 0);
+	set_execution_state(process->state, "MODE_UNKNOWN", "UNNAMED",
+			"UNNAMED", 0);
+	g_hash_table_insert(tcs->processes, process, process);
+	return process;
+}
+
+static void free_process(gpointer data)
+{
+	LttvProcessState *process = data;
+
+	g_array_free(process->execution_stack, TRUE);
+	g_free(process);
+}
+
+/* The initial state: one idle process per cpu and idle resources. Like in
+   state.c, the block devices are kept. */
+void lttv_trace_state_reset(LttvTraceState *self)
+{
+	guint i;
+
+	if(self->processes != NULL)
+		g_hash_table_destroy(self->processes);
+	self->processes = g_hash_table_new_full(process_hash, process_equal,
+			NULL, free_process);
+	for(i = 0; i < NB_CPUS; i++) {
+		self->running_process[i] = lttv_state_create_process(self,
+				NULL, i, 0, 0, 0, &ltt_time_zero);
+		g_array_set_size(self->cpu_states[i].mode_stack, 0);
+		g_array_set_size(self->cpu_states[i].irq_stack, 0);
+		g_array_set_size(self->cpu_states[i].softirq_stack, 0);
+		g_array_set_size(self->cpu_states[i].trap_stack, 0);
+	}
+	for(i = 0; i < self->name_tables->nb_irqs; i++)
+		g_array_set_size(self->irq_states[i].mode_stack, 0);
+	for(i = 0; i < self->name_tables->nb_soft_irqs; i++) {
+		self->soft_irq_states[i].pending = 0;
+		self->soft_irq_states[i].running = 0;
+	}
+	for(i = 0; i < self->name_tables->nb_traps; i++)
+		self->trap_states[i].running = 0;
+}
+
+void lttv_trace_state_expand_irq_tables(LttvTraceState *self, guint nb_irqs,
+		guint nb_soft_irqs)
+{
+	LttvNameTables *nt = self->name_tables;
+	guint i;
+
+	if(nb_irqs > nt->nb_irqs) {
+		self->irq_states = g_renew(LttvIRQState, self->irq_states, nb_irqs);
+		for(i = nt->nb_irqs; i < nb_irqs; i++)
+			self->irq_states[i].mode_stack = g_array_new(FALSE, FALSE,
+					sizeof(LttvIRQMode));
+		nt->nb_irqs = nb_irqs;
+	}
+	if(nb_soft_irqs > nt->nb_soft_irqs) {
+		self->soft_irq_states = g_renew(LttvSoftIRQState,
+				self->soft_irq_states, nb_soft_irqs);
+		for(i = nt->nb_soft_irqs; i < nb_soft_irqs; i++) {
+			self->soft_irq_states[i].pending = 0;
+			self->soft_irq_states[i].running = 0;
+		}
+		nt->nb_soft_irqs = nb_soft_irqs;
+	}
+}
+
+static void trace_state_init(LttvTraceState *ts)
+{
+	guint i;
+
+	memset(ts, 0, sizeof(*ts));
+	ts->running_process = g_new0(LttvProcessState *, NB_CPUS);
+	ts->name_tables = g_new0(LttvNameTables, 1);
+	ts->cpu_states = g_new(LttvCPUState, NB_CPUS);
+	for(i = 0; i < NB_CPUS; i++) {
+		ts->cpu_states[i].mode_stack = g_array_new(FALSE, FALSE,
+				sizeof(LttvCPUMode));
+		ts->cpu_states[i].irq_stack = g_array_new(FALSE, FALSE,
+				sizeof(gint));
+		ts->cpu_states[i].softirq_stack = g_array_new(FALSE, FALSE,
+				sizeof(gint));
+		ts->cpu_states[i].trap_stack = g_array_new(FALSE, FALSE,
+				sizeof(gint));
+	}
+	lttv_trace_state_expand_irq_tables(ts, NB_IRQS, NB_SOFT_IRQS);
+	ts->name_tables->nb_traps = NB_TRAPS;
+	ts->trap_states = g_new0(LttvTrapState, NB_TRAPS);
+	ts->bdev_states = g_hash_table_new(g_int_hash, g_int_equal);
+	lttv_trace_state_reset(ts);
+}
+
+static void push_quark(GArray *stack, const char *name)
+{
+	GQuark q = g_quark_from_string(name);
+
+	g_array_append_val(stack, q);
+}
+
+static void push_int(GArray *stack, gint number)
+{
+	g_array_append_val(stack, number);
+}
+
+static void add_bdev(LttvTraceState *ts, gint devcode, const char *mode)
+{
+	LttvBdevState *bdev = g_new(LttvBdevState, 1);
+	gint *key = g_new(gint, 1);
+
+	*key = devcode;
+	bdev->mode_stack = g_array_new(FALSE, FALSE, sizeof(GQuark));
+	push_quark(bdev->mode_stack, mode);
+	g_hash_table_insert(ts->bdev_states, key, bdev);
+}
+
+/* Busy resources. The second state has more irqs than the initial state,
+   the tables of the restored state must grow. */
+static void set_resources(LttvTraceState *ts, guint nb_irqs, gint devcode)
+{
+	lttv_trace_state_expand_irq_tables(ts, nb_irqs, NB_SOFT_IRQS);
+
+	push_quark(ts->cpu_states[0].mode_stack, "BUSY");
+	push_quark(ts->cpu_states[0].mode_stack, "IRQ");
+	push_int(ts->cpu_states[0].irq_stack, nb_irqs - 1);
+	push_int(ts->cpu_states[1].softirq_stack, 2);
+	push_int(ts->cpu_states[1].trap_stack, 1);
+	push_quark(ts->irq_states[nb_irqs - 1].mode_stack, "BUSY");
+	ts->soft_irq_states[2].pending = 1;
+	ts->soft_irq_states[2].running = 1;
+	ts->trap_states[1].running = 1;
+	add_bdev(ts, devcode, "BUSY");
+}
+
+static void check_stack(GArray *stack, GArray *copy)
+{
+	g_assert(copy->len == stack->len);
+	g_assert(stack->len == 0 || memcmp(copy->data, stack->data,
+			stack->len * sizeof(guint32)) == 0);
+}
+
+static void check_bdev(gpointer key, gpointer value, gpointer user_data)
+{
+	LttvBdevState *bdev = value;
+	LttvTraceState *restored = user_data;
+	LttvBdevState *copy;
+
+	copy = g_hash_table_lookup(restored->bdev_states, key);
+	g_assert(copy != NULL);
+	check_stack(bdev->mode_stack, copy->mode_stack);
+}
+
+static void count_busy_bdev(gpointer key, gpointer value, gpointer user_data)
+{
+	if(((LttvBdevState *)value)->mode_stack->len > 0)
+		(*(guint *)user_data)++;
+}
+
+static guint count_busy_bdevs(LttvTraceState *ts)
+{
+	guint nb = 0;
+
+	g_hash_table_foreach(ts->bdev_states, count_busy_bdev, &nb);
+	return nb;
+}
+
+static void check_resources(LttvTraceState *ts, LttvTraceState *restored)
+{
+	guint i;
+
+	for(i = 0; i < NB_CPUS; i++) {
+		check_stack(ts->cpu_states[i].mode_stack,
+				restored->cpu_states[i].mode_stack);
+		check_stack(ts->cpu_states[i].irq_stack,
+				restored->cpu_states[i].irq_stack);
+		check_stack(ts->cpu_states[i].softirq_stack,
+				restored->cpu_states[i].softirq_stack);
+		check_stack(ts->cpu_states[i].trap_stack,
+				restored->cpu_states[i].trap_stack);
+	}
+	g_assert(restored->name_tables->nb_irqs >= ts->name_tables->nb_irqs);
+	for(i = 0; i < ts->name_tables->nb_irqs; i++)
+		check_stack(ts->irq_states[i].mode_stack,
+				restored->irq_states[i].mode_stack);
+	for(i = 0; i < ts->name_tables->nb_soft_irqs; i++) {
+		g_assert(restored->soft_irq_states[i].pending ==
+				ts->soft_irq_states[i].pending);
+		g_assert(restored->soft_irq_states[i].running ==
+				ts->soft_irq_states[i].running);
+	}
+	for(i = 0; i < ts->name_tables->nb_traps; i++)
+		g_assert(restored->trap_states[i].running ==
+				ts->trap_states[i].running);
+
+	/* The block devices of another snapshot are idle */
+	g_hash_table_foreach(ts->bdev_states, check_bdev, restored);
+	g_assert(count_busy_bdevs(restored) ==
+			g_hash_table_size(ts->bdev_states));
+}
+
+/* Write a fake stream whose packet header has the magic and the uuid of a
+   trace, and return the trace directory */
+static char *make_trace_dir(void)
+{
+	char *dir = g_strdup("/tmp/lttv-state-trace-XXXXXX");
+	char *path;
+	guint32 magic = 0xC1FC1FC1;
+	FILE *fp;
+
+	g_assert(mkdtemp(dir) != NULL);
+	path = g_build_filename(dir, "channel0_0", NULL);
+	fp = fopen(path, "w");
+	g_assert(fp != NULL);
+	fwrite(&magic, sizeof(magic), 1, fp);
+	fwrite(trace_uuid, 1, sizeof(trace_uuid), fp);
+	fclose(fp);
+	g_free(path);
+	return dir;
+}
+
+static LttvProcessState *add_process(LttvTraceState *ts, guint cpu,
+		guint pid, const char *name, guint nb_execution_states)
+{
+	LttTime creation_time = ltt_time_from_uint64(pid * 1000);
+	LttvProcessState *process;
+	guint i;
+
+	process = lttv_state_create_process(ts, NULL, cpu, pid, pid,
+			g_quark_from_string(name), &creation_time);
+	process->ppid = 1;
+	process->creation_time = creation_time;
+	process->type = g_quark_from_string("USER_THREAD");
+	process->free_events = pid % 3;
+	g_array_set_size(process->execution_stack, nb_execution_states);
+	for(i = 0; i < nb_execution_states; i++)
+		set_execution_state(&g_array_index(process->execution_stack,
+				LttvExecutionState, i), i == 0 ? "USER_MODE" : "SYSCALL",
+				i == 0 ? "NONE" : name, "RUN", pid * 1000 + i);
+	process->state = &g_array_index(process->execution_stack,
+			LttvExecutionState, nb_execution_states - 1);
+	return process;
+}
+
+static void check_process(gpointer key, gpointer value, gpointer user_data)
+{
+	LttvProcessState *process = value;
+	LttvTraceState *restored = user_data;
+	LttvProcessState *copy;
+	guint i;
+
+	copy = lttv_state_find_process(restored, process->cpu, process->pid);
+	g_assert(copy != NULL);
+	g_assert(copy->tgid == process->tgid);
+	g_assert(copy->ppid == process->ppid);
+	g_assert(copy->cpu == process->cpu);
+	g_assert(copy->name == process->name);
+	g_assert(copy->type == process->type);
+	g_assert(copy->free_events == process->free_events);
+	g_assert(ltt_time_compare(copy->creation_time,
+			process->creation_time) == 0);
+	g_assert(ltt_time_compare(copy->insertion_time,
+			process->insertion_time) == 0);
+
+	g_assert(copy->execution_stack->len == process->execution_stack->len);
+	for(i = 0; i < process->execution_stack->len; i++) {
+		LttvExecutionState *es = &g_array_index(process->execution_stack,
+				LttvExecutionState, i);
+		LttvExecutionState *es_copy = &g_array_index(copy->execution_stack,
+				LttvExecutionState, i);
+
+		g_assert(es_copy->t == es->t);
+		g_assert(es_copy->n == es->n);
+		g_assert(es_copy->s == es->s);
+		g_assert(ltt_time_compare(es_copy->entry, es->entry) == 0);
+		g_assert(ltt_time_compare(es_copy->change, es->change) == 0);
+		g_assert(ltt_time_compare(es_copy->cum_cpu_time,
+				es->cum_cpu_time) == 0);
+	}
+	g_assert(copy->state == &g_array_index(copy->execution_stack,
+			LttvExecutionState, copy->execution_stack->len - 1));
+}
+
+/* Restore a snapshot in restored and check that it is the same as ts */
+static void check_restore(const LttvStateFile *file, guint64 snapshot,
+		LttvTraceState *ts, LttvTraceState *restored)
+{
+	guint cpu;
+
+	lttv_state_file_restore(file, snapshot, restored);
+	check_resources(ts, restored);
+	g_assert(g_hash_table_size(restored->processes) ==
+			g_hash_table_size(ts->processes));
+	g_hash_table_foreach(ts->processes, check_process, restored);
+	for(cpu = 0; cpu < NB_CPUS; cpu++) {
+		g_assert(restored->running_process[cpu]->pid ==
+				ts->running_process[cpu]->pid);
+		g_assert(restored->running_process[cpu]->cpu ==
+				ts->running_process[cpu]->cpu);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	LttvTraceState first, second, restored;
+	LttvStateFileWriter *writer;
+	LttvStateFile *file;
+	char path[] = "/tmp/lttv-state-file-XXXXXX";
+	guint8 uuid[LTTV_STATE_FILE_UUID_LEN];
+	char *trace_dir, *stream_path;
+	int fd;
+
+	fd = mkstemp(path);
+	g_assert(fd >= 0);
+	close(fd);
+
+	/* The uuid is read in the packet header of a stream */
+	trace_dir = make_trace_dir();
+	g_assert(lttv_state_file_get_trace_uuid(trace_dir, uuid));
+	g_assert(memcmp(uuid, trace_uuid, sizeof(uuid)) == 0);
+	stream_path = g_build_filename(trace_dir, "channel0_0", NULL);
+	unlink(stream_path);
+	g_free(stream_path);
+	g_assert(!lttv_state_file_get_trace_uuid(trace_dir, uuid));
+	rmdir(trace_dir);
+	g_free(trace_dir);
+
+	/* Two snapshots, the second one has a new process and another one
+	   running on cpu 0 */
+	trace_state_init(&first);
+	first.running_process[1] = add_process(&first, 1, 42, "bash", 3);
+	add_process(&first, 0, 43, "make", 1);
+	set_resources(&first, NB_IRQS, 8);
+
+	trace_state_init(&second);
+	second.running_process[1] = add_process(&second, 1, 42, "bash", 2);
+	add_process(&second, 0, 43, "make", 1);
+	second.running_process[0] = add_process(&second, 0, 44, "cc1", 4);
+	set_resources(&second, NB_IRQS + 2, 16);
+
+	writer = lttv_state_file_writer_new(path, NB_CPUS, trace_uuid);
+	g_assert(writer != NULL);
+	lttv_state_file_write_start(writer, &first, ltt_time_from_uint64(1000));
+	lttv_state_file_write(writer, &second, ltt_time_from_uint64(2000));
+	g_assert(lttv_state_file_writer_close(writer));
+
+	/* The file of another trace is refused */
+	uuid[0]++;
+	g_assert(lttv_state_file_open(path, NB_CPUS, uuid) == NULL);
+	g_assert(lttv_state_file_open(path, NB_CPUS, NULL) == NULL);
+	g_assert(lttv_state_file_open(path, NB_CPUS + 1, trace_uuid) == NULL);
+
+	file = lttv_state_file_open(path, NB_CPUS, trace_uuid);
+	g_assert(file != NULL);
+	g_assert(lttv_state_file_get_nb_snapshots(file) == 2);
+	g_assert(ltt_time_compare(lttv_state_file_get_time(file, 1),
+			ltt_time_from_uint64(2000)) == 0);
+	g_assert(lttv_state_file_find(file,
+			ltt_time_from_uint64(999)) == -1);
+	g_assert(lttv_state_file_find(file,
+			ltt_time_from_uint64(1000)) == 0);
+	g_assert(lttv_state_file_find(file,
+			ltt_time_from_uint64(1999)) == 0);
+	g_assert(lttv_state_file_find(file,
+			ltt_time_from_uint64(5000)) == 1);
+	g_assert(lttv_state_file_is_start(file, 0));
+	g_assert(!lttv_state_file_is_start(file, 1));
+
+	/* Restore in a state that already has processes, like when seeking
+	   back in a trace */
+	trace_state_init(&restored);
+	check_restore(file, 1, &second, &restored);
+	check_restore(file, 0, &first, &restored);
+	check_restore(file, 1, &second, &restored);
+
+	lttv_state_file_close(file);
+	unlink(path);
+
+	/* A file that is not a state file is refused */
+	g_assert(lttv_state_file_open(argv[0], NB_CPUS, trace_uuid) == NULL);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,844 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <lttv/lttv.h>
+#include <lttv/traceset.h>
+#include <lttv/state-file.h>
+
+/* Magic number of the CTF packet headers */
+#define CTF_MAGIC 0xC1FC1FC1
+
+struct _LttvStateFileWriter {
+	char *path;
+	char *tmp_path;		/* renamed to path when closing */
+	FILE *fp;		/* header and processes */
+	FILE *es_fp;		/* execution states, appended when closing */
+	LttvStateFileHeader header;
+	GArray *snapshots;	/* LttvStateFileSnapshot */
+	GArray *running;	/* guint32, nb_cpus per snapshot */
+	GArray *cpus;		/* LttvStateFileCPU, nb_cpus per snapshot */
+	GArray *irqs;		/* LttvStateFileIRQ */
+	GArray *soft_irqs;	/* LttvStateFileSoftIRQ */
+	GArray *traps;		/* LttvStateFileTrap */
+	GArray *bdevs;		/* LttvStateFileBdev */
+	GArray *stack_entries;	/* guint32 */
+	GHashTable *string_ids;	/* GQuark -> string index */
+	GArray *strings;	/* GQuark of each string index */
+};
+
+struct _LttvStateFile {
+	void *map;
+	gsize size;
+	const LttvStateFileHeader *header;
+	const LttvStateFileSnapshot *snapshots;
+	const guint32 *running;
+	const LttvStateFileCPU *cpus;
+	const LttvStateFileProcess *processes;
+	const LttvStateFileExecutionState *execution_states;
+	const LttvStateFileIRQ *irqs;
+	const LttvStateFileSoftIRQ *soft_irqs;
+	const LttvStateFileTrap *traps;
+	const LttvStateFileBdev *bdevs;
+	const guint32 *stack_entries;
+	GQuark *quarks;		/* quark of each string index */
+};
+
+gboolean lttv_state_file_get_trace_uuid(const char *trace_path, guint8 *uuid)
+{
+	struct {
+		guint32 magic;
+		guint8 uuid[LTTV_STATE_FILE_UUID_LEN];
+	} __attribute__((packed)) header;
+	GDir *dir;
+	const char *name;
+	gboolean found = FALSE;
+
+	dir = g_dir_open(trace_path, 0, NULL);
+	if(dir == NULL)
+		return FALSE;
+
+	while(!found && (name = g_dir_read_name(dir)) != NULL) {
+		char *path;
+		FILE *fp;
+
+		if(name[0] == '.' || strcmp(name, "metadata") == 0)
+			continue;
+		path = g_build_filename(trace_path, name, NULL);
+		fp = fopen(path, "rb");
+		g_free(path);
+		if(fp == NULL)
+			continue;
+		if(fread(&header, sizeof(header), 1, fp) == 1 &&
+				(header.magic == CTF_MAGIC ||
+				 header.magic == GUINT32_SWAP_LE_BE(CTF_MAGIC))) {
+			memcpy(uuid, header.uuid, LTTV_STATE_FILE_UUID_LEN);
+			found = TRUE;
+		}
+		fclose(fp);
+	}
+	g_dir_close(dir);
+
+	return found;
+}
+
+LttvStateFileWriter *lttv_state_file_writer_new(const char *path,
+		guint nb_cpus, const guint8 *uuid)
+{
+	LttvStateFileWriter *writer;
+	GQuark null_quark = 0;
+
+	/* The file of a trace is mapped while the trace is open, so it is
+	   replaced instead of being truncated */
+	writer = g_new0(LttvStateFileWriter, 1);
+	writer->path = g_strdup(path);
+	writer->tmp_path = g_strdup_printf("%s.tmp", path);
+	writer->fp = fopen(writer->tmp_path, "w");
+	if(writer->fp == NULL) {
+		g_free(writer->path);
+		g_free(writer->tmp_path);
+		g_free(writer);
+		return NULL;
+	}
+	writer->es_fp = tmpfile();
+	if(writer->es_fp == NULL) {
+		fclose(writer->fp);
+		unlink(writer->tmp_path);
+		g_free(writer->path);
+		g_free(writer->tmp_path);
+		g_free(writer);
+		return NULL;
+	}
+
+	writer->header.magic = LTTV_STATE_FILE_MAGIC;
+	writer->header.version = LTTV_STATE_FILE_VERSION;
+	writer->header.byte_order = LTTV_STATE_FILE_BYTE_ORDER;
+	writer->header.word_size = sizeof(void *);
+	writer->header.nb_cpus = nb_cpus;
+	if(uuid != NULL)
+		memcpy(writer->header.uuid, uuid, LTTV_STATE_FILE_UUID_LEN);
+	writer->header.processes_offset = sizeof(LttvStateFileHeader);
+
+	writer->snapshots = g_array_new(FALSE, FALSE,
+			sizeof(LttvStateFileSnapshot));
+	writer->running = g_array_new(FALSE, FALSE, sizeof(guint32));
+	writer->cpus = g_array_new(FALSE, FALSE, sizeof(LttvStateFileCPU));
+	writer->irqs = g_array_new(FALSE, FALSE, sizeof(LttvStateFileIRQ));
+	writer->soft_irqs = g_array_new(FALSE, FALSE,
+			sizeof(LttvStateFileSoftIRQ));
+	writer->traps = g_array_new(FALSE, FALSE, sizeof(LttvStateFileTrap));
+	writer->bdevs = g_array_new(FALSE, FALSE, sizeof(LttvStateFileBdev));
+	writer->stack_entries = g_array_new(FALSE, FALSE, sizeof(guint32));
+	writer->string_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+	writer->strings = g_array_new(FALSE, FALSE, sizeof(GQuark));
+	g_array_append_val(writer->strings, null_quark);
+
+	/* The header is written again when closing, with the tables offsets */
+	fwrite(&writer->header, sizeof(writer->header), 1, writer->fp);
+
+	return writer;
+}
+
+static guint32 string_id(LttvStateFileWriter *writer, GQuark q)
+{
+	gpointer id;
+
+	if(q == 0)
+		return 0;
+
+	id = g_hash_table_lookup(writer->string_ids, GUINT_TO_POINTER(q));
+	if(id == NULL) {
+		id = GUINT_TO_POINTER(writer->strings->len);
+		g_array_append_val(writer->strings, q);
+		g_hash_table_insert(writer->string_ids, GUINT_TO_POINTER(q), id);
+	}
+	return GPOINTER_TO_UINT(id);
+}
+
+static void write_process(gpointer key, gpointer value, gpointer user_data)
+{
+	LttvStateFileWriter *writer = (LttvStateFileWriter *)user_data;
+	LttvProcessState *process = (LttvProcessState *)value;
+	LttvStateFileProcess record;
+	guint i;
+
+	memset(&record, 0, sizeof(record));
+	record.creation_time = ltt_time_to_uint64(process->creation_time);
+	record.insertion_time = ltt_time_to_uint64(process->insertion_time);
+	record.first_execution_state = writer->header.nb_execution_states;
+	record.pid = process->pid;
+	record.tgid = process->tgid;
+	record.ppid = process->ppid;
+	record.cpu = process->cpu;
+	record.name = string_id(writer, process->name);
+	record.type = string_id(writer, process->type);
+	record.free_events = process->free_events;
+	record.nb_execution_states = process->execution_stack->len;
+
+	for(i = 0; i < process->execution_stack->len; i++) {
+		LttvExecutionState *es = &g_array_index(process->execution_stack,
+				LttvExecutionState, i);
+		LttvStateFileExecutionState es_record;
+
+		memset(&es_record, 0, sizeof(es_record));
+		es_record.entry = ltt_time_to_uint64(es->entry);
+		es_record.change = ltt_time_to_uint64(es->change);
+		es_record.cum_cpu_time = ltt_time_to_uint64(es->cum_cpu_time);
+		es_record.mode = string_id(writer, es->t);
+		es_record.submode = string_id(writer, es->n);
+		es_record.status = string_id(writer, es->s);
+		fwrite(&es_record, sizeof(es_record), 1, writer->es_fp);
+	}
+	writer->header.nb_execution_states += process->execution_stack->len;
+
+	fwrite(&record, sizeof(record), 1, writer->fp);
+	writer->header.nb_processes++;
+}
+
+/* Append a stack of quarks to the stack entries */
+static void write_quark_stack(LttvStateFileWriter *writer, GArray *stack)
+{
+	guint i;
+
+	for(i = 0; i < stack->len; i++) {
+		guint32 id = string_id(writer, g_array_index(stack, GQuark, i));
+
+		g_array_append_val(writer->stack_entries, id);
+	}
+}
+
+/* Append a stack of numbers to the stack entries */
+static void write_int_stack(LttvStateFileWriter *writer, GArray *stack)
+{
+	guint i;
+
+	for(i = 0; i < stack->len; i++) {
+		guint32 number = g_array_index(stack, gint, i);
+
+		g_array_append_val(writer->stack_entries, number);
+	}
+}
+
+static void write_bdev(gpointer key, gpointer value, gpointer user_data)
+{
+	LttvStateFileWriter *writer = (LttvStateFileWriter *)user_data;
+	LttvBdevState *bdev = (LttvBdevState *)value;
+	LttvStateFileBdev record;
+
+	memset(&record, 0, sizeof(record));
+	record.first_entry = writer->stack_entries->len;
+	record.devcode = *(gint *)key;
+	record.nb_modes = bdev->mode_stack->len;
+	write_quark_stack(writer, bdev->mode_stack);
+	g_array_append_val(writer->bdevs, record);
+}
+
+void lttv_state_file_write(LttvStateFileWriter *writer, LttvTraceState *ts,
+		LttTime t)
+{
+	LttvStateFileSnapshot snapshot;
+	LttvNameTables *nt = ts->name_tables;
+	guint i, nb_cpus;
+
+	memset(&snapshot, 0, sizeof(snapshot));
+	snapshot.time = ltt_time_to_uint64(t);
+	snapshot.first_process = writer->header.nb_processes;
+
+	g_hash_table_foreach(ts->processes, write_process, writer);
+
+	snapshot.nb_processes = writer->header.nb_processes -
+		snapshot.first_process;
+
+	nb_cpus = lttv_trace_get_num_cpu(ts->trace);
+	for(i = 0; i < writer->header.nb_cpus; i++) {
+		LttvStateFileCPU cpu;
+		guint32 pid = 0;
+
+		memset(&cpu, 0, sizeof(cpu));
+		cpu.first_entry = writer->stack_entries->len;
+		if(i < nb_cpus) {
+			LttvCPUState *state = &ts->cpu_states[i];
+
+			pid = ts->running_process[i]->pid;
+			cpu.nb_modes = state->mode_stack->len;
+			cpu.nb_irqs = state->irq_stack->len;
+			cpu.nb_soft_irqs = state->softirq_stack->len;
+			cpu.nb_traps = state->trap_stack->len;
+			write_quark_stack(writer, state->mode_stack);
+			write_int_stack(writer, state->irq_stack);
+			write_int_stack(writer, state->softirq_stack);
+			write_int_stack(writer, state->trap_stack);
+		}
+		g_array_append_val(writer->running, pid);
+		g_array_append_val(writer->cpus, cpu);
+	}
+
+	snapshot.first_irq = writer->irqs->len;
+	snapshot.nb_irqs = nt->nb_irqs;
+	for(i = 0; i < nt->nb_irqs; i++) {
+		LttvStateFileIRQ irq;
+
+		memset(&irq, 0, sizeof(irq));
+		irq.first_entry = writer->stack_entries->len;
+		irq.nb_modes = ts->irq_states[i].mode_stack->len;
+		write_quark_stack(writer, ts->irq_states[i].mode_stack);
+		g_array_append_val(writer->irqs, irq);
+	}
+
+	snapshot.first_soft_irq = writer->soft_irqs->len;
+	snapshot.nb_soft_irqs = nt->nb_soft_irqs;
+	for(i = 0; i < nt->nb_soft_irqs; i++) {
+		LttvStateFileSoftIRQ soft_irq;
+
+		soft_irq.pending = ts->soft_irq_states[i].pending;
+		soft_irq.running = ts->soft_irq_states[i].running;
+		g_array_append_val(writer->soft_irqs, soft_irq);
+	}
+
+	snapshot.first_trap = writer->traps->len;
+	snapshot.nb_traps = nt->nb_traps;
+	for(i = 0; i < nt->nb_traps; i++) {
+		LttvStateFileTrap trap;
+
+		memset(&trap, 0, sizeof(trap));
+		trap.running = ts->trap_states[i].running;
+		g_array_append_val(writer->traps, trap);
+	}
+
+	snapshot.first_bdev = writer->bdevs->len;
+	g_hash_table_foreach(ts->bdev_states, write_bdev, writer);
+	snapshot.nb_bdevs = writer->bdevs->len - snapshot.first_bdev;
+
+	g_array_append_val(writer->snapshots, snapshot);
+}
+
+void lttv_state_file_write_start(LttvStateFileWriter *writer,
+		LttvTraceState *ts, LttTime t)
+{
+	g_assert(writer->snapshots->len == 0);
+	lttv_state_file_write(writer, ts, t);
+	g_array_index(writer->snapshots, LttvStateFileSnapshot, 0).flags |=
+		LTTV_STATE_FILE_SNAPSHOT_START;
+}
+
+/* Align the next table on 8 bytes */
+static void write_padding(FILE *fp)
+{
+	static const char zeros[8];
+	long pos = ftell(fp);
+
+	fwrite(zeros, 1, (8 - pos % 8) % 8, fp);
+}
+
+gboolean lttv_state_file_writer_close(LttvStateFileWriter *writer)
+{
+	LttvStateFileHeader *header = &writer->header;
+	char buffer[65536];
+	size_t size;
+	guint64 offset;
+	guint i;
+	gboolean ok;
+
+	header->execution_states_offset = ftell(writer->fp);
+	rewind(writer->es_fp);
+	while((size = fread(buffer, 1, sizeof(buffer), writer->es_fp)) > 0)
+		fwrite(buffer, 1, size, writer->fp);
+
+	header->nb_snapshots = writer->snapshots->len;
+	header->snapshots_offset = ftell(writer->fp);
+	fwrite(writer->snapshots->data, sizeof(LttvStateFileSnapshot),
+			writer->snapshots->len, writer->fp);
+
+	header->running_offset = ftell(writer->fp);
+	fwrite(writer->running->data, sizeof(guint32), writer->running->len,
+			writer->fp);
+	write_padding(writer->fp);
+
+	header->cpus_offset = ftell(writer->fp);
+	fwrite(writer->cpus->data, sizeof(LttvStateFileCPU), writer->cpus->len,
+			writer->fp);
+
+	header->nb_irqs = writer->irqs->len;
+	header->irqs_offset = ftell(writer->fp);
+	fwrite(writer->irqs->data, sizeof(LttvStateFileIRQ), writer->irqs->len,
+			writer->fp);
+
+	header->nb_soft_irqs = writer->soft_irqs->len;
+	header->soft_irqs_offset = ftell(writer->fp);
+	fwrite(writer->soft_irqs->data, sizeof(LttvStateFileSoftIRQ),
+			writer->soft_irqs->len, writer->fp);
+
+	header->nb_traps = writer->traps->len;
+	header->traps_offset = ftell(writer->fp);
+	fwrite(writer->traps->data, sizeof(LttvStateFileTrap),
+			writer->traps->len, writer->fp);
+
+	header->nb_bdevs = writer->bdevs->len;
+	header->bdevs_offset = ftell(writer->fp);
+	fwrite(writer->bdevs->data, sizeof(LttvStateFileBdev),
+			writer->bdevs->len, writer->fp);
+
+	header->nb_stack_entries = writer->stack_entries->len;
+	header->stack_entries_offset = ftell(writer->fp);
+	fwrite(writer->stack_entries->data, sizeof(guint32),
+			writer->stack_entries->len, writer->fp);
+	write_padding(writer->fp);
+
+	header->nb_strings = writer->strings->len;
+	header->strings_offset = ftell(writer->fp);
+	offset = 0;
+	for(i = 0; i < writer->strings->len; i++) {
+		const char *s = g_quark_to_string(g_array_index(writer->strings,
+				GQuark, i));
+
+		fwrite(&offset, sizeof(offset), 1, writer->fp);
+		offset += (s != NULL ? strlen(s) : 0) + 1;
+	}
+	header->string_data_offset = ftell(writer->fp);
+	header->string_data_size = offset;
+	for(i = 0; i < writer->strings->len; i++) {
+		const char *s = g_quark_to_string(g_array_index(writer->strings,
+				GQuark, i));
+
+		if(s == NULL)
+			s = "";
+		fwrite(s, 1, strlen(s) + 1, writer->fp);
+	}
+
+	rewind(writer->fp);
+	fwrite(header, sizeof(*header), 1, writer->fp);
+
+	ok = !ferror(writer->fp) && !ferror(writer->es_fp);
+	if(fclose(writer->fp) != 0)
+		ok = FALSE;
+	fclose(writer->es_fp);
+	if(ok && rename(writer->tmp_path, writer->path) != 0)
+		ok = FALSE;
+	if(!ok)
+		unlink(writer->tmp_path);
+
+	g_array_free(writer->snapshots, TRUE);
+	g_array_free(writer->running, TRUE);
+	g_array_free(writer->cpus, TRUE);
+	g_array_free(writer->irqs, TRUE);
+	g_array_free(writer->soft_irqs, TRUE);
+	g_array_free(writer->traps, TRUE);
+	g_array_free(writer->bdevs, TRUE);
+	g_array_free(writer->stack_entries, TRUE);
+	g_hash_table_destroy(writer->string_ids);
+	g_array_free(writer->strings, TRUE);
+	g_free(writer->path);
+	g_free(writer->tmp_path);
+	g_free(writer);
+
+	return ok;
+}
+
+/* Check that a table of nb records of record_size bytes is in the file */
+static gboolean check_table(const LttvStateFile *file, guint64 offset,
+		guint64 nb, gsize record_size)
+{
+	return offset % 8 == 0 && offset <= file->size &&
+		nb <= (file->size - offset) / record_size;
+}
+
+/* Check that a range of nb records from first is in a table of total
+   records */
+static inline gboolean check_range(guint64 first, guint64 nb, guint64 total)
+{
+	return first <= total && nb <= total - first;
+}
+
+LttvStateFile *lttv_state_file_open(const char *path, guint nb_cpus,
+		const guint8 *uuid)
+{
+	static const guint8 no_uuid[LTTV_STATE_FILE_UUID_LEN];
+	LttvStateFile *file;
+	const LttvStateFileHeader *header;
+	const guint64 *string_offsets;
+	const char *string_data;
+	struct stat st;
+	guint64 i;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		g_warning("Cannot open state file %s: %s", path, strerror(errno));
+		return NULL;
+	}
+	if(fstat(fd, &st) < 0 || st.st_size < sizeof(LttvStateFileHeader)) {
+		g_warning("State file %s is too short", path);
+		close(fd);
+		return NULL;
+	}
+
+	file = g_new0(LttvStateFile, 1);
+	file->size = st.st_size;
+	file->map = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(file->map == MAP_FAILED) {
+		g_warning("Cannot map state file %s: %s", path, strerror(errno));
+		g_free(file);
+		return NULL;
+	}
+
+	header = file->header = file->map;
+	if(header->magic != LTTV_STATE_FILE_MAGIC) {
+		g_warning("%s is not a state file", path);
+		goto error;
+	}
+	if(header->byte_order != LTTV_STATE_FILE_BYTE_ORDER) {
+		g_warning("State file %s was written with another byte order",
+				path);
+		goto error;
+	}
+	if(header->version != LTTV_STATE_FILE_VERSION) {
+		g_warning("State file %s has version %u, expected %u", path,
+				header->version, LTTV_STATE_FILE_VERSION);
+		goto error;
+	}
+	if(header->nb_cpus != nb_cpus || memcmp(header->uuid,
+				uuid != NULL ? uuid : no_uuid,
+				LTTV_STATE_FILE_UUID_LEN) != 0) {
+		g_warning("State file %s was written for another trace", path);
+		goto error;
+	}
+	if(!check_table(file, header->snapshots_offset, header->nb_snapshots,
+				sizeof(LttvStateFileSnapshot)) ||
+			(header->nb_cpus > 0 && header->nb_snapshots >
+			 G_MAXUINT64 / sizeof(LttvStateFileCPU) / header->nb_cpus) ||
+			!check_table(file, header->running_offset,
+				header->nb_snapshots * header->nb_cpus, sizeof(guint32)) ||
+			!check_table(file, header->cpus_offset,
+				header->nb_snapshots * header->nb_cpus,
+				sizeof(LttvStateFileCPU)) ||
+			!check_table(file, header->irqs_offset, header->nb_irqs,
+				sizeof(LttvStateFileIRQ)) ||
+			!check_table(file, header->soft_irqs_offset,
+				header->nb_soft_irqs, sizeof(LttvStateFileSoftIRQ)) ||
+			!check_table(file, header->traps_offset, header->nb_traps,
+				sizeof(LttvStateFileTrap)) ||
+			!check_table(file, header->bdevs_offset, header->nb_bdevs,
+				sizeof(LttvStateFileBdev)) ||
+			!check_table(file, header->stack_entries_offset,
+				header->nb_stack_entries, sizeof(guint32)) ||
+			!check_table(file, header->processes_offset,
+				header->nb_processes, sizeof(LttvStateFileProcess)) ||
+			!check_table(file, header->execution_states_offset,
+				header->nb_execution_states,
+				sizeof(LttvStateFileExecutionState)) ||
+			!check_table(file, header->strings_offset, header->nb_strings,
+				sizeof(guint64)) ||
+			header->string_data_offset > file->size ||
+			header->string_data_size > file->size -
+				header->string_data_offset) {
+		g_warning("State file %s is truncated", path);
+		goto error;
+	}
+
+	file->snapshots = (const LttvStateFileSnapshot *)
+		((const char *)file->map + header->snapshots_offset);
+	file->running = (const guint32 *)
+		((const char *)file->map + header->running_offset);
+	file->cpus = (const LttvStateFileCPU *)
+		((const char *)file->map + header->cpus_offset);
+	file->processes = (const LttvStateFileProcess *)
+		((const char *)file->map + header->processes_offset);
+	file->execution_states = (const LttvStateFileExecutionState *)
+		((const char *)file->map + header->execution_states_offset);
+	file->irqs = (const LttvStateFileIRQ *)
+		((const char *)file->map + header->irqs_offset);
+	file->soft_irqs = (const LttvStateFileSoftIRQ *)
+		((const char *)file->map + header->soft_irqs_offset);
+	file->traps = (const LttvStateFileTrap *)
+		((const char *)file->map + header->traps_offset);
+	file->bdevs = (const LttvStateFileBdev *)
+		((const char *)file->map + header->bdevs_offset);
+	file->stack_entries = (const guint32 *)
+		((const char *)file->map + header->stack_entries_offset);
+
+	/* Only the strings are converted when loading, the other tables are
+	   used in place */
+	string_offsets = (const guint64 *)
+		((const char *)file->map + header->strings_offset);
+	string_data = (const char *)file->map + header->string_data_offset;
+	file->quarks = g_new(GQuark, header->nb_strings);
+	for(i = 0; i < header->nb_strings; i++) {
+		guint64 offset = string_offsets[i];
+
+		if(offset >= header->string_data_size ||
+				memchr(string_data + offset, '\0',
+					header->string_data_size - offset) == NULL) {
+			g_warning("State file %s has an invalid string", path);
+			goto error;
+		}
+		file->quarks[i] = (i == 0 ? 0 :
+				g_quark_from_string(string_data + offset));
+	}
+
+	return file;
+
+error:
+	lttv_state_file_close(file);
+	return NULL;
+}
+
+void lttv_state_file_close(LttvStateFile *file)
+{
+	munmap(file->map, file->size);
+	g_free(file->quarks);
+	g_free(file);
+}
+
+guint64 lttv_state_file_get_nb_snapshots(const LttvStateFile *file)
+{
+	return file->header->nb_snapshots;
+}
+
+LttTime lttv_state_file_get_time(const LttvStateFile *file, guint64 snapshot)
+{
+	g_assert(snapshot < file->header->nb_snapshots);
+	return ltt_time_from_uint64(file->snapshots[snapshot].time);
+}
+
+gint64 lttv_state_file_find(const LttvStateFile *file, LttTime t)
+{
+	guint64 target = ltt_time_to_uint64(t);
+	guint64 under = 0, over = file->header->nb_snapshots;
+
+	/* First snapshot after t */
+	while(under < over) {
+		guint64 middle = under + (over - under) / 2;
+
+		if(file->snapshots[middle].time <= target)
+			under = middle + 1;
+		else
+			over = middle;
+	}
+	return (gint64)under - 1;
+}
+
+gboolean lttv_state_file_is_start(const LttvStateFile *file,
+		guint64 snapshot)
+{
+	g_assert(snapshot < file->header->nb_snapshots);
+	return snapshot == 0 &&
+		(file->snapshots[0].flags & LTTV_STATE_FILE_SNAPSHOT_START);
+}
+
+static inline GQuark file_quark(const LttvStateFile *file, guint32 id)
+{
+	return id < file->header->nb_strings ? file->quarks[id] : 0;
+}
+
+static void restore_process(const LttvStateFile *file,
+		const LttvStateFileProcess *record, LttvTraceState *ts)
+{
+	LttvProcessState *process;
+	LttTime creation_time;
+	guint64 i;
+
+	creation_time = ltt_time_from_uint64(record->creation_time);
+
+	/* The idle processes are created per cpu by the reset */
+	if(record->pid == 0)
+		process = lttv_state_find_process(ts, record->cpu, 0);
+	else
+		process = lttv_state_find_process(ts, ANY_CPU, record->pid);
+	if(process == NULL)
+		process = lttv_state_create_process(ts, NULL, record->cpu,
+				record->pid, record->tgid, file_quark(file, record->name),
+				&creation_time);
+
+	process->tgid = record->tgid;
+	process->ppid = record->ppid;
+	process->cpu = record->cpu;
+	process->creation_time = creation_time;
+	process->insertion_time = ltt_time_from_uint64(record->insertion_time);
+	process->name = file_quark(file, record->name);
+	process->type = file_quark(file, record->type);
+	process->free_events = record->free_events;
+
+	if(record->nb_execution_states == 0 ||
+			record->first_execution_state >
+				file->header->nb_execution_states ||
+			record->nb_execution_states >
+				file->header->nb_execution_states -
+				record->first_execution_state) {
+		return;
+	}
+
+	process->execution_stack = g_array_set_size(process->execution_stack,
+			record->nb_execution_states);
+	for(i = 0; i < record->nb_execution_states; i++) {
+		const LttvStateFileExecutionState *es_record =
+			&file->execution_states[record->first_execution_state + i];
+		LttvExecutionState *es = &g_array_index(process->execution_stack,
+				LttvExecutionState, i);
+
+		es->t = file_quark(file, es_record->mode);
+		es->n = file_quark(file, es_record->submode);
+		es->s = file_quark(file, es_record->status);
+		es->entry = ltt_time_from_uint64(es_record->entry);
+		es->change = ltt_time_from_uint64(es_record->change);
+		es->cum_cpu_time = ltt_time_from_uint64(es_record->cum_cpu_time);
+	}
+	process->state = &g_array_index(process->execution_stack,
+			LttvExecutionState, process->execution_stack->len - 1);
+}
+
+/* Replace a stack by nb stack entries from first, quarks or numbers. The
+   stack is emptied if the entries are not in the file. */
+static void restore_stack(const LttvStateFile *file, GArray *stack,
+		guint64 first, guint32 nb, gboolean quarks)
+{
+	guint i;
+
+	if(!check_range(first, nb, file->header->nb_stack_entries))
+		nb = 0;
+	stack = g_array_set_size(stack, nb);
+	for(i = 0; i < nb; i++) {
+		guint32 entry = file->stack_entries[first + i];
+
+		if(quarks)
+			g_array_index(stack, GQuark, i) = file_quark(file, entry);
+		else
+			g_array_index(stack, gint, i) = (gint)entry;
+	}
+}
+
+static void clear_bdev(gpointer key, gpointer value, gpointer user_data)
+{
+	LttvBdevState *bdev = (LttvBdevState *)value;
+
+	g_array_set_size(bdev->mode_stack, 0);
+}
+
+static void restore_resources(const LttvStateFile *file,
+		const LttvStateFileSnapshot *s, guint64 snapshot, LttvTraceState *ts)
+{
+	LttvNameTables *nt;
+	guint i, nb_cpus;
+
+	nb_cpus = MIN(file->header->nb_cpus, lttv_trace_get_num_cpu(ts->trace));
+	for(i = 0; i < nb_cpus; i++) {
+		const LttvStateFileCPU *cpu =
+			&file->cpus[snapshot * file->header->nb_cpus + i];
+		LttvCPUState *state = &ts->cpu_states[i];
+		guint64 entry = cpu->first_entry;
+
+		restore_stack(file, state->mode_stack, entry, cpu->nb_modes, TRUE);
+		entry += cpu->nb_modes;
+		restore_stack(file, state->irq_stack, entry, cpu->nb_irqs, FALSE);
+		entry += cpu->nb_irqs;
+		restore_stack(file, state->softirq_stack, entry, cpu->nb_soft_irqs,
+				FALSE);
+		entry += cpu->nb_soft_irqs;
+		restore_stack(file, state->trap_stack, entry, cpu->nb_traps, FALSE);
+	}
+
+	/* The irq tables grow with the irq numbers seen in the trace, the trap
+	   table has a fixed size */
+	lttv_trace_state_expand_irq_tables(ts, s->nb_irqs, s->nb_soft_irqs);
+	nt = ts->name_tables;
+	for(i = 0; i < MIN(s->nb_irqs, nt->nb_irqs); i++) {
+		const LttvStateFileIRQ *irq = &file->irqs[s->first_irq + i];
+
+		restore_stack(file, ts->irq_states[i].mode_stack, irq->first_entry,
+				irq->nb_modes, TRUE);
+	}
+	for(i = 0; i < MIN(s->nb_soft_irqs, nt->nb_soft_irqs); i++) {
+		const LttvStateFileSoftIRQ *soft_irq =
+			&file->soft_irqs[s->first_soft_irq + i];
+
+		ts->soft_irq_states[i].pending = soft_irq->pending;
+		ts->soft_irq_states[i].running = soft_irq->running;
+	}
+	for(i = 0; i < MIN(s->nb_traps, nt->nb_traps); i++)
+		ts->trap_states[i].running = file->traps[s->first_trap + i].running;
+
+	/* The block devices are not removed by the reset */
+	g_hash_table_foreach(ts->bdev_states, clear_bdev, NULL);
+	for(i = 0; i < s->nb_bdevs; i++) {
+		const LttvStateFileBdev *record = &file->bdevs[s->first_bdev + i];
+		gint devcode = record->devcode;
+		LttvBdevState *bdev;
+
+		bdev = g_hash_table_lookup(ts->bdev_states, &devcode);
+		if(bdev == NULL) {
+			gint *key = g_new(gint, 1);
+
+			*key = devcode;
+			bdev = g_new(LttvBdevState, 1);
+			bdev->mode_stack = g_array_new(FALSE, FALSE, sizeof(GQuark));
+			g_hash_table_insert(ts->bdev_states, key, bdev);
+		}
+		restore_stack(file, bdev->mode_stack, record->first_entry,
+				record->nb_modes, TRUE);
+	}
+}
+
+void lttv_state_file_restore(const LttvStateFile *file, guint64 snapshot,
+		LttvTraceState *ts)
+{
+	const LttvStateFileSnapshot *s;
+	const LttvStateFileHeader *header = file->header;
+	const guint32 *running;
+	guint64 i;
+	guint cpu, nb_cpus;
+
+	g_assert(snapshot < header->nb_snapshots);
+	s = &file->snapshots[snapshot];
+	if(!check_range(s->first_process, s->nb_processes,
+				header->nb_processes) ||
+			!check_range(s->first_irq, s->nb_irqs, header->nb_irqs) ||
+			!check_range(s->first_soft_irq, s->nb_soft_irqs,
+				header->nb_soft_irqs) ||
+			!check_range(s->first_trap, s->nb_traps, header->nb_traps) ||
+			!check_range(s->first_bdev, s->nb_bdevs, header->nb_bdevs)) {
+		g_warning("Invalid snapshot %" G_GUINT64_FORMAT " in state file",
+				snapshot);
+		return;
+	}
+
+	lttv_trace_state_reset(ts);
+
+	for(i = 0; i < s->nb_processes; i++)
+		restore_process(file, &file->processes[s->first_process + i], ts);
+
+	nb_cpus = MIN(header->nb_cpus, lttv_trace_get_num_cpu(ts->trace));
+	running = &file->running[snapshot * header->nb_cpus];
+	for(cpu = 0; cpu < nb_cpus; cpu++) {
+		LttvProcessState *process;
+
+		process = lttv_state_find_process(ts, cpu, running[cpu]);
+		if(process != NULL)
+			ts->running_process[cpu] = process;
+	}
+
+	restore_resources(file, s, snapshot, ts);
+}
@@ -0,0 +1,232 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef STATE_FILE_H
+#define STATE_FILE_H
+
+#include <glib.h>
+#include <lttv/time.h>
+#include <lttv/state.h>
+
+/* A state file holds snapshots of the state of a trace, as written by the
+   precomputeState and sliceTrace modules. It is meant to be mapped in
+   memory and used in place: all the records have a fixed size and are
+   aligned on 8 bytes, the times are in ns. A snapshot holds the state before
+   the events at its time. Its time is the raw time of the trace, without
+   the synchronization correction, like the seeks.
+
+   The state file of a trace is LTTV_STATE_FILE_NAME in the trace directory.
+   It is loaded with the trace and used to restore the state when seeking.
+   The name is hidden so that babeltrace does not read it as a stream. A
+   file is only loaded for the trace it was written for: the uuid of the
+   trace, read in its packet headers, and its number of cpus are in the
+   header.
+
+   The file starts with a LttvStateFileHeader, which gives the offset and
+   number of records of each table:
+   - the snapshots, sorted by time. The processes, irqs, softirqs, traps
+     and block devices of a snapshot are ranges of their tables;
+   - the pid running on each cpu, nb_cpus entries per snapshot;
+   - the state of each cpu, nb_cpus entries per snapshot;
+   - the processes. Their execution stack is a range of the execution state
+     table, from the bottom to the top of the stack;
+   - the execution states;
+   - the irqs, softirqs, traps and block devices, numbered from 0 in each
+     snapshot, except for the block devices which have their device code;
+   - the stack entries. The mode stacks of the cpus, irqs and block devices
+     and the irq, softirq and trap stacks of the cpus are ranges of this
+     table, from the bottom to the top of the stack;
+   - the strings. Names, modes and statuses are stored as indexes in this
+     table instead of GQuarks, which only have a meaning in the process that
+     created them, so that a file can be used on another machine. Index 0 is
+     the empty string and stands for the null quark.
+
+   The records are written in the byte order of the writer, which is given by
+   byte_order. A file written on a host of the other byte order is refused.
+   The records do not depend on the word size, word_size is informative. */
+
+#define LTTV_STATE_FILE_NAME ".lttv-state"
+
+#define LTTV_STATE_FILE_MAGIC 0x4c54545653544154ULL /* "LTTVSTAT" */
+#define LTTV_STATE_FILE_VERSION 2
+#define LTTV_STATE_FILE_BYTE_ORDER 0x01020304
+
+#define LTTV_STATE_FILE_UUID_LEN 16
+
+typedef struct _LttvStateFileHeader {
+	guint64 magic;
+	guint32 version;
+	guint32 byte_order;
+	guint32 word_size;
+	guint32 nb_cpus;
+	guint8 uuid[LTTV_STATE_FILE_UUID_LEN];	/* zero if not known */
+	guint64 nb_snapshots;
+	guint64 snapshots_offset;
+	guint64 running_offset;
+	guint64 cpus_offset;
+	guint64 nb_processes;
+	guint64 processes_offset;
+	guint64 nb_execution_states;
+	guint64 execution_states_offset;
+	guint64 nb_irqs;
+	guint64 irqs_offset;
+	guint64 nb_soft_irqs;
+	guint64 soft_irqs_offset;
+	guint64 nb_traps;
+	guint64 traps_offset;
+	guint64 nb_bdevs;
+	guint64 bdevs_offset;
+	guint64 nb_stack_entries;
+	guint64 stack_entries_offset;	/* guint32 each */
+	guint64 nb_strings;
+	guint64 strings_offset;		/* offset of each string in the data */
+	guint64 string_data_offset;
+	guint64 string_data_size;
+} LttvStateFileHeader;
+
+typedef struct _LttvStateFileSnapshot {
+	guint64 time;
+	guint64 first_process;
+	guint64 first_irq;
+	guint64 first_soft_irq;
+	guint64 first_trap;
+	guint64 first_bdev;
+	guint32 nb_processes;
+	guint32 nb_irqs;
+	guint32 nb_soft_irqs;
+	guint32 nb_traps;
+	guint32 nb_bdevs;
+	guint32 flags;
+} LttvStateFileSnapshot;
+
+/* The first snapshot is the state at the start of the trace, which may hold
+   events before it: the state must be restored from it when reading the
+   trace from its start, instead of the initial state, and the events before
+   it are skipped. */
+#define LTTV_STATE_FILE_SNAPSHOT_START 1
+
+typedef struct _LttvStateFileProcess {
+	guint64 creation_time;
+	guint64 insertion_time;
+	guint64 first_execution_state;
+	guint32 pid;
+	guint32 tgid;
+	guint32 ppid;
+	guint32 cpu;
+	guint32 name;
+	guint32 type;
+	guint32 free_events;
+	guint32 nb_execution_states;
+} LttvStateFileProcess;
+
+typedef struct _LttvStateFileExecutionState {
+	guint64 entry;
+	guint64 change;
+	guint64 cum_cpu_time;
+	guint32 mode;
+	guint32 submode;
+	guint32 status;
+	guint32 reserved;
+} LttvStateFileExecutionState;
+
+/* The stacks of a cpu follow each other in the stack entries: the modes
+   (strings), then the irqs, softirqs and traps (numbers) */
+typedef struct _LttvStateFileCPU {
+	guint64 first_entry;
+	guint32 nb_modes;
+	guint32 nb_irqs;
+	guint32 nb_soft_irqs;
+	guint32 nb_traps;
+} LttvStateFileCPU;
+
+typedef struct _LttvStateFileIRQ {
+	guint64 first_entry;
+	guint32 nb_modes;
+	guint32 reserved;
+} LttvStateFileIRQ;
+
+typedef struct _LttvStateFileSoftIRQ {
+	guint32 pending;
+	guint32 running;
+} LttvStateFileSoftIRQ;
+
+typedef struct _LttvStateFileTrap {
+	guint32 running;
+	guint32 reserved;
+} LttvStateFileTrap;
+
+typedef struct _LttvStateFileBdev {
+	guint64 first_entry;
+	guint32 devcode;
+	guint32 nb_modes;
+} LttvStateFileBdev;
+
+typedef struct _LttvStateFileWriter LttvStateFileWriter;
+
+typedef struct _LttvStateFile LttvStateFile;
+
+/* Read the uuid of the trace in the directory trace_path from the packet
+   header of one of its streams, which must have the layout of LTTng: magic,
+   uuid. Returns FALSE if it cannot be read. */
+gboolean lttv_state_file_get_trace_uuid(const char *trace_path,
+		guint8 *uuid);
+
+/* Create a state file for a trace of nb_cpus cpus, whose uuid may be NULL
+   if it is not known. It is written under a temporary name and replaces
+   path when closed. Returns NULL if it cannot be created. */
+LttvStateFileWriter *lttv_state_file_writer_new(const char *path,
+		guint nb_cpus, const guint8 *uuid);
+
+/* Add a snapshot of the state of a trace at time t. The snapshots must be
+   added in time order. */
+void lttv_state_file_write(LttvStateFileWriter *writer, LttvTraceState *ts,
+		LttTime t);
+
+/* Add the first snapshot, of the state of a trace at the time t where the
+   trace starts. */
+void lttv_state_file_write_start(LttvStateFileWriter *writer,
+		LttvTraceState *ts, LttTime t);
+
+/* Write the tables and free the writer. Returns FALSE on a write error. */
+gboolean lttv_state_file_writer_close(LttvStateFileWriter *writer);
+
+/* Map the state file of a trace of nb_cpus cpus, whose uuid may be NULL if
+   it is not known. Returns NULL if it cannot be read, is not valid or was
+   written for another trace. */
+LttvStateFile *lttv_state_file_open(const char *path, guint nb_cpus,
+		const guint8 *uuid);
+
+void lttv_state_file_close(LttvStateFile *file);
+
+guint64 lttv_state_file_get_nb_snapshots(const LttvStateFile *file);
+
+LttTime lttv_state_file_get_time(const LttvStateFile *file, guint64 snapshot);
+
+/* Find the last snapshot taken at or before t. Returns -1 if there is none. */
+gint64 lttv_state_file_find(const LttvStateFile *file, LttTime t);
+
+/* Check if a snapshot is the state at the start of the trace */
+gboolean lttv_state_file_is_start(const LttvStateFile *file,
+		guint64 snapshot);
+
+/* Replace the state of a trace by a snapshot: its processes and the state of
+   its cpus, irqs, softirqs, traps and block devices. The trace can then be
+   read from the first event at the time of the snapshot. */
+void lttv_state_file_restore(const LttvStateFile *file, guint64 snapshot,
+		LttvTraceState *ts);
+
+#endif // STATE_FILE_H
@@ -0,0 +1,223 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <lttv/lttv.h>
+#include <lttv/module.h>
+#include <lttv/compiler.h>
+#include <lttv/attribute.h>
+#include <lttv/hook.h>
+#include <lttv/event.h>
+#include <lttv/traceset.h>
+#include <lttv/state-intervals.h>
+
+/* Recording of the state intervals from the state engine hooks */
+
+GQuark
+	LTTV_SOFT_IRQ_IDLE,
+	LTTV_SOFT_IRQ_PENDING,
+	LTTV_SOFT_IRQ_BUSY;
+
+static GQuark LTTV_STATE_INTERVALS;
+
+LttvStateIntervals *lttv_state_intervals_get_from_traceset(
+		LttvTraceset *traceset)
+{
+	LttvAttributeValue value;
+	LttvStateIntervals *self;
+	gboolean retval;
+
+	retval = lttv_attribute_find(lttv_traceset_attribute(traceset),
+			LTTV_STATE_INTERVALS, LTTV_POINTER, &value);
+	g_assert(retval);
+	self = (LttvStateIntervals *)*(value.v_pointer);
+	if(self == NULL) {
+		self = lttv_state_intervals_new();
+		*(value.v_pointer) = self;
+	}
+	return self;
+}
+
+void lttv_state_intervals_destroy_from_traceset(LttvTraceset *traceset)
+{
+	LttvAttributeValue value;
+	LttvAttributeType type;
+
+	type = lttv_attribute_get_by_name(lttv_traceset_attribute(traceset),
+			LTTV_STATE_INTERVALS, &value);
+	if(type == LTTV_POINTER && *(value.v_pointer) != NULL) {
+		lttv_state_intervals_destroy(
+				(LttvStateIntervals *)*(value.v_pointer));
+		*(value.v_pointer) = NULL;
+	}
+}
+
+static inline void record_process(LttvStateIntervals *self, guint trace_num,
+		LttvProcessState *process, guint64 time)
+{
+	if(process == NULL || process->state == NULL)
+		return;
+
+	lttv_state_intervals_record(self, LTTV_RESOURCE_PROCESS, trace_num, process->pid,
+			process->pid == 0 ? process->cpu : ANY_CPU, time,
+			process->state->t, process->state->n,
+			process->state->s);
+}
+
+static inline GQuark stack_top(GArray *mode_stack, GQuark unknown)
+{
+	if(mode_stack == NULL || mode_stack->len == 0)
+		return unknown;
+	return g_array_index(mode_stack, GQuark, mode_stack->len - 1);
+}
+
+static gboolean record_intervals(void *hook_data, void *call_data)
+{
+	LttvEvent *event = (LttvEvent *)call_data;
+	LttvTraceState *ts = event->state;
+	LttvStateIntervals *self;
+	const char *name;
+	guint64 time;
+	guint cpu, trace_num, id;
+
+	self = (LttvStateIntervals *)hook_data;
+	name = lttv_traceset_get_name_from_event(event);
+	time = ltt_time_to_uint64(lttv_event_get_timestamp(event));
+	cpu = lttv_traceset_get_cpuid_from_event(event);
+	trace_num = lttv_traceset_get_trace_index_from_event(event);
+
+	/* Every event may change the state of the current process and cpu */
+	record_process(self, trace_num, ts->running_process[cpu], time);
+	lttv_state_intervals_record(self, LTTV_RESOURCE_CPU, trace_num, cpu, 0, time,
+			stack_top(ts->cpu_states[cpu].mode_stack,
+				LTTV_CPU_UNKNOWN), 0, 0);
+
+	/* Other resources are only changed by specific events */
+	if(strncmp(name, "sched_", sizeof("sched_") - 1) == 0) {
+		if(strcmp(name, "sched_switch") == 0) {
+			id = lttv_event_get_long(event, "prev_tid");
+			record_process(self, trace_num,
+					lttv_state_find_process(ts, cpu, id), time);
+		} else if(strcmp(name, "sched_wakeup") == 0) {
+			id = lttv_event_get_long(event, "tid");
+			record_process(self, trace_num,
+					lttv_state_find_process(ts,
+						lttv_event_get_long(event,
+							"target_cpu"), id),
+					time);
+		} else if(strcmp(name, "sched_process_fork") == 0) {
+			id = lttv_event_get_long(event, "child_tid");
+			record_process(self, trace_num,
+					lttv_state_find_process(ts, cpu, id), time);
+		}
+	} else if(strncmp(name, "irq_handler_", sizeof("irq_handler_") - 1)
+			== 0) {
+		id = lttv_event_get_long(event, "irq");
+		if(id < ts->name_tables->nb_irqs)
+			lttv_state_intervals_record(self, LTTV_RESOURCE_IRQ, trace_num, id, 0, time,
+					stack_top(ts->irq_states[id].mode_stack,
+						LTTV_IRQ_UNKNOWN), 0, 0);
+	} else if(strncmp(name, "softirq_", sizeof("softirq_") - 1) == 0) {
+		LttvSoftIRQState *softirq;
+		GQuark mode;
+
+		id = lttv_event_get_long_unsigned(event, "vec");
+		if(id < ts->name_tables->nb_soft_irqs) {
+			softirq = &ts->soft_irq_states[id];
+			if(softirq->running)
+				mode = LTTV_SOFT_IRQ_BUSY;
+			else if(softirq->pending)
+				mode = LTTV_SOFT_IRQ_PENDING;
+			else
+				mode = LTTV_SOFT_IRQ_IDLE;
+			lttv_state_intervals_record(self, LTTV_RESOURCE_SOFT_IRQ, trace_num, id, 0, time,
+					mode, 0, 0);
+		}
+	}
+
+	return FALSE;
+}
+
+void lttv_state_intervals_add_event_hooks(LttvTraceset *traceset)
+{
+	LttvHooks *event_hook;
+	LttvHook f;
+	void *hook_data;
+	LttvHookPrio prio;
+	guint i;
+
+	event_hook = lttv_traceset_get_hooks(traceset);
+	g_assert(event_hook);
+
+	/* The GUI adds them each time the traceset of a tab is set, which can
+	   be the same traceset again. The hooks go with the traceset. */
+	for(i = 0; i < lttv_hooks_number(event_hook); i++) {
+		lttv_hooks_get(event_hook, i, &f, &hook_data, &prio);
+		if(f == record_intervals)
+			return;
+	}
+
+	lttv_hooks_add(event_hook, record_intervals,
+			lttv_state_intervals_get_from_traceset(traceset),
+			LTTV_PRIO_STATE_INTERVALS);
+}
+
+void lttv_state_intervals_remove_event_hooks(LttvTraceset *traceset)
+{
+	LttvHooks *event_hook;
+
+	event_hook = lttv_traceset_get_hooks(traceset);
+	g_assert(event_hook);
+
+	lttv_hooks_remove(event_hook, record_intervals);
+}
+
+gint lttv_state_intervals_hook_add_event_hooks(void *hook_data,
+		void *call_data)
+{
+	lttv_state_intervals_add_event_hooks((LttvTraceset *)call_data);
+	return 0;
+}
+
+gint lttv_state_intervals_hook_remove_event_hooks(void *hook_data,
+		void *call_data)
+{
+	lttv_state_intervals_remove_event_hooks((LttvTraceset *)call_data);
+	return 0;
+}
+
+static void module_init(void)
+{
+	LTTV_STATE_INTERVALS = g_quark_from_string("state_intervals");
+
+	LTTV_SOFT_IRQ_IDLE = g_quark_from_string("idle");
+	LTTV_SOFT_IRQ_PENDING = g_quark_from_string("pending");
+	LTTV_SOFT_IRQ_BUSY = g_quark_from_string("busy");
+}
+
+static void module_destroy()
+{
+}
+
+
+LTTV_MODULE("state_intervals", "State intervals", \
+		"Keep the history of the state of each resource", \
+		module_init, module_destroy, "state")
@@ -0,0 +1,149 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks of the state interval store, run by "make check" */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <lttv/state-intervals.h>
+
+static GQuark running, waiting;
+
+static void record(LttvStateIntervals *store, guint64 time, GQuark status)
+{
+	lttv_state_intervals_record(store, LTTV_RESOURCE_PROCESS, 0, 42,
+			ANY_CPU, time, 0, 0, status);
+}
+
+static GArray *history(LttvStateIntervals *store)
+{
+	return lttv_state_intervals_get_history(store, LTTV_RESOURCE_PROCESS,
+			0, 42, 3);
+}
+
+/* The histories must stay sorted, without two intervals of the same state
+   in a row */
+static void check_sorted(GArray *history)
+{
+	LttvStateInterval *a, *b;
+	guint i;
+
+	for(i = 1; i < history->len; i++) {
+		a = &g_array_index(history, LttvStateInterval, i - 1);
+		b = &g_array_index(history, LttvStateInterval, i);
+		g_assert(a->start < b->start);
+		g_assert(a->status != b->status);
+	}
+}
+
+static void count_interval(LttvStateInterval *interval, LttTime begin,
+		LttTime end, gpointer user_data)
+{
+	(*(guint *)user_data)++;
+}
+
+/* Record the states of one process from 10 to 60 ns, changing every 10 ns */
+static void record_run(LttvStateIntervals *store, guint64 from)
+{
+	guint64 t;
+
+	for(t = from; t <= 60; t += 5)
+		record(store, t, (t / 10) % 2 ? running : waiting);
+}
+
+static void check_queries(LttvStateIntervals *store)
+{
+	LttvStateInterval *interval;
+	LttTime t;
+	guint count;
+
+	g_assert(history(store)->len == 6);
+	check_sorted(history(store));
+
+	g_assert(lttv_state_intervals_find(history(store),
+				ltt_time_from_uint64(5)) == NULL);
+	interval = lttv_state_intervals_find(history(store),
+			ltt_time_from_uint64(35));
+	g_assert(interval != NULL && interval->start == 30
+			&& interval->status == running);
+
+	g_assert(lttv_state_intervals_next_change(history(store),
+				ltt_time_from_uint64(30), &t));
+	g_assert(ltt_time_to_uint64(t) == 40);
+	g_assert(!lttv_state_intervals_next_change(history(store),
+				ltt_time_from_uint64(60), &t));
+	g_assert(lttv_state_intervals_previous_change(history(store),
+				ltt_time_from_uint64(30), &t));
+	g_assert(ltt_time_to_uint64(t) == 20);
+	g_assert(!lttv_state_intervals_previous_change(history(store),
+				ltt_time_from_uint64(10), &t));
+
+	count = 0;
+	lttv_state_intervals_foreach(history(store), ltt_time_from_uint64(25),
+			ltt_time_from_uint64(45), count_interval, &count);
+	g_assert(count == 3);
+}
+
+int main(int argc, char **argv)
+{
+	LttvStateIntervals *store;
+
+	running = g_quark_from_static_string("running");
+	waiting = g_quark_from_static_string("waiting");
+
+	store = lttv_state_intervals_new();
+
+	/* Intervals are only added when the state changes */
+	record_run(store, 10);
+	check_queries(store);
+
+	/* A seek back in time replays the same states, the history must be
+	   the same as before the seek */
+	record_run(store, 25);
+	check_queries(store);
+	record_run(store, 30);
+	check_queries(store);
+
+	/* Several changes at the same time keep the last one */
+	record(store, 60, running);
+	g_assert(history(store)->len == 5);
+	record(store, 60, waiting);
+	g_assert(history(store)->len == 6);
+	check_queries(store);
+
+	/* Seeking back before the first change drops the whole history */
+	record(store, 0, running);
+	g_assert(history(store)->len == 1);
+	g_assert(g_array_index(history(store), LttvStateInterval, 0).start
+			== 0);
+	record_run(store, 10);
+	check_sorted(history(store));
+
+	/* The other resources are kept apart */
+	g_assert(lttv_state_intervals_get_history(store, LTTV_RESOURCE_CPU, 0,
+				42, 3) == NULL);
+
+	lttv_state_intervals_clear(store);
+	g_assert(history(store) == NULL);
+
+	lttv_state_intervals_destroy(store);
+
+	return EXIT_SUCCESS;
+}
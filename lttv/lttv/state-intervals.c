@@ -0,0 +1,256 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <lttv/compiler.h>
+#include <lttv/state-intervals.h>
+
+/* Intervals are allocated in chunks, most resources have few state changes */
+#define INTERVALS_PREALLOC 16
+
+typedef struct _LttvResourceKey {
+	LttvResourceType type;
+	guint trace_num;
+	guint id;
+	guint cpu;
+} LttvResourceKey;
+
+struct _LttvStateIntervals {
+	GHashTable *resources;	/* LttvResourceKey -> GArray of
+				   LttvStateInterval */
+};
+
+static guint resource_hash(gconstpointer key)
+{
+	const LttvResourceKey *k = (const LttvResourceKey *)key;
+	guint id = k->id;
+
+	return (id>>8 ^ id>>4 ^ id>>2 ^ id) ^ (k->cpu << 16)
+		^ (k->type << 24) ^ (k->trace_num << 28);
+}
+
+static gboolean resource_equal(gconstpointer a, gconstpointer b)
+{
+	const LttvResourceKey *ka = (const LttvResourceKey *)a;
+	const LttvResourceKey *kb = (const LttvResourceKey *)b;
+
+	return ka->type == kb->type && ka->id == kb->id
+		&& ka->cpu == kb->cpu && ka->trace_num == kb->trace_num;
+}
+
+static void history_free(gpointer data)
+{
+	g_array_free((GArray *)data, TRUE);
+}
+
+LttvStateIntervals *lttv_state_intervals_new(void)
+{
+	LttvStateIntervals *self = g_new(LttvStateIntervals, 1);
+
+	self->resources = g_hash_table_new_full(resource_hash, resource_equal,
+			g_free, history_free);
+	return self;
+}
+
+void lttv_state_intervals_destroy(LttvStateIntervals *self)
+{
+	g_hash_table_destroy(self->resources);
+	g_free(self);
+}
+
+void lttv_state_intervals_clear(LttvStateIntervals *self)
+{
+	g_hash_table_remove_all(self->resources);
+}
+
+GArray *lttv_state_intervals_get_history(LttvStateIntervals *self,
+		LttvResourceType type, guint trace_num, guint id, guint cpu)
+{
+	LttvResourceKey key;
+
+	key.type = type;
+	key.trace_num = trace_num;
+	key.id = id;
+	key.cpu = (type == LTTV_RESOURCE_PROCESS && id != 0) ? ANY_CPU : cpu;
+
+	return (GArray *)g_hash_table_lookup(self->resources, &key);
+}
+
+/* Index of the last interval starting at or before t, -1 if none */
+static gint find_index(GArray *history, guint64 t)
+{
+	gint low = 0, high = (gint)history->len - 1, mid;
+
+	if(history->len == 0
+			|| g_array_index(history, LttvStateInterval, 0).start > t)
+		return -1;
+
+	while(low < high) {
+		mid = (low + high + 1) / 2;
+		if(g_array_index(history, LttvStateInterval, mid).start <= t)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	return low;
+}
+
+/* Number of intervals starting strictly before t */
+static guint count_before(GArray *history, guint64 t)
+{
+	if(t == 0)
+		return 0;
+	return find_index(history, t - 1) + 1;
+}
+
+void lttv_state_intervals_record(LttvStateIntervals *self,
+		LttvResourceType type, guint trace_num, guint id, guint cpu,
+		guint64 time, GQuark mode, GQuark submode, GQuark status)
+{
+	LttvResourceKey key;
+	LttvStateInterval *last;
+	LttvStateInterval interval;
+	GArray *history;
+
+	key.type = type;
+	key.trace_num = trace_num;
+	key.id = id;
+	key.cpu = cpu;
+
+	history = (GArray *)g_hash_table_lookup(self->resources, &key);
+	if(unlikely(history == NULL)) {
+		history = g_array_sized_new(FALSE, FALSE,
+				sizeof(LttvStateInterval), INTERVALS_PREALLOC);
+		g_hash_table_insert(self->resources,
+				g_memdup(&key, sizeof(LttvResourceKey)), history);
+	} else if(unlikely(history->len > 0 && time < g_array_index(history,
+			LttvStateInterval, history->len - 1).start)) {
+		/* The events are replayed after a seek : the same states will be
+		   recorded again, forget those from this time on */
+		g_array_set_size(history, count_before(history, time));
+	}
+
+	if(likely(history->len > 0)) {
+		last = &g_array_index(history, LttvStateInterval,
+				history->len - 1);
+		if(likely(last->mode == mode && last->submode == submode
+				&& last->status == status))
+			return;
+		/* Several changes at the same time : keep the last state, which
+		   may be the one before them */
+		if(last->start == time) {
+			if(history->len > 1) {
+				LttvStateInterval *previous = last - 1;
+
+				if(previous->mode == mode
+						&& previous->submode == submode
+						&& previous->status == status) {
+					g_array_set_size(history, history->len - 1);
+					return;
+				}
+			}
+			last->mode = mode;
+			last->submode = submode;
+			last->status = status;
+			return;
+		}
+	}
+
+	interval.start = time;
+	interval.mode = mode;
+	interval.submode = submode;
+	interval.status = status;
+	g_array_append_val(history, interval);
+}
+
+LttvStateInterval *lttv_state_intervals_find(GArray *history, LttTime t)
+{
+	gint i;
+
+	if(history == NULL)
+		return NULL;
+
+	i = find_index(history, ltt_time_to_uint64(t));
+	if(i < 0)
+		return NULL;
+	return &g_array_index(history, LttvStateInterval, i);
+}
+
+gboolean lttv_state_intervals_next_change(GArray *history, LttTime t,
+		LttTime *next)
+{
+	gint i;
+
+	if(history == NULL)
+		return FALSE;
+
+	i = find_index(history, ltt_time_to_uint64(t)) + 1;
+	if(i >= (gint)history->len)
+		return FALSE;
+	*next = ltt_time_from_uint64(
+			g_array_index(history, LttvStateInterval, i).start);
+	return TRUE;
+}
+
+gboolean lttv_state_intervals_previous_change(GArray *history, LttTime t,
+		LttTime *previous)
+{
+	guint64 time = ltt_time_to_uint64(t);
+	gint i;
+
+	if(history == NULL || time == 0)
+		return FALSE;
+
+	i = find_index(history, time - 1);
+	if(i < 0)
+		return FALSE;
+	*previous = ltt_time_from_uint64(
+			g_array_index(history, LttvStateInterval, i).start);
+	return TRUE;
+}
+
+void lttv_state_intervals_foreach(GArray *history, LttTime start,
+		LttTime end, LttvStateIntervalFunc func, gpointer user_data)
+{
+	guint64 end_time = ltt_time_to_uint64(end);
+	LttvStateInterval *interval;
+	LttTime begin, finish;
+	gint i;
+
+	if(history == NULL)
+		return;
+
+	i = find_index(history, ltt_time_to_uint64(start));
+	if(i < 0)
+		i = 0;
+
+	for(; i < (gint)history->len; i++) {
+		interval = &g_array_index(history, LttvStateInterval, i);
+		if(interval->start > end_time)
+			break;
+		begin = ltt_time_from_uint64(interval->start);
+		if(i + 1 < (gint)history->len)
+			finish = ltt_time_from_uint64(g_array_index(history,
+					LttvStateInterval, i + 1).start);
+		else
+			finish = ltt_time_infinite;
+		func(interval, begin, finish, user_data);
+	}
+}
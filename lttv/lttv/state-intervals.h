@@ -0,0 +1,133 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef STATE_INTERVALS_H
+#define STATE_INTERVALS_H
+
+#include <glib.h>
+#include <lttv/time.h>
+#include <lttv/state.h>
+#include <lttv/traceset.h>
+
+/* The state intervals keep the history of the state of each resource
+   (process, cpu, irq and soft irq) of a traceset, as computed by the state
+   engine.
+
+   Each resource has an array of intervals sorted by start time, an interval
+   ending where the next one starts. A new interval is only recorded when
+   the state of the resource changes, so the history of a resource is as
+   compact as its state changes. The viewers can then render a time window,
+   find the state at a given time or the next state change with a binary
+   search instead of replaying the trace.
+
+   The intervals are recorded by an event hook running right after the
+   state hooks. When the events are replayed after a seek back in time, the
+   intervals from the first replayed event on are dropped and recorded
+   again, so the histories stay sorted.
+
+   The traps and block devices are not recorded: their state hooks are not
+   ported to babeltrace yet, so their state never changes. The controlflow
+   and resourceview viewers still draw by replaying the events; they use
+   the store to jump to the next or previous state change of a row. */
+
+/* Priority of the recording hook : after the state, before the viewers */
+#define LTTV_PRIO_STATE_INTERVALS (LTTV_PRIO_STATE+1)
+
+typedef enum _LttvResourceType {
+	LTTV_RESOURCE_PROCESS,
+	LTTV_RESOURCE_CPU,
+	LTTV_RESOURCE_IRQ,
+	LTTV_RESOURCE_SOFT_IRQ
+} LttvResourceType;
+
+/* Soft IRQ modes, derived from the pending and running counts */
+extern GQuark
+	LTTV_SOFT_IRQ_IDLE,
+	LTTV_SOFT_IRQ_PENDING,
+	LTTV_SOFT_IRQ_BUSY;
+
+typedef struct _LttvStateInterval {
+	guint64 start;		/* in ns, the end is the start of the next one */
+	GQuark mode;		/* execution mode for processes, resource mode
+				   for the others */
+	GQuark submode;		/* execution submode, processes only */
+	GQuark status;		/* process status, processes only */
+} LttvStateInterval;
+
+typedef struct _LttvStateIntervals LttvStateIntervals;
+
+LttvStateIntervals *lttv_state_intervals_new(void);
+
+void lttv_state_intervals_destroy(LttvStateIntervals *self);
+
+/* Forget all the recorded intervals, e.g. when the traceset changes */
+void lttv_state_intervals_clear(LttvStateIntervals *self);
+
+/* The intervals of a traceset, kept in the traceset attributes and created
+   on first use. */
+LttvStateIntervals *lttv_state_intervals_get_from_traceset(
+		LttvTraceset *traceset);
+
+/* Destroy the intervals of a traceset, if it has any */
+void lttv_state_intervals_destroy_from_traceset(LttvTraceset *traceset);
+
+/* Record the intervals while the traceset is processed. The state hooks
+   must be added too. Adding the hooks again to the same traceset does
+   nothing. */
+void lttv_state_intervals_add_event_hooks(LttvTraceset *traceset);
+void lttv_state_intervals_remove_event_hooks(LttvTraceset *traceset);
+
+/* Hook adder / remover versions, call_data being the traceset */
+gint lttv_state_intervals_hook_add_event_hooks(void *hook_data,
+		void *call_data);
+gint lttv_state_intervals_hook_remove_event_hooks(void *hook_data,
+		void *call_data);
+
+/* Record the state of a resource at a time, in ns. A new interval is only
+   added if the state changed. A time before the last recorded change drops
+   the intervals starting at or after it first. The cpu is only used for the
+   processes of pid 0, ANY_CPU otherwise. */
+void lttv_state_intervals_record(LttvStateIntervals *self,
+		LttvResourceType type, guint trace_num, guint id, guint cpu,
+		guint64 time, GQuark mode, GQuark submode, GQuark status);
+
+/* History of a resource, NULL if no interval was recorded. The cpu is only
+   used for the processes of pid 0, id is the pid, cpu, irq or soft irq. */
+GArray *lttv_state_intervals_get_history(LttvStateIntervals *self,
+		LttvResourceType type, guint trace_num, guint id, guint cpu);
+
+/* Interval covering time t, NULL if t is before the first state change
+   recorded for the resource. */
+LttvStateInterval *lttv_state_intervals_find(GArray *history, LttTime t);
+
+/* First state change strictly after t. Returns FALSE if there is none. */
+gboolean lttv_state_intervals_next_change(GArray *history, LttTime t,
+		LttTime *next);
+
+/* Last state change strictly before t. Returns FALSE if there is none. */
+gboolean lttv_state_intervals_previous_change(GArray *history, LttTime t,
+		LttTime *previous);
+
+/* Call func for every interval of the history which overlaps
+   [start, end]. The end time of the last interval is ltt_time_infinite. */
+typedef void (*LttvStateIntervalFunc)(LttvStateInterval *interval,
+		LttTime begin, LttTime end, gpointer user_data);
+
+void lttv_state_intervals_foreach(GArray *history, LttTime start,
+		LttTime end, LttvStateIntervalFunc func, gpointer user_data);
+
+#endif // STATE_INTERVALS_H
@@ -25,6 +25,7 @@
 #include <lttv/lttv.h>
 #include <lttv/module.h>
 #include <lttv/state.h>
+#include <lttv/state-file.h>
 #include <lttv/compiler.h>
 #include <lttv/traceset.h>
 #include <lttv/traceset-process.h>
@@ -579,6 +580,23 @@ end:
 }
 #endif /* BABEL_CLEANUP */
 
+/* Map the state file of the trace, if it has one */
+static void state_load_state_file(LttvTraceState *ts)
+{
+	guint8 uuid[LTTV_STATE_FILE_UUID_LEN];
+	gboolean has_uuid;
+	char *path;
+
+	path = g_build_filename(ts->trace->full_path, LTTV_STATE_FILE_NAME, NULL);
+	if(g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+		has_uuid = lttv_state_file_get_trace_uuid(ts->trace->full_path, uuid);
+		ts->state_file = lttv_state_file_open(path,
+				lttv_trace_get_num_cpu(ts->trace), has_uuid ? uuid : NULL);
+	} else
+		ts->state_file = NULL;
+	g_free(path);
+}
+
 void lttv_trace_state_init(LttvTraceState *trace_state, LttvTrace *trace)
 {
 	guint j, nb_cpu;
@@ -634,7 +652,21 @@ void lttv_trace_state_init(LttvTraceState *trace_state, LttvTrace *trace)
 	restore_init_state(trace_state);
 
 	/* See if the trace has saved states */
-	//state_load_saved_states(trace_state);
+	state_load_state_file(trace_state);
+}
+
+void lttv_trace_state_reset(LttvTraceState *self)
+{
+	restore_init_state(self);
+}
+
+void lttv_trace_state_expand_irq_tables(LttvTraceState *self, guint nb_irqs,
+		guint nb_soft_irqs)
+{
+	if(nb_irqs > 0)
+		expand_irq_table(self, nb_irqs - 1);
+	if(nb_soft_irqs > 0)
+		expand_soft_irq_table(self, nb_soft_irqs - 1);
 }
 
 void lttv_trace_state_fini(LttvTraceState *trace_state)
@@ -657,10 +689,12 @@ void lttv_trace_state_fini(LttvTraceState *trace_state)
 	trace_state->running_process = NULL;
 	lttv_state_free_process_table(trace_state->processes);
 	trace_state->processes = NULL;
+	if(trace_state->state_file != NULL) {
+		lttv_state_file_close(trace_state->state_file);
+		trace_state->state_file = NULL;
+	}
 }
 
-#ifdef BABEL_CLEANUP
-
 /* Write the process state of the trace */
 
 static void write_process_state(gpointer key, gpointer value,
@@ -673,7 +707,6 @@ static void write_process_state(gpointer key, gpointer value,
 	FILE *fp = (FILE *)user_data;
 
 	guint i;
-	guint64 address;
 
 	process = (LttvProcessState *)value;
 	fprintf(fp,"  <PROCESS CORE=%p PID=%u TGID=%u PPID=%u TYPE=\"%s\" CTIME_S=%lu CTIME_NS=%lu ITIME_S=%lu ITIME_NS=%lu NAME=\"%s\" CPU=\"%u\" FREE_EVENTS=\"%u\">\n",
@@ -695,62 +728,28 @@ static void write_process_state(gpointer key, gpointer value,
 				es->change.tv_sec, es->change.tv_nsec, g_quark_to_string(es->s));
 	}
 
-	for(i = 0 ; i < process->user_stack->len; i++) {
-		address = g_array_index(process->user_stack, guint64, i);
-		fprintf(fp, "    <USER_STACK ADDRESS=\"%" PRIu64 "\"/>\n", address);
-	}
-
 	fprintf(fp, "  </PROCESS>\n");
 }
 
 
 void lttv_state_write(LttvTraceState *self, LttTime t, FILE *fp)
 {
-	guint i, nb_tracefile, nb_block, offset;
-	guint64 tsc;
-
-	LttvTracefileState *tfcs;
-
-	LttTracefile *tf;
-
-	LttEventPosition *ep;
-
-	guint nb_cpus;
-
-	ep = ltt_event_position_new();
+	guint i, nb_cpus;
 
 	fprintf(fp,"<PROCESS_STATE TIME_S=%lu TIME_NS=%lu>\n", t.tv_sec, t.tv_nsec);
 
 	g_hash_table_foreach(self->processes, write_process_state, fp);
 
-	nb_cpus = ltt_trace_get_num_cpu(self->parent.t);
+	nb_cpus = lttv_trace_get_num_cpu(self->trace);
 	for(i=0;i<nb_cpus;i++) {
-		fprintf(fp,"  <CPU NUM=%u RUNNING_PROCESS=%u>\n",
+		fprintf(fp,"  <CPU NUM=%u RUNNING_PROCESS=%u/>\n",
 				i, self->running_process[i]->pid);
 	}
 
-	nb_tracefile = self->parent.tracefiles->len;
-
-	for(i = 0 ; i < nb_tracefile ; i++) {
-		tfcs =
-				LTTV_TRACEFILE_STATE(g_array_index(self->parent.tracefiles,
-				LttvTracefileContext*, i));
-		fprintf(fp, "  <TRACEFILE TIMESTAMP_S=%lu TIMESTAMP_NS=%lu",
-				tfcs->parent.timestamp.tv_sec,
-				tfcs->parent.timestamp.tv_nsec);
-		LttEvent *e = ltt_tracefile_get_event(tfcs->parent.tf);
-		if(e == NULL) fprintf(fp,"/>\n");
-		else {
-			ltt_event_position(e, ep);
-			ltt_event_position_get(ep, &tf, &nb_block, &offset, &tsc);
-			fprintf(fp, " BLOCK=%u OFFSET=%u TSC=%" PRIu64 "/>\n", nb_block, offset,
-					tsc);
-		}
-	}
-	g_free(ep);
 	fprintf(fp,"</PROCESS_STATE>\n");
 }
 
+#ifdef BABEL_CLEANUP
 
 static void write_process_state_raw(gpointer key, gpointer value,
 		gpointer user_data)
@@ -3746,6 +3745,65 @@ void lttv_state_traceset_seek_position(LttvTraceset *traceset, LttvTracesetPosit
 				     position);
 }
 
+/* Restore the state of the traces from their state files, at the last
+   snapshot at or before t, and seek to it. All the traces need a snapshot at
+   the same time, which must be later than after: a checkpoint in memory at
+   the same time is as good and is already restored. If t is before the
+   first snapshot and this snapshot is the state at the start of the trace,
+   as in a sliced trace, it is restored and the seek lands at its time: the
+   events before it are skipped. Returns FALSE if the state files cannot be
+   used. */
+static gboolean seek_state_files(LttvTraceset *traceset, LttTime t,
+		LttTime after)
+{
+	guint i, nb_trace;
+	gint64 *snapshots;
+	LttTime time = ltt_time_zero;
+	gboolean found = TRUE;
+
+	nb_trace = lttv_traceset_number(traceset);
+	if(nb_trace == 0)
+		return FALSE;
+
+	snapshots = g_new(gint64, nb_trace);
+	for(i = 0 ; i < nb_trace && found ; i++) {
+		LttvStateFile *file = lttv_traceset_get(traceset, i)->state->state_file;
+
+		if(file == NULL) {
+			found = FALSE;
+			continue;
+		}
+		/* The other traces must have a snapshot at the time of the first */
+		snapshots[i] = lttv_state_file_find(file, i == 0 ? t : time);
+		if(snapshots[i] < 0 && lttv_state_file_get_nb_snapshots(file) > 0
+				&& lttv_state_file_is_start(file, 0))
+			snapshots[i] = 0;
+		if(snapshots[i] < 0) {
+			found = FALSE;
+		} else if(i == 0) {
+			time = lttv_state_file_get_time(file, snapshots[i]);
+			found = ltt_time_compare(time, after) > 0;
+		} else {
+			found = ltt_time_compare(time,
+					lttv_state_file_get_time(file, snapshots[i])) == 0;
+		}
+	}
+
+	if(found) {
+		g_debug("Restoring the state files at time %lu.%lu", time.tv_sec,
+				time.tv_nsec);
+		for(i = 0 ; i < nb_trace ; i++) {
+			LttvTraceState *tstate = lttv_traceset_get(traceset, i)->state;
+
+			lttv_state_file_restore(tstate->state_file, snapshots[i],
+					tstate);
+		}
+		lttv_process_traceset_seek_time(traceset, time);
+	}
+	g_free(snapshots);
+	return found;
+}
+
 void lttv_state_traceset_seek_time_closest(LttvTraceset *traceset, LttTime t)
 {
 	guint i, nb_trace;
@@ -3835,6 +3893,10 @@ void lttv_state_traceset_seek_time_closest(LttvTraceset *traceset, LttTime t)
 	}
 
 	if(resto_start || resto_at) {
+		// Use the state files of the traces if they have a state before t
+		if(seek_state_files(traceset, t, ltt_time_zero))
+			return;
+
 		// Restore init state and seek so
 		for(i = 0 ; i < nb_trace ; i++) {
 
@@ -3855,7 +3917,7 @@ void lttv_state_traceset_seek_time_closest(LttvTraceset *traceset, LttTime t)
 		}
 		g_info("NOT Calling restore");
 
-	} else {
+	} else if(!seek_state_files(traceset, t, restored_time)) {
 		// Seek at checkpoint		
 		lttv_process_traceset_seek_time(traceset, restored_time);
 					
@@ -318,7 +318,8 @@ LttvProcessState *lttv_state_create_process(LttvTraceState *tcs,
 		LttvProcessState *parent, guint cpu, guint pid,
 		guint tgid, GQuark name, const LttTime *timestamp);
 
-//void lttv_state_write(LttvTraceState *trace_state, LttTime t, FILE *fp);
+/* Write the process state of a trace in a readable form */
+void lttv_state_write(LttvTraceState *trace_state, LttTime t, FILE *fp);
 //void lttv_state_write_raw(LttvTraceState *trace_state, LttTime t, FILE *fp);
 
 typedef struct _LttvCPUState {
@@ -379,10 +380,18 @@ struct _LttvTraceState {
 	/* FIXME should be a g_array to deal with resize and copy. */
 	LttvTrapState *trap_states; /* state of each trap */
 	GHashTable *bdev_states; /* state of the block devices */
+	/* Saved states loaded with the trace, NULL if it has no state file */
+	struct _LttvStateFile *state_file;
 };
 
 void lttv_trace_state_init(LttvTraceState *self, LttvTrace *trace);
 void lttv_trace_state_fini(LttvTraceState *self);
+/* Put the trace state back to its state at the beginning of the trace */
+void lttv_trace_state_reset(LttvTraceState *self);
+/* Grow the irq and softirq tables of the trace to hold at least nb_irqs and
+   nb_soft_irqs of them */
+void lttv_trace_state_expand_irq_tables(LttvTraceState *self, guint nb_irqs,
+		guint nb_soft_irqs);
 
 void lttv_state_save(LttvTraceState *self, LttvAttribute *container);
 void lttv_state_restore(LttvTraceState *self, LttvAttribute *container);
@@ -0,0 +1,100 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <lttv/sync-correction.h>
+
+/* Convert a linear correction to fixed point. drift - 1 is scaled to the
+   largest power of two that keeps it below 2^63, so mult keeps 62 or 63
+   significant bits whatever the magnitude of the drift. */
+void lttv_sync_fixed_init(LttvTraceSyncFixed *f, guint64 start,
+		double drift, double offset)
+{
+	double d = drift - 1.;
+
+	f->start = start;
+	f->offset = (gint64) (offset < 0. ? offset - 0.5 : offset + 0.5);
+	f->negative = d < 0.;
+	if (f->negative)
+		d = -d;
+	f->shift = 0;
+	if (d > 0.) {
+		while (d < 4611686018427387904. && f->shift < 127) {
+			/* 2^62 */
+			d *= 2.;
+			f->shift++;
+		}
+	}
+	f->mult = (guint64) d;
+}
+
+void lttv_sync_segments_init(GArray *segments)
+{
+	guint i;
+
+	for (i = 0; i < segments->len; i++) {
+		LttvTraceSyncSegment *segment =
+			&g_array_index(segments, LttvTraceSyncSegment, i);
+
+		lttv_sync_fixed_init(&segment->fixed, segment->start,
+			segment->drift, segment->offset);
+	}
+}
+
+/* Events are mostly read in time order, so the segment of the previous call
+   or the one after it are tried before searching the whole table.
+
+   The correction only uses integer operations. Applied in double, drift *
+   time loses the low bits of timestamps larger than 2^53 ns. */
+guint64 lttv_sync_segments_apply(GArray *segments_array, guint *hint,
+		guint64 time)
+{
+	LttvTraceSyncSegment *segments;
+	guint nb, i, low, high;
+
+	segments = (LttvTraceSyncSegment *) segments_array->data;
+	nb = segments_array->len;
+	i = *hint;
+
+	if (time >= segments[i].start &&
+			(i + 1 == nb || time < segments[i + 1].start)) {
+		/* Same segment as the previous call */
+	} else if (i + 1 < nb && time >= segments[i + 1].start &&
+			(i + 2 == nb || time < segments[i + 2].start)) {
+		i++;
+	} else {
+		/* Last segment whose start is <= time, the first one applies to
+		   the times before it */
+		low = 0;
+		high = nb;
+		while (high - low > 1) {
+			guint mid = low + (high - low) / 2;
+
+			if (segments[mid].start <= time)
+				low = mid;
+			else
+				high = mid;
+		}
+		i = low;
+	}
+	*hint = i;
+
+	return lttv_sync_fixed_apply(&segments[i].fixed, time);
+}
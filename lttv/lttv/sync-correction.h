@@ -0,0 +1,103 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Synchronization corrections of the trace times, linear or piecewise
+   linear. They only depend on glib so that the sync unittest can check
+   them. */
+
+#ifndef SYNC_CORRECTION_H
+#define SYNC_CORRECTION_H
+
+#include <glib.h>
+
+/* Fixed-point form of a linear correction, applied with integer operations
+   only. The corrected time is t + offset + (t - start) * (drift - 1), where
+   drift - 1 is mult / 2^shift, negated if negative is TRUE. */
+typedef struct {
+	guint64 start;
+	gint64 offset;
+	guint64 mult;
+	guint shift;
+	gboolean negative;
+} LttvTraceSyncFixed;
+
+/* One piece of a piecewise-linear synchronization correction. It applies to
+   the uncorrected times from start until the start of the next piece. The
+   corrected time is t + offset + (drift - 1) * (t - start), it is relative to
+   start so that the correction keeps the precision of the timestamps. fixed
+   is computed by lttv_sync_segments_init. */
+typedef struct {
+	guint64 start;
+	double drift;
+	double offset;
+	LttvTraceSyncFixed fixed;
+} LttvTraceSyncSegment;
+
+/* Convert a linear correction to fixed point */
+void lttv_sync_fixed_init(LttvTraceSyncFixed *f, guint64 start,
+		double drift, double offset);
+
+/* Full 128 bit product of two 64 bit integers, from 32 bit halves */
+static inline void lttv_sync_mul_64_64(guint64 a, guint64 b, guint64 *hi,
+		guint64 *lo)
+{
+	guint64 p0, p1, p2, p3, middle;
+
+	p0 = (a & 0xffffffff) * (b & 0xffffffff);
+	p1 = (a & 0xffffffff) * (b >> 32);
+	p2 = (a >> 32) * (b & 0xffffffff);
+	p3 = (a >> 32) * (b >> 32);
+	middle = (p0 >> 32) + (p1 & 0xffffffff) + (p2 & 0xffffffff);
+	*lo = (middle << 32) | (p0 & 0xffffffff);
+	*hi = p3 + (p1 >> 32) + (p2 >> 32) + (middle >> 32);
+}
+
+static inline guint64 lttv_sync_fixed_apply(const LttvTraceSyncFixed *f,
+		guint64 time)
+{
+	guint64 delta, hi, lo, correction;
+	gboolean negative = f->negative;
+
+	if (time >= f->start) {
+		delta = time - f->start;
+	} else {
+		delta = f->start - time;
+		negative = !negative;
+	}
+
+	lttv_sync_mul_64_64(delta, f->mult, &hi, &lo);
+	if (f->shift >= 64)
+		correction = hi >> (f->shift - 64);
+	else if (f->shift > 0)
+		correction = (hi << (64 - f->shift)) | (lo >> f->shift);
+	else
+		correction = lo;
+
+	return time + f->offset +
+		(negative ? -(gint64) correction : (gint64) correction);
+}
+
+/* Compute the fixed point form of each segment of an array of
+   LttvTraceSyncSegment */
+void lttv_sync_segments_init(GArray *segments);
+
+/* Apply a piecewise correction to a time in ns. hint is the index of the
+   segment used by the previous call, it is updated. */
+guint64 lttv_sync_segments_apply(GArray *segments, guint *hint,
+		guint64 time);
+
+#endif // SYNC_CORRECTION_H
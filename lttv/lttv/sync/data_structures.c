@@ -21,6 +21,7 @@
 
 #include <arpa/inet.h>
 #include <glib.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -40,6 +41,39 @@
 #define SEQ_GT(a,b)     ((int32_t)((a)-(b)) > 0)
 #define SEQ_GEQ(a,b)    ((int32_t)((a)-(b)) >= 0)
 
+/* A TCP event is allocated in one block with its TCPEvent and its SegmentKey.
+ * The blocks come from slabs and are recycled through free lists instead of
+ * being returned to malloc(), so that steady state matching does not
+ * allocate. Events are created by the reader threads and destroyed by the
+ * matching thread. Each thread keeps its own free list and exchanges the
+ * blocks with the shared one by batches, so the lock is taken once per
+ * batch rather than once per event. A reader thread returns its blocks with
+ * releaseTCPEventCache() before it ends. The slabs are freed by
+ * destroyTCPEventPool() once the modules are destroyed.
+ */
+typedef struct _TCPEventRecord
+{
+	Event event; // This must be the first field
+	TCPEvent tcpEvent;
+	SegmentKey segmentKey;
+	struct _TCPEventRecord* next;
+} TCPEventRecord;
+
+#define TCP_EVENT_SLAB_SIZE 1024
+#define TCP_EVENT_BATCH_SIZE 64
+
+static TCPEventRecord* tcpEventFreeList= NULL;
+// TCPEventRecord* tcpEventSlabs[], NULL when no event was allocated
+static GPtrArray* tcpEventSlabs= NULL;
+// Number of events taken from the shared free list and not returned to it,
+// including the ones in the free lists of the threads
+static unsigned int tcpEventLiveNb= 0;
+static pthread_mutex_t tcpEventLock= PTHREAD_MUTEX_INITIALIZER;
+
+// Free list of the current thread
+static __thread TCPEventRecord* tcpEventCache= NULL;
+static __thread unsigned int tcpEventCacheNb= 0;
+
 const char* const approxNames[]= {
 	[EXACT]= "Exact",
 	[ACCURATE]= "Accurate",
@@ -151,10 +185,27 @@ void printTCPSegment(const Message* const segment)
  */
 guint ghfSegmentKeyHash(gconstpointer key)
 {
-	const SegmentKey* p;
-	uint32_t a, b, c;
+	uint32_t hash;
+
+	hash= segmentKeyHash((const SegmentKey*) key);
+	g_debug("segment key hash %p: %u", key, hash);
+
+	return hash;
+}
+
 
-	p= (SegmentKey*) key;
+/*
+ * Hash all fields of a SegmentKey
+ *
+ * Args:
+ *   p             SegmentKey to hash
+ *
+ * Returns:
+ *   A hash of all fields in the SegmentKey
+ */
+uint32_t segmentKeyHash(const SegmentKey* const p)
+{
+	uint32_t a, b, c;
 
 	a= p->connectionKey.source + (p->connectionKey.dest << 16);
 	b= p->connectionKey.saddr;
@@ -169,8 +220,6 @@ guint ghfSegmentKeyHash(gconstpointer key)
 	a+= p->ack + (p->rst << 8) + (p->syn << 16) + (p->fin << 24);
 	final(a, b, c);
 
-	g_debug("segment key hash %p: %u", p, c);
-
 	return c;
 }
 
@@ -189,11 +238,28 @@ guint ghfSegmentKeyHash(gconstpointer key)
  */
 gboolean gefSegmentKeyEqual(gconstpointer a, gconstpointer b)
 {
-	const SegmentKey* sA, * sB;
+	if (segmentKeyEqual((const SegmentKey*) a, (const SegmentKey*) b))
+	{
+		g_debug("segment key equal %p %p: TRUE", a, b);
+		return TRUE;
+	}
+	else
+	{
+		g_debug("segment key equal %p %p: FALSE", a, b);
+		return FALSE;
+	}
+}
 
-	sA= (SegmentKey*) a;
-	sB= (SegmentKey*) b;
 
+/*
+ * Compare two SegmentKey structures
+ *
+ * Returns:
+ *   true if each field of the structure is equal
+ *   false otherwise
+ */
+bool segmentKeyEqual(const SegmentKey* const sA, const SegmentKey* const sB)
+{
 	if (connectionKeyEqual(&sA->connectionKey, &sB->connectionKey) &&
 		sA->ihl == sB->ihl &&
 		sA->tot_len == sB->tot_len &&
@@ -205,13 +271,11 @@ gboolean gefSegmentKeyEqual(gconstpointer a, gconstpointer b)
 		sA->syn == sB->syn &&
 		sA->fin == sB->fin)
 	{
-		g_debug("segment key equal %p %p: TRUE", sA, sB);
-		return TRUE;
+		return true;
 	}
 	else
 	{
-		g_debug("segment key equal %p %p: FALSE", sA, sB);
-		return FALSE;
+		return false;
 	}
 }
 
@@ -269,22 +333,27 @@ void gfTCPSegmentDestroy(gpointer data, gpointer user_data)
  */
 void destroyTCPSegment(Message* const segment)
 {
-	TCPEvent* inE, *outE;
+	destroyTCPSegmentEvents(segment);
+	free(segment);
+}
 
-	segment->print(segment);
 
+/*
+ * Free the events of a TCP Message but not the Message itself, for messages
+ * that were not allocated on the heap
+ *
+ * Args:
+ *   segment       TCP Message whose events to destroy
+ */
+void destroyTCPSegmentEvents(Message* const segment)
+{
 	g_assert(segment->inE != NULL && segment->outE != NULL);
 	g_assert(segment->inE->type == TCP && segment->outE->type == TCP);
-	inE= segment->inE->event.tcpEvent;
-	outE= segment->outE->event.tcpEvent;
-	g_assert(inE->segmentKey == outE->segmentKey);
-
-	outE->segmentKey= NULL;
+	g_assert(segment->inE->event.tcpEvent->segmentKey ==
+		segment->outE->event.tcpEvent->segmentKey);
 
 	destroyTCPEvent(segment->inE);
 	destroyTCPEvent(segment->outE);
-
-	free(segment);
 }
 
 
@@ -311,19 +380,186 @@ void destroyTCPExchange(Exchange* const exchange)
 
 
 /*
- * Free the memory used by a TCP Event and its associated resources
+ * Take a batch of events from the shared free list into the free list of the
+ * current thread, allocating a slab if needed
+ */
+static void refillTCPEventCache(void)
+{
+	unsigned int i;
+	int retval;
+
+	retval= pthread_mutex_lock(&tcpEventLock);
+	g_assert(retval == 0);
+
+	for (i= 0; i < TCP_EVENT_BATCH_SIZE; i++)
+	{
+		TCPEventRecord* record;
+
+		if (tcpEventFreeList == NULL)
+		{
+			TCPEventRecord* slab;
+			unsigned int j;
+
+			slab= malloc(TCP_EVENT_SLAB_SIZE * sizeof(TCPEventRecord));
+			for (j= 0; j < TCP_EVENT_SLAB_SIZE - 1; j++)
+			{
+				slab[j].next= &slab[j + 1];
+			}
+			slab[TCP_EVENT_SLAB_SIZE - 1].next= NULL;
+			tcpEventFreeList= slab;
+
+			if (tcpEventSlabs == NULL)
+			{
+				tcpEventSlabs= g_ptr_array_new_with_free_func(&free);
+			}
+			g_ptr_array_add(tcpEventSlabs, slab);
+		}
+
+		record= tcpEventFreeList;
+		tcpEventFreeList= record->next;
+		record->next= tcpEventCache;
+		tcpEventCache= record;
+	}
+	tcpEventCacheNb+= TCP_EVENT_BATCH_SIZE;
+	tcpEventLiveNb+= TCP_EVENT_BATCH_SIZE;
+
+	retval= pthread_mutex_unlock(&tcpEventLock);
+	g_assert(retval == 0);
+}
+
+
+/*
+ * Return the first events of the free list of the current thread to the
+ * shared free list
+ *
+ * Args:
+ *   nb:           number of events to return, at most tcpEventCacheNb
+ */
+static void returnTCPEvents(unsigned int nb)
+{
+	TCPEventRecord* first, * last;
+	unsigned int i;
+	int retval;
+
+	if (nb == 0)
+	{
+		return;
+	}
+
+	first= tcpEventCache;
+	last= first;
+	for (i= 1; i < nb; i++)
+	{
+		last= last->next;
+	}
+	tcpEventCache= last->next;
+	tcpEventCacheNb-= nb;
+
+	retval= pthread_mutex_lock(&tcpEventLock);
+	g_assert(retval == 0);
+
+	last->next= tcpEventFreeList;
+	tcpEventFreeList= first;
+	tcpEventLiveNb-= nb;
+
+	retval= pthread_mutex_unlock(&tcpEventLock);
+	g_assert(retval == 0);
+}
+
+
+/*
+ * Allocate a TCP event from the pool
+ *
+ * Returns:
+ *   A TCP event whose tcpEvent and segmentKey members point to storage
+ *   allocated along with the event. The other members, the direction and the
+ *   key must be filled by the caller. It must be freed with
+ *   destroyTCPEvent().
+ */
+Event* createTCPEvent(void)
+{
+	TCPEventRecord* record;
+
+	if (tcpEventCache == NULL)
+	{
+		refillTCPEventCache();
+	}
+
+	record= tcpEventCache;
+	tcpEventCache= record->next;
+	tcpEventCacheNb--;
+
+	record->event.type= TCP;
+	record->event.copy= &copyTCPEvent;
+	record->event.destroy= &destroyTCPEvent;
+	record->event.event.tcpEvent= &record->tcpEvent;
+	record->tcpEvent.segmentKey= &record->segmentKey;
+
+	return &record->event;
+}
+
+
+/*
+ * Return a TCP Event to the pool. The event must have been allocated by
+ * createTCPEvent(), possibly in another thread. Its segmentKey may point to
+ * the key of its companion event, it is not freed separately.
  */
 void destroyTCPEvent(Event* const event)
 {
+	TCPEventRecord* record;
+
 	g_assert(event->type == TCP);
 
-	if (event->event.tcpEvent->segmentKey != NULL)
+	record= (TCPEventRecord*) event;
+	record->next= tcpEventCache;
+	tcpEventCache= record;
+	tcpEventCacheNb++;
+
+	// Keep a batch for the next events created by this thread
+	if (tcpEventCacheNb >= 2 * TCP_EVENT_BATCH_SIZE)
 	{
-		free(event->event.tcpEvent->segmentKey);
+		returnTCPEvents(TCP_EVENT_BATCH_SIZE);
 	}
-	free(event->event.tcpEvent);
-	event->event.tcpEvent= NULL;
-	destroyEvent(event);
+}
+
+
+/*
+ * Return the free list of the current thread to the pool. A thread that
+ * created or destroyed TCP events must call it before it ends.
+ */
+void releaseTCPEventCache(void)
+{
+	returnTCPEvents(tcpEventCacheNb);
+}
+
+
+/*
+ * Free the slabs of the TCP event pool. The pool is kept if some events were
+ * not destroyed, they would point to freed memory otherwise.
+ */
+void destroyTCPEventPool(void)
+{
+	int retval;
+
+	releaseTCPEventCache();
+
+	retval= pthread_mutex_lock(&tcpEventLock);
+	g_assert(retval == 0);
+
+	if (tcpEventLiveNb != 0)
+	{
+		g_debug("%u TCP events were not destroyed, keeping their pool",
+			tcpEventLiveNb);
+	}
+	else if (tcpEventSlabs != NULL)
+	{
+		g_ptr_array_free(tcpEventSlabs, TRUE);
+		tcpEventSlabs= NULL;
+		tcpEventFreeList= NULL;
+	}
+
+	retval= pthread_mutex_unlock(&tcpEventLock);
+	g_assert(retval == 0);
 }
 
 
@@ -600,7 +836,7 @@ void copyEvent(const Event* const event, Event** const newEvent)
 
 
 /*
- * Allocate and copy a TCP event
+ * Allocate from the pool and copy a TCP event
  *
  * Args:
  *   newEvent:     new event, pointer will be updated
@@ -610,14 +846,11 @@ void copyTCPEvent(const Event* const event, Event** const newEvent)
 {
 	g_assert(event->type == TCP);
 
-	*newEvent= malloc(sizeof(Event));
-	memcpy(*newEvent, event, sizeof(Event));
-
-	(*newEvent)->event.tcpEvent= malloc(sizeof(TCPEvent));
-	memcpy((*newEvent)->event.tcpEvent, event->event.tcpEvent,
-		sizeof(TCPEvent));
-
-	(*newEvent)->event.tcpEvent->segmentKey= malloc(sizeof(SegmentKey));
+	*newEvent= createTCPEvent();
+	(*newEvent)->traceNum= event->traceNum;
+	(*newEvent)->cpuTime= event->cpuTime;
+	(*newEvent)->wallTime= event->wallTime;
+	(*newEvent)->event.tcpEvent->direction= event->event.tcpEvent->direction;
 	memcpy((*newEvent)->event.tcpEvent->segmentKey,
 		event->event.tcpEvent->segmentKey, sizeof(SegmentKey));
 }
@@ -185,6 +185,17 @@ typedef struct
 } AllFactors;
 
 
+/* Factors between trace pairs computed from the messages of one time window,
+ * for piecewise synchronization
+ */
+typedef struct
+{
+	// Time at which the window begins, in ns
+	uint64_t start;
+	AllFactors* allFactors;
+} SegmentFactors;
+
+
 // This structure is used to return a corrected time value with accuracy
 // bounds
 typedef struct
@@ -205,6 +216,8 @@ void gdnConnectionKeyDestroy(gpointer data);
 // SegmentKey-related functions
 guint ghfSegmentKeyHash(gconstpointer key);
 gboolean gefSegmentKeyEqual(gconstpointer a, gconstpointer b);
+uint32_t segmentKeyHash(const SegmentKey* const key);
+bool segmentKeyEqual(const SegmentKey* const a, const SegmentKey* const b);
 
 // DatagramKey-related functions
 guint ghfDatagramKeyHash(gconstpointer key);
@@ -212,12 +225,15 @@ gboolean gefDatagramKeyEqual(gconstpointer a, gconstpointer b);
 void gdnDestroyDatagramKey(gpointer data);
 
 // Event-related functions
+Event* createTCPEvent(void);
 void gdnDestroyEvent(gpointer data);
 void copyEvent(const Event* const event, Event** const newEvent);
 void copyTCPEvent(const Event* const event, Event** const newEvent);
 void copyUDPEvent(const Event* const event, Event** const newEvent);
 void destroyEvent(Event* const event);
 void destroyTCPEvent(Event* const event);
+void releaseTCPEventCache(void);
+void destroyTCPEventPool(void);
 void destroyUDPEvent(Event* const event);
 void gfDestroyEvent(gpointer data, gpointer user_data);
 double wallTimeSub(const WallTime const* tA, const WallTime const* tB);
@@ -233,6 +249,7 @@ bool isAcking(const Message* const ackSegment, const Message* const ackedSegment
 void gdnTCPSegmentListDestroy(gpointer data);
 void gfTCPSegmentDestroy(gpointer data, gpointer user_data);
 void destroyTCPSegment(Message* const segment);
+void destroyTCPSegmentEvents(Message* const segment);
 
 // Exchange-related functions
 void destroyTCPExchange(Exchange* const exchange);
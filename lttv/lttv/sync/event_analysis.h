@@ -66,6 +66,22 @@ typedef struct
 	 */
 	AllFactors* (*finalizeAnalysis)(struct _SyncState* const syncState);
 
+	/*
+	 * Return synchronization factors between trace pairs computed from the
+	 * messages analyzed so far, without finalizing the analysis. May be NULL
+	 * if the module cannot provide an estimate before the end of the trace.
+	 */
+	AllFactors* (*estimateAnalysis)(struct _SyncState* const syncState);
+
+	/*
+	 * Return the synchronization factors of each time window, as a GArray of
+	 * SegmentFactors sorted by start. The starts are times of trace 0. Is
+	 * only called after finalizeAnalysis and when syncState->segmentLength
+	 * is not 0. May be NULL if the module does not support piecewise
+	 * synchronization.
+	 */
+	GArray* (*finalizeSegments)(struct _SyncState* const syncState);
+
 	/*
 	 * Print statistics related to analysis. Is always called after
 	 * finalizeAnalysis.
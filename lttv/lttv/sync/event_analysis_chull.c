@@ -63,6 +63,8 @@ static void destroyAnalysisCHull(SyncState* const syncState);
 static void analyzeMessageCHull(SyncState* const syncState, Message* const
 	message);
 static AllFactors* finalizeAnalysisCHull(SyncState* const syncState);
+static AllFactors* estimateAnalysisCHull(SyncState* const syncState);
+static GArray* finalizeSegmentsCHull(SyncState* const syncState);
 static void printAnalysisStatsCHull(SyncState* const syncState);
 static void writeAnalysisTraceTraceForePlotsCHull(SyncState* const syncState,
 	const unsigned int i, const unsigned int j);
@@ -73,13 +75,23 @@ static void closeGraphFiles(SyncState* const syncState);
 static void writeGraphFiles(SyncState* const syncState);
 static void gfDumpHullToFile(gpointer data, gpointer userData);
 
+static Hull** createHullArray(const unsigned int traceNb);
+static void destroyHullArray(Hull** const hullArray, const unsigned int
+	traceNb);
+static bool addHullPoint(Hull* const hull, const Point* const newPoint, const
+	HullType type);
+static void hullPush(Hull* const hull, const Point* const point);
+static void hullForeach(Hull* const hull, GFunc func, gpointer userData);
+
 AllFactors* calculateAllFactors(struct _SyncState* const syncState);
+static AllFactors* calculateHullArrayFactors(SyncState* const syncState, Hull**
+	const hullArray);
 void calculateFactorsMiddle(PairFactors* const factors);
-static Factors* calculateFactorsExact(GQueue* const cu, GQueue* const cl, const
+static Factors* calculateFactorsExact(Hull* const cu, Hull* const cl, const
 	LineType lineType) __attribute__((pure));
-static void calculateFactorsFallback(GQueue* const cr, GQueue* const cs,
+static void calculateFactorsFallback(Hull* const cr, Hull* const cs,
 	PairFactors* const result);
-static void grahamScan(GQueue* const hull, Point* const newPoint, const
+static void grahamScan(Hull* const hull, const Point* const newPoint, const
 	HullType type);
 static int jointCmp(const Point* const p1, const Point* const p2, const Point*
 	const p3) __attribute__((pure));
@@ -92,8 +104,6 @@ static double intercept(const Point* const p1, const Point* const p2)
 static double verticalDistance(Point* p1, Point* p2, Point* const point)
 	__attribute__((pure));
 
-static void gfPointDestroy(gpointer data, gpointer userData);
-
 // The next group of functions is only needed when computing synchronization
 // accuracy.
 #ifdef HAVE_LIBGLPK
@@ -105,7 +115,7 @@ static void writeAnalysisTraceTimeForePlotsCHull(SyncState* const syncState,
 static void writeAnalysisTraceTraceBackPlotsCHull(SyncState* const syncState,
 	const unsigned int i, const unsigned int j);
 
-static glp_prob* lpCreateProblem(GQueue* const lowerHull, GQueue* const
+static glp_prob* lpCreateProblem(Hull* const lowerHull, Hull* const
 	upperHull);
 static void gfLPAddRow(gpointer data, gpointer user_data);
 static Factors* calculateFactorsLP(glp_prob* const lp, const int direction);
@@ -131,6 +141,8 @@ static AnalysisModule analysisModuleCHull= {
 	.destroyAnalysis= &destroyAnalysisCHull,
 	.analyzeMessage= &analyzeMessageCHull,
 	.finalizeAnalysis= &finalizeAnalysisCHull,
+	.estimateAnalysis= &estimateAnalysisCHull,
+	.finalizeSegments= &finalizeSegmentsCHull,
 	.printAnalysisStats= &printAnalysisStatsCHull,
 	.graphFunctions= {
 #ifdef HAVE_LIBGLPK
@@ -165,26 +177,26 @@ void registerAnalysisCHull()
  *                 This function allocates or initializes these analysisData
  *                 members:
  *                 hullArray
+ *                 segmentHulls
  *                 dropped
  */
 static void initAnalysisCHull(SyncState* const syncState)
 {
-	unsigned int i, j;
 	AnalysisDataCHull* analysisData;
 
 	analysisData= malloc(sizeof(AnalysisDataCHull));
 	syncState->analysisData= analysisData;
 
-	analysisData->hullArray= malloc(syncState->traceNb * sizeof(GQueue**));
-	for (i= 0; i < syncState->traceNb; i++)
+	analysisData->hullArray= createHullArray(syncState->traceNb);
+	if (syncState->segmentLength != 0)
 	{
-		analysisData->hullArray[i]= malloc(syncState->traceNb * sizeof(GQueue*));
-
-		for (j= 0; j < syncState->traceNb; j++)
-		{
-			analysisData->hullArray[i][j]= g_queue_new();
-		}
+		analysisData->segmentHulls= g_ptr_array_new();
 	}
+	else
+	{
+		analysisData->segmentHulls= NULL;
+	}
+	analysisData->segmentOrigin= 0;
 #ifdef HAVE_LIBGLPK
 	analysisData->lps= NULL;
 #endif
@@ -202,6 +214,59 @@ static void initAnalysisCHull(SyncState* const syncState)
 }
 
 
+/*
+ * Allocate a matrix of empty hulls
+ *
+ * Args:
+ *   traceNb:      number of traces
+ *
+ * Returns:
+ *   Hull* hullArray[traceNb][traceNb], see AnalysisDataCHull
+ */
+static Hull** createHullArray(const unsigned int traceNb)
+{
+	unsigned int i, j;
+	Hull** hullArray;
+
+	hullArray= malloc(traceNb * sizeof(Hull*));
+	for (i= 0; i < traceNb; i++)
+	{
+		hullArray[i]= malloc(traceNb * sizeof(Hull));
+
+		for (j= 0; j < traceNb; j++)
+		{
+			hullArray[i][j]= (Hull) {NULL, 0, 0};
+		}
+	}
+
+	return hullArray;
+}
+
+
+/*
+ * Free a matrix of hulls and their points
+ *
+ * Args:
+ *   hullArray:    matrix allocated by createHullArray()
+ *   traceNb:      number of traces
+ */
+static void destroyHullArray(Hull** const hullArray, const unsigned int
+	traceNb)
+{
+	unsigned int i, j;
+
+	for (i= 0; i < traceNb; i++)
+	{
+		for (j= 0; j < traceNb; j++)
+		{
+			free(hullArray[i][j].points);
+		}
+		free(hullArray[i]);
+	}
+	free(hullArray);
+}
+
+
 /*
  * Create and open files used to store convex hull points to genereate
  * graphs. Allocate and populate array to store file pointers.
@@ -274,7 +339,7 @@ static void writeGraphFiles(SyncState* const syncState)
 		{
 			if (i != j)
 			{
-				g_queue_foreach(analysisData->hullArray[i][j],
+				hullForeach(&analysisData->hullArray[i][j],
 					&gfDumpHullToFile,
 					analysisData->graphsData->hullPoints[i][j]);
 			}
@@ -284,7 +349,7 @@ static void writeGraphFiles(SyncState* const syncState)
 
 
 /*
- * A GFunc for g_queue_foreach. Write a hull point to a file used to generate
+ * A GFunc for hullForeach. Write a hull point to a file used to generate
  * graphs
  *
  * Args:
@@ -349,11 +414,12 @@ static void closeGraphFiles(SyncState* const syncState)
  *   syncState     container for synchronization data.
  *                 This function deallocates these analysisData members:
  *                 hullArray
+ *                 segmentHulls
  *                 stDev
  */
 static void destroyAnalysisCHull(SyncState* const syncState)
 {
-	unsigned int i, j;
+	unsigned int i;
 	AnalysisDataCHull* analysisData;
 
 	analysisData= (AnalysisDataCHull*) syncState->analysisData;
@@ -363,17 +429,17 @@ static void destroyAnalysisCHull(SyncState* const syncState)
 		return;
 	}
 
-	for (i= 0; i < syncState->traceNb; i++)
+	destroyHullArray(analysisData->hullArray, syncState->traceNb);
+
+	if (analysisData->segmentHulls != NULL)
 	{
-		for (j= 0; j < syncState->traceNb; j++)
+		for (i= 0; i < analysisData->segmentHulls->len; i++)
 		{
-			g_queue_foreach(analysisData->hullArray[i][j], gfPointDestroy,
-				NULL);
-			g_queue_free(analysisData->hullArray[i][j]);
+			destroyHullArray(g_ptr_array_index(analysisData->segmentHulls, i),
+				syncState->traceNb);
 		}
-		free(analysisData->hullArray[i]);
+		g_ptr_array_free(analysisData->segmentHulls, TRUE);
 	}
-	free(analysisData->hullArray);
 
 #ifdef HAVE_LIBGLPK
 	if (analysisData->lps != NULL)
@@ -441,53 +507,113 @@ static void destroyAnalysisCHull(SyncState* const syncState)
 static void analyzeMessageCHull(SyncState* const syncState, Message* const message)
 {
 	AnalysisDataCHull* analysisData;
-	Point* newPoint;
+	Point newPoint;
 	HullType hullType;
-	GQueue* hull;
+	Hull* hull;
 
 	analysisData= (AnalysisDataCHull*) syncState->analysisData;
 
-	newPoint= malloc(sizeof(Point));
 	if (message->inE->traceNum < message->outE->traceNum)
 	{
 		// CA is inE->traceNum
-		newPoint->x= message->inE->cpuTime;
-		newPoint->y= message->outE->cpuTime;
+		newPoint.x= message->inE->cpuTime;
+		newPoint.y= message->outE->cpuTime;
 		hullType= UPPER;
 		g_debug("Reception point hullArray[%lu][%lu] "
 			"x= inE->time= %" PRIu64 " y= outE->time= %" PRIu64,
-			message->inE->traceNum, message->outE->traceNum, newPoint->x,
-			newPoint->y);
+			message->inE->traceNum, message->outE->traceNum, newPoint.x,
+			newPoint.y);
 	}
 	else
 	{
 		// CA is outE->traceNum
-		newPoint->x= message->outE->cpuTime;
-		newPoint->y= message->inE->cpuTime;
+		newPoint.x= message->outE->cpuTime;
+		newPoint.y= message->inE->cpuTime;
 		hullType= LOWER;
 		g_debug("Send point hullArray[%lu][%lu] "
 			"x= inE->time= %" PRIu64 " y= outE->time= %" PRIu64,
-			message->inE->traceNum, message->outE->traceNum, newPoint->x,
-			newPoint->y);
+			message->inE->traceNum, message->outE->traceNum, newPoint.x,
+			newPoint.y);
 	}
 
 	hull=
-		analysisData->hullArray[message->inE->traceNum][message->outE->traceNum];
+		&analysisData->hullArray[message->inE->traceNum][message->outE->traceNum];
 
-	if (hull->length >= 1 && newPoint->x < ((Point*)
-			g_queue_peek_tail(hull))->x)
+	if (!addHullPoint(hull, &newPoint, hullType))
 	{
 		if (syncState->stats)
 		{
 			analysisData->stats->dropped++;
 		}
+	}
+	else if (syncState->stats && hull->length >
+		analysisData->stats->maxHullLength)
+	{
+		analysisData->stats->maxHullLength= hull->length;
+	}
 
-		free(newPoint);
+	/* The point is also added to the hulls of its time window. The windows
+	 * are on the abscissa, the time of the lower-numbered trace. For the
+	 * pairs with trace 0 it is the clock of the window starts, for the
+	 * other pairs the windows only match as closely as the clocks agree
+	 * before synchronization.
+	 */
+	if (analysisData->segmentHulls != NULL)
+	{
+		GPtrArray* segmentHulls= analysisData->segmentHulls;
+		uint64_t window;
+		Hull** windowHulls;
+
+		if (segmentHulls->len == 0)
+		{
+			analysisData->segmentOrigin= newPoint.x - newPoint.x %
+				syncState->segmentLength;
+		}
+
+		if (newPoint.x < analysisData->segmentOrigin)
+		{
+			window= 0;
+		}
+		else
+		{
+			window= (newPoint.x - analysisData->segmentOrigin) /
+				syncState->segmentLength;
+		}
+		while (segmentHulls->len <= window)
+		{
+			g_ptr_array_add(segmentHulls, createHullArray(syncState->traceNb));
+		}
+
+		windowHulls= g_ptr_array_index(segmentHulls, window);
+		addHullPoint(&windowHulls[message->inE->traceNum][message->outE->traceNum],
+			&newPoint, hullType);
 	}
-	else
+}
+
+
+/*
+ * Add a point to a half-hull, unless it is out of order
+ *
+ * Args:
+ *   hull:         the points already in the hull
+ *   newPoint:     a new point to consider, it is copied
+ *   type:         which half of the hull to construct
+ *
+ * Returns:
+ *   false if the point was dropped because its abscissa is lower than the
+ *   last point of the hull
+ */
+static bool addHullPoint(Hull* const hull, const Point* const newPoint, const
+	HullType type)
+{
+	if (hull->length >= 1 && newPoint->x < hull->points[hull->length - 1].x)
 	{
-		grahamScan(hull, newPoint, hullType);
+		return false;
 	}
+
+	grahamScan(hull, newPoint, type);
+
+	return true;
 }
 
 
@@ -499,7 +625,7 @@ static void analyzeMessageCHull(SyncState* const syncState, Message* const messa
  *   newPoint:     a new point to consider
  *   type:         which half of the hull to construct
  */
-static void grahamScan(GQueue* const hull, Point* const newPoint, const
+static void grahamScan(Hull* const hull, const Point* const newPoint, const
 	HullType type)
 {
 	int inversionFactor;
@@ -516,36 +642,55 @@ static void grahamScan(GQueue* const hull, Point* const newPoint, const
 		inversionFactor= -1;
 	}
 
-	if (hull->length >= 2)
+	while (hull->length >= 2 && jointCmp(&hull->points[hull->length - 2],
+			&hull->points[hull->length - 1], newPoint) * inversionFactor <= 0)
 	{
-		g_debug("jointCmp(hull[%u], hull[%u], newPoint) * inversionFactor = %d * %d = %d",
-			hull->length - 2,
-			hull->length - 1,
-			jointCmp(g_queue_peek_nth(hull, hull->length - 2),
-				g_queue_peek_tail(hull), newPoint),
-			inversionFactor,
-			jointCmp(g_queue_peek_nth(hull, hull->length - 2),
-				g_queue_peek_tail(hull), newPoint) * inversionFactor);
+		g_debug("Removing hull[%u]", hull->length - 1);
+		hull->length--;
 	}
-	while (hull->length >= 2 && jointCmp(g_queue_peek_nth(hull, hull->length -
-				2), g_queue_peek_tail(hull), newPoint) * inversionFactor <= 0)
-	{
-		g_debug("Removing hull[%u]", hull->length);
-		free((Point*) g_queue_pop_tail(hull));
+	hullPush(hull, newPoint);
+}
 
-		if (hull->length >= 2)
+
+/*
+ * Append a point at the end of a hull, growing its array if it is full
+ *
+ * Args:
+ *   hull:         the hull
+ *   point:        the point to append, it is copied
+ */
+static void hullPush(Hull* const hull, const Point* const point)
+{
+	if (hull->length == hull->capacity)
+	{
+		hull->capacity= hull->capacity == 0 ? 16 : hull->capacity * 2;
+		hull->points= realloc(hull->points, hull->capacity * sizeof(Point));
+		if (hull->points == NULL)
 		{
-			g_debug("jointCmp(hull[%u], hull[%u], newPoint) * inversionFactor = %d * %d = %d",
-				hull->length - 2,
-				hull->length - 1,
-				jointCmp(g_queue_peek_nth(hull, hull->length - 2),
-					g_queue_peek_tail(hull), newPoint),
-				inversionFactor,
-				jointCmp(g_queue_peek_nth(hull, hull->length - 2),
-					g_queue_peek_tail(hull), newPoint) * inversionFactor);
+			g_error("%s", strerror(errno));
 		}
 	}
-	g_queue_push_tail(hull, newPoint);
+
+	hull->points[hull->length++]= *point;
+}
+
+
+/*
+ * Call a function for each point of a hull, in order of abscissa
+ *
+ * Args:
+ *   hull:         the hull
+ *   func:         function called with a Point* and userData
+ *   userData:     passed to func
+ */
+static void hullForeach(Hull* const hull, GFunc func, gpointer userData)
+{
+	unsigned int i;
+
+	for (i= 0; i < hull->length; i++)
+	{
+		func(&hull->points[i], userData);
+	}
 }
 
 
@@ -619,6 +764,61 @@ static AllFactors* finalizeAnalysisCHull(SyncState* const syncState)
 }
 
 
+/*
+ * Calculate the factors from the messages analyzed so far
+ *
+ * The hulls are kept up to date as messages are analyzed, so this can be
+ * called at any time during the processing, for example to follow a live
+ * trace. It does not change the analysis state.
+ *
+ * Args:
+ *   syncState     container for synchronization data.
+ *
+ * Returns:
+ *   AllFactors*   synchronization factors for each trace pair, the caller is
+ *   responsible for freeing the structure
+ */
+static AllFactors* estimateAnalysisCHull(SyncState* const syncState)
+{
+	return calculateAllFactors(syncState);
+}
+
+
+/*
+ * Calculate the factors of each time window from the hulls of its messages
+ *
+ * Args:
+ *   syncState     container for synchronization data.
+ *
+ * Returns:
+ *   GArray* of SegmentFactors, one per window. The caller is responsible for
+ *   freeing the array and the factors it contains.
+ */
+static GArray* finalizeSegmentsCHull(SyncState* const syncState)
+{
+	AnalysisDataCHull* analysisData;
+	GArray* segments;
+	unsigned int i;
+
+	analysisData= (AnalysisDataCHull*) syncState->analysisData;
+
+	segments= g_array_sized_new(FALSE, FALSE, sizeof(SegmentFactors),
+		analysisData->segmentHulls->len);
+	for (i= 0; i < analysisData->segmentHulls->len; i++)
+	{
+		SegmentFactors segment;
+
+		segment.start= analysisData->segmentOrigin + i *
+			syncState->segmentLength;
+		segment.allFactors= calculateHullArrayFactors(syncState,
+			g_ptr_array_index(analysisData->segmentHulls, i));
+		g_array_append_val(segments, segment);
+	}
+
+	return segments;
+}
+
+
 /*
  * Print statistics related to analysis. Must be called after
  * finalizeAnalysis.
@@ -641,6 +841,8 @@ static void printAnalysisStatsCHull(SyncState* const syncState)
 	printf("Convex hull analysis stats:\n");
 	printf("\tout of order packets dropped from analysis: %u\n",
 		analysisData->stats->dropped);
+	printf("\tlargest half-hull during analysis: %u points\n",
+		analysisData->stats->maxHullLength);
 
 	printf("\tNumber of points in convex hulls:\n");
 
@@ -649,8 +851,8 @@ static void printAnalysisStatsCHull(SyncState* const syncState)
 		for (j= i + 1; j < syncState->traceNb; j++)
 		{
 			printf("\t\t%3d - %-3d: lower half-hull %-5u upper half-hull %-5u\n",
-				i, j, analysisData->hullArray[j][i]->length,
-				analysisData->hullArray[i][j]->length);
+				i, j, analysisData->hullArray[j][i].length,
+				analysisData->hullArray[i][j].length);
 		}
 	}
 
@@ -781,22 +983,6 @@ static void printAnalysisStatsCHull(SyncState* const syncState)
 }
 
 
-/*
- * A GFunc for g_queue_foreach()
- *
- * Args:
- *   data          Point*, point to destroy
- *   user_data     NULL
- */
-static void gfPointDestroy(gpointer data, gpointer userData)
-{
-	Point* point;
-
-	point= (Point*) data;
-	free(point);
-}
-
-
 /*
  * Find out if a sequence of three points constitutes a "left turn" or a
  * "right turn".
@@ -869,12 +1055,33 @@ static double crossProductK(const Point const* p1, const Point const* p2,
  */
 AllFactors* calculateAllFactors(SyncState* const syncState)
 {
-	unsigned int traceNumA, traceNumB;
-	AllFactors* geoFactors;
 	AnalysisDataCHull* analysisData;
 
 	analysisData= (AnalysisDataCHull*) syncState->analysisData;
 
+	return calculateHullArrayFactors(syncState, analysisData->hullArray);
+}
+
+
+/*
+ * Analyze a matrix of convex hulls to determine the synchronization factors
+ * between each pair of trace.
+ *
+ * Args:
+ *   syncState     container for synchronization data.
+ *   hullArray     hulls, with the same structure as
+ *                 AnalysisDataCHull.hullArray
+ *
+ * Returns:
+ *   AllFactors*, see the documentation for the member geoFactors of
+ *   AnalysisStatsCHull.
+ */
+static AllFactors* calculateHullArrayFactors(SyncState* const syncState, Hull**
+	const hullArray)
+{
+	unsigned int traceNumA, traceNumB;
+	AllFactors* geoFactors;
+
 	// Allocate geoFactors and calculate min and max
 	geoFactors= createAllFactors(syncState->traceNb);
 	for (traceNumA= 0; traceNumA < syncState->traceNb; traceNumA++)
@@ -882,7 +1089,7 @@ AllFactors* calculateAllFactors(SyncState* const syncState)
 		for (traceNumB= 0; traceNumB < traceNumA; traceNumB++)
 		{
 			unsigned int i;
-			GQueue* cs, * cr;
+			Hull* cs, * cr;
 			const struct
 			{
 				LineType lineType;
@@ -892,8 +1099,8 @@ AllFactors* calculateAllFactors(SyncState* const syncState)
 				{MAXIMUM, offsetof(PairFactors, max)}
 			};
 
-			cr= analysisData->hullArray[traceNumB][traceNumA];
-			cs= analysisData->hullArray[traceNumA][traceNumB];
+			cr= &hullArray[traceNumB][traceNumA];
+			cs= &hullArray[traceNumA][traceNumB];
 
 			for (i= 0; i < sizeof(loopValues) / sizeof(*loopValues); i++)
 			{
@@ -922,8 +1129,8 @@ AllFactors* calculateAllFactors(SyncState* const syncState)
 			if (factorsCHull->min == NULL && factorsCHull->max == NULL)
 			{
 				factorsCHull->type= APPROXIMATE;
-				calculateFactorsFallback(analysisData->hullArray[traceNumB][traceNumA],
-					analysisData->hullArray[traceNumA][traceNumB],
+				calculateFactorsFallback(&hullArray[traceNumB][traceNumA],
+					&hullArray[traceNumA][traceNumB],
 					&geoFactors->pairFactors[traceNumA][traceNumB]);
 			}
 			else if (factorsCHull->min != NULL && factorsCHull->max != NULL)
@@ -1024,10 +1231,10 @@ void calculateFactorsMiddle(PairFactors* const factors)
  *   result and returned
  *   NULL otherwise, degenerate case 2 is in effect
  */
-static Factors* calculateFactorsExact(GQueue* const cu, GQueue* const cl, const
+static Factors* calculateFactorsExact(Hull* const cu, Hull* const cl, const
 	LineType lineType)
 {
-	GQueue* c1, * c2;
+	Hull* c1, * c2;
 	unsigned int i1, i2;
 	Point* p1, * p2;
 	double inversionFactor;
@@ -1053,8 +1260,8 @@ static Factors* calculateFactorsExact(GQueue* const cu, GQueue* const cl, const
 	i2= c2->length - 1;
 
 	// Check for degenerate case 1
-	if (c1->length == 0 || c2->length == 0 || ((Point*) g_queue_peek_nth(c1,
-				i1))->x >= ((Point*) g_queue_peek_nth(c2, i2))->x)
+	if (c1->length == 0 || c2->length == 0 || c1->points[i1].x >=
+		c2->points[i2].x)
 	{
 		result= malloc(sizeof(Factors));
 		if (lineType == MINIMUM)
@@ -1077,14 +1284,13 @@ static Factors* calculateFactorsExact(GQueue* const cu, GQueue* const cl, const
 		(
 			(int) i2 - 1 > 0
 			&& crossProductK(
-				g_queue_peek_nth(c1, i1),
-				g_queue_peek_nth(c2, i2),
-				g_queue_peek_nth(c1, i1),
-				g_queue_peek_nth(c2, i2 - 1)) * inversionFactor < 0.
+				&c1->points[i1],
+				&c2->points[i2],
+				&c1->points[i1],
+				&c2->points[i2 - 1]) * inversionFactor < 0.
 		)
 		{
-			if (((Point*) g_queue_peek_nth(c1, i1))->x
-				< ((Point*) g_queue_peek_nth(c2, i2 - 1))->x)
+			if (c1->points[i1].x < c2->points[i2 - 1].x)
 			{
 				i2--;
 			}
@@ -1098,14 +1304,13 @@ static Factors* calculateFactorsExact(GQueue* const cu, GQueue* const cl, const
 		(
 			i1 + 1 < c1->length - 1
 			&& crossProductK(
-				g_queue_peek_nth(c1, i1),
-				g_queue_peek_nth(c2, i2),
-				g_queue_peek_nth(c1, i1 + 1),
-				g_queue_peek_nth(c2, i2)) * inversionFactor < 0.
+				&c1->points[i1],
+				&c2->points[i2],
+				&c1->points[i1 + 1],
+				&c2->points[i2]) * inversionFactor < 0.
 		)
 		{
-			if (((Point*) g_queue_peek_nth(c1, i1 + 1))->x
-					< ((Point*) g_queue_peek_nth(c2, i2))->x)
+			if (c1->points[i1 + 1].x < c2->points[i2].x)
 			{
 				i1++;
 			}
@@ -1119,14 +1324,14 @@ static Factors* calculateFactorsExact(GQueue* const cu, GQueue* const cl, const
 	(
 		(int) i2 - 1 > 0
 		&& crossProductK(
-			g_queue_peek_nth(c1, i1),
-			g_queue_peek_nth(c2, i2),
-			g_queue_peek_nth(c1, i1),
-			g_queue_peek_nth(c2, i2 - 1)) * inversionFactor < 0.
+			&c1->points[i1],
+			&c2->points[i2],
+			&c1->points[i1],
+			&c2->points[i2 - 1]) * inversionFactor < 0.
 	);
 
-	p1= g_queue_peek_nth(c1, i1);
-	p2= g_queue_peek_nth(c2, i2);
+	p1= &c1->points[i1];
+	p2= &c2->points[i2];
 
 	g_debug("Resulting points are: c1[i1]: x= %" PRIu64 " y= %" PRIu64
 		" c2[i2]: x= %" PRIu64 " y= %" PRIu64 "", p1->x, p1->y, p2->x, p2->y);
@@ -1167,7 +1372,7 @@ static Factors* calculateFactorsExact(GQueue* const cu, GQueue* const cl, const
  *   result:       a pointer to the pre-allocated struct where the results
  *                 will be stored
  */
-static void calculateFactorsFallback(GQueue* const cr, GQueue* const cs,
+static void calculateFactorsFallback(Hull* const cr, Hull* const cs,
 	PairFactors* const result)
 {
 	unsigned int i, j, k;
@@ -1186,32 +1391,32 @@ static void calculateFactorsFallback(GQueue* const cr, GQueue* const cs,
 
 			error= 0.;
 
-			if (((Point*) g_queue_peek_nth(cs, i))->x < ((Point*)g_queue_peek_nth(cr, j))->x)
+			if (cs->points[i].x < cr->points[j].x)
 			{
-				p1= *(Point*)g_queue_peek_nth(cs, i);
-				p2= *(Point*)g_queue_peek_nth(cr, j);
+				p1= cs->points[i];
+				p2= cr->points[j];
 			}
 			else
 			{
-				p1= *(Point*)g_queue_peek_nth(cr, j);
-				p2= *(Point*)g_queue_peek_nth(cs, i);
+				p1= cr->points[j];
+				p2= cs->points[i];
 			}
 
 			// The lower hull should be above the point
 			for (k= 0; k < cs->length; k++)
 			{
-				if (jointCmp(&p1, &p2, g_queue_peek_nth(cs, k)) < 0.)
+				if (jointCmp(&p1, &p2, &cs->points[k]) < 0.)
 				{
-					error+= verticalDistance(&p1, &p2, g_queue_peek_nth(cs, k));
+					error+= verticalDistance(&p1, &p2, &cs->points[k]);
 				}
 			}
 
 			// The upper hull should be below the point
 			for (k= 0; k < cr->length; k++)
 			{
-				if (jointCmp(&p1, &p2, g_queue_peek_nth(cr, k)) > 0.)
+				if (jointCmp(&p1, &p2, &cr->points[k]) > 0.)
 				{
-					error+= verticalDistance(&p1, &p2, g_queue_peek_nth(cr, k));
+					error+= verticalDistance(&p1, &p2, &cr->points[k]);
 				}
 			}
 
@@ -1399,15 +1604,14 @@ void writeAnalysisTraceTraceForePlotsCHull(SyncState* const syncState, const uns
  *   A new glp_prob*, this problem must be freed by the caller with
  *   glp_delete_prob()
  */
-static glp_prob* lpCreateProblem(GQueue* const lowerHull, GQueue* const
+static glp_prob* lpCreateProblem(Hull* const lowerHull, Hull* const
 	upperHull)
 {
 	unsigned int it;
 	const int zero= 0;
 	const double zeroD= 0.;
 	glp_prob* lp= glp_create_prob();
-	unsigned int hullPointNb= g_queue_get_length(lowerHull) +
-		g_queue_get_length(upperHull);
+	unsigned int hullPointNb= lowerHull->length + upperHull->length;
 	GArray* iArray= g_array_sized_new(FALSE, FALSE, sizeof(int), hullPointNb +
 		1);
 	GArray* jArray= g_array_sized_new(FALSE, FALSE, sizeof(int), hullPointNb +
@@ -1415,7 +1619,7 @@ static glp_prob* lpCreateProblem(GQueue* const lowerHull, GQueue* const
 	GArray* aArray= g_array_sized_new(FALSE, FALSE, sizeof(double),
 		hullPointNb + 1);
 	struct {
-		GQueue* hull;
+		Hull* hull;
 		struct LPAddRowInfo rowInfo;
 	} loopValues[2]= {
 		{lowerHull, {lp, GLP_UP, iArray, jArray, aArray}},
@@ -1442,7 +1646,7 @@ static glp_prob* lpCreateProblem(GQueue* const lowerHull, GQueue* const
 
 	for (it= 0; it < sizeof(loopValues) / sizeof(*loopValues); it++)
 	{
-		g_queue_foreach(loopValues[it].hull, &gfLPAddRow,
+		hullForeach(loopValues[it].hull, &gfLPAddRow,
 			&loopValues[it].rowInfo);
 	}
 
@@ -1464,7 +1668,7 @@ static glp_prob* lpCreateProblem(GQueue* const lowerHull, GQueue* const
 
 
 /*
- * A GFunc for g_queue_foreach(). Add constraints and bounds for one row.
+ * A GFunc for hullForeach(). Add constraints and bounds for one row.
  *
  * Args:
  *   data          Point*, synchronization point for which to add an LP row
@@ -1576,7 +1780,7 @@ static void calculateCompleteFactorsLP(glp_prob* const lp, PairFactors* factors)
 
 
 /*
- * A GFunc for g_queue_foreach()
+ * A GFunc for hullForeach()
  *
  * Args:
  *   data          Point*, a convex hull point
@@ -1647,11 +1851,11 @@ static AllFactors* finalizeAnalysisCHullLP(SyncState* const syncState)
 		{
 			glp_prob* lp;
 			unsigned int it;
-			GQueue*** hullArray= analysisData->hullArray;
+			Hull** hullArray= analysisData->hullArray;
 			PairFactors* lpFactors= &lpFactorsArray->pairFactors[i][j];
 
 			// Create the LP problem
-			lp= lpCreateProblem(hullArray[i][j], hullArray[j][i]);
+			lp= lpCreateProblem(&hullArray[i][j], &hullArray[j][i]);
 			analysisData->lps[i][j]= lp;
 
 			// Use the LP problem to find the correction factors for this pair of
@@ -1690,11 +1894,10 @@ static AllFactors* finalizeAnalysisCHullLP(SyncState* const syncState)
 
 				// Build the list of absisca values for the points in the accuracy graph
 				xValues= g_array_sized_new(FALSE, FALSE, sizeof(uint64_t),
-					g_queue_get_length(hullArray[i][j]) +
-					g_queue_get_length(hullArray[j][i]));
+					hullArray[i][j].length + hullArray[j][i].length);
 
-				g_queue_foreach(hullArray[i][j], &gfAddAbsiscaToArray, xValues);
-				g_queue_foreach(hullArray[j][i], &gfAddAbsiscaToArray, xValues);
+				hullForeach(&hullArray[i][j], &gfAddAbsiscaToArray, xValues);
+				hullForeach(&hullArray[j][i], &gfAddAbsiscaToArray, xValues);
 
 				g_array_sort(xValues, &gcfCompareUint64);
 
@@ -32,9 +32,24 @@ typedef struct
 } Point;
 
 
+/* A half-hull, its points are sorted by abscissa and stored contiguously.
+ * Points that the Graham scan removes are dropped from the end of the array
+ * and their slots are reused, so the memory used is bounded by the size of
+ * the hull, not by the number of messages analyzed.
+ */
+typedef struct
+{
+	Point* points;
+	unsigned int length;
+	unsigned int capacity;
+} Hull;
+
+
 typedef struct
 {
 	unsigned int dropped;
+	// Largest number of points held by a half-hull during the analysis
+	unsigned int maxHullLength;
 
 	/* geoFactors is divided into three parts depending on the position of an
 	 * element geoFactors->pairFactors[i][j]:
@@ -137,7 +152,7 @@ typedef struct
 
 typedef struct
 {
-	/* Point* hullArray[traceNb][traceNb][]
+	/* Hull hullArray[traceNb][traceNb]
 	 *
 	 * A message comes from two traces. The lowest numbered trace is
 	 * considered to be the reference clock, CA. The other is CB. The
@@ -176,7 +191,17 @@ typedef struct
 	 * is in fact the "lower half" of a hull. When assumptions are respected,
 	 * the lower half is above the upper half.
 	 */
-	GQueue*** hullArray;
+	Hull** hullArray;
+
+	/* Hull** segmentHulls[window]
+	 *
+	 * The hulls of the messages of each time window, with the same structure
+	 * as hullArray. Window k begins at segmentOrigin + k *
+	 * syncState->segmentLength, times are those of the reference clock, CA.
+	 * NULL unless syncState->segmentLength is not 0.
+	 */
+	GPtrArray* segmentHulls;
+	uint64_t segmentOrigin;
 
 #ifdef HAVE_LIBGLPK
 	/* glp_prob* lps[traceNum][traceNum]
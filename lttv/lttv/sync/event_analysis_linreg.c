@@ -22,6 +22,7 @@
 #include <config.h>
 #endif
 
+#include <inttypes.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,6 +44,9 @@ static void writeAnalysisGraphsPlotsLinReg(SyncState* const syncState, const
 
 // Functions specific to this module
 static void finalizeLSA(SyncState* const syncState);
+static void flushFit(Fit* const fit);
+static void kahanAdd(KahanSum* const sum, const double value);
+static double studentQuantile95(const int df);
 
 
 static AnalysisModule analysisModuleLinReg= {
@@ -51,6 +55,8 @@ static AnalysisModule analysisModuleLinReg= {
 	.destroyAnalysis= &destroyAnalysisLinReg,
 	.analyzeExchange= &analyzeExchangeLinReg,
 	.finalizeAnalysis= &finalizeAnalysisLinReg,
+	// Finalizing only reads the sums, it can be done at any time
+	.estimateAnalysis= &finalizeAnalysisLinReg,
 	.printAnalysisStats= &printAnalysisStatsLinReg,
 	.graphFunctions= {
 		.writeTraceTraceForePlots= &writeAnalysisGraphsPlotsLinReg,
@@ -111,7 +117,6 @@ static void initAnalysisLinReg(SyncState* const syncState)
  *   syncState     container for synchronization data.
  *                 This function deallocates these analysisData members:
  *                 fitArray
- *                 graphList
  *                 stDev
  */
 static void destroyAnalysisLinReg(SyncState* const syncState)
@@ -128,6 +133,12 @@ static void destroyAnalysisLinReg(SyncState* const syncState)
 
 	for (i= 0; i < syncState->traceNb; i++)
 	{
+		unsigned int j;
+
+		for (j= 0; j < syncState->traceNb; j++)
+		{
+			free(analysisData->fitArray[i][j].batchT);
+		}
 		free(analysisData->fitArray[i]);
 	}
 	free(analysisData->fitArray);
@@ -165,28 +176,38 @@ static void analyzeExchangeLinReg(SyncState* const syncState, Exchange* const ex
 	analysisData= (AnalysisDataLinReg*) syncState->analysisData;
 	ackedMessage= g_queue_peek_tail(exchange->acks);
 
-	// Calculate the intermediate values for the
-	// least-squares analysis
-	dji= ((double) ackedMessage->inE->cpuTime - (double) ackedMessage->outE->cpuTime
-		+ (double) exchange->message->outE->cpuTime - (double)
-		exchange->message->inE->cpuTime) / 2;
-	timoy= ((double) ackedMessage->outE->cpuTime + (double)
-		exchange->message->inE->cpuTime) / 2;
 	ni= ackedMessage->outE->traceNum;
 	nj= ackedMessage->inE->traceNum;
 	fit= &analysisData->fitArray[nj][ni];
 
+	if (fit->n == 0)
+	{
+		fit->t0= ackedMessage->outE->cpuTime;
+		fit->batchT= malloc(2 * FIT_BATCH_SIZE * sizeof(double));
+		fit->batchD= fit->batchT + FIT_BATCH_SIZE;
+	}
+
+	// Calculate the intermediate values for the
+	// least-squares analysis. The differences are taken on the integer
+	// times, before the conversion to double.
+	dji= ((double) (int64_t) (ackedMessage->inE->cpuTime -
+			ackedMessage->outE->cpuTime) + (double) (int64_t)
+		(exchange->message->outE->cpuTime - exchange->message->inE->cpuTime))
+		/ 2;
+	timoy= ((double) (int64_t) (ackedMessage->outE->cpuTime - fit->t0) +
+		(double) (int64_t) (exchange->message->inE->cpuTime - fit->t0)) / 2;
+
 	fit->n++;
-	fit->st+= timoy;
-	fit->st2+= pow(timoy, 2);
-	fit->sd+= dji;
-	fit->sd2+= pow(dji, 2);
-	fit->std+= timoy * dji;
+	fit->batchT[fit->batchNb]= timoy;
+	fit->batchD[fit->batchNb]= dji;
+	fit->batchNb++;
+	if (fit->batchNb == FIT_BATCH_SIZE)
+	{
+		flushFit(fit);
+	}
 
 	g_debug("intermediate values: dji= %f ti moy= %f "
-		"ni= %u nj= %u fit: n= %u st= %f st2= %f sd= %f "
-		"sd2= %f std= %f, ", dji, timoy, ni, nj, fit->n,
-		fit->st, fit->st2, fit->sd, fit->sd2, fit->std);
+		"ni= %u nj= %u fit: n= %u, ", dji, timoy, ni, nj, fit->n);
 }
 
 
@@ -200,6 +221,9 @@ static void analyzeExchangeLinReg(SyncState* const syncState, Exchange* const ex
  * necessary to use many graphs when there are "islands" of independent
  * traces.
  *
+ * The sums are not modified, so this can also be called before the end of
+ * the trace to get running estimates.
+ *
  * Args:
  *   syncState     container for synchronization data.
  *
@@ -260,7 +284,8 @@ static void printAnalysisStatsLinReg(SyncState* const syncState)
 
 	printf("Linear regression analysis stats:\n");
 
-	printf("\tIndividual synchronization factors:\n");
+	printf("\tIndividual synchronization factors (with 95%% confidence "
+		"intervals):\n");
 
 	for (j= 0; j < syncState->traceNb; j++)
 	{
@@ -270,13 +295,15 @@ static void printAnalysisStatsLinReg(SyncState* const syncState)
 
 			fit= &analysisData->fitArray[j][i];
 			printf("\t\t%3d - %-3d: ", i, j);
-			printf("a0= % 7g a1= 1 %c %7g accuracy %7g\n", fit->d0, fit->x <
-				0.  ? '-' : '+', fabs(fit->x), fit->e);
+			printf("a0= % 7g +/- %7g a1= 1 %c %7g +/- %7g accuracy %7g\n",
+				fit->d0, fit->d0Interval, fit->x < 0.  ? '-' : '+',
+				fabs(fit->x), fit->xInterval, fit->e);
 
 			fit= &analysisData->fitArray[i][j];
 			printf("\t\t%3d - %-3d: ", j, i);
-			printf("a0= % 7g a1= 1 %c %7g accuracy %7g\n", fit->d0, fit->x <
-				0.  ? '-' : '+', fabs(fit->x), fit->e);
+			printf("a0= % 7g +/- %7g a1= 1 %c %7g +/- %7g accuracy %7g\n",
+				fit->d0, fit->d0Interval, fit->x < 0.  ? '-' : '+',
+				fabs(fit->x), fit->xInterval, fit->e);
 		}
 	}
 }
@@ -287,6 +314,9 @@ static void printAnalysisStatsLinReg(SyncState* const syncState)
  * array are used to calculate the drift and the offset between each pair of
  * nodes based on their exchanges.
  *
+ * The sums are over times relative to t0, the regression line is moved back
+ * to absolute times at the end.
+ *
  * Args:
  *   syncState:    container for synchronization data.
  */
@@ -304,20 +334,37 @@ static void finalizeLSA(SyncState* const syncState)
 			if (i != j)
 			{
 				Fit* fit;
-				double delta;
+				double delta, st, st2, sd, sd2, std, t0, quantile;
 
 				fit= &analysisData->fitArray[i][j];
-
-				delta= fit->n * fit->st2 - pow(fit->st, 2);
-				fit->x= (fit->n * fit->std - fit->st * fit->sd) / delta;
-				fit->d0= (fit->st2 * fit->sd - fit->st * fit->std) / delta;
-				fit->e= sqrt((fit->sd2 - (fit->n * pow(fit->std, 2) +
-							pow(fit->sd, 2) * fit->st2 - 2 * fit->st * fit->sd
-							* fit->std) / delta) / (fit->n - 2));
+				if (fit->batchNb > 0)
+				{
+					flushFit(fit);
+				}
+
+				st= fit->st.sum;
+				st2= fit->st2.sum;
+				sd= fit->sd.sum;
+				sd2= fit->sd2.sum;
+				std= fit->std.sum;
+				t0= fit->t0;
+
+				delta= fit->n * st2 - pow(st, 2);
+				fit->x= (fit->n * std - st * sd) / delta;
+				fit->d0= (st2 * sd - st * std) / delta - fit->x * t0;
+				fit->e= sqrt((sd2 - (fit->n * pow(std, 2) + pow(sd, 2) * st2 -
+							2 * st * sd * std) / delta) / (fit->n - 2));
+
+				// The standard error of d0 depends on the sum of the squared
+				// absolute times
+				quantile= studentQuantile95((int) fit->n - 2);
+				fit->xInterval= quantile * fit->e * sqrt(fit->n / delta);
+				fit->d0Interval= quantile * fit->e * sqrt((st2 + 2 * t0 * st +
+						fit->n * pow(t0, 2)) / delta);
 
 				g_debug("[i= %u j= %u]", i, j);
-				g_debug("n= %d st= %g st2= %g sd= %g sd2= %g std= %g",
-					fit->n, fit->st, fit->st2, fit->sd, fit->sd2, fit->std);
+				g_debug("n= %d t0= %" PRIu64 " st= %g st2= %g sd= %g sd2= %g "
+					"std= %g", fit->n, fit->t0, st, st2, sd, sd2, std);
 				g_debug("xij= %g d0ij= %g e= %g", fit->x, fit->d0, fit->e);
 				g_debug("(xji= %g d0ji= %g)", -fit->x / (1 + fit->x),
 					-fit->d0 / (1 + fit->x));
@@ -327,6 +374,114 @@ static void finalizeLSA(SyncState* const syncState)
 }
 
 
+/*
+ * Add the buffered points of a fit to its sums
+ *
+ * The batch is first summed in FIT_LANES independent partial sums. The inner
+ * loop has no dependency between lanes, so the compiler can keep them in
+ * vector registers. The partial sums are then added to the compensated
+ * totals.
+ *
+ * Args:
+ *   fit:          fit whose batch is emptied
+ */
+#define FIT_LANES 4
+static void flushFit(Fit* const fit)
+{
+	double st[FIT_LANES]= {0.}, st2[FIT_LANES]= {0.}, sd[FIT_LANES]= {0.},
+		sd2[FIT_LANES]= {0.}, std[FIT_LANES]= {0.};
+	unsigned int i, k;
+
+	for (i= 0; i + FIT_LANES <= fit->batchNb; i+= FIT_LANES)
+	{
+		for (k= 0; k < FIT_LANES; k++)
+		{
+			const double t= fit->batchT[i + k], d= fit->batchD[i + k];
+
+			st[k]+= t;
+			st2[k]+= t * t;
+			sd[k]+= d;
+			sd2[k]+= d * d;
+			std[k]+= t * d;
+		}
+	}
+	for (k= 0; i < fit->batchNb; i++, k++)
+	{
+		const double t= fit->batchT[i], d= fit->batchD[i];
+
+		st[k]+= t;
+		st2[k]+= t * t;
+		sd[k]+= d;
+		sd2[k]+= d * d;
+		std[k]+= t * d;
+	}
+
+	for (k= 0; k < FIT_LANES; k++)
+	{
+		kahanAdd(&fit->st, st[k]);
+		kahanAdd(&fit->st2, st2[k]);
+		kahanAdd(&fit->sd, sd[k]);
+		kahanAdd(&fit->sd2, sd2[k]);
+		kahanAdd(&fit->std, std[k]);
+	}
+
+	fit->batchNb= 0;
+}
+#undef FIT_LANES
+
+
+/*
+ * Add a value to a compensated sum. This relies on strict floating point
+ * semantics, it must not be compiled with -ffast-math.
+ *
+ * Args:
+ *   sum:          sum to update
+ *   value:        value to add
+ */
+static void kahanAdd(KahanSum* const sum, const double value)
+{
+	const double y= value - sum->c;
+	const double t= sum->sum + y;
+
+	sum->c= (t - sum->sum) - y;
+	sum->sum= t;
+}
+
+
+/*
+ * Quantile of the Student t distribution for a two-sided 95% confidence
+ * interval. Exact values are tabulated for small degrees of freedom, a
+ * series approximation is used above.
+ *
+ * Args:
+ *   df:           degrees of freedom
+ *
+ * Returns:
+ *   The quantile, INFINITY if df < 1
+ */
+static double studentQuantile95(const int df)
+{
+	const double table[]= {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+		2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110,
+		2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+		2.048, 2.045, 2.042};
+	const double z= 1.959964;
+
+	if (df < 1)
+	{
+		return INFINITY;
+	}
+	else if (df <= (int) ARRAY_SIZE(table))
+	{
+		return table[df - 1];
+	}
+	else
+	{
+		return z + (pow(z, 3) + z) / (4 * df);
+	}
+}
+
+
 /*
  * Write the analysis-specific graph lines in the gnuplot script.
  *
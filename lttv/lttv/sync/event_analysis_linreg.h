@@ -19,15 +19,41 @@
 #define EVENT_ANALYSIS_LINREG_H
 
 #include <glib.h>
+#include <stdint.h>
 
 #include "data_structures.h"
 
 
+// Number of points buffered by a fit before they are added to its sums
+#define FIT_BATCH_SIZE 256
+
+// Sum with Kahan compensation, c holds the low-order bits lost by sum
+typedef struct
+{
+	double sum, c;
+} KahanSum;
+
+/* The points of a fit are buffered and added to the sums one batch at a
+ * time. Times are relative to t0, the time of the first point, so that the
+ * sums do not lose the low-order bits of the absolute times.
+ */
 typedef struct
 {
 	unsigned int n;
+	uint64_t t0;
+
+	// double batchT[FIT_BATCH_SIZE], batchD[FIT_BATCH_SIZE], points not yet
+	// in the sums, allocated with the first point
+	unsigned int batchNb;
+	double* batchT;
+	double* batchD;
+
 	// notation: s__: sum of __; __2: __ squared; example sd2: sum of d squared
-	double st, st2, sd, sd2, std, x, d0, e;
+	KahanSum st, st2, sd, sd2, std;
+
+	double x, d0, e;
+	// Half-width of the 95% confidence intervals of x and d0
+	double xInterval, d0Interval;
 } Fit;
 
 typedef struct
@@ -26,6 +26,7 @@
 #include <unistd.h>
 
 #include "event_analysis.h"
+#include "message_file.h"
 #include "sync_chain.h"
 
 #include "event_matching_tcp.h"
@@ -43,11 +44,22 @@ static void writeMatchingGraphsPlotsTCPMessages(SyncState* const syncState,
 
 // Functions specific to this module
 static void matchEvents(SyncState* const syncState, Event* const event,
-	GHashTable* const unMatchedList, GHashTable* const
+	SegmentTable* const unMatchedList, SegmentTable* const
 	unMatchedOppositeList, const size_t fieldOffset, const size_t
 	oppositeFieldOffset);
 static void partialDestroyMatchingTCP(SyncState* const syncState);
 
+static void initSegmentTable(SegmentTable* const table);
+static void destroySegmentTable(SegmentTable* const table);
+static uint32_t slotHash(const SegmentKey* const key);
+static Event* segmentTableSteal(SegmentTable* const table, const SegmentKey*
+	const key, const uint32_t hash);
+static void segmentTableReplace(SyncState* const syncState, SegmentTable*
+	const table, Event* const event, const uint32_t hash);
+static void rebuildSegmentTable(SyncState* const syncState, SegmentTable*
+	const table);
+static void removeSlot(SegmentTable* const table, unsigned int i);
+
 static bool isAck(const Message* const message);
 static bool needsAck(const Message* const message);
 static void buildReversedConnectionKey(ConnectionKey* const
@@ -56,7 +68,31 @@ static void buildReversedConnectionKey(ConnectionKey* const
 static void openGraphDataFiles(SyncState* const syncState);
 static void closeGraphDataFiles(SyncState* const syncState);
 static void writeMessagePoint(FILE* stream, const Message* const message);
+static void openMessageFile(SyncState* const syncState);
+static void closeMessageFile(SyncState* const syncState);
+static void writeMessageRecord(MatchingDataTCP* const matchingData, const
+	Message* const message);
+
 
+// Initial number of slots of the unmatched tables, must be a power of 2
+#define SEGMENT_TABLE_SIZE 256
+
+
+static ModuleOption optionSyncTCPTimeout= {
+	.longName= "sync-tcp-timeout",
+	.hasArg= REQUIRED_ARG,
+	.optionHelp= "drop the TCP events still unmatched after this time, it "
+		"must be larger than the clock offsets between the traces",
+	.argHelp= "seconds",
+};
+static ModuleOption optionSyncDumpMessages= {
+	.longName= "sync-dump-messages",
+	.hasArg= REQUIRED_ARG,
+	.optionHelp= "write the matched TCP messages to a binary test case for "
+		"the sync unittest",
+	.argHelp= "FILE",
+	.outputOnly= true,
+};
 
 static MatchingModule matchingModuleTCP = {
 	.name= "TCP",
@@ -79,6 +115,8 @@ static MatchingModule matchingModuleTCP = {
 void registerMatchingTCP()
 {
 	g_queue_push_tail(&matchingModules, &matchingModuleTCP);
+	g_queue_push_tail(&moduleOptions, &optionSyncTCPTimeout);
+	g_queue_push_tail(&moduleOptions, &optionSyncDumpMessages);
 }
 
 
@@ -96,6 +134,7 @@ void registerMatchingTCP()
  *                 unMatchedInE
  *                 unMatchedOutE
  *                 unAcked
+ *                 lastTime
  *                 stats
  */
 static void initMatchingTCP(SyncState* const syncState)
@@ -105,14 +144,35 @@ static void initMatchingTCP(SyncState* const syncState)
 	matchingData= malloc(sizeof(MatchingDataTCP));
 	syncState->matchingData= matchingData;
 
-	matchingData->unMatchedInE= g_hash_table_new_full(&ghfSegmentKeyHash,
-		&gefSegmentKeyEqual, NULL, &gdnDestroyEvent);
-	matchingData->unMatchedOutE= g_hash_table_new_full(&ghfSegmentKeyHash,
-		&gefSegmentKeyEqual, NULL, &gdnDestroyEvent);
+	initSegmentTable(&matchingData->unMatchedInE);
+	initSegmentTable(&matchingData->unMatchedOutE);
 	matchingData->unAcked= g_hash_table_new_full(&ghfConnectionKeyHash,
 		&gefConnectionKeyEqual, &gdnConnectionKeyDestroy,
 		&gdnTCPSegmentListDestroy);
 
+	matchingData->timeout= 0;
+	if (optionSyncTCPTimeout.arg != NULL)
+	{
+		double timeout= strtod(optionSyncTCPTimeout.arg, NULL);
+
+		if (!(timeout > 0.))
+		{
+			g_error("Invalid TCP matching timeout '%s'",
+				optionSyncTCPTimeout.arg);
+		}
+		matchingData->timeout= timeout * 1e9;
+	}
+	matchingData->lastTime= calloc(syncState->traceNb, sizeof(uint64_t));
+
+	if (optionSyncDumpMessages.arg != NULL)
+	{
+		openMessageFile(syncState);
+	}
+	else
+	{
+		matchingData->messageFile= NULL;
+	}
+
 	if (syncState->stats)
 	{
 		unsigned int i;
@@ -194,6 +254,8 @@ static void destroyMatchingTCP(SyncState* const syncState)
  *                 unMatchedInE
  *                 unMatchedOut
  *                 unAcked
+ *                 lastTime
+ *                 messageFile
  */
 static void partialDestroyMatchingTCP(SyncState* const syncState)
 {
@@ -201,15 +263,20 @@ static void partialDestroyMatchingTCP(SyncState* const syncState)
 
 	matchingData= (MatchingDataTCP*) syncState->matchingData;
 
-	if (matchingData == NULL || matchingData->unMatchedInE == NULL)
+	if (matchingData == NULL || matchingData->unMatchedInE.slots == NULL)
 	{
 		return;
 	}
 
-	g_hash_table_destroy(matchingData->unMatchedInE);
-	matchingData->unMatchedInE= NULL;
-	g_hash_table_destroy(matchingData->unMatchedOutE);
+	destroySegmentTable(&matchingData->unMatchedInE);
+	destroySegmentTable(&matchingData->unMatchedOutE);
 	g_hash_table_destroy(matchingData->unAcked);
+	free(matchingData->lastTime);
+
+	if (matchingData->messageFile != NULL)
+	{
+		closeMessageFile(syncState);
+	}
 
 	if (syncState->graphsStream && matchingData->messagePoints)
 	{
@@ -234,16 +301,21 @@ static void matchEventTCP(SyncState* const syncState, Event* const event)
 
 	matchingData= (MatchingDataTCP*) syncState->matchingData;
 
+	if (event->cpuTime > matchingData->lastTime[event->traceNum])
+	{
+		matchingData->lastTime[event->traceNum]= event->cpuTime;
+	}
+
 	if (event->event.tcpEvent->direction == IN)
 	{
-		matchEvents(syncState, event, matchingData->unMatchedInE,
-			matchingData->unMatchedOutE, offsetof(Message, inE),
+		matchEvents(syncState, event, &matchingData->unMatchedInE,
+			&matchingData->unMatchedOutE, offsetof(Message, inE),
 			offsetof(Message, outE));
 	}
 	else
 	{
-		matchEvents(syncState, event, matchingData->unMatchedOutE,
-			matchingData->unMatchedInE, offsetof(Message, outE),
+		matchEvents(syncState, event, &matchingData->unMatchedOutE,
+			&matchingData->unMatchedInE, offsetof(Message, outE),
 			offsetof(Message, inE));
 	}
 }
@@ -310,6 +382,12 @@ static void printMatchingStatsTCP(SyncState* const syncState)
 		printf("\ttotal synchronization exchanges: %u\n",
 			matchingData->stats->totExchangeSync);
 	}
+
+	if (matchingData->timeout != 0)
+	{
+		printf("\ttotal unmatched events dropped after the timeout: %u\n",
+			matchingData->stats->totExpired);
+	}
 }
 
 
@@ -328,29 +406,32 @@ static void printMatchingStatsTCP(SyncState* const syncState)
  *                 for the field of the opposite type of event
  */
 static void matchEvents(SyncState* const syncState, Event* const event,
-	GHashTable* const unMatchedList, GHashTable* const unMatchedOppositeList,
-	const size_t fieldOffset, const size_t oppositeFieldOffset)
+	SegmentTable* const unMatchedList, SegmentTable* const
+	unMatchedOppositeList, const size_t fieldOffset, const size_t
+	oppositeFieldOffset)
 {
 	Event* companionEvent;
-	Message* packet;
+	// The message is only copied to the heap if it is kept in unAcked
+	Message message, * packet;
 	MatchingDataTCP* matchingData;
 	GQueue* conUnAcked;
+	uint32_t hash;
 
 	matchingData= (MatchingDataTCP*) syncState->matchingData;
 
-	companionEvent= g_hash_table_lookup(unMatchedOppositeList, event->event.tcpEvent->segmentKey);
+	hash= slotHash(event->event.tcpEvent->segmentKey);
+	companionEvent= segmentTableSteal(unMatchedOppositeList,
+		event->event.tcpEvent->segmentKey, hash);
 	if (companionEvent != NULL)
 	{
 		g_debug("Found matching companion event, ");
 
 		// If it's there, remove it and create a Message
-		g_hash_table_steal(unMatchedOppositeList, event->event.tcpEvent->segmentKey);
-		packet= malloc(sizeof(Message));
+		packet= &message;
 		*((Event**) ((void*) packet + fieldOffset))= event;
 		*((Event**) ((void*) packet + oppositeFieldOffset))= companionEvent;
 		packet->print= &printTCPSegment;
 		// Both events can now share the same segmentKey
-		free(packet->outE->event.tcpEvent->segmentKey);
 		packet->outE->event.tcpEvent->segmentKey= packet->inE->event.tcpEvent->segmentKey;
 
 		if (syncState->stats)
@@ -362,10 +443,23 @@ static void matchEvents(SyncState* const syncState, Event* const event,
 		// Discard loopback traffic
 		if (packet->inE->traceNum == packet->outE->traceNum)
 		{
-			destroyTCPSegment(packet);
+			destroyTCPSegmentEvents(packet);
+			return;
+		}
+
+		// The factors between these traces were found in the cache
+		if (syncState->knownPairs != NULL &&
+			syncState->knownPairs[packet->inE->traceNum][packet->outE->traceNum])
+		{
+			destroyTCPSegmentEvents(packet);
 			return;
 		}
 
+		if (matchingData->messageFile != NULL)
+		{
+			writeMessageRecord(matchingData, packet);
+		}
+
 		if (syncState->graphsStream)
 		{
 			writeMessagePoint(matchingData->messagePoints[packet->inE->traceNum][packet->outE->traceNum],
@@ -381,7 +475,7 @@ static void matchEvents(SyncState* const syncState, Event* const event,
 		// interested in exchanges
 		if (syncState->analysisModule->analyzeExchange == NULL)
 		{
-			destroyTCPSegment(packet);
+			destroyTCPSegmentEvents(packet);
 			return;
 		}
 
@@ -483,11 +577,13 @@ static void matchEvents(SyncState* const syncState, Event* const event,
 				g_hash_table_insert(matchingData->unAcked, connectionKey,
 					conUnAcked= g_queue_new());
 			}
+			packet= malloc(sizeof(Message));
+			*packet= message;
 			g_queue_push_tail(conUnAcked, packet);
 		}
 		else
 		{
-			destroyTCPSegment(packet);
+			destroyTCPSegmentEvents(packet);
 		}
 	}
 	else
@@ -495,8 +591,234 @@ static void matchEvents(SyncState* const syncState, Event* const event,
 		// If there's no corresponding event, add the event to the unmatched
 		// list for this type of event
 		g_debug("Adding to unmatched event list, ");
-		g_hash_table_replace(unMatchedList, event->event.tcpEvent->segmentKey, event);
+		segmentTableReplace(syncState, unMatchedList, event, hash);
+	}
+}
+
+
+/*
+ * Allocate the slots of an empty unmatched table
+ *
+ * Args:
+ *   table         table to initialize
+ */
+static void initSegmentTable(SegmentTable* const table)
+{
+	table->size= SEGMENT_TABLE_SIZE;
+	table->count= 0;
+	table->slots= calloc(table->size, sizeof(SegmentSlot));
+}
+
+
+/*
+ * Free the slots of an unmatched table and the events it still contains
+ *
+ * Args:
+ *   table         table to destroy
+ */
+static void destroySegmentTable(SegmentTable* const table)
+{
+	unsigned int i;
+
+	for (i= 0; i < table->size; i++)
+	{
+		if (table->slots[i].hash != 0)
+		{
+			table->slots[i].event->destroy(table->slots[i].event);
+		}
 	}
+	free(table->slots);
+	table->slots= NULL;
+}
+
+
+/*
+ * Hash a SegmentKey for the unmatched tables
+ *
+ * Returns:
+ *   A hash of all fields in the SegmentKey, never 0
+ */
+static uint32_t slotHash(const SegmentKey* const key)
+{
+	uint32_t hash;
+
+	hash= segmentKeyHash(key);
+	if (hash == 0)
+	{
+		hash= 1;
+	}
+
+	return hash;
+}
+
+
+/*
+ * Find an event in an unmatched table and remove it
+ *
+ * Args:
+ *   table         table to search
+ *   key           key of the event
+ *   hash          slotHash() of key
+ *
+ * Returns:
+ *   The event, or NULL if no event has this key
+ */
+static Event* segmentTableSteal(SegmentTable* const table, const SegmentKey*
+	const key, const uint32_t hash)
+{
+	const unsigned int mask= table->size - 1;
+	unsigned int i;
+	Event* event;
+
+	for (i= hash & mask; table->slots[i].hash != 0; i= (i + 1) & mask)
+	{
+		if (table->slots[i].hash == hash &&
+			segmentKeyEqual(&table->slots[i].key, key))
+		{
+			event= table->slots[i].event;
+			removeSlot(table, i);
+
+			return event;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Add an event to an unmatched table. If an event with the same key is
+ * already present, it is destroyed and replaced.
+ *
+ * Args:
+ *   syncState     container for synchronization data
+ *   table         table to add to
+ *   event         TCP event to add
+ *   hash          slotHash() of the key of event
+ */
+static void segmentTableReplace(SyncState* const syncState, SegmentTable*
+	const table, Event* const event, const uint32_t hash)
+{
+	const SegmentKey* const key= event->event.tcpEvent->segmentKey;
+	unsigned int mask, i;
+
+	// Keep the load factor under 3/4
+	if ((table->count + 1) * 4 > table->size * 3)
+	{
+		rebuildSegmentTable(syncState, table);
+	}
+
+	mask= table->size - 1;
+	for (i= hash & mask; table->slots[i].hash != 0; i= (i + 1) & mask)
+	{
+		if (table->slots[i].hash == hash &&
+			segmentKeyEqual(&table->slots[i].key, key))
+		{
+			table->slots[i].event->destroy(table->slots[i].event);
+			table->slots[i].event= event;
+
+			return;
+		}
+	}
+
+	table->slots[i].hash= hash;
+	table->slots[i].key= *key;
+	table->slots[i].event= event;
+	table->count++;
+}
+
+
+/*
+ * Make room in a full unmatched table. The events that are older than the
+ * timeout are dropped and the table is doubled until it is at most half
+ * full.
+ *
+ * Args:
+ *   syncState     container for synchronization data
+ *   table         table to rebuild
+ */
+static void rebuildSegmentTable(SyncState* const syncState, SegmentTable*
+	const table)
+{
+	MatchingDataTCP* matchingData;
+	SegmentSlot* oldSlots;
+	unsigned int oldSize, mask, i, j;
+
+	matchingData= (MatchingDataTCP*) syncState->matchingData;
+	oldSlots= table->slots;
+	oldSize= table->size;
+
+	if (matchingData->timeout != 0)
+	{
+		for (i= 0; i < oldSize; i++)
+		{
+			Event* event= oldSlots[i].event;
+
+			if (oldSlots[i].hash != 0 &&
+				matchingData->lastTime[event->traceNum] - event->cpuTime >
+				matchingData->timeout)
+			{
+				event->destroy(event);
+				oldSlots[i].hash= 0;
+				table->count--;
+
+				if (syncState->stats)
+				{
+					matchingData->stats->totExpired++;
+				}
+			}
+		}
+	}
+
+	while ((table->count + 1) * 2 > table->size)
+	{
+		table->size*= 2;
+	}
+
+	table->slots= calloc(table->size, sizeof(SegmentSlot));
+	mask= table->size - 1;
+	for (i= 0; i < oldSize; i++)
+	{
+		if (oldSlots[i].hash != 0)
+		{
+			j= oldSlots[i].hash & mask;
+			while (table->slots[j].hash != 0)
+			{
+				j= (j + 1) & mask;
+			}
+			table->slots[j]= oldSlots[i];
+		}
+	}
+	free(oldSlots);
+}
+
+
+/*
+ * Empty a slot of an unmatched table. The following slots of the probe
+ * sequence are shifted back so that no tombstone is needed.
+ *
+ * Args:
+ *   table         table to remove from
+ *   i             index of the slot to empty
+ */
+static void removeSlot(SegmentTable* const table, unsigned int i)
+{
+	const unsigned int mask= table->size - 1;
+	unsigned int j;
+
+	for (j= (i + 1) & mask; table->slots[j].hash != 0; j= (j + 1) & mask)
+	{
+		unsigned int home= table->slots[j].hash & mask;
+
+		// The slot at j can move to i if i is between its home and j
+		if (((j - home) & mask) >= ((j - i) & mask))
+		{
+			table->slots[i]= table->slots[j];
+			i= j;
+		}
+	}
+	table->slots[i].hash= 0;
+	table->count--;
 }
 
 
@@ -647,6 +969,92 @@ static void writeMessagePoint(FILE* stream, const Message* const message)
 }
 
 
+/*
+ * Create the binary file where the messages are dumped. The header is
+ * written again when the file is closed, once the number of messages is
+ * known.
+ *
+ * Args:
+ *   syncState:    container for synchronization data
+ */
+static void openMessageFile(SyncState* const syncState)
+{
+	MatchingDataTCP* matchingData;
+	MessageFileHeader header= {
+		.magic= MESSAGE_FILE_MAGIC,
+		.version= MESSAGE_FILE_VERSION,
+		.traceNb= syncState->traceNb,
+		.messageNb= 0,
+	};
+
+	matchingData= (MatchingDataTCP*) syncState->matchingData;
+
+	matchingData->messageFile= fopen(optionSyncDumpMessages.arg, "wb");
+	if (matchingData->messageFile == NULL)
+	{
+		g_error("%s: %s", optionSyncDumpMessages.arg, strerror(errno));
+	}
+	if (fwrite(&header, sizeof(header), 1, matchingData->messageFile) != 1)
+	{
+		g_error("%s", strerror(errno));
+	}
+	matchingData->messageNb= 0;
+}
+
+
+/*
+ * Append a message to the binary message file
+ *
+ * Args:
+ *   matchingData: matching module data
+ *   message:      matched message
+ */
+static void writeMessageRecord(MatchingDataTCP* const matchingData, const
+	Message* const message)
+{
+	MessageRecord record= {
+		.sender= message->outE->traceNum,
+		.receiver= message->inE->traceNum,
+		.sendTime= message->outE->cpuTime,
+		.recvTime= message->inE->cpuTime,
+	};
+
+	if (fwrite(&record, sizeof(record), 1, matchingData->messageFile) != 1)
+	{
+		g_error("%s", strerror(errno));
+	}
+	matchingData->messageNb++;
+}
+
+
+/*
+ * Complete the header of the binary message file and close it
+ *
+ * Args:
+ *   syncState:    container for synchronization data
+ */
+static void closeMessageFile(SyncState* const syncState)
+{
+	MatchingDataTCP* matchingData;
+	MessageFileHeader header= {
+		.magic= MESSAGE_FILE_MAGIC,
+		.version= MESSAGE_FILE_VERSION,
+		.traceNb= syncState->traceNb,
+	};
+
+	matchingData= (MatchingDataTCP*) syncState->matchingData;
+	header.messageNb= matchingData->messageNb;
+
+	if (fseek(matchingData->messageFile, 0, SEEK_SET) != 0 ||
+		fwrite(&header, sizeof(header), 1, matchingData->messageFile) != 1 ||
+		fclose(matchingData->messageFile) != 0)
+	{
+		g_error("%s", strerror(errno));
+	}
+	matchingData->messageFile= NULL;
+}
+
+
 /*
  * Close files used to store convex hull points to genereate graphs.
  * Deallocate array to store file pointers.
@@ -19,6 +19,7 @@
 #define EVENT_MATCHING_TCP_H
 
 #include <glib.h>
+#include <stdint.h>
 
 #include "data_structures.h"
 
@@ -28,7 +29,8 @@ typedef struct
 	unsigned int totPacket,
 		totPacketNeedAck,
 		totExchangeEffective,
-		totExchangeSync;
+		totExchangeSync,
+		totExpired;
 	/* The structure of the array is the same as for hullArray in
 	 * analysis_chull, messagePoints[row][col] where:
 	 *   row= inE->traceNum
@@ -37,15 +39,47 @@ typedef struct
 	unsigned int** totMessageArray;
 } MatchingStatsTCP;
 
+/* Unmatched events are kept in open addressing tables with linear probing.
+ * The key is copied in the slot along with its hash so that probing does not
+ * have to follow the event pointer.
+ */
 typedef struct
 {
-	// NetEvent* unMatchedInE[packetKey]
-	GHashTable* unMatchedInE;
-	// NetEvent* unMatchedOutE[packetKey]
-	GHashTable* unMatchedOutE;
+	// 0 if the slot is empty, hashes of keys are never 0
+	uint32_t hash;
+	SegmentKey key;
+	Event* event;
+} SegmentSlot;
+
+typedef struct
+{
+	// Number of slots, a power of 2
+	unsigned int size;
+	unsigned int count;
+	SegmentSlot* slots;
+} SegmentTable;
+
+typedef struct
+{
+	// Event* unMatchedInE[packetKey]
+	SegmentTable unMatchedInE;
+	// Event* unMatchedOutE[packetKey]
+	SegmentTable unMatchedOutE;
 	// Packet* unAcked[connectionKey]
 	GHashTable* unAcked;
 
+	/* Unmatched events older than this, in ns, compared to the last event of
+	 * their trace are dropped when a table is about to grow. 0 to keep them
+	 * forever. */
+	uint64_t timeout;
+	// uint64_t lastTime[traceNum], time of the last event of each trace
+	uint64_t* lastTime;
+
+	// Binary file where the messages are dumped, see message_file.h, NULL
+	// if they are not
+	FILE* messageFile;
+	uint64_t messageNb;
+
 	MatchingStatsTCP* stats;
 	/* This array is used for graphs. It contains file pointers to files where
 	 * messages x-y points are outputed. Each trace-pair has two files, one
@@ -38,6 +38,12 @@ typedef struct
 	 */
 	void (*initProcessing)(struct _SyncState* const syncStateLttv, ...);
 
+	/*
+	 * Read the events and pass them to the matching module. May be NULL if
+	 * the events are read by finalizeProcessing.
+	 */
+	void (*runProcessing)(struct _SyncState* const syncState);
+
 	/*
 	 * Obtain the factors from downstream.
 	 */
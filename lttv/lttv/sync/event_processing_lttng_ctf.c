@@ -0,0 +1,1118 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <babeltrace/ctf/events.h>
+#include <lttv/event.h>
+#include <lttv/hook.h>
+#include <lttv/time.h>
+#include <lttv/traceset-process.h>
+
+#include "sync_chain.h"
+#include "sync_streams.h"
+
+#include "event_processing_lttng_ctf.h"
+
+/* IPv4 Ethertype, taken from <linux/if_ether.h>, unlikely to change as it's
+ * defined by IANA: http://www.iana.org/assignments/ethernet-numbers
+ */
+#define ETH_P_IP    0x0800
+
+// Number of events that may wait for the matching thread, per trace
+#define CTF_QUEUE_SIZE 4096
+
+/* With --sync-stats, the factors estimated from the messages analyzed so far
+ * are printed every time this number of events has been matched
+ */
+#define CTF_ESTIMATE_INTERVAL (UINT64_C(1) << 20)
+
+
+// Functions common to all processing modules
+static void initProcessingLTTngCTF(SyncState* const syncState, ...);
+static void runProcessingLTTngCTF(SyncState* const syncState);
+static void destroyProcessingLTTngCTF(SyncState* const syncState);
+
+static AllFactors* finalizeProcessingLTTngCTF(SyncState* const syncState);
+static void printProcessingStatsLTTngCTF(SyncState* const syncState);
+static void writeProcessingGraphVariablesLTTngCTF(SyncState* const syncState,
+	const unsigned int i);
+static void writeProcessingTraceTraceOptionsLTTngCTF(SyncState* const
+	syncState, const unsigned int i, const unsigned int j);
+static void writeProcessingTraceTimeOptionsLTTngCTF(SyncState* const
+	syncState, const unsigned int i, const unsigned int j);
+
+// Functions specific to this module
+static gboolean processEventLTTngCTF(void* hookData, void* callData);
+static void partialDestroyProcessingLTTngCTF(SyncState* const syncState);
+static CTFEventHandle* resolveEventHandle(CTFReader* const reader, const
+	struct bt_ctf_event* const event);
+static void matchEvent(SyncState* const syncState, Event* const event);
+static void printEstimatedFactors(SyncState* const syncState);
+static void emitEvent(CTFReader* const reader, Event* const event, const
+	uint64_t time);
+
+
+static ProcessingModule processingModuleLTTngCTF = {
+	.name= "LTTng-CTF",
+	.initProcessing= &initProcessingLTTngCTF,
+	.runProcessing= &runProcessingLTTngCTF,
+	.destroyProcessing= &destroyProcessingLTTngCTF,
+	.finalizeProcessing= &finalizeProcessingLTTngCTF,
+	.printProcessingStats= &printProcessingStatsLTTngCTF,
+	.graphFunctions= {
+		.writeVariables= &writeProcessingGraphVariablesLTTngCTF,
+		.writeTraceTraceOptions= &writeProcessingTraceTraceOptionsLTTngCTF,
+		.writeTraceTimeOptions= &writeProcessingTraceTimeOptionsLTTngCTF,
+	},
+};
+
+/* Names of the network events, as produced by the LTTng 2.x kernel tracer
+ * and the extended network probes
+ */
+static const struct
+{
+	const char* name;
+	CTFEventType type;
+} eventNames[]= {
+	{"net_dev_xmit_extended", CTF_EVENT_DEV_XMIT},
+	{"netif_receive_skb", CTF_EVENT_DEV_RECEIVE},
+	{"net_dev_receive", CTF_EVENT_DEV_RECEIVE},
+	{"tcpv4_rcv_extended", CTF_EVENT_TCPV4_RCV},
+	{"udpv4_rcv_extended", CTF_EVENT_UDPV4_RCV},
+};
+
+/* Payload field names, LTTng 2.x kernel events use "skbaddr" where the
+ * extended probes use "skb"
+ */
+static const char* const fieldNames[CTF_FIELD_COUNT][2]= {
+	[CTF_FIELD_SKB]= {"skb", "skbaddr"},
+	[CTF_FIELD_PROTOCOL]= {"protocol", NULL},
+	[CTF_FIELD_NETWORK_PROTOCOL]= {"network_protocol", NULL},
+	[CTF_FIELD_TRANSPORT_PROTOCOL]= {"transport_protocol", NULL},
+	[CTF_FIELD_SADDR]= {"saddr", NULL},
+	[CTF_FIELD_DADDR]= {"daddr", NULL},
+	[CTF_FIELD_TOT_LEN]= {"tot_len", NULL},
+	[CTF_FIELD_IHL]= {"ihl", NULL},
+	[CTF_FIELD_SOURCE]= {"source", NULL},
+	[CTF_FIELD_DEST]= {"dest", NULL},
+	[CTF_FIELD_SEQ]= {"seq", NULL},
+	[CTF_FIELD_ACK_SEQ]= {"ack_seq", NULL},
+	[CTF_FIELD_DOFF]= {"doff", NULL},
+	[CTF_FIELD_ACK]= {"ack", NULL},
+	[CTF_FIELD_RST]= {"rst", NULL},
+	[CTF_FIELD_SYN]= {"syn", NULL},
+	[CTF_FIELD_FIN]= {"fin", NULL},
+	[CTF_FIELD_UNICAST]= {"unicast", NULL},
+	[CTF_FIELD_ULEN]= {"ulen", NULL},
+	[CTF_FIELD_DATA_START]= {"data_start", NULL},
+};
+
+#define FIELD_BIT(field) (UINT32_C(1) << (field))
+
+#define TCP_HEADER_FIELDS (FIELD_BIT(CTF_FIELD_SADDR) | \
+	FIELD_BIT(CTF_FIELD_DADDR) | FIELD_BIT(CTF_FIELD_TOT_LEN) | \
+	FIELD_BIT(CTF_FIELD_IHL) | FIELD_BIT(CTF_FIELD_SOURCE) | \
+	FIELD_BIT(CTF_FIELD_DEST) | FIELD_BIT(CTF_FIELD_SEQ) | \
+	FIELD_BIT(CTF_FIELD_ACK_SEQ) | FIELD_BIT(CTF_FIELD_DOFF) | \
+	FIELD_BIT(CTF_FIELD_ACK) | FIELD_BIT(CTF_FIELD_RST) | \
+	FIELD_BIT(CTF_FIELD_SYN) | FIELD_BIT(CTF_FIELD_FIN))
+
+/* Fields without which an event cannot be used. The protocol fields are
+ * optional, when they are absent the event is not filtered on them.
+ */
+static const uint32_t requiredFields[]= {
+	[CTF_EVENT_NONE]= 0,
+	[CTF_EVENT_DEV_XMIT]= TCP_HEADER_FIELDS,
+	[CTF_EVENT_DEV_RECEIVE]= FIELD_BIT(CTF_FIELD_SKB),
+	[CTF_EVENT_TCPV4_RCV]= FIELD_BIT(CTF_FIELD_SKB) | TCP_HEADER_FIELDS,
+	[CTF_EVENT_UDPV4_RCV]= FIELD_BIT(CTF_FIELD_SKB) |
+		FIELD_BIT(CTF_FIELD_SADDR) | FIELD_BIT(CTF_FIELD_DADDR) |
+		FIELD_BIT(CTF_FIELD_UNICAST) | FIELD_BIT(CTF_FIELD_ULEN) |
+		FIELD_BIT(CTF_FIELD_SOURCE) | FIELD_BIT(CTF_FIELD_DEST) |
+		FIELD_BIT(CTF_FIELD_DATA_START),
+};
+
+
+/*
+ * Processing Module registering function
+ */
+void registerProcessingLTTngCTF()
+{
+	g_queue_push_tail(&processingModules, &processingModuleLTTngCTF);
+}
+
+
+/*
+ * Tell if the events of a given name are used by this module
+ *
+ * Args:
+ *   name:         event name
+ *
+ * Returns:
+ *   true if events of this name are needed for synchronization
+ */
+bool isSyncEventLTTngCTF(const char* const name)
+{
+	unsigned int i;
+
+	for (i= 0; i < ARRAY_SIZE(eventNames); i++)
+	{
+		if (strcmp(name, eventNames[i].name) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * Allocate and initialize data structures for synchronizing a traceset.
+ * Open the traces for reading and register the event hooks.
+ *
+ * Args:
+ *   syncState:    container for synchronization data.
+ *                 This function allocates these processingData members:
+ *                 readers
+ *   traceset:     LttvTraceset*, set of LTTV traces
+ *   sparse:       int, true to read only the streams that may hold network
+ *                 events
+ *   parallel:     int, true to read each trace in its own thread
+ */
+static void initProcessingLTTngCTF(SyncState* const syncState, ...)
+{
+	unsigned int i;
+	ProcessingDataLTTngCTF* processingData;
+	LttvTraceset* traceset;
+	bool sparse;
+	va_list ap;
+
+	processingData= malloc(sizeof(ProcessingDataLTTngCTF));
+	syncState->processingData= processingData;
+	va_start(ap, syncState);
+	traceset= va_arg(ap, LttvTraceset*);
+	sparse= va_arg(ap, int);
+	processingData->parallel= va_arg(ap, int);
+	va_end(ap);
+	processingData->matchedNb= 0;
+	syncState->traceNb= lttv_traceset_number(traceset);
+
+	if (processingData->parallel)
+	{
+		processingData->readerNb= syncState->traceNb;
+	}
+	else
+	{
+		processingData->readerNb= 1;
+	}
+	processingData->readers= calloc(processingData->readerNb,
+		sizeof(CTFReader));
+
+	for (i= 0; i < processingData->readerNb; i++)
+	{
+		CTFReader* reader= &processingData->readers[i];
+		unsigned int traceNb, j;
+
+		reader->syncState= syncState;
+		if (processingData->parallel)
+		{
+			reader->traceOffset= i;
+			traceNb= 1;
+		}
+		else
+		{
+			reader->traceOffset= 0;
+			traceNb= syncState->traceNb;
+		}
+
+		/* In parallel, each trace needs its own babeltrace context since
+		 * there can be only one iterator per context
+		 */
+		reader->traceset= NULL;
+		if (sparse)
+		{
+			reader->traceset= createSyncTraceset(traceset,
+				reader->traceOffset, traceNb, &isSyncEventLTTngCTF);
+		}
+		if (reader->traceset == NULL && processingData->parallel)
+		{
+			reader->traceset= createSyncTraceset(traceset,
+				reader->traceOffset, traceNb, NULL);
+			if (reader->traceset == NULL)
+			{
+				g_error("Cannot open trace %u for synchronization", i);
+			}
+		}
+		reader->ownTraceset= reader->traceset != NULL;
+		if (reader->traceset == NULL)
+		{
+			reader->traceset= traceset;
+		}
+
+		reader->handles= g_hash_table_new_full(&g_direct_hash, NULL, NULL,
+			&free);
+
+		reader->pendingRecv= malloc(sizeof(GHashTable*) * traceNb);
+		for(j= 0; j < traceNb; j++)
+		{
+			reader->pendingRecv[j]= g_hash_table_new_full(&g_int64_hash,
+				&g_int64_equal, &free, &gdnDestroyEvent);
+		}
+
+		if (processingData->parallel)
+		{
+			reader->queue= spscQueueNew(CTF_QUEUE_SIZE,
+				sizeof(CTFQueuedEvent));
+		}
+		else
+		{
+			reader->queue= NULL;
+		}
+
+		lttv_hooks_add(lttv_traceset_get_hooks(reader->traceset),
+			&processEventLTTngCTF, reader, LTTV_PRIO_DEFAULT);
+	}
+}
+
+
+/*
+ * Read all the events of a reader's traceset
+ *
+ * Args:
+ *   reader:       reader
+ */
+static void readTraceset(CTFReader* const reader)
+{
+	lttv_process_traceset_begin(reader->traceset, NULL, NULL, NULL);
+	lttv_process_traceset_seek_time(reader->traceset, ltt_time_zero);
+	lttv_process_traceset_middle(reader->traceset, ltt_time_infinite,
+		G_MAXULONG, NULL);
+	lttv_process_traceset_seek_time(reader->traceset, ltt_time_zero);
+	lttv_process_traceset_end(reader->traceset, NULL, NULL, NULL);
+}
+
+
+/*
+ * Thread function of a reader, the end of the trace is marked by a NULL
+ * event in the queue
+ *
+ * Args:
+ *   arg:          CTFReader*
+ */
+static void* readerThread(void* arg)
+{
+	CTFReader* reader= (CTFReader*) arg;
+	const CTFQueuedEvent end= {NULL, 0};
+
+	readTraceset(reader);
+	releaseTCPEventCache();
+	spscQueuePush(reader->queue, &end);
+
+	return NULL;
+}
+
+
+/*
+ * Read the traceset and pass its network events to the matching module
+ *
+ * When the traces are read in parallel, the events of the readers are
+ * merged before they are matched, in this thread. The matching, analysis and
+ * reduction modules therefore always run in a single thread. The merge is on
+ * the time of the trace event that completed each event, a receive event is
+ * only complete at the transport event, so the events reach the matching
+ * module in the same order as when a single reader reads all the traces.
+ * Between traces, equal times are ordered by trace number.
+ *
+ * Args:
+ *   syncState:    container for synchronization data.
+ */
+static void runProcessingLTTngCTF(SyncState* const syncState)
+{
+	ProcessingDataLTTngCTF* processingData;
+	CTFQueuedEvent* heads;
+	unsigned int i;
+
+	processingData= (ProcessingDataLTTngCTF*) syncState->processingData;
+
+	if (!processingData->parallel)
+	{
+		readTraceset(&processingData->readers[0]);
+		return;
+	}
+
+	for (i= 0; i < processingData->readerNb; i++)
+	{
+		if (pthread_create(&processingData->readers[i].thread, NULL,
+				&readerThread, &processingData->readers[i]) != 0)
+		{
+			g_error("Cannot create the reader thread of trace %u", i);
+		}
+	}
+
+	// heads[reader], next event of each reader, event is NULL when it is
+	// done
+	heads= malloc(processingData->readerNb * sizeof(CTFQueuedEvent));
+	for (i= 0; i < processingData->readerNb; i++)
+	{
+		spscQueuePop(processingData->readers[i].queue, &heads[i]);
+	}
+
+	while (true)
+	{
+		int next= -1;
+
+		for (i= 0; i < processingData->readerNb; i++)
+		{
+			if (heads[i].event != NULL && (next == -1 || heads[i].time <
+					heads[next].time))
+			{
+				next= i;
+			}
+		}
+		if (next == -1)
+		{
+			break;
+		}
+
+		matchEvent(syncState, heads[next].event);
+		spscQueuePop(processingData->readers[next].queue, &heads[next]);
+	}
+	free(heads);
+
+	for (i= 0; i < processingData->readerNb; i++)
+	{
+		pthread_join(processingData->readers[i].thread, NULL);
+	}
+}
+
+
+/*
+ * Call the partial processing destroyer, obtain and the factors from
+ * downstream
+ *
+ * Args:
+ *   syncState     container for synchronization data.
+ *
+ * Returns:
+ *   AllFactors    synchronization factors for each trace pair
+ */
+static AllFactors* finalizeProcessingLTTngCTF(SyncState* const syncState)
+{
+	partialDestroyProcessingLTTngCTF(syncState);
+
+	if (syncState->matchingModule == NULL)
+	{
+		return createAllFactors(syncState->traceNb);
+	}
+
+	return syncState->matchingModule->finalizeMatching(syncState);
+}
+
+
+/*
+ * Print statistics related to processing. Must be called after
+ * finalizeProcessing.
+ *
+ * Args:
+ *   syncState     container for synchronization data.
+ */
+static void printProcessingStatsLTTngCTF(SyncState* const syncState)
+{
+	ProcessingDataLTTngCTF* processingData;
+	ProcessingStatsLTTngCTF stats= {0, 0, 0, 0, 0};
+	unsigned int i;
+
+	if (!syncState->stats)
+	{
+		return;
+	}
+
+	processingData= (ProcessingDataLTTngCTF*) syncState->processingData;
+
+	for (i= 0; i < processingData->readerNb; i++)
+	{
+		ProcessingStatsLTTngCTF* readerStats=
+			&processingData->readers[i].stats;
+
+		stats.totRecv+= readerStats->totRecv;
+		stats.totRecvIp+= readerStats->totRecvIp;
+		stats.totRecvTCP+= readerStats->totRecvTCP;
+		stats.totRecvUDP+= readerStats->totRecvUDP;
+		stats.totOutE+= readerStats->totOutE;
+	}
+
+	printf("LTTng CTF processing stats:\n");
+	printf("\treceived frames: %d\n", stats.totRecv);
+	printf("\treceived frames that are IP: %d\n", stats.totRecvIp);
+	printf("\treceived and processed packets that are TCP: %d\n",
+		stats.totRecvTCP);
+	printf("\treceived and processed packets that are UDP: %d\n",
+		stats.totRecvUDP);
+	printf("\tsent packets that are TCP: %d\n", stats.totOutE);
+}
+
+
+/*
+ * Unregister the event hooks. Deallocate processingData.
+ *
+ * Args:
+ *   syncState:    container for synchronization data.
+ *                 This function deallocates these processingData members:
+ *                 readers
+ */
+static void destroyProcessingLTTngCTF(SyncState* const syncState)
+{
+	ProcessingDataLTTngCTF* processingData;
+
+	processingData= (ProcessingDataLTTngCTF*) syncState->processingData;
+
+	if (processingData == NULL)
+	{
+		return;
+	}
+
+	partialDestroyProcessingLTTngCTF(syncState);
+
+	free(processingData->readers);
+
+	free(syncState->processingData);
+	syncState->processingData= NULL;
+}
+
+
+/*
+ * Unregister the event hooks and close the traces. Deallocate some of
+ * processingData.
+ *
+ * This function can be called right after the events have been processed to
+ * free some data structures that are not needed for finalization.
+ *
+ * Args:
+ *   syncState:    container for synchronization data.
+ *                 This function deallocates these members of the readers:
+ *                 traceset, if it was opened for synchronization
+ *                 handles
+ *                 pendingRecv
+ *                 queue
+ */
+static void partialDestroyProcessingLTTngCTF(SyncState* const syncState)
+{
+	unsigned int i, j;
+	ProcessingDataLTTngCTF* processingData;
+
+	processingData= (ProcessingDataLTTngCTF*) syncState->processingData;
+
+	if (processingData == NULL)
+	{
+		return;
+	}
+
+	for (i= 0; i < processingData->readerNb; i++)
+	{
+		CTFReader* reader= &processingData->readers[i];
+		unsigned int traceNb;
+
+		if (reader->handles == NULL)
+		{
+			continue;
+		}
+
+		lttv_hooks_remove_data(lttv_traceset_get_hooks(reader->traceset),
+			&processEventLTTngCTF, reader);
+
+		traceNb= processingData->parallel ? 1 : syncState->traceNb;
+		for(j= 0; j < traceNb; j++)
+		{
+			g_debug("Cleaning up pendingRecv list");
+			g_hash_table_destroy(reader->pendingRecv[j]);
+		}
+		free(reader->pendingRecv);
+
+		g_hash_table_destroy(reader->handles);
+		reader->handles= NULL;
+
+		if (reader->queue != NULL)
+		{
+			spscQueueDestroy(reader->queue);
+			reader->queue= NULL;
+		}
+
+		if (reader->ownTraceset)
+		{
+			destroySyncTraceset(reader->traceset);
+		}
+		reader->traceset= NULL;
+	}
+}
+
+
+/*
+ * Find the fields of an event class in its payload declaration
+ *
+ * Args:
+ *   reader:       reader of the event, the handle is cached in it
+ *   event:        first event of this class
+ *
+ * Returns:
+ *   The handle of the event class, its type is CTF_EVENT_NONE if the events
+ *   of this class are not used for synchronization
+ */
+static CTFEventHandle* resolveEventHandle(CTFReader* const reader, const
+	struct bt_ctf_event* const event)
+{
+	CTFEventHandle* handle;
+	const struct bt_definition* scope;
+	struct bt_definition const* const* list;
+	unsigned int count, i, j, k;
+	const char* name;
+	uint32_t found= 0;
+
+	handle= malloc(sizeof(CTFEventHandle));
+	handle->type= CTF_EVENT_NONE;
+	handle->traceNum= reader->traceOffset +
+		lttv_traceset_get_trace_index_from_handle_id(reader->traceset,
+			bt_ctf_event_get_handle_id(event));
+	handle->signedFields= 0;
+	for (i= 0; i < CTF_FIELD_COUNT; i++)
+	{
+		handle->fields[i]= -1;
+	}
+	g_hash_table_insert(reader->handles, bt_ctf_event_get_decl(event),
+		handle);
+
+	name= bt_ctf_event_name(event);
+	for (i= 0; i < ARRAY_SIZE(eventNames); i++)
+	{
+		if (strcmp(name, eventNames[i].name) == 0)
+		{
+			handle->type= eventNames[i].type;
+			break;
+		}
+	}
+	if (handle->type == CTF_EVENT_NONE)
+	{
+		return handle;
+	}
+
+	scope= bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+	if (bt_ctf_get_field_list(event, scope, &list, &count) != 0)
+	{
+		count= 0;
+	}
+
+	for (i= 0; i < count; i++)
+	{
+		const char* fieldName= bt_ctf_field_name(list[i]);
+
+		for (j= 0; j < CTF_FIELD_COUNT; j++)
+		{
+			for (k= 0; k < ARRAY_SIZE(fieldNames[j]) && fieldNames[j][k] !=
+				NULL; k++)
+			{
+				if (strcmp(fieldName, fieldNames[j][k]) == 0)
+				{
+					const struct bt_declaration* decl=
+						bt_ctf_get_decl_from_def(list[i]);
+
+					handle->fields[j]= i;
+					found|= FIELD_BIT(j);
+					if (bt_ctf_field_type(decl) == CTF_TYPE_INTEGER &&
+						bt_ctf_get_int_signedness(decl) == 1)
+					{
+						handle->signedFields|= FIELD_BIT(j);
+					}
+				}
+			}
+		}
+	}
+
+	if ((found & requiredFields[handle->type]) != requiredFields[handle->type])
+	{
+		g_warning("Event '%s' of trace %u lacks fields needed for "
+			"synchronization, ignoring it", name, handle->traceNum);
+		handle->type= CTF_EVENT_NONE;
+	}
+
+	return handle;
+}
+
+
+/*
+ * Read an integer field through its resolved position
+ *
+ * Args:
+ *   handle:       handle of the event class
+ *   list:         payload fields of the event
+ *   field:        field to read, it must be present
+ *
+ * Returns:
+ *   The field value
+ */
+static inline uint64_t getField(const CTFEventHandle* const handle, struct
+	bt_definition const* const* list, const CTFField field)
+{
+	const struct bt_definition* def= list[handle->fields[field]];
+
+	if (handle->signedFields & FIELD_BIT(field))
+	{
+		return bt_ctf_get_int64(def);
+	}
+	else
+	{
+		return bt_ctf_get_uint64(def);
+	}
+}
+
+
+/*
+ * Fill a SegmentKey from the TCP header fields of an event
+ *
+ * Args:
+ *   handle:       handle of the event class
+ *   list:         payload fields of the event
+ *   segmentKey:   key to fill
+ */
+static void getSegmentKey(const CTFEventHandle* const handle, struct
+	bt_definition const* const* list, SegmentKey* const segmentKey)
+{
+	segmentKey->connectionKey.saddr= htonl(getField(handle, list,
+			CTF_FIELD_SADDR));
+	segmentKey->connectionKey.daddr= htonl(getField(handle, list,
+			CTF_FIELD_DADDR));
+	segmentKey->tot_len= getField(handle, list, CTF_FIELD_TOT_LEN);
+	segmentKey->ihl= getField(handle, list, CTF_FIELD_IHL);
+	segmentKey->connectionKey.source= getField(handle, list,
+		CTF_FIELD_SOURCE);
+	segmentKey->connectionKey.dest= getField(handle, list, CTF_FIELD_DEST);
+	segmentKey->seq= getField(handle, list, CTF_FIELD_SEQ);
+	segmentKey->ack_seq= getField(handle, list, CTF_FIELD_ACK_SEQ);
+	segmentKey->doff= getField(handle, list, CTF_FIELD_DOFF);
+	segmentKey->ack= getField(handle, list, CTF_FIELD_ACK);
+	segmentKey->rst= getField(handle, list, CTF_FIELD_RST);
+	segmentKey->syn= getField(handle, list, CTF_FIELD_SYN);
+	segmentKey->fin= getField(handle, list, CTF_FIELD_FIN);
+}
+
+
+/*
+ * Pass an event to the matching module, or drop it when the traceset is only
+ * read (sync-null)
+ *
+ * Args:
+ *   syncState:    container for synchronization data
+ *   event:        event to match, ownership is transferred
+ */
+static void matchEvent(SyncState* const syncState, Event* const event)
+{
+	ProcessingDataLTTngCTF* processingData= syncState->processingData;
+
+	if (syncState->matchingModule != NULL)
+	{
+		syncState->matchingModule->matchEvent(syncState, event);
+
+		processingData->matchedNb++;
+		if (syncState->stats &&
+			processingData->matchedNb % CTF_ESTIMATE_INTERVAL == 0)
+		{
+			printEstimatedFactors(syncState);
+		}
+	}
+	else
+	{
+		event->destroy(event);
+	}
+}
+
+
+/*
+ * Print the factors estimated by the analysis module from the messages
+ * analyzed so far, for the trace pairs that have an approximation
+ *
+ * Args:
+ *   syncState:    container for synchronization data
+ */
+static void printEstimatedFactors(SyncState* const syncState)
+{
+	ProcessingDataLTTngCTF* processingData= syncState->processingData;
+	AllFactors* allFactors;
+	unsigned int i, j;
+
+	allFactors= estimateFactors(syncState);
+	if (allFactors == NULL)
+	{
+		return;
+	}
+
+	printf("Estimated factors after %" PRIu64 " events:\n",
+		processingData->matchedNb);
+	for (i= 0; i < syncState->traceNb; i++)
+	{
+		for (j= i + 1; j < syncState->traceNb; j++)
+		{
+			PairFactors* factors= &allFactors->pairFactors[j][i];
+
+			if (factors->approx != NULL)
+			{
+				printf("\t%3u - %-3u: a0= % 7g a1= %.9f\n", i, j,
+					factors->approx->offset, factors->approx->drift);
+			}
+		}
+	}
+
+	freeAllFactors(allFactors, syncState->traceNb);
+}
+
+
+/*
+ * Pass an event to the matching module, through the matching thread when
+ * the traces are read in parallel
+ *
+ * Args:
+ *   reader:       reader of the event
+ *   event:        event to match, ownership is transferred
+ *   time:         time of the trace event being processed
+ */
+static void emitEvent(CTFReader* const reader, Event* const event, const
+	uint64_t time)
+{
+	if (reader->queue != NULL)
+	{
+		const CTFQueuedEvent queued= {event, time};
+
+		spscQueuePush(reader->queue, &queued);
+	}
+	else
+	{
+		matchEvent(reader->syncState, event);
+	}
+}
+
+
+/*
+ * Lttv hook function that will be called for all events
+ *
+ * Args:
+ *   hookData:     CTFReader* of the traceset
+ *   callData:     LttvEvent* at the moment of the event
+ *
+ * Returns:
+ *   FALSE         Always returns FALSE, meaning to keep processing hooks for
+ *                 this event
+ */
+static gboolean processEventLTTngCTF(void* hookData, void* callData)
+{
+	CTFReader* reader;
+	SyncState* syncState;
+	struct bt_ctf_event* event;
+	CTFEventHandle* handle;
+	const struct bt_definition* scope;
+	struct bt_definition const* const* list;
+	unsigned int count;
+	uint64_t time;
+	WallTime wTime;
+	unsigned long traceNum;
+	GHashTable* pendingRecv;
+
+	reader= (CTFReader*) hookData;
+	syncState= reader->syncState;
+	event= ((LttvEvent*) callData)->bt_event;
+
+	handle= g_hash_table_lookup(reader->handles, bt_ctf_event_get_decl(event));
+	if (handle == NULL)
+	{
+		handle= resolveEventHandle(reader, event);
+	}
+	if (handle->type == CTF_EVENT_NONE)
+	{
+		return FALSE;
+	}
+
+	scope= bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+	if (bt_ctf_get_field_list(event, scope, &list, &count) != 0)
+	{
+		g_warning("Cannot read the fields of event '%s'",
+			bt_ctf_event_name(event));
+		return FALSE;
+	}
+
+	/* The clock of LTTng 2.x kernel traces counts nanoseconds, the factors
+	 * are therefore computed on the timestamps
+	 */
+	time= bt_ctf_get_timestamp(event);
+	wTime.seconds= time / NANOSECONDS_PER_SECOND;
+	wTime.nanosec= time % NANOSECONDS_PER_SECOND;
+	traceNum= handle->traceNum;
+	pendingRecv= reader->pendingRecv[traceNum - reader->traceOffset];
+
+	g_debug("Process event: time: %u.%09u trace: %lu name: %s ",
+		wTime.seconds, wTime.nanosec, traceNum, bt_ctf_event_name(event));
+
+	if (handle->type == CTF_EVENT_DEV_XMIT)
+	{
+		Event* outE;
+
+		if ((handle->fields[CTF_FIELD_NETWORK_PROTOCOL] != -1 &&
+				getField(handle, list, CTF_FIELD_NETWORK_PROTOCOL) !=
+				ETH_P_IP) ||
+			(handle->fields[CTF_FIELD_TRANSPORT_PROTOCOL] != -1 &&
+				getField(handle, list, CTF_FIELD_TRANSPORT_PROTOCOL) !=
+				IPPROTO_TCP))
+		{
+			return FALSE;
+		}
+
+		if (syncState->matchingModule != NULL &&
+			!syncState->matchingModule->canMatch[TCP])
+		{
+			return FALSE;
+		}
+
+		if (syncState->stats)
+		{
+			reader->stats.totOutE++;
+		}
+
+		outE= createTCPEvent();
+		outE->traceNum= traceNum;
+		outE->cpuTime= time;
+		outE->wallTime= wTime;
+		outE->event.tcpEvent->direction= OUT;
+		getSegmentKey(handle, list, outE->event.tcpEvent->segmentKey);
+
+		emitEvent(reader, outE, time);
+
+		g_debug("Output event done");
+	}
+	else if (handle->type == CTF_EVENT_DEV_RECEIVE)
+	{
+		if (syncState->stats)
+		{
+			reader->stats.totRecv++;
+		}
+
+		if (handle->fields[CTF_FIELD_PROTOCOL] == -1 ||
+			getField(handle, list, CTF_FIELD_PROTOCOL) == ETH_P_IP)
+		{
+			Event* inE;
+			uint64_t* skb;
+
+			if (syncState->stats)
+			{
+				reader->stats.totRecvIp++;
+			}
+
+			// Most receptions are TCP, the event is converted in the case of
+			// UDP
+			inE= createTCPEvent();
+			inE->traceNum= traceNum;
+			inE->cpuTime= time;
+			inE->wallTime= wTime;
+			inE->event.tcpEvent->direction= IN;
+
+			skb= malloc(sizeof(uint64_t));
+			*skb= getField(handle, list, CTF_FIELD_SKB);
+			g_hash_table_replace(pendingRecv, skb, inE);
+
+			g_debug("Adding inE %p for skb %" PRIx64 " to pendingRecv", inE,
+				*skb);
+		}
+	}
+	else if (handle->type == CTF_EVENT_TCPV4_RCV ||
+		handle->type == CTF_EVENT_UDPV4_RCV)
+	{
+		Event* inE;
+		uint64_t skb;
+		gpointer origKey;
+
+		// Search pendingRecv for an event with the same skb
+		skb= getField(handle, list, CTF_FIELD_SKB);
+
+		if (!g_hash_table_lookup_extended(pendingRecv, &skb, &origKey,
+				(gpointer*) &inE))
+		{
+			// This should only happen in case of lost events
+			g_warning("No matching pending receive event found");
+			return FALSE;
+		}
+
+		// If it's there, remove it and proceed with a receive event
+		g_hash_table_steal(pendingRecv, &skb);
+		free(origKey);
+
+		if (handle->type == CTF_EVENT_TCPV4_RCV)
+		{
+			if (syncState->stats)
+			{
+				reader->stats.totRecvTCP++;
+			}
+
+			getSegmentKey(handle, list, inE->event.tcpEvent->segmentKey);
+
+			if (syncState->matchingModule != NULL &&
+				!syncState->matchingModule->canMatch[TCP])
+			{
+				inE->destroy(inE);
+				return FALSE;
+			}
+
+			emitEvent(reader, inE, time);
+
+			g_debug("TCP input event %p for skb %" PRIx64 " done", inE, skb);
+		}
+		else
+		{
+			uint64_t dataStart;
+			DatagramKey* datagramKey;
+			Event* tcpInE;
+
+			if (syncState->stats)
+			{
+				reader->stats.totRecvUDP++;
+			}
+
+			tcpInE= inE;
+			inE= malloc(sizeof(Event));
+			inE->traceNum= tcpInE->traceNum;
+			inE->cpuTime= tcpInE->cpuTime;
+			inE->wallTime= tcpInE->wallTime;
+			tcpInE->destroy(tcpInE);
+
+			inE->type= UDP;
+			inE->event.udpEvent= malloc(sizeof(UDPEvent));
+			inE->copy= &copyUDPEvent;
+			inE->destroy= &destroyUDPEvent;
+			inE->event.udpEvent->direction= IN;
+			inE->event.udpEvent->datagramKey= datagramKey=
+				malloc(sizeof(DatagramKey));
+			datagramKey->saddr= htonl(getField(handle, list,
+					CTF_FIELD_SADDR));
+			datagramKey->daddr= htonl(getField(handle, list,
+					CTF_FIELD_DADDR));
+			inE->event.udpEvent->unicast= getField(handle, list,
+				CTF_FIELD_UNICAST) == 0 ? false : true;
+			datagramKey->ulen= getField(handle, list, CTF_FIELD_ULEN);
+			datagramKey->source= getField(handle, list, CTF_FIELD_SOURCE);
+			datagramKey->dest= getField(handle, list, CTF_FIELD_DEST);
+			dataStart= getField(handle, list, CTF_FIELD_DATA_START);
+			g_assert_cmpuint(sizeof(datagramKey->dataKey), ==,
+				sizeof(uint64_t));
+			if (datagramKey->ulen - 8 >= sizeof(datagramKey->dataKey))
+			{
+				memcpy(datagramKey->dataKey, &dataStart,
+					sizeof(datagramKey->dataKey));
+			}
+			else
+			{
+				memset(datagramKey->dataKey, 0, sizeof(datagramKey->dataKey));
+				memcpy(datagramKey->dataKey, &dataStart, datagramKey->ulen -
+					8);
+			}
+
+			if (syncState->matchingModule != NULL &&
+				!syncState->matchingModule->canMatch[UDP])
+			{
+				inE->destroy(inE);
+				return FALSE;
+			}
+
+			emitEvent(reader, inE, time);
+
+			g_debug("UDP input event %p for skb %" PRIx64 " done", inE, skb);
+		}
+	}
+	else
+	{
+		g_assert_not_reached();
+	}
+
+	return FALSE;
+}
+
+
+/*
+ * Write the processing-specific variables in the gnuplot script.
+ *
+ * Args:
+ *   syncState:    container for synchronization data
+ *   i:            trace number
+ */
+static void writeProcessingGraphVariablesLTTngCTF(SyncState* const syncState,
+	const unsigned int i)
+{
+	fprintf(syncState->graphsStream, "clock_freq_%u= %.3f\n", i, (double)
+		NANOSECONDS_PER_SECOND);
+}
+
+
+/*
+ * Write the processing-specific options in the gnuplot script.
+ *
+ * Args:
+ *   syncState:    container for synchronization data
+ *   i:            first trace number
+ *   j:            second trace number, garanteed to be larger than i
+ */
+static void writeProcessingTraceTraceOptionsLTTngCTF(SyncState* const
+	syncState, const unsigned int i, const unsigned int j)
+{
+	fprintf(syncState->graphsStream,
+        "set key inside right bottom\n"
+        "set xlabel \"Clock %1$u\"\n"
+        "set xtics nomirror\n"
+        "set ylabel \"Clock %2$u\"\n"
+        "set ytics nomirror\n"
+		"set x2label \"Clock %1$d (s)\"\n"
+		"set x2range [GPVAL_X_MIN / clock_freq_%1$u : GPVAL_X_MAX / clock_freq_%1$u]\n"
+		"set x2tics\n"
+		"set y2label \"Clock %2$d (s)\"\n"
+		"set y2range [GPVAL_Y_MIN / clock_freq_%2$u : GPVAL_Y_MAX / clock_freq_%2$u]\n"
+		"set y2tics\n", i, j);
+}
+
+
+/*
+ * Write the processing-specific options in the gnuplot script.
+ *
+ * Args:
+ *   syncState:    container for synchronization data
+ *   i:            first trace number
+ *   j:            second trace number, garanteed to be larger than i
+ */
+static void writeProcessingTraceTimeOptionsLTTngCTF(SyncState* const
+	syncState, const unsigned int i, const unsigned int j)
+{
+	fprintf(syncState->graphsStream,
+        "set key inside right bottom\n"
+        "set xlabel \"Clock %1$u\"\n"
+        "set xtics nomirror\n"
+        "set ylabel \"time (s)\"\n"
+        "set ytics nomirror\n"
+		"set x2label \"Clock %1$d (s)\"\n"
+		"set x2range [GPVAL_X_MIN / clock_freq_%1$u : GPVAL_X_MAX / clock_freq_%1$u]\n"
+		"set x2tics\n", i);
+}
@@ -0,0 +1,141 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENT_PROCESSING_LTTNG_CTF_H
+#define EVENT_PROCESSING_LTTNG_CTF_H
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <lttv/traceset.h>
+
+#include "event_processing.h"
+#include "spsc_queue.h"
+
+typedef enum
+{
+	CTF_EVENT_NONE,
+	CTF_EVENT_DEV_XMIT,
+	CTF_EVENT_DEV_RECEIVE,
+	CTF_EVENT_TCPV4_RCV,
+	CTF_EVENT_UDPV4_RCV,
+} CTFEventType;
+
+typedef enum
+{
+	CTF_FIELD_SKB,
+	CTF_FIELD_PROTOCOL,
+	CTF_FIELD_NETWORK_PROTOCOL,
+	CTF_FIELD_TRANSPORT_PROTOCOL,
+	CTF_FIELD_SADDR,
+	CTF_FIELD_DADDR,
+	CTF_FIELD_TOT_LEN,
+	CTF_FIELD_IHL,
+	CTF_FIELD_SOURCE,
+	CTF_FIELD_DEST,
+	CTF_FIELD_SEQ,
+	CTF_FIELD_ACK_SEQ,
+	CTF_FIELD_DOFF,
+	CTF_FIELD_ACK,
+	CTF_FIELD_RST,
+	CTF_FIELD_SYN,
+	CTF_FIELD_FIN,
+	CTF_FIELD_UNICAST,
+	CTF_FIELD_ULEN,
+	CTF_FIELD_DATA_START,
+	CTF_FIELD_COUNT // This must be the last field
+} CTFField;
+
+/* The fields of an event class are resolved the first time an event of that
+ * class is seen. Afterwards, a field is read by its position in the payload
+ * instead of by a name lookup.
+ */
+typedef struct
+{
+	CTFEventType type;
+	unsigned int traceNum;
+	// int fields[CTFField], position in the payload, -1 if absent
+	int fields[CTF_FIELD_COUNT];
+	// bit CTFField is set if the field is a signed integer
+	uint32_t signedFields;
+} CTFEventHandle;
+
+typedef struct
+{
+	int totRecv,
+		totRecvIp,
+		totRecvTCP,
+		totRecvUDP,
+		totOutE;
+} ProcessingStatsLTTngCTF;
+
+struct _SyncState;
+
+/* Event passed from a reader thread to the matching thread, with the time of
+ * the trace event that completed it. The readers emit their events in the
+ * order of this time, which is the order in which a single reader would
+ * emit them.
+ */
+typedef struct
+{
+	Event* event;
+	uint64_t time;
+} CTFQueuedEvent;
+
+/* A reader decodes the events of some traces of the traceset. When the
+ * traces are read in parallel, there is one reader per trace, each one with
+ * its own thread and babeltrace context.
+ */
+typedef struct
+{
+	struct _SyncState* syncState;
+
+	LttvTraceset* traceset;
+	// true if the traceset was opened for synchronization
+	bool ownTraceset;
+	// traceNum of the first trace of traceset
+	unsigned int traceOffset;
+
+	// CTFEventHandle* handles[struct bt_ctf_event_decl*]
+	GHashTable* handles;
+
+	// Event* pendingRecv[traceNum - traceOffset][skb]
+	GHashTable** pendingRecv;
+
+	ProcessingStatsLTTngCTF stats;
+
+	// CTFQueuedEvent queue[], events waiting for the matching thread, NULL
+	// if the events are matched as they are read
+	SPSCQueue* queue;
+	pthread_t thread;
+} CTFReader;
+
+typedef struct
+{
+	unsigned int readerNb;
+	CTFReader* readers;
+	bool parallel;
+
+	// Number of events passed to the matching module
+	uint64_t matchedNb;
+} ProcessingDataLTTngCTF;
+
+void registerProcessingLTTngCTF();
+bool isSyncEventLTTngCTF(const char* const name);
+
+#endif
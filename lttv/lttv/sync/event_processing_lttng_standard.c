@@ -360,16 +360,11 @@ static gboolean processEventLTTVStandard(void* hookData, void* callData)
 			processingData->stats->totOutE++;
 		}
 
-		outE= malloc(sizeof(Event));
+		outE= createTCPEvent();
 		outE->traceNum= traceNum;
 		outE->cpuTime= tsc;
 		outE->wallTime= wTime;
-		outE->type= TCP;
-		outE->copy= &copyTCPEvent;
-		outE->destroy= &destroyTCPEvent;
-		outE->event.tcpEvent= malloc(sizeof(TCPEvent));
 		outE->event.tcpEvent->direction= OUT;
-		outE->event.tcpEvent->segmentKey= malloc(sizeof(SegmentKey));
 		outE->event.tcpEvent->segmentKey->connectionKey.saddr=
 			htonl(ltt_event_get_unsigned(event,
 					lttv_trace_get_hook_field(traceHook, 3)));
@@ -447,7 +442,7 @@ static gboolean processEventLTTVStandard(void* hookData, void* callData)
 	}
 	else if (info->name == LTT_EVENT_TCPV4_RCV_EXTENDED)
 	{
-		Event* inE;
+		Event* inE, * tcpInE;
 		void* skb;
 
 		// Search pendingRecv for an event with the same skb
@@ -471,12 +466,14 @@ static gboolean processEventLTTVStandard(void* hookData, void* callData)
 			// If it's there, remove it and proceed with a receive event
 			g_hash_table_steal(processingData->pendingRecv[traceNum], skb);
 
-			inE->type= TCP;
-			inE->event.tcpEvent= malloc(sizeof(TCPEvent));
-			inE->copy= &copyTCPEvent;
-			inE->destroy= &destroyTCPEvent;
+			tcpInE= createTCPEvent();
+			tcpInE->traceNum= inE->traceNum;
+			tcpInE->cpuTime= inE->cpuTime;
+			tcpInE->wallTime= inE->wallTime;
+			inE->destroy(inE);
+			inE= tcpInE;
+
 			inE->event.tcpEvent->direction= IN;
-			inE->event.tcpEvent->segmentKey= malloc(sizeof(SegmentKey));
 			inE->event.tcpEvent->segmentKey->connectionKey.saddr=
 				htonl(ltt_event_get_unsigned(event,
 						lttv_trace_get_hook_field(traceHook, 1)));
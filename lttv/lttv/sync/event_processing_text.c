@@ -24,11 +24,15 @@
 #endif
 
 #include <errno.h>
+#include <inttypes.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
+#include "message_file.h"
 #include "sync_chain.h"
 
 #include "event_processing_text.h"
@@ -38,6 +42,7 @@
 static void initProcessingText(SyncState* const syncState, ...);
 static void destroyProcessingText(SyncState* const syncState);
 static AllFactors* finalizeProcessingText(SyncState* const syncState);
+static void printProcessingStatsText(SyncState* const syncState);
 static void writeProcessingTraceTimeOptionsText(SyncState* const syncState,
 	const unsigned int i, const unsigned int j);
 static void writeProcessingTraceTraceOptionsText(SyncState* const syncState,
@@ -48,6 +53,15 @@ static void writeProcessingGraphVariablesText(SyncState* const syncState,
 // Functions specific to this module
 static unsigned int readTraceNb(FILE* testCase);
 static void skipCommentLines(FILE* testCase);
+static GMappedFile* openMessageFile(const char* const testCaseName, unsigned
+	int* const traceNb);
+static void readMessageFile(SyncState* const syncState, unsigned int* const
+	seq, const unsigned int addressOffset);
+static void readTextFile(SyncState* const syncState, unsigned int* const seq,
+	const unsigned int addressOffset);
+static void generateMessage(SyncState* const syncState, unsigned int* const
+	seq, const unsigned int addressOffset, const unsigned int sender, const
+	unsigned int receiver, const uint64_t sendTime, const uint64_t recvTime);
 
 
 static ProcessingModule processingModuleText = {
@@ -55,6 +69,7 @@ static ProcessingModule processingModuleText = {
 	.initProcessing= &initProcessingText,
 	.destroyProcessing= &destroyProcessingText,
 	.finalizeProcessing= &finalizeProcessingText,
+	.printProcessingStats= &printProcessingStatsText,
 	.graphFunctions= {
 		.writeVariables= &writeProcessingGraphVariablesText,
 		.writeTraceTraceOptions= &writeProcessingTraceTraceOptionsText,
@@ -74,7 +89,7 @@ void registerProcessingText()
 
 /*
  * Allocate and initialize data structures for synchronizing a traceset.
- * Open test case file.
+ * Open test case file, either text or binary.
  *
  * Args:
  *   syncState:    container for synchronization data.
@@ -92,16 +107,26 @@ static void initProcessingText(SyncState* const syncState, ...)
 	testCaseName= va_arg(ap, const char*);
 	va_end(ap);
 
-	processingData->testCase= fopen(testCaseName, "r");
-	if (processingData->testCase == NULL)
+	processingData->messageFile= openMessageFile(testCaseName,
+		&syncState->traceNb);
+	if (processingData->messageFile != NULL)
 	{
-		g_error("%s", strerror(errno));
+		processingData->testCase= NULL;
+	}
+	else
+	{
+		processingData->testCase= fopen(testCaseName, "r");
+		if (processingData->testCase == NULL)
+		{
+			g_error("%s", strerror(errno));
+		}
+		syncState->traceNb= readTraceNb(processingData->testCase);
 	}
-	syncState->traceNb= readTraceNb(processingData->testCase);
 
 	if (syncState->stats)
 	{
 		processingData->factors= NULL;
+		processingData->stats= calloc(1, sizeof(ProcessingStatsText));
 	}
 }
 
@@ -116,13 +141,25 @@ static void destroyProcessingText(SyncState* const syncState)
 		return;
 	}
 
-	fclose(processingData->testCase);
+	if (processingData->messageFile != NULL)
+	{
+		g_mapped_file_unref(processingData->messageFile);
+	}
+	else
+	{
+		fclose(processingData->testCase);
+	}
 
 	if (syncState->stats && processingData->factors)
 	{
 		freeAllFactors(processingData->factors, syncState->traceNb);
 	}
 
+	if (syncState->stats)
+	{
+		free(processingData->stats);
+	}
+
 	free(syncState->processingData);
 	syncState->processingData= NULL;
 }
@@ -140,17 +177,103 @@ static void destroyProcessingText(SyncState* const syncState)
  */
 static AllFactors* finalizeProcessingText(SyncState* const syncState)
 {
-	int retval;
 	unsigned int* seq;
+	unsigned int addressOffset;
 	AllFactors* factors;
+	struct timeval startTime, endTime;
+	ProcessingDataText* processingData= (ProcessingDataText*)
+		syncState->processingData;
+
+	seq= calloc(syncState->traceNb, sizeof(unsigned int));
+
+	/* addressOffset is added to a traceNum to convert it to an address so
+	 * that the address is not plainly the same as the traceNb. */
+	if (syncState->traceNb > 1)
+	{
+		addressOffset= pow(10, floor(log(syncState->traceNb - 1) / log(10)) +
+			1);
+	}
+	else
+	{
+		addressOffset= 0;
+	}
+
+	gettimeofday(&startTime, NULL);
+	if (processingData->messageFile != NULL)
+	{
+		readMessageFile(syncState, seq, addressOffset);
+	}
+	else
+	{
+		readTextFile(syncState, seq, addressOffset);
+	}
+
+	free(seq);
+
+	factors= syncState->matchingModule->finalizeMatching(syncState);
+	gettimeofday(&endTime, NULL);
+	if (syncState->stats)
+	{
+		factors->refCount++;
+		processingData->factors= factors;
+		processingData->stats->readTime= (endTime.tv_sec -
+			startTime.tv_sec) + (endTime.tv_usec - startTime.tv_usec) / 1e6;
+	}
+
+	return factors;
+}
+
+
+/*
+ * Print statistics related to processing. Must be called after
+ * finalizeProcessing.
+ *
+ * Args:
+ *   syncState     container for synchronization data.
+ */
+static void printProcessingStatsText(SyncState* const syncState)
+{
+	ProcessingDataText* processingData;
+
+	if (!syncState->stats)
+	{
+		return;
+	}
+
+	processingData= (ProcessingDataText*) syncState->processingData;
+
+	printf("Text processing stats:\n");
+	printf("\ttest case format: %s\n", processingData->messageFile ?
+		"binary" : "text");
+	printf("\tmessages read: %" PRIu64 "\n", processingData->stats->messageNb);
+	printf("\tprocessing time: %.6f s", processingData->stats->readTime);
+	if (processingData->stats->readTime > 0.)
+	{
+		printf(", %.0f messages/s", processingData->stats->messageNb /
+			processingData->stats->readTime);
+	}
+	printf("\n");
+}
+
+
+/*
+ * Read the messages of a text test case and make up events
+ *
+ * Args:
+ *   syncState:    container for synchronization data.
+ *   seq:          next sequence number of each trace
+ *   addressOffset: see generateMessage()
+ */
+static void readTextFile(SyncState* const syncState, unsigned int* const seq,
+	const unsigned int addressOffset)
+{
+	int retval;
 	ProcessingDataText* processingData= (ProcessingDataText*)
 		syncState->processingData;
 	FILE* testCase= processingData->testCase;
 	char* line= NULL;
 	size_t bufLen;
 
-	seq= calloc(syncState->traceNb, sizeof(unsigned int));
-
 	skipCommentLines(testCase);
 	retval= getline(&line, &bufLen, testCase);
 	while(!feof(testCase))
@@ -158,7 +281,6 @@ static AllFactors* finalizeProcessingText(SyncState* const syncState)
 		unsigned int sender, receiver;
 		double sendTime, recvTime;
 		char tmp;
-		unsigned int i;
 
 		if (retval == -1 && !feof(testCase))
 		{
@@ -201,85 +323,181 @@ static AllFactors* finalizeProcessingText(SyncState* const syncState)
 			g_error("Error parsing test file, receive time is negative, line was '%s'", line);
 		}
 
-		// Generate ouput and input events
+		generateMessage(syncState, seq, addressOffset, sender, receiver,
+			round(sendTime * CPU_FREQ), round(recvTime * CPU_FREQ));
+		if (syncState->stats)
 		{
-			unsigned int addressOffset;
-			struct {
-				unsigned int traceNum;
-				double time;
-				enum Direction direction;
-			} loopValues[]= {
-				{sender, sendTime, OUT},
-				{receiver, recvTime, IN},
-			};
-
-			/* addressOffset is added to a traceNum to convert it to an address so
-			 * that the address is not plainly the same as the traceNb. */
-			if (syncState->traceNb > 1)
-			{
-				addressOffset= pow(10, floor(log(syncState->traceNb - 1) /
-						log(10)) + 1);
-			}
-			else
-			{
-				addressOffset= 0;
-			}
-
-			for (i= 0; i < sizeof(loopValues) / sizeof(*loopValues); i++)
-			{
-				Event* event;
-
-				event= malloc(sizeof(Event));
-				event->traceNum= loopValues[i].traceNum;
-				event->wallTime.seconds= floor(loopValues[i].time);
-				event->wallTime.nanosec= floor((loopValues[i].time -
-						floor(loopValues[i].time)) * NANOSECONDS_PER_SECOND);
-				event->cpuTime= round(loopValues[i].time * CPU_FREQ);
-				event->type= TCP;
-				event->destroy= &destroyTCPEvent;
-				event->event.tcpEvent= malloc(sizeof(TCPEvent));
-				event->event.tcpEvent->direction= loopValues[i].direction;
-				event->event.tcpEvent->segmentKey= malloc(sizeof(SegmentKey));
-				event->event.tcpEvent->segmentKey->ihl= 5;
-				event->event.tcpEvent->segmentKey->tot_len= 40;
-				event->event.tcpEvent->segmentKey->connectionKey.saddr= sender +
-					addressOffset;
-				event->event.tcpEvent->segmentKey->connectionKey.daddr= receiver +
-					addressOffset;
-				event->event.tcpEvent->segmentKey->connectionKey.source= 57645;
-				event->event.tcpEvent->segmentKey->connectionKey.dest= 80;
-				event->event.tcpEvent->segmentKey->seq= seq[sender];
-				event->event.tcpEvent->segmentKey->ack_seq= 0;
-				event->event.tcpEvent->segmentKey->doff= 5;
-				event->event.tcpEvent->segmentKey->ack= 0;
-				event->event.tcpEvent->segmentKey->rst= 0;
-				event->event.tcpEvent->segmentKey->syn= 1;
-				event->event.tcpEvent->segmentKey->fin= 0;
-
-				syncState->matchingModule->matchEvent(syncState, event);
-			}
+			processingData->stats->messageNb++;
 		}
 
-		seq[sender]++;
-
 		skipCommentLines(testCase);
 		retval= getline(&line, &bufLen, testCase);
 	}
 
-	free(seq);
-
 	if (line)
 	{
 		free(line);
 	}
+}
+
+
+/*
+ * Read the messages of a binary test case and make up events
+ *
+ * Args:
+ *   syncState:    container for synchronization data.
+ *   seq:          next sequence number of each trace
+ *   addressOffset: see generateMessage()
+ */
+static void readMessageFile(SyncState* const syncState, unsigned int* const
+	seq, const unsigned int addressOffset)
+{
+	GMappedFile* messageFile= ((ProcessingDataText*)
+		syncState->processingData)->messageFile;
+	const MessageFileHeader* header;
+	const MessageRecord* records;
+	uint64_t i;
+
+	header= (const MessageFileHeader*) g_mapped_file_get_contents(messageFile);
+	records= (const MessageRecord*) (header + 1);
+
+	for (i= 0; i < header->messageNb; i++)
+	{
+		const MessageRecord* const record= &records[i];
+
+		if (record->sender >= syncState->traceNb || record->receiver >=
+			syncState->traceNb)
+		{
+			g_error("Error reading test file, trace out of range in message "
+				"%" PRIu64, i);
+		}
+
+		generateMessage(syncState, seq, addressOffset, record->sender,
+			record->receiver, record->sendTime, record->recvTime);
+	}
 
-	factors= syncState->matchingModule->finalizeMatching(syncState);
 	if (syncState->stats)
 	{
-		processingData->factors= factors;
+		((ProcessingDataText*) syncState->processingData)->stats->messageNb=
+			header->messageNb;
 	}
+}
 
-	return factors;
+
+/*
+ * Make up the output and input events of a message and dispatch them to the
+ * matching module
+ *
+ * Args:
+ *   syncState:    container for synchronization data.
+ *   seq:          next sequence number of each trace, the one of sender is
+ *                 incremented
+ *   addressOffset: added to a traceNum to convert it to an address
+ *   sender, receiver: trace numbers
+ *   sendTime, recvTime: times of the events, in ns
+ */
+static void generateMessage(SyncState* const syncState, unsigned int* const
+	seq, const unsigned int addressOffset, const unsigned int sender, const
+	unsigned int receiver, const uint64_t sendTime, const uint64_t recvTime)
+{
+	unsigned int i;
+	struct {
+		unsigned int traceNum;
+		uint64_t time;
+		enum Direction direction;
+	} loopValues[]= {
+		{sender, sendTime, OUT},
+		{receiver, recvTime, IN},
+	};
+
+	for (i= 0; i < sizeof(loopValues) / sizeof(*loopValues); i++)
+	{
+		Event* event;
+
+		event= createTCPEvent();
+		event->traceNum= loopValues[i].traceNum;
+		event->wallTime.seconds= loopValues[i].time / NANOSECONDS_PER_SECOND;
+		event->wallTime.nanosec= loopValues[i].time % NANOSECONDS_PER_SECOND;
+		event->cpuTime= loopValues[i].time;
+		event->event.tcpEvent->direction= loopValues[i].direction;
+		event->event.tcpEvent->segmentKey->ihl= 5;
+		event->event.tcpEvent->segmentKey->tot_len= 40;
+		event->event.tcpEvent->segmentKey->connectionKey.saddr= sender +
+			addressOffset;
+		event->event.tcpEvent->segmentKey->connectionKey.daddr= receiver +
+			addressOffset;
+		event->event.tcpEvent->segmentKey->connectionKey.source= 57645;
+		event->event.tcpEvent->segmentKey->connectionKey.dest= 80;
+		event->event.tcpEvent->segmentKey->seq= seq[sender];
+		event->event.tcpEvent->segmentKey->ack_seq= 0;
+		event->event.tcpEvent->segmentKey->doff= 5;
+		event->event.tcpEvent->segmentKey->ack= 0;
+		event->event.tcpEvent->segmentKey->rst= 0;
+		event->event.tcpEvent->segmentKey->syn= 1;
+		event->event.tcpEvent->segmentKey->fin= 0;
+
+		syncState->matchingModule->matchEvent(syncState, event);
+	}
+
+	seq[sender]++;
+}
+
+
+/*
+ * Map a binary test case
+ *
+ * Args:
+ *   testCaseName: test case file name
+ *   traceNb:      the number of traces is stored there
+ *
+ * Returns:
+ *   The mapped file, or NULL if the file is not a binary test case
+ */
+static GMappedFile* openMessageFile(const char* const testCaseName, unsigned
+	int* const traceNb)
+{
+	GMappedFile* messageFile;
+	GError* error= NULL;
+	const MessageFileHeader* header;
+	gsize length;
+
+	messageFile= g_mapped_file_new(testCaseName, FALSE, &error);
+	if (messageFile == NULL)
+	{
+		g_error("%s", error->message);
+	}
+
+	header= (const MessageFileHeader*) g_mapped_file_get_contents(messageFile);
+	length= g_mapped_file_get_length(messageFile);
+	if (length < sizeof(MessageFileHeader) || header->magic !=
+		MESSAGE_FILE_MAGIC)
+	{
+		if (length >= sizeof(MessageFileHeader) && header->magic ==
+			GUINT64_SWAP_LE_BE(MESSAGE_FILE_MAGIC))
+		{
+			g_error("Test file %s was written with another byte order",
+				testCaseName);
+		}
+
+		g_mapped_file_unref(messageFile);
+		return NULL;
+	}
+
+	if (header->version != MESSAGE_FILE_VERSION)
+	{
+		g_error("Test file %s has unsupported version %u", testCaseName,
+			header->version);
+	}
+
+	if ((length - sizeof(MessageFileHeader)) / sizeof(MessageRecord) <
+		header->messageNb)
+	{
+		g_error("Test file %s is truncated", testCaseName);
+	}
+
+	*traceNb= header->traceNb;
+
+	return messageFile;
 }
 
 
@@ -18,14 +18,26 @@
 #ifndef EVENT_PROCESSING_TEXT_H
 #define EVENT_PROCESSING_TEXT_H
 
+#include <stdint.h>
+
 #include "event_processing.h"
 
+typedef struct
+{
+	uint64_t messageNb;
+	// Time to read the messages and run the rest of the chain on them, in s
+	double readTime;
+} ProcessingStatsText;
+
 typedef struct
 {
 	// Only used for stats
 	AllFactors* factors;
+	ProcessingStatsText* stats;
 
 	FILE* testCase;
+	// Binary test case, see message_file.h, NULL for a text test case
+	GMappedFile* messageFile;
 } ProcessingDataText;
 
 void registerProcessingText();
@@ -41,7 +41,8 @@ typedef struct
 
 	/*
 	 * Convert trace pair synchronization factors to a resulting offset and
-	 * drift for each trace.
+	 * drift for each trace. With piecewise synchronization, this is called
+	 * once for each time window and then once for the whole traces.
 	 */
 	GArray* (*finalizeReduction)(struct _SyncState* const syncState,
 		AllFactors* allFactors);
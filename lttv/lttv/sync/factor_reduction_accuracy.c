@@ -252,6 +252,17 @@ static GArray* finalizeReductionAccuracy(SyncState* const syncState,
 	{
 		ReductionStatsAccuracy* stats= syncState->reductionData;
 
+		// Only the last reduction is kept, the one for the whole traces
+		if (stats->predecessors)
+		{
+			for (i= 0; i < syncState->traceNb; i++)
+			{
+				free(stats->predecessors[i]);
+			}
+			free(stats->predecessors);
+			free(stats->references);
+		}
+
 		stats->predecessors= predecessors;
 		stats->references= references;
 	}
@@ -0,0 +1,48 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGE_FILE_H
+#define MESSAGE_FILE_H
+
+#include <stdint.h>
+
+/* Binary message files hold the same information as the text test cases: a
+ * number of traces followed by messages. They are written by the TCP
+ * matching module with --sync-dump-messages and read by the text processing
+ * module, which maps them instead of parsing them.
+ *
+ * The file is a MessageFileHeader followed by messageNb MessageRecords, in
+ * the byte order of the host that wrote it. Times are in ns.
+ */
+
+#define MESSAGE_FILE_MAGIC 0x4c5454564d534731ULL
+#define MESSAGE_FILE_VERSION 1
+
+typedef struct
+{
+	uint64_t magic;
+	uint32_t version;
+	uint32_t traceNb;
+	uint64_t messageNb;
+} MessageFileHeader;
+
+typedef struct
+{
+	uint32_t sender, receiver;
+	uint64_t sendTime, recvTime;
+} MessageRecord;
+
+#endif
@@ -0,0 +1,201 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Lock-free ring buffer for one producer thread and one consumer thread
+ *
+ * The producer only writes tail and the consumer only writes head. Each one
+ * publishes its index with a release store after touching the slots and
+ * reads the other's index with an acquire load, so no lock is needed while
+ * the queue is neither empty nor full. The indexes are kept on separate
+ * cache lines to avoid false sharing.
+ *
+ * A thread that finds the queue full (producer) or empty (consumer) sleeps
+ * on a condition variable. It raises its waiting flag before checking the
+ * queue again and the other thread checks the flag after moving its index,
+ * both behind a full barrier, so one of them always sees the other and no
+ * wakeup is lost.
+ */
+
+#define SPSC_CACHE_LINE 64
+
+typedef struct
+{
+	unsigned int size; // must be a power of 2
+	size_t itemSize;
+	char* slots;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t notFull;
+	pthread_cond_t notEmpty;
+	bool producerWaiting;
+	bool consumerWaiting;
+
+	unsigned int head __attribute__((aligned(SPSC_CACHE_LINE)));
+	unsigned int tail __attribute__((aligned(SPSC_CACHE_LINE)));
+} SPSCQueue;
+
+
+/*
+ * Args:
+ *   size:         number of items, must be a power of 2
+ *   itemSize:     size of an item, items are copied in the queue
+ */
+static inline SPSCQueue* spscQueueNew(const unsigned int size, const size_t
+	itemSize)
+{
+	SPSCQueue* queue;
+
+	if (posix_memalign((void**) &queue, SPSC_CACHE_LINE, sizeof(SPSCQueue))
+		!= 0)
+	{
+		return NULL;
+	}
+	queue->size= size;
+	queue->itemSize= itemSize;
+	queue->slots= malloc(size * itemSize);
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->notFull, NULL);
+	pthread_cond_init(&queue->notEmpty, NULL);
+	queue->producerWaiting= false;
+	queue->consumerWaiting= false;
+	queue->head= 0;
+	queue->tail= 0;
+
+	return queue;
+}
+
+
+static inline void spscQueueDestroy(SPSCQueue* const queue)
+{
+	pthread_cond_destroy(&queue->notEmpty);
+	pthread_cond_destroy(&queue->notFull);
+	pthread_mutex_destroy(&queue->mutex);
+	free(queue->slots);
+	free(queue);
+}
+
+
+/*
+ * Returns:
+ *   false if the queue is full
+ */
+static inline bool spscQueueTryPush(SPSCQueue* const queue, const void* const
+	item)
+{
+	unsigned int tail= queue->tail;
+
+	if (tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == queue->size)
+	{
+		return false;
+	}
+
+	memcpy(&queue->slots[(tail & (queue->size - 1)) * queue->itemSize], item,
+		queue->itemSize);
+	__atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+
+/*
+ * Returns:
+ *   false if the queue is empty
+ */
+static inline bool spscQueueTryPop(SPSCQueue* const queue, void* const item)
+{
+	unsigned int head= queue->head;
+
+	if (__atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) == head)
+	{
+		return false;
+	}
+
+	memcpy(item, &queue->slots[(head & (queue->size - 1)) * queue->itemSize],
+		queue->itemSize);
+	__atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+
+/*
+ * Wake up the other thread if it sleeps, after the index was moved
+ *
+ * Args:
+ *   queue:        queue
+ *   waiting:      waiting flag of the other thread
+ *   cond:         condition the other thread waits on
+ */
+static inline void spscQueueWake(SPSCQueue* const queue, bool* const waiting,
+	pthread_cond_t* const cond)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(waiting, __ATOMIC_RELAXED))
+	{
+		pthread_mutex_lock(&queue->mutex);
+		pthread_cond_signal(cond);
+		pthread_mutex_unlock(&queue->mutex);
+	}
+}
+
+
+static inline void spscQueuePush(SPSCQueue* const queue, const void* const
+	item)
+{
+	if (!spscQueueTryPush(queue, item))
+	{
+		pthread_mutex_lock(&queue->mutex);
+		__atomic_store_n(&queue->producerWaiting, true, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		while (!spscQueueTryPush(queue, item))
+		{
+			pthread_cond_wait(&queue->notFull, &queue->mutex);
+		}
+		__atomic_store_n(&queue->producerWaiting, false, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&queue->mutex);
+	}
+
+	spscQueueWake(queue, &queue->consumerWaiting, &queue->notEmpty);
+}
+
+
+static inline void spscQueuePop(SPSCQueue* const queue, void* const item)
+{
+	if (!spscQueueTryPop(queue, item))
+	{
+		pthread_mutex_lock(&queue->mutex);
+		__atomic_store_n(&queue->consumerWaiting, true, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		while (!spscQueueTryPop(queue, item))
+		{
+			pthread_cond_wait(&queue->notEmpty, &queue->mutex);
+		}
+		__atomic_store_n(&queue->consumerWaiting, false, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&queue->mutex);
+	}
+
+	spscQueueWake(queue, &queue->producerWaiting, &queue->notFull);
+}
+
+#endif
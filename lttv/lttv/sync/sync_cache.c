@@ -0,0 +1,421 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "sync_streams.h"
+
+#include "sync_cache.h"
+
+
+static char* getGroupName(const SyncCache* const cache, const unsigned int i,
+	const unsigned int j, unsigned int* const low, unsigned int* const high);
+static bool readPairFactors(GKeyFile* const keyFile, const char* const group,
+	const char* const direction, PairFactors* const pairFactors);
+static void writePairFactors(GKeyFile* const keyFile, const char* const
+	group, const char* const direction, const PairFactors* const pairFactors);
+
+
+/*
+ * Identify the traces of a traceset and load the cache file
+ *
+ * Args:
+ *   traceset:     traceset to synchronize
+ *   options:      description of the options that change the factors
+ *
+ * Returns:
+ *   A new cache, to close with closeSyncCache()
+ */
+SyncCache* openSyncCache(LttvTraceset* const traceset, const char* const
+	options)
+{
+	SyncCache* cache;
+	unsigned int i;
+	GError* error= NULL;
+
+	cache= malloc(sizeof(SyncCache));
+	cache->traceNb= lttv_traceset_number(traceset);
+	cache->traceIds= malloc(cache->traceNb * sizeof(char*));
+	for (i= 0; i < cache->traceNb; i++)
+	{
+		cache->traceIds[i]=
+			getTraceIdentity(lttv_traceset_get(traceset, i)->full_path);
+	}
+	cache->options= g_strdup(options);
+
+	cache->path= g_build_filename(g_get_user_cache_dir(), "lttv",
+		"sync-cache", NULL);
+	cache->keyFile= g_key_file_new();
+	if (!g_key_file_load_from_file(cache->keyFile, cache->path,
+			G_KEY_FILE_NONE, &error))
+	{
+		if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+		{
+			g_warning("Cannot read the synchronization cache %s: %s",
+				cache->path, error->message);
+		}
+		g_error_free(error);
+	}
+	cache->modified= false;
+
+	return cache;
+}
+
+
+/*
+ * Fill the factors of the trace pairs found in the cache
+ *
+ * Args:
+ *   cache:        cache opened for the traceset
+ *   allFactors:   the factors of the pairs found are replaced
+ *   knownPairs:   knownPairs[i][j] and knownPairs[j][i] are set to true if
+ *                 the pair (i, j) is found, they must be initialized to
+ *                 false
+ *
+ * Returns:
+ *   The number of trace pairs that are not in the cache
+ */
+unsigned int getCachedFactors(SyncCache* const cache, AllFactors* const
+	allFactors, bool** const knownPairs)
+{
+	unsigned int i, j, missing= 0;
+
+	for (i= 0; i < cache->traceNb; i++)
+	{
+		for (j= i + 1; j < cache->traceNb; j++)
+		{
+			char* group;
+			unsigned int low, high;
+			PairFactors forward= {NULL}, backward= {NULL};
+
+			group= getGroupName(cache, i, j, &low, &high);
+			if (group != NULL && g_key_file_has_group(cache->keyFile, group) &&
+				readPairFactors(cache->keyFile, group, "forward", &forward) &&
+				readPairFactors(cache->keyFile, group, "backward", &backward))
+			{
+				destroyPairFactors(&allFactors->pairFactors[low][high]);
+				allFactors->pairFactors[low][high]= forward;
+				destroyPairFactors(&allFactors->pairFactors[high][low]);
+				allFactors->pairFactors[high][low]= backward;
+
+				knownPairs[i][j]= true;
+				knownPairs[j][i]= true;
+			}
+			else
+			{
+				destroyPairFactors(&forward);
+				destroyPairFactors(&backward);
+				missing++;
+			}
+			g_free(group);
+		}
+	}
+
+	g_debug("%u trace pairs missing from the synchronization cache",
+		missing);
+
+	return missing;
+}
+
+
+/*
+ * Add the factors of the trace pairs that were computed to the cache
+ *
+ * Args:
+ *   cache:        cache opened for the traceset
+ *   allFactors:   factors of all the trace pairs
+ *   knownPairs:   pairs that came from the cache and are not stored again,
+ *                 NULL to store all the pairs
+ */
+void storeFactors(SyncCache* const cache, const AllFactors* const
+	allFactors, bool** const knownPairs)
+{
+	unsigned int i, j;
+
+	for (i= 0; i < cache->traceNb; i++)
+	{
+		for (j= i + 1; j < cache->traceNb; j++)
+		{
+			char* group;
+			unsigned int low, high;
+
+			if (knownPairs != NULL && knownPairs[i][j])
+			{
+				continue;
+			}
+
+			// Failures are not kept, the next run tries again
+			if (allFactors->pairFactors[i][j].type == FAIL ||
+				allFactors->pairFactors[j][i].type == FAIL)
+			{
+				continue;
+			}
+
+			group= getGroupName(cache, i, j, &low, &high);
+			if (group == NULL)
+			{
+				continue;
+			}
+
+			g_key_file_remove_group(cache->keyFile, group, NULL);
+			writePairFactors(cache->keyFile, group, "forward",
+				&allFactors->pairFactors[low][high]);
+			writePairFactors(cache->keyFile, group, "backward",
+				&allFactors->pairFactors[high][low]);
+			cache->modified= true;
+
+			g_free(group);
+		}
+	}
+}
+
+
+/*
+ * Write the cache file if it was modified and free the cache
+ *
+ * Args:
+ *   cache:        cache to close
+ */
+void closeSyncCache(SyncCache* const cache)
+{
+	unsigned int i;
+
+	if (cache->modified)
+	{
+		char* dir;
+		char* data;
+		gsize length;
+		GError* error= NULL;
+
+		dir= g_path_get_dirname(cache->path);
+		g_mkdir_with_parents(dir, 0700);
+		g_free(dir);
+
+		data= g_key_file_to_data(cache->keyFile, &length, NULL);
+		if (!g_file_set_contents(cache->path, data, length, &error))
+		{
+			g_warning("Cannot write the synchronization cache %s: %s",
+				cache->path, error->message);
+			g_error_free(error);
+		}
+		g_free(data);
+	}
+
+	for (i= 0; i < cache->traceNb; i++)
+	{
+		g_free(cache->traceIds[i]);
+	}
+	free(cache->traceIds);
+	g_free(cache->options);
+	g_free(cache->path);
+	g_key_file_free(cache->keyFile);
+	free(cache);
+}
+
+
+/*
+ * Name the cache entry of a trace pair
+ *
+ * The traces of a pair are ordered by identity, so that the entry does not
+ * depend on the order of the traces in the traceset. "forward" factors
+ * convert the times of the high trace to the low trace, "backward" factors
+ * do the opposite.
+ *
+ * Args:
+ *   cache:        cache opened for the traceset
+ *   i, j:         trace numbers
+ *   low, high:    the trace numbers of the pair in identity order are
+ *                 stored there
+ *
+ * Returns:
+ *   The group name, to free with g_free(), or NULL if the pair cannot be
+ *   cached
+ */
+static char* getGroupName(const SyncCache* const cache, const unsigned int i,
+	const unsigned int j, unsigned int* const low, unsigned int* const high)
+{
+	int order;
+	char* key;
+	char* group;
+
+	if (cache->traceIds[i] == NULL || cache->traceIds[j] == NULL)
+	{
+		return NULL;
+	}
+
+	order= strcmp(cache->traceIds[i], cache->traceIds[j]);
+	if (order == 0)
+	{
+		// The same trace is opened twice
+		return NULL;
+	}
+	else if (order < 0)
+	{
+		*low= i;
+		*high= j;
+	}
+	else
+	{
+		*low= j;
+		*high= i;
+	}
+
+	key= g_strdup_printf("%s %s %s", cache->traceIds[*low],
+		cache->traceIds[*high], cache->options);
+	group= g_compute_checksum_for_string(G_CHECKSUM_MD5, key, -1);
+	g_free(key);
+
+	return group;
+}
+
+
+/*
+ * Read the factors of one direction of a trace pair
+ *
+ * Args:
+ *   keyFile:      cache contents
+ *   group:        entry of the pair
+ *   direction:    "forward" or "backward"
+ *   pairFactors:  the factors are stored there, its members must be NULL.
+ *                 They may be allocated even if the entry is incomplete.
+ *
+ * Returns:
+ *   false if the entry is incomplete
+ */
+static bool readPairFactors(GKeyFile* const keyFile, const char* const group,
+	const char* const direction, PairFactors* const pairFactors)
+{
+	const struct
+	{
+		const char* name;
+		Factors** factors;
+	} loopValues[]= {
+		{"min", &pairFactors->min},
+		{"max", &pairFactors->max},
+		{"approx", &pairFactors->approx},
+	};
+	char* key;
+	char* type;
+	unsigned int i;
+	bool found= false;
+
+	key= g_strdup_printf("%s-type", direction);
+	type= g_key_file_get_string(keyFile, group, key, NULL);
+	g_free(key);
+	if (type == NULL)
+	{
+		return false;
+	}
+	for (i= 0; i < APPROX_NB; i++)
+	{
+		if (strcmp(type, approxNames[i]) == 0)
+		{
+			pairFactors->type= i;
+			found= true;
+			break;
+		}
+	}
+	g_free(type);
+	if (!found)
+	{
+		return false;
+	}
+
+	for (i= 0; i < ARRAY_SIZE(loopValues); i++)
+	{
+		double* values;
+		gsize length;
+
+		key= g_strdup_printf("%s-%s", direction, loopValues[i].name);
+		values= g_key_file_get_double_list(keyFile, group, key, &length,
+			NULL);
+		g_free(key);
+		if (values == NULL)
+		{
+			continue;
+		}
+		if (length != 2)
+		{
+			g_free(values);
+			return false;
+		}
+
+		*loopValues[i].factors= malloc(sizeof(Factors));
+		(*loopValues[i].factors)->drift= values[0];
+		(*loopValues[i].factors)->offset= values[1];
+		g_free(values);
+	}
+
+	key= g_strdup_printf("%s-accuracy", direction);
+	pairFactors->accuracy= g_key_file_get_double(keyFile, group, key, NULL);
+	g_free(key);
+
+	return true;
+}
+
+
+/*
+ * Write the factors of one direction of a trace pair
+ *
+ * Args:
+ *   keyFile:      cache contents
+ *   group:        entry of the pair
+ *   direction:    "forward" or "backward"
+ *   pairFactors:  factors to write
+ */
+static void writePairFactors(GKeyFile* const keyFile, const char* const
+	group, const char* const direction, const PairFactors* const pairFactors)
+{
+	const struct
+	{
+		const char* name;
+		const Factors* factors;
+	} loopValues[]= {
+		{"min", pairFactors->min},
+		{"max", pairFactors->max},
+		{"approx", pairFactors->approx},
+	};
+	char* key;
+	unsigned int i;
+
+	key= g_strdup_printf("%s-type", direction);
+	g_key_file_set_string(keyFile, group, key, approxNames[pairFactors->type]);
+	g_free(key);
+
+	for (i= 0; i < ARRAY_SIZE(loopValues); i++)
+	{
+		if (loopValues[i].factors != NULL)
+		{
+			double values[2]= {loopValues[i].factors->drift,
+				loopValues[i].factors->offset};
+
+			key= g_strdup_printf("%s-%s", direction, loopValues[i].name);
+			g_key_file_set_double_list(keyFile, group, key, values, 2);
+			g_free(key);
+		}
+	}
+
+	key= g_strdup_printf("%s-accuracy", direction);
+	g_key_file_set_double(keyFile, group, key, pairFactors->accuracy);
+	g_free(key);
+}
@@ -0,0 +1,54 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNC_CACHE_H
+#define SYNC_CACHE_H
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include <lttv/traceset.h>
+
+#include "data_structures.h"
+
+/* The factors between trace pairs are kept in a key file in the user cache
+ * directory. An entry is keyed by the identities of both traces, see
+ * getTraceIdentity(), and by the options that change the analysis. When a
+ * trace is added to a traceset, only the pairs that include it are missing
+ * from the cache.
+ */
+
+typedef struct
+{
+	unsigned int traceNb;
+	// char* traceIds[traceNb], NULL if the trace could not be identified
+	char** traceIds;
+	char* options;
+
+	char* path;
+	GKeyFile* keyFile;
+	bool modified;
+} SyncCache;
+
+SyncCache* openSyncCache(LttvTraceset* const traceset, const char* const
+	options);
+unsigned int getCachedFactors(SyncCache* const cache, AllFactors* const
+	allFactors, bool** const knownPairs);
+void storeFactors(SyncCache* const cache, const AllFactors* const
+	allFactors, bool** const knownPairs);
+void closeSyncCache(SyncCache* const cache);
+
+#endif
@@ -20,6 +20,7 @@
 #endif
 
 #include <errno.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -64,6 +65,30 @@ void printStats(SyncState* const syncState)
 }
 
 
+/*
+ * Get the factors between trace pairs from the messages analyzed so far,
+ * while the traceset is still being processed
+ *
+ * Args:
+ *   syncState:    Container for synchronization data
+ *
+ * Returns:
+ *   AllFactors*, the caller is responsible for freeing it with
+ *   freeAllFactors(), NULL if the analysis module cannot estimate the
+ *   factors before it is finalized
+ */
+AllFactors* estimateFactors(SyncState* const syncState)
+{
+	if (syncState->analysisModule == NULL ||
+		syncState->analysisModule->estimateAnalysis == NULL)
+	{
+		return NULL;
+	}
+
+	return syncState->analysisModule->estimateAnalysis(syncState);
+}
+
+
 /*
  * Calculate the elapsed time between two timeval values
  *
@@ -208,3 +233,232 @@ void gfAppendReductionName(gpointer data, gpointer user_data)
 	g_string_append((GString*) user_data, ((ReductionModule*) data)->name);
 	g_string_append((GString*) user_data, ", ");
 }
+
+
+/*
+ * Reduce the factors of each time window of a piecewise synchronization
+ *
+ * A window is only used when it relates all the trace pairs that the whole
+ * traces relate. Otherwise, the corrections for the whole traces apply to
+ * it.
+ *
+ * Args:
+ *   syncState:    container for synchronization data
+ *   allFactors:   factors between trace pairs for the whole traces
+ *
+ * Returns:
+ *   GArray* of WindowFactors sorted by start, NULL if the analysis module
+ *   does not support piecewise synchronization
+ */
+GArray* reduceWindows(SyncState* const syncState, AllFactors* const
+	allFactors)
+{
+	GArray* segments, * windows;
+	unsigned int i, j, k;
+
+	if (syncState->analysisModule->finalizeSegments == NULL)
+	{
+		g_warning("Analysis module '%s' does not support piecewise "
+			"synchronization", syncState->analysisModule->name);
+		return NULL;
+	}
+
+	segments= syncState->analysisModule->finalizeSegments(syncState);
+	windows= g_array_sized_new(FALSE, FALSE, sizeof(WindowFactors),
+		segments->len);
+	for (i= 0; i < segments->len; i++)
+	{
+		SegmentFactors* segment= &g_array_index(segments, SegmentFactors, i);
+		WindowFactors window;
+		bool complete= true;
+
+		for (j= 0; j < syncState->traceNb; j++)
+		{
+			for (k= 0; k < j; k++)
+			{
+				ApproxType whole= allFactors->pairFactors[j][k].type;
+				ApproxType part= segment->allFactors->pairFactors[j][k].type;
+
+				if ((whole == ACCURATE || whole == APPROXIMATE) && part !=
+					ACCURATE && part != APPROXIMATE)
+				{
+					complete= false;
+				}
+			}
+		}
+
+		window.start= segment->start;
+		if (complete)
+		{
+			window.factors=
+				syncState->reductionModule->finalizeReduction(syncState,
+					segment->allFactors);
+		}
+		else
+		{
+			g_debug("Synchronization window %u lacks messages, using the "
+				"factors of the whole traces", i);
+			window.factors= NULL;
+		}
+		g_array_append_val(windows, window);
+
+		freeAllFactors(segment->allFactors, syncState->traceNb);
+	}
+	g_array_free(segments, TRUE);
+
+	return windows;
+}
+
+
+/*
+ * Convert a time of the clock of trace 0 to the clock of another trace
+ *
+ * Args:
+ *   factors:      correction of each trace for the whole traces, as set in
+ *                 the traces
+ *   traceNum:     trace number
+ *   time:         time in the clock of trace 0, in ns
+ *
+ * Returns:
+ *   The uncorrected time of trace traceNum that is corrected to the same
+ *   time as the time of trace 0
+ */
+static double convertWindowTime(GArray* const factors, const unsigned int
+	traceNum, const double time)
+{
+	const Factors* reference= &g_array_index(factors, Factors, 0);
+	const Factors* target= &g_array_index(factors, Factors, traceNum);
+
+	return (reference->drift * time + reference->offset - target->offset) /
+		target->drift;
+}
+
+
+/*
+ * Join the corrections of the time windows of a trace into a continuous
+ * piecewise-linear correction
+ *
+ * Each window gives a line. The pieces join at the window boundaries, where
+ * the correction is the mean of the lines of the two adjacent windows, so
+ * corrected times never jump backwards or forwards. The pieces are stored
+ * relative to their start to keep the precision of the nanosecond
+ * timestamps.
+ *
+ * The window boundaries are times of trace 0, see finalizeSegments. They
+ * are converted to the clock of the trace with the corrections for the
+ * whole traces, so that the boundaries of all the traces are at the same
+ * corrected times.
+ *
+ * Args:
+ *   windows:      GArray* of WindowFactors
+ *   traceNum:     trace number
+ *   factors:      correction of each trace for the whole traces, minOffset
+ *                 already subtracted, used to convert the boundaries and
+ *                 for the windows that lack messages
+ *   segmentLength: length of the windows, in ns
+ *   minOffset:    offset subtracted from all the corrections
+ *
+ * Returns:
+ *   GArray* of LttvTraceSyncSegment, NULL if there are no windows
+ */
+GArray* joinWindows(GArray* const windows, const unsigned int traceNum,
+	GArray* const factors, const uint64_t segmentLength, const double
+	minOffset)
+{
+	GArray* segments;
+	double* knots, * bounds;
+	unsigned int k;
+
+	if (windows->len == 0)
+	{
+		return NULL;
+	}
+
+	/* bounds[k] is the start of window k in the clock of the trace.
+	 * bounds[windows->len] is the end of the last window.
+	 */
+	bounds= malloc((windows->len + 1) * sizeof(double));
+	for (k= 0; k < windows->len; k++)
+	{
+		bounds[k]= convertWindowTime(factors, traceNum,
+			g_array_index(windows, WindowFactors, k).start);
+	}
+	bounds[windows->len]= convertWindowTime(factors, traceNum,
+		g_array_index(windows, WindowFactors, windows->len - 1).start +
+		segmentLength);
+
+	/* knots[k] is the correction, minus the uncorrected time, at the start
+	 * of window k. knots[windows->len] is at the end of the last window.
+	 */
+	knots= malloc((windows->len + 1) * sizeof(double));
+	for (k= 0; k < windows->len; k++)
+	{
+		WindowFactors* window= &g_array_index(windows, WindowFactors, k);
+		const Factors* f;
+		double offset, atStart, atEnd;
+
+		if (window->factors != NULL)
+		{
+			f= &g_array_index(window->factors, Factors, traceNum);
+			offset= f->offset - minOffset;
+		}
+		else
+		{
+			f= &g_array_index(factors, Factors, traceNum);
+			offset= f->offset;
+		}
+		atStart= (f->drift - 1.) * bounds[k] + offset;
+		atEnd= (f->drift - 1.) * bounds[k + 1] + offset;
+
+		if (k == 0)
+		{
+			knots[k]= atStart;
+		}
+		else
+		{
+			knots[k]= (knots[k] + atStart) / 2.;
+		}
+		knots[k + 1]= atEnd;
+	}
+
+	segments= g_array_sized_new(FALSE, FALSE, sizeof(LttvTraceSyncSegment),
+		windows->len);
+	for (k= 0; k < windows->len; k++)
+	{
+		LttvTraceSyncSegment segment;
+
+		// Events cannot have negative times, see syncTraceset()
+		segment.start= bounds[k] < 0. ? 0 : round(bounds[k]);
+		segment.offset= knots[k];
+		segment.drift= 1. + (knots[k + 1] - knots[k]) / (bounds[k + 1] -
+			bounds[k]);
+		g_array_append_val(segments, segment);
+	}
+	free(knots);
+	free(bounds);
+
+	return segments;
+}
+
+
+/*
+ * Free the windows of a piecewise synchronization
+ *
+ * Args:
+ *   windows:      GArray* of WindowFactors
+ */
+void destroyWindows(GArray* const windows)
+{
+	unsigned int i;
+
+	for (i= 0; i < windows->len; i++)
+	{
+		WindowFactors* window= &g_array_index(windows, WindowFactors, i);
+
+		if (window->factors != NULL)
+		{
+			g_array_free(window->factors, TRUE);
+		}
+	}
+	g_array_free(windows, TRUE);
+}
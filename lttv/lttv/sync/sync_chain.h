@@ -21,6 +21,8 @@
 #include <glib.h>
 #include <sys/time.h>
 
+#include <lttv/sync-correction.h>
+
 #include "event_processing.h"
 #include "event_matching.h"
 #include "event_analysis.h"
@@ -32,6 +34,13 @@ typedef struct _SyncState
 	bool stats;
 	FILE* graphsStream;
 	const char* graphsDir;
+	// Length of the windows of piecewise synchronization in ns, 0 to compute
+	// a single correction per trace
+	uint64_t segmentLength;
+	/* knownPairs[i][j] is true when the factors between traces i and j are
+	 * already known, the messages between them are then not analyzed. NULL
+	 * if no factors are known. */
+	bool** knownPairs;
 
 	const ProcessingModule* processingModule;
 	void* processingData;
@@ -43,6 +52,17 @@ typedef struct _SyncState
 	void* reductionData;
 } SyncState;
 
+/* Correction factors of the traces for one time window of a piecewise
+ * synchronization
+ */
+typedef struct
+{
+	// Start of the window in the clock of trace 0
+	uint64_t start;
+	// Factors for each trace, NULL if the window is not used
+	GArray* factors;
+} WindowFactors;
+
 typedef struct
 {
 	char shortName;
@@ -59,6 +79,9 @@ typedef struct
 	const char* arg;
 	const char* optionHelp;
 	const char* argHelp;
+	// true if the option only adds an output, the factors do not depend on
+	// it but the traces must be processed to produce it
+	bool outputOnly;
 } ModuleOption;
 
 
@@ -70,6 +93,14 @@ extern GQueue reductionModules;
 extern GQueue moduleOptions;
 
 void printStats(SyncState* const syncState);
+AllFactors* estimateFactors(SyncState* const syncState);
+
+GArray* reduceWindows(SyncState* const syncState, AllFactors* const
+	allFactors);
+GArray* joinWindows(GArray* const windows, const unsigned int traceNum,
+	GArray* const factors, const uint64_t segmentLength, const double
+	minOffset);
+void destroyWindows(GArray* const windows);
 
 void timeDiff(struct timeval* const end, const struct timeval* const start);
 
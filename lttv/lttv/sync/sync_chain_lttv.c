@@ -26,6 +26,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -36,8 +37,7 @@
 #include <lttv/option.h>
 
 
-#include "event_processing_lttng_standard.h"
-#include "event_processing_lttng_null.h"
+#include "event_processing_lttng_ctf.h"
 #include "event_matching_tcp.h"
 #include "event_matching_broadcast.h"
 #include "event_matching_distributor.h"
@@ -45,6 +45,7 @@
 #include "event_analysis_linreg.h"
 #include "event_analysis_eval.h"
 #include "factor_reduction_accuracy.h"
+#include "sync_cache.h"
 #include "sync_chain.h"
 #include "sync_chain_lttv.h"
 
@@ -55,6 +56,10 @@ static void destroy();
 static void gfAddModuleOption(gpointer data, gpointer user_data);
 static void gfRemoveModuleOption(gpointer data, gpointer user_data);
 
+static char* getCacheOptions();
+static void gfAppendCacheOption(gpointer data, gpointer user_data);
+static gint gcfCompareOutputOption(gconstpointer a, gconstpointer b);
+
 static ModuleOption optionSync= {
 	.longName= "sync",
 	.hasArg= NO_ARG,
@@ -70,6 +75,29 @@ static ModuleOption optionSyncNull= {
 	.hasArg= NO_ARG,
 	.optionHelp= "read the events but do not perform any processing",
 };
+static ModuleOption optionSyncFull= {
+	.longName= "sync-full",
+	.hasArg= NO_ARG,
+	.optionHelp= "read all the streams of the traces, not only the ones "
+		"declaring network events",
+};
+static ModuleOption optionSyncParallel= {
+	.longName= "sync-parallel",
+	.hasArg= NO_ARG,
+	.optionHelp= "read the traces in parallel, one thread per trace",
+};
+static ModuleOption optionSyncSegment= {
+	.longName= "sync-segment",
+	.hasArg= REQUIRED_ARG,
+	.optionHelp= "compute a piecewise correction, with one piece for each "
+		"window of this length",
+	.argHelp= "seconds",
+};
+static ModuleOption optionSyncNoCache= {
+	.longName= "sync-no-cache",
+	.hasArg= NO_ARG,
+	.optionHelp= "do not read or write the cache of synchronization results",
+};
 static GString* analysisModulesNames;
 static ModuleOption optionSyncAnalysis= {
 	.longName= "sync-analysis",
@@ -127,8 +155,7 @@ static void init()
 	 * processingModules, matchingModules, analysisModules or moduleOptions
 	 * are accessed.
 	 */
-	registerProcessingLTTVStandard();
-	registerProcessingLTTVNull();
+	registerProcessingLTTngCTF();
 
 	registerMatchingTCP();
 	registerMatchingBroadcast();
@@ -168,6 +195,10 @@ static void init()
 	g_queue_push_head(&moduleOptions, &optionSyncGraphs);
 	g_queue_push_head(&moduleOptions, &optionSyncReduction);
 	g_queue_push_head(&moduleOptions, &optionSyncAnalysis);
+	g_queue_push_head(&moduleOptions, &optionSyncNoCache);
+	g_queue_push_head(&moduleOptions, &optionSyncSegment);
+	g_queue_push_head(&moduleOptions, &optionSyncParallel);
+	g_queue_push_head(&moduleOptions, &optionSyncFull);
 	g_queue_push_head(&moduleOptions, &optionSyncNull);
 	g_queue_push_head(&moduleOptions, &optionSyncStats);
 	g_queue_push_head(&moduleOptions, &optionSync);
@@ -201,12 +232,12 @@ static void destroy()
  * The individual correction factors are written out to each trace.
  *
  * Args:
- *   traceSetContext: traceset
+ *   traceset:     traceset
  *
  * Returns:
  *   false if synchronization was not performed, true otherwise
  */
-bool syncTraceset(LttvTracesetContext* const traceSetContext)
+bool syncTraceset(LttvTraceset* const traceset)
 {
 	SyncState* syncState;
 	struct timeval startTime, endTime;
@@ -215,8 +246,11 @@ bool syncTraceset(LttvTracesetContext* const traceSetContext)
 	unsigned int i;
 	AllFactors* allFactors;
 	GArray* factors;
-	double minOffset, minDrift;
-	unsigned int refFreqTrace;
+	GArray* windows;
+	double minOffset;
+	SyncCache* cache;
+	AllFactors* knownFactors;
+	unsigned int missingPairs;
 
 	if (!optionSync.present)
 	{
@@ -255,68 +289,199 @@ bool syncTraceset(LttvTracesetContext* const traceSetContext)
 		syncState->graphsDir= NULL;
 	}
 
+	syncState->segmentLength= 0;
+	// lttv only sets present for the options without argument
+	if (!optionSyncNull.present && optionSyncSegment.arg != NULL)
+	{
+		double length= strtod(optionSyncSegment.arg, NULL);
+
+		if (!(length > 0.))
+		{
+			g_error("Invalid synchronization segment length '%s'",
+				optionSyncSegment.arg);
+		}
+		syncState->segmentLength= length * NANOSECONDS_PER_SECOND;
+	}
+
 	// Identify and initialize modules
 	syncState->processingData= NULL;
+	result= g_queue_find_custom(&processingModules, "LTTng-CTF",
+		&gcfCompareProcessing);
+	g_assert(result != NULL);
+	syncState->processingModule= (ProcessingModule*) result->data;
+
+	syncState->matchingData= NULL;
+	syncState->analysisData= NULL;
+	syncState->reductionData= NULL;
 	if (optionSyncNull.present)
 	{
-		result= g_queue_find_custom(&processingModules, "LTTV-null",
-			&gcfCompareProcessing);
+		// The events are decoded but not matched
+		syncState->matchingModule= NULL;
+		syncState->analysisModule= NULL;
+		syncState->reductionModule= NULL;
 	}
 	else
 	{
-		result= g_queue_find_custom(&processingModules, "LTTV-standard",
-			&gcfCompareProcessing);
+		result= g_queue_find_custom(&matchingModules, "TCP",
+			&gcfCompareMatching);
+		g_assert(result != NULL);
+		syncState->matchingModule= (MatchingModule*) result->data;
+
+		result= g_queue_find_custom(&analysisModules, optionSyncAnalysis.arg,
+			&gcfCompareAnalysis);
+		if (result != NULL)
+		{
+			syncState->analysisModule= (AnalysisModule*) result->data;
+		}
+		else
+		{
+			g_error("Analysis module '%s' not found", optionSyncAnalysis.arg);
+		}
+
+		result= g_queue_find_custom(&reductionModules, optionSyncReduction.arg,
+			&gcfCompareReduction);
+		if (result != NULL)
+		{
+			syncState->reductionModule= (ReductionModule*) result->data;
+		}
+		else
+		{
+			g_error("Reduction module '%s' not found", optionSyncReduction.arg);
+		}
 	}
-	g_assert(result != NULL);
-	syncState->processingModule= (ProcessingModule*) result->data;
 
-	syncState->matchingData= NULL;
-	result= g_queue_find_custom(&matchingModules, "TCP", &gcfCompareMatching);
-	g_assert(result != NULL);
-	syncState->matchingModule= (MatchingModule*) result->data;
+	/* The factors between trace pairs found in the cache are not computed
+	 * again. They are only read when the statistics and graphs, which need
+	 * the events, are not requested. Piecewise corrections are not cached.
+	 */
+	cache= NULL;
+	knownFactors= NULL;
+	missingPairs= 0;
+	syncState->knownPairs= NULL;
+	if (!optionSyncNull.present && !optionSyncNoCache.present &&
+		syncState->segmentLength == 0)
+	{
+		char* options= getCacheOptions();
 
-	syncState->analysisData= NULL;
-	result= g_queue_find_custom(&analysisModules, optionSyncAnalysis.arg,
-		&gcfCompareAnalysis);
-	if (result != NULL)
+		cache= openSyncCache(traceset, options);
+		g_free(options);
+
+		// The factors are not read from the cache when the traces must be
+		// processed for an output
+		if (!optionSyncStats.present && !optionSyncGraphs.present &&
+			g_queue_find_custom(&moduleOptions, NULL,
+				&gcfCompareOutputOption) == NULL)
+		{
+			knownFactors= createAllFactors(cache->traceNb);
+			syncState->knownPairs= malloc(cache->traceNb * sizeof(bool*));
+			for (i= 0; i < cache->traceNb; i++)
+			{
+				syncState->knownPairs[i]= calloc(cache->traceNb,
+					sizeof(bool));
+			}
+			missingPairs= getCachedFactors(cache, knownFactors,
+				syncState->knownPairs);
+		}
+	}
+
+	if (knownFactors != NULL && missingPairs == 0)
 	{
-		syncState->analysisModule= (AnalysisModule*) result->data;
+		g_debug("Using cached synchronization factors");
+
+		syncState->traceNb= cache->traceNb;
+		syncState->reductionModule->initReduction(syncState);
+		allFactors= knownFactors;
+		knownFactors= NULL;
 	}
 	else
 	{
-		g_error("Analysis module '%s' not found", optionSyncAnalysis.arg);
+		/* Unless --sync-full is given, only the streams that may hold
+		 * network events are read, the traces are opened a second time with
+		 * just these streams
+		 */
+		syncState->processingModule->initProcessing(syncState, traceset,
+			(int) !optionSyncFull.present, (int) optionSyncParallel.present);
+		if (!optionSyncNull.present)
+		{
+			syncState->matchingModule->initMatching(syncState);
+			syncState->analysisModule->initAnalysis(syncState);
+			syncState->reductionModule->initReduction(syncState);
+		}
+
+		// Process traceset
+		if (syncState->processingModule->runProcessing != NULL)
+		{
+			syncState->processingModule->runProcessing(syncState);
+		}
+
+		allFactors= syncState->processingModule->finalizeProcessing(syncState);
+
+		if (knownFactors != NULL)
+		{
+			unsigned int j;
+
+			// The messages between known pairs were not analyzed
+			for (i= 0; i < syncState->traceNb; i++)
+			{
+				for (j= 0; j < syncState->traceNb; j++)
+				{
+					if (syncState->knownPairs[i][j])
+					{
+						destroyPairFactors(&allFactors->pairFactors[i][j]);
+						allFactors->pairFactors[i][j]=
+							knownFactors->pairFactors[i][j];
+						memset(&knownFactors->pairFactors[i][j], 0,
+							sizeof(PairFactors));
+					}
+				}
+			}
+			freeAllFactors(knownFactors, syncState->traceNb);
+		}
+
+		if (cache != NULL)
+		{
+			storeFactors(cache, allFactors, syncState->knownPairs);
+		}
 	}
 
-	syncState->reductionData= NULL;
-	result= g_queue_find_custom(&reductionModules, optionSyncReduction.arg,
-		&gcfCompareReduction);
-	if (result != NULL)
+	if (cache != NULL)
 	{
-		syncState->reductionModule= (ReductionModule*) result->data;
+		closeSyncCache(cache);
 	}
-	else
+	if (syncState->knownPairs != NULL)
 	{
-		g_error("Reduction module '%s' not found", optionSyncReduction.arg);
+		for (i= 0; i < syncState->traceNb; i++)
+		{
+			free(syncState->knownPairs[i]);
+		}
+		free(syncState->knownPairs);
+		syncState->knownPairs= NULL;
 	}
 
-	syncState->processingModule->initProcessing(syncState, traceSetContext);
+	// Reduce, adjust and set correction factors
+	windows= NULL;
 	if (!optionSyncNull.present)
 	{
-		syncState->matchingModule->initMatching(syncState);
-		syncState->analysisModule->initAnalysis(syncState);
-		syncState->reductionModule->initReduction(syncState);
+		// The windows are reduced first so the reduction stats are those of
+		// the whole traces
+		if (syncState->segmentLength != 0)
+		{
+			windows= reduceWindows(syncState, allFactors);
+		}
+		factors= syncState->reductionModule->finalizeReduction(syncState,
+			allFactors);
+	}
+	else
+	{
+		factors= g_array_sized_new(FALSE, FALSE, sizeof(Factors),
+			syncState->traceNb);
+		g_array_set_size(factors, syncState->traceNb);
+		for (i= 0; i < syncState->traceNb; i++)
+		{
+			g_array_index(factors, Factors, i).drift= 1.;
+			g_array_index(factors, Factors, i).offset= 0.;
+		}
 	}
-
-	// Process traceset
-	lttv_process_traceset_seek_time(traceSetContext, ltt_time_zero);
-	lttv_process_traceset_middle(traceSetContext, ltt_time_infinite,
-		G_MAXULONG, NULL);
-	lttv_process_traceset_seek_time(traceSetContext, ltt_time_zero);
-
-	// Obtain, reduce, adjust and set correction factors
-	allFactors= syncState->processingModule->finalizeProcessing(syncState);
-	factors= syncState->reductionModule->finalizeReduction(syncState,
-		allFactors);
 	freeAllFactors(allFactors, syncState->traceNb);
 
 	/* The offsets are adjusted so the lowest one is 0. This is done because
@@ -335,50 +500,37 @@ bool syncTraceset(LttvTracesetContext* const traceSetContext)
 		g_array_index(factors, Factors, i).offset-= minOffset;
 	}
 
-	/* Because the timestamps are corrected at the TSC level (not at the
-	 * LttTime level) all trace frequencies must be made equal. We use the
-	 * frequency of the system with the lowest drift
+	/* Write the factors to the LttvTrace structures. The factors apply to
+	 * the timestamps in nanoseconds, so there is no reference frequency to
+	 * choose as with the cycle counters of LTT 0.x traces.
 	 */
-	minDrift= INFINITY;
-	refFreqTrace= 0;
-	for (i= 0; i < syncState->traceNb; i++)
-	{
-		if (g_array_index(factors, Factors, i).drift < minDrift)
-		{
-			minDrift= g_array_index(factors, Factors, i).drift;
-			refFreqTrace= i;
-		}
-	}
-	g_assert(syncState->traceNb == 0 || minDrift != INFINITY);
-
-	// Write the factors to the LttTrace structures
 	for (i= 0; i < syncState->traceNb; i++)
 	{
-		LttTrace* t;
+		LttvTrace* t;
 		Factors* traceFactors;
 
-		t= traceSetContext->traces[i]->t;
+		t= lttv_traceset_get(traceset, i);
 		traceFactors= &g_array_index(factors, Factors, i);
 
-		t->drift= traceFactors->drift;
-		t->offset= traceFactors->offset;
-		t->start_freq= traceSetContext->traces[refFreqTrace]->t->start_freq;
-		t->freq_scale= traceSetContext->traces[refFreqTrace]->t->freq_scale;
-		t->start_time_from_tsc =
-			ltt_time_from_uint64(tsc_to_uint64(t->freq_scale, t->start_freq,
-					t->drift * t->start_tsc + t->offset));
+		lttv_trace_set_sync_factors(t, traceFactors->drift,
+			traceFactors->offset);
+
+		if (windows != NULL)
+		{
+			lttv_trace_set_sync_segments(t, joinWindows(windows, i,
+					factors, syncState->segmentLength, minOffset));
+		}
+		else
+		{
+			lttv_trace_set_sync_segments(t, NULL);
+		}
 	}
 
 	g_array_free(factors, TRUE);
-
-	lttv_traceset_context_compute_time_span(traceSetContext,
-		&traceSetContext->time_span);
-
-	g_debug("traceset start %ld.%09ld end %ld.%09ld",
-		traceSetContext->time_span.start_time.tv_sec,
-		traceSetContext->time_span.start_time.tv_nsec,
-		traceSetContext->time_span.end_time.tv_sec,
-		traceSetContext->time_span.end_time.tv_nsec);
+	if (windows != NULL)
+	{
+		destroyWindows(windows);
+	}
 
 	// Write graphs file
 	if (!optionSyncNull.present && optionSyncGraphs.present)
@@ -398,19 +550,24 @@ bool syncTraceset(LttvTracesetContext* const traceSetContext)
 		printf("Resulting synchronization factors:\n");
 		for (i= 0; i < syncState->traceNb; i++)
 		{
-			LttTrace* t;
+			LttvTrace* t;
 
-			t= traceSetContext->traces[i]->t;
+			t= lttv_traceset_get(traceset, i);
 
-			printf("\ttrace %u drift= %g offset= %g (%f) start time= %ld.%09ld\n",
-				i, t->drift, t->offset, (double) tsc_to_uint64(t->freq_scale,
-					t->start_freq, t->offset) / NANOSECONDS_PER_SECOND,
-				t->start_time_from_tsc.tv_sec,
-				t->start_time_from_tsc.tv_nsec);
+			printf("\ttrace %u drift= %g offset= %g (%f)\n", i, t->drift,
+				t->offset, t->offset / NANOSECONDS_PER_SECOND);
+			if (t->sync_segments != NULL)
+			{
+				printf("\t\tpiecewise correction, %u pieces\n",
+					t->sync_segments->len);
+			}
 		}
 	}
 
-	syncState->processingModule->destroyProcessing(syncState);
+	if (syncState->processingData != NULL)
+	{
+		syncState->processingModule->destroyProcessing(syncState);
+	}
 	if (syncState->matchingModule != NULL)
 	{
 		syncState->matchingModule->destroyMatching(syncState);
@@ -423,6 +580,7 @@ bool syncTraceset(LttvTracesetContext* const traceSetContext)
 	{
 		syncState->reductionModule->destroyReduction(syncState);
 	}
+	destroyTCPEventPool();
 
 	free(syncState);
 
@@ -499,6 +657,94 @@ static void gfRemoveModuleOption(gpointer data, gpointer user_data)
 }
 
 
+
+/*
+ * Describe the options that change the factors between trace pairs, to key
+ * the entries of the synchronization cache
+ *
+ * Returns:
+ *   The description, to free with g_free()
+ */
+static char* getCacheOptions()
+{
+	GString* options;
+
+	options= g_string_new("");
+	g_string_append_printf(options, "%s=%s", optionSyncAnalysis.longName,
+		optionSyncAnalysis.arg);
+	g_queue_foreach(&moduleOptions, &gfAppendCacheOption, options);
+
+	return g_string_free(options, FALSE);
+}
+
+
+/*
+ * A GFunc for g_queue_foreach()
+ *
+ * The options of the sync module other than the analysis do not change the
+ * factors between trace pairs. The options of the event modules do, except
+ * the output ones.
+ *
+ * Args:
+ *   data:         ModuleOption*
+ *   user_data:    GString*, description of the options
+ */
+static void gfAppendCacheOption(gpointer data, gpointer user_data)
+{
+	const ModuleOption* const option= data;
+	const ModuleOption* const chainOptions[]= {&optionSync, &optionSyncStats,
+		&optionSyncNull, &optionSyncFull, &optionSyncParallel,
+		&optionSyncSegment, &optionSyncNoCache, &optionSyncAnalysis,
+		&optionSyncReduction, &optionSyncGraphs, &optionSyncGraphsDir};
+	unsigned int i;
+
+	if (!option->present && (option->hasArg == NO_ARG || option->arg ==
+			NULL))
+	{
+		return;
+	}
+
+	if (option->outputOnly)
+	{
+		return;
+	}
+
+	for (i= 0; i < ARRAY_SIZE(chainOptions); i++)
+	{
+		if (option == chainOptions[i])
+		{
+			return;
+		}
+	}
+
+	g_string_append_printf((GString*) user_data, " %s=%s", option->longName,
+		option->arg ? option->arg : "");
+}
+
+
+/*
+ * A GCompareFunc for g_queue_find_custom()
+ *
+ * Args:
+ *   a:            ModuleOption*
+ *   b:            NULL
+ *
+ * Returns:
+ *   0 if the option is an output option that is set
+ */
+static gint gcfCompareOutputOption(gconstpointer a, gconstpointer b)
+{
+	const ModuleOption* const option= a;
+
+	if (option->outputOnly && (option->present || (option->hasArg != NO_ARG
+				&& option->arg != NULL)))
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
 LTTV_MODULE("sync", "Synchronize traces", \
 	"Synchronizes a traceset based on the correspondance of network events", \
 	init, destroy, "option")
@@ -20,8 +20,8 @@
 
 #include <stdbool.h>
 
-#include <lttv/tracecontext.h>
+#include <lttv/traceset.h>
 
-bool syncTraceset(LttvTracesetContext* const traceSetContext);
+bool syncTraceset(LttvTraceset* const traceset);
 
 #endif
@@ -24,6 +24,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,6 +46,8 @@
 #include "factor_reduction_accuracy.h"
 #include "sync_chain.h"
 
+#define NANOSECONDS_PER_SECOND 1000000000
+
 
 struct OptionsInfo
 {
@@ -60,6 +64,10 @@ static void gfPrintModuleOption(gpointer data, gpointer user_data);
 static void nullLog(const gchar *log_domain, GLogLevelFlags log_level, const
 	gchar *message, gpointer user_data);
 static void gfAddModuleOption(gpointer data, gpointer user_data);
+static void checkSegments(SyncState* const syncState, const char* const
+	testCaseName, GArray* const windows, GArray* const factors);
+static void checkMessages(const char* const testCaseName, GArray** const
+	segments, const unsigned int traceNb);
 static guint ghfCharHash(gconstpointer key);
 static gboolean gefCharEqual(gconstpointer a, gconstpointer b);
 
@@ -89,6 +97,14 @@ static ModuleOption optionSyncReduction= {
 	.hasArg= REQUIRED_ARG,
 	.optionHelp= "Specify which algorithm to use for factor reduction",
 };
+static ModuleOption optionSyncSegment= {
+	.shortName= 'S',
+	.longName= "sync-segment",
+	.hasArg= REQUIRED_ARG,
+	.optionHelp= "Compute a piecewise correction, with one piece for each "
+		"window of this length, and check it against the messages",
+	.argHelp= "seconds",
+};
 
 
 /*
@@ -107,7 +123,7 @@ int main(const int argc, char* const argv[])
 	struct timeval startTime, endTime;
 	struct rusage startUsage, endUsage;
 	GList* result;
-	GArray* factors;
+	GArray* factors, * windows;
 	int retval;
 	bool stats;
 	const char* testCaseName;
@@ -166,6 +182,7 @@ int main(const int argc, char* const argv[])
 	}
 	optionSyncGraphs.arg= graphsDir;
 
+	g_queue_push_head(&moduleOptions, &optionSyncSegment);
 	g_queue_push_head(&moduleOptions, &optionSyncReduction);
 	g_queue_push_head(&moduleOptions, &optionSyncAnalysis);
 	g_queue_push_head(&moduleOptions, &optionSyncGraphs);
@@ -200,6 +217,19 @@ int main(const int argc, char* const argv[])
         syncState->graphsStream= NULL;
         syncState->graphsDir= NULL;
     }
+	syncState->segmentLength= 0;
+	if (optionSyncSegment.present)
+	{
+		double length= strtod(optionSyncSegment.arg, NULL);
+
+		if (!(length > 0.))
+		{
+			g_error("Invalid synchronization segment length '%s'",
+				optionSyncSegment.arg);
+		}
+		syncState->segmentLength= length * NANOSECONDS_PER_SECOND;
+	}
+	syncState->knownPairs= NULL;
 
 	// Identify modules
 	syncState->processingData= NULL;
@@ -245,10 +275,21 @@ int main(const int argc, char* const argv[])
 
 	// Process traceset
 	allFactors= syncState->processingModule->finalizeProcessing(syncState);
+	windows= NULL;
+	if (syncState->segmentLength != 0)
+	{
+		windows= reduceWindows(syncState, allFactors);
+	}
 	factors= syncState->reductionModule->finalizeReduction(syncState,
 		allFactors);
 	freeAllFactors(allFactors, syncState->traceNb);
 
+	if (windows != NULL)
+	{
+		checkSegments(syncState, testCaseName, windows, factors);
+		destroyWindows(windows);
+	}
+
 	// Write graphs file
 	if (syncState->graphsStream)
 	{
@@ -281,6 +322,7 @@ int main(const int argc, char* const argv[])
 	syncState->matchingModule->destroyMatching(syncState);
 	syncState->analysisModule->destroyAnalysis(syncState);
 	syncState->reductionModule->destroyReduction(syncState);
+	destroyTCPEventPool();
 
 	stats= syncState->stats;
 	free(syncState);
@@ -328,7 +370,6 @@ const char* processOptions(const int argc, char* const argv[])
 	GArray* longOptions;
 	GString* optionString;
 	GQueue* longIndex;
-	int longOption;
 	GHashTable* shortIndex;
 
 	longOptions= g_array_sized_new(TRUE, FALSE, sizeof(struct option),
@@ -345,13 +386,14 @@ const char* processOptions(const int argc, char* const argv[])
 		int optionIndex= 0;
 		ModuleOption* moduleOption;
 
-		longOption= -1;
 		c= getopt_long(argc, argv, optionString->str, (struct option*)
 			longOptions->data, &optionIndex);
 
-		if (longOption >= 0 && longOption < g_queue_get_length(longIndex))
+		// Long options return their index in longIndex, which is below the
+		// short option characters
+		if (c >= 0 && c < g_queue_get_length(longIndex))
 		{
-			moduleOption= g_queue_peek_nth(longIndex, longOption);
+			moduleOption= g_queue_peek_nth(longIndex, c);
 		}
 		else if ((moduleOption= g_hash_table_lookup(shortIndex, &c)) != NULL)
 		{
@@ -463,6 +505,192 @@ static void gfPrintModuleOption(gpointer data, gpointer user_data)
 }
 
 
+/*
+ * Join the windows of a piecewise synchronization like the lttv sync chain
+ * does and check the corrections of the traces
+ *
+ * The corrections must be continuous and increasing at the window
+ * boundaries, the boundaries of all the traces must be at the same
+ * corrected time and no message may be received before it is sent once
+ * corrected. The program aborts if a check fails.
+ *
+ * Args:
+ *   syncState:    container for synchronization data
+ *   testCaseName: test case file, its messages are read again
+ *   windows:      GArray* of WindowFactors
+ *   factors:      GArray* of Factors, correction of each trace for the whole
+ *                 traces
+ */
+static void checkSegments(SyncState* const syncState, const char* const
+	testCaseName, GArray* const windows, GArray* const factors)
+{
+	GArray* traceFactors;
+	GArray** segments;
+	double minOffset= 0.;
+	unsigned int i, k;
+
+	// The offsets are adjusted so the lowest one is 0, see syncTraceset()
+	traceFactors= g_array_sized_new(FALSE, FALSE, sizeof(Factors),
+		factors->len);
+	g_array_append_vals(traceFactors, factors->data, factors->len);
+	for (i= 0; i < traceFactors->len; i++)
+	{
+		minOffset= MIN(g_array_index(traceFactors, Factors, i).offset,
+			minOffset);
+	}
+	for (i= 0; i < traceFactors->len; i++)
+	{
+		g_array_index(traceFactors, Factors, i).offset-= minOffset;
+	}
+
+	segments= malloc(syncState->traceNb * sizeof(GArray*));
+	for (i= 0; i < syncState->traceNb; i++)
+	{
+		guint hint= 0;
+
+		segments[i]= joinWindows(windows, i, traceFactors,
+			syncState->segmentLength, minOffset);
+		if (segments[i] == NULL)
+		{
+			g_error("No synchronization windows");
+		}
+		lttv_sync_segments_init(segments[i]);
+
+		for (k= 1; k < segments[i]->len; k++)
+		{
+			LttvTraceSyncSegment* segment= &g_array_index(segments[i],
+				LttvTraceSyncSegment, k);
+			uint64_t before, at;
+
+			if (segment->start <= (segment - 1)->start)
+			{
+				g_error("Window %u of trace %u starts before the previous "
+					"one", k, i);
+			}
+
+			before= lttv_sync_segments_apply(segments[i], &hint,
+				segment->start - 1);
+			at= lttv_sync_segments_apply(segments[i], &hint, segment->start);
+			if (at < before || at - before > 2)
+			{
+				g_error("The correction of trace %u jumps from %" PRIu64
+					" to %" PRIu64 " at window %u", i, before, at, k);
+			}
+		}
+	}
+
+	// The boundaries are at the same time once corrected for the whole
+	// traces
+	for (i= 1; i < syncState->traceNb; i++)
+	{
+		const Factors* f0= &g_array_index(traceFactors, Factors, 0);
+		const Factors* fi= &g_array_index(traceFactors, Factors, i);
+
+		for (k= 0; k < segments[i]->len; k++)
+		{
+			double t0= f0->drift * g_array_index(segments[0],
+				LttvTraceSyncSegment, k).start + f0->offset;
+			double ti= fi->drift * g_array_index(segments[i],
+				LttvTraceSyncSegment, k).start + fi->offset;
+
+			if (fabs(ti - t0) > 2.)
+			{
+				g_error("Window %u of trace %u starts %g ns away from the "
+					"one of trace 0", k, i, ti - t0);
+			}
+		}
+	}
+
+	checkMessages(testCaseName, segments, syncState->traceNb);
+
+	if (syncState->stats)
+	{
+		printf("Piecewise synchronization:\n");
+		for (i= 0; i < syncState->traceNb; i++)
+		{
+			for (k= 0; k < segments[i]->len; k++)
+			{
+				LttvTraceSyncSegment* segment= &g_array_index(segments[i],
+					LttvTraceSyncSegment, k);
+
+				printf("\ttrace %u start= %" PRIu64 " drift= %.9f offset= %g\n",
+					i, segment->start, segment->drift, segment->offset);
+			}
+		}
+	}
+
+	for (i= 0; i < syncState->traceNb; i++)
+	{
+		g_array_free(segments[i], TRUE);
+	}
+	free(segments);
+	g_array_free(traceFactors, TRUE);
+}
+
+
+/*
+ * Check that no message of a text test case is received before it is sent,
+ * once the times are corrected
+ *
+ * Args:
+ *   testCaseName: test case file
+ *   segments:     GArray* of LttvTraceSyncSegment, piecewise correction of
+ *                 each trace
+ *   traceNb:      number of traces
+ */
+static void checkMessages(const char* const testCaseName, GArray** const
+	segments, const unsigned int traceNb)
+{
+	FILE* testCase;
+	char* line= NULL;
+	size_t bufLen;
+	guint* hints;
+	unsigned int count= 0;
+
+	testCase= fopen(testCaseName, "r");
+	if (testCase == NULL)
+	{
+		g_error("%s", strerror(errno));
+	}
+
+	hints= calloc(traceNb, sizeof(guint));
+	while (getline(&line, &bufLen, testCase) != -1)
+	{
+		unsigned int sender, receiver;
+		double sendTime, recvTime;
+		uint64_t send, recv;
+
+		// The comments and the number of traces do not match
+		if (sscanf(line, " %u %u %lf %lf", &sender, &receiver, &sendTime,
+				&recvTime) != 4 || sender >= traceNb || receiver >= traceNb)
+		{
+			continue;
+		}
+
+		send= lttv_sync_segments_apply(segments[sender], &hints[sender],
+			round(sendTime * NANOSECONDS_PER_SECOND));
+		recv= lttv_sync_segments_apply(segments[receiver],
+			&hints[receiver], round(recvTime * NANOSECONDS_PER_SECOND));
+		if (recv < send)
+		{
+			g_error("Message from trace %u at %.9f to trace %u at %.9f is "
+				"received %" PRIu64 " ns before it is sent", sender,
+				sendTime, receiver, recvTime, send - recv);
+		}
+		count++;
+	}
+
+	if (count == 0)
+	{
+		g_error("No message found in test case %s", testCaseName);
+	}
+
+	free(hints);
+	free(line);
+	fclose(testCase);
+}
+
+
 /*
  * A Glib log function which does nothing.
  */
@@ -0,0 +1,720 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <lttv/attribute.h>
+
+#include "sync_streams.h"
+
+#define CTF_MAGIC 0xC1FC1FC1
+#define TSDL_MAGIC 0x75D11D57
+
+// Size of the header of a metadata packet, see the CTF specification
+#define METADATA_PACKET_HEADER_SIZE 37
+
+
+static char* readMetadata(const char* const tracePath);
+static void findSyncStreamIds(const char* const text, bool (*isSyncEvent)(const
+		char* const name), GArray* const streamIds);
+static bool getStreamId(const char* const path, uint64_t* const streamId,
+	uint8_t* const uuid);
+static bool linkSyncStreams(const char* const tracePath, const char* const
+	syncPath, GArray* const streamIds, bool* const skipped);
+static void removeSyncDir(const char* const syncPath);
+static gint gcfCompareNames(gconstpointer a, gconstpointer b);
+
+
+/*
+ * Open the network streams of some traces of a traceset
+ *
+ * Args:
+ *   traceset:     traceset to synchronize
+ *   first:        number of the first trace to open
+ *   count:        number of traces to open
+ *   isSyncEvent:  function telling if an event name is needed for
+ *                 synchronization, NULL to open all the streams
+ *
+ * Returns:
+ *   A new traceset, to destroy with destroySyncTraceset(), or NULL on
+ *   error. When isSyncEvent is not NULL, NULL is also returned if no stream
+ *   can be left out or a stream class cannot be found. In that case the
+ *   whole traces must be read.
+ */
+LttvTraceset* createSyncTraceset(LttvTraceset* const traceset, const unsigned
+	int first, const unsigned int count, bool (*isSyncEvent)(const char* const
+		name))
+{
+	unsigned int i;
+	GPtrArray* linkDirs;
+	GPtrArray* paths;
+	LttvTraceset* syncTraceset= NULL;
+	LttvAttributeValue value;
+	gboolean retval;
+	bool skipped= false;
+
+	g_assert(first + count <= lttv_traceset_number(traceset));
+
+	linkDirs= g_ptr_array_new_with_free_func(&g_free);
+	paths= g_ptr_array_new();
+
+	for (i= first; i < first + count; i++)
+	{
+		const char* tracePath= lttv_traceset_get(traceset, i)->full_path;
+		char* metadata;
+		char* linkDir;
+		GArray* streamIds;
+		bool linked;
+
+		if (isSyncEvent == NULL)
+		{
+			g_ptr_array_add(paths, (char*) tracePath);
+			continue;
+		}
+
+		metadata= readMetadata(tracePath);
+		if (metadata == NULL)
+		{
+			goto out;
+		}
+
+		streamIds= g_array_new(FALSE, FALSE, sizeof(uint64_t));
+		findSyncStreamIds(metadata, isSyncEvent, streamIds);
+		g_free(metadata);
+
+		if (streamIds->len == 0)
+		{
+			g_debug("No network events declared in trace %s", tracePath);
+			g_array_free(streamIds, TRUE);
+			goto out;
+		}
+
+		linkDir= g_dir_make_tmp("lttv-sync-XXXXXX", NULL);
+		if (linkDir == NULL)
+		{
+			g_array_free(streamIds, TRUE);
+			goto out;
+		}
+		g_ptr_array_add(linkDirs, linkDir);
+		g_ptr_array_add(paths, linkDir);
+
+		linked= linkSyncStreams(tracePath, linkDir, streamIds, &skipped);
+		g_array_free(streamIds, TRUE);
+		if (!linked)
+		{
+			goto out;
+		}
+	}
+
+	if (isSyncEvent != NULL && !skipped)
+	{
+		g_debug("All the streams carry network events");
+		goto out;
+	}
+
+	syncTraceset= lttv_traceset_new();
+	for (i= 0; i < paths->len; i++)
+	{
+		if (lttv_traceset_add_path(syncTraceset, g_ptr_array_index(paths, i))
+			< 0)
+		{
+			break;
+		}
+	}
+	if (lttv_traceset_number(syncTraceset) != count)
+	{
+		g_warning("Cannot open the streams of the traceset for "
+			"synchronization");
+		lttv_traceset_destroy(syncTraceset);
+		syncTraceset= NULL;
+		goto out;
+	}
+
+	// The links are removed with the traceset
+	retval= lttv_attribute_find(lttv_traceset_attribute(syncTraceset),
+		g_quark_from_static_string("sync_link_dirs"), LTTV_POINTER, &value);
+	g_assert(retval);
+	*(value.v_pointer)= linkDirs;
+	linkDirs= NULL;
+
+out:
+	if (linkDirs != NULL)
+	{
+		for (i= 0; i < linkDirs->len; i++)
+		{
+			removeSyncDir(g_ptr_array_index(linkDirs, i));
+		}
+		g_ptr_array_free(linkDirs, TRUE);
+	}
+	g_ptr_array_free(paths, TRUE);
+
+	return syncTraceset;
+}
+
+
+/*
+ * Destroy a traceset created by createSyncTraceset() and remove its
+ * directories of links
+ *
+ * Args:
+ *   syncTraceset: sync traceset
+ */
+void destroySyncTraceset(LttvTraceset* const syncTraceset)
+{
+	unsigned int i;
+	GPtrArray* linkDirs;
+	LttvAttributeValue value;
+	gboolean retval;
+
+	retval= lttv_attribute_find(lttv_traceset_attribute(syncTraceset),
+		g_quark_from_static_string("sync_link_dirs"), LTTV_POINTER, &value);
+	g_assert(retval);
+	linkDirs= *(value.v_pointer);
+
+	lttv_traceset_destroy(syncTraceset);
+
+	if (linkDirs != NULL)
+	{
+		for (i= 0; i < linkDirs->len; i++)
+		{
+			removeSyncDir(g_ptr_array_index(linkDirs, i));
+		}
+		g_ptr_array_free(linkDirs, TRUE);
+	}
+}
+
+
+/*
+ * Identify the content of a trace
+ *
+ * The identity is made of the trace uuid, found in the packet headers, and
+ * of the names and sizes of the files of the trace. A trace that is still
+ * being written or that was recorded again gets a different identity.
+ *
+ * Args:
+ *   tracePath:    trace directory
+ *
+ * Returns:
+ *   A checksum of the identity, to free with g_free(), or NULL if the trace
+ *   directory cannot be read
+ */
+char* getTraceIdentity(const char* const tracePath)
+{
+	GDir* dir;
+	const char* entry;
+	GPtrArray* names;
+	GString* identity;
+	uint8_t uuid[16];
+	bool uuidFound= false;
+	unsigned int i;
+	char* checksum;
+
+	dir= g_dir_open(tracePath, 0, NULL);
+	if (dir == NULL)
+	{
+		return NULL;
+	}
+
+	names= g_ptr_array_new_with_free_func(&g_free);
+	while ((entry= g_dir_read_name(dir)) != NULL)
+	{
+		if (entry[0] != '.')
+		{
+			g_ptr_array_add(names, g_strdup(entry));
+		}
+	}
+	g_dir_close(dir);
+	g_ptr_array_sort(names, &gcfCompareNames);
+
+	identity= g_string_new("");
+	for (i= 0; i < names->len; i++)
+	{
+		const char* name= g_ptr_array_index(names, i);
+		char* path= g_build_filename(tracePath, name, NULL);
+		struct stat buf;
+		uint64_t streamId;
+
+		if (g_stat(path, &buf) == 0 && S_ISREG(buf.st_mode))
+		{
+			g_string_append_printf(identity, "%s %lld\n", name, (long long)
+				buf.st_size);
+
+			if (!uuidFound && strcmp(name, "metadata") != 0)
+			{
+				uuidFound= getStreamId(path, &streamId, uuid);
+			}
+		}
+		g_free(path);
+	}
+	g_ptr_array_free(names, TRUE);
+
+	if (uuidFound)
+	{
+		g_string_append(identity, "uuid ");
+		for (i= 0; i < sizeof(uuid); i++)
+		{
+			g_string_append_printf(identity, "%02x", uuid[i]);
+		}
+	}
+
+	checksum= g_compute_checksum_for_string(G_CHECKSUM_MD5, identity->str,
+		identity->len);
+	g_string_free(identity, TRUE);
+
+	return checksum;
+}
+
+
+/*
+ * A GCompareFunc for g_ptr_array_sort()
+ *
+ * Args:
+ *   a, b          char**
+ */
+static gint gcfCompareNames(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+
+/*
+ * Read the metadata of a trace, removing the packet headers if it is
+ * packetized
+ *
+ * Args:
+ *   tracePath:    trace directory
+ *
+ * Returns:
+ *   The metadata text, to free with g_free(), or NULL on error
+ */
+static char* readMetadata(const char* const tracePath)
+{
+	char* path;
+	char* contents;
+	gsize length;
+	uint32_t magic;
+	GString* text;
+	gsize offset;
+	bool swap;
+
+	path= g_build_filename(tracePath, "metadata", NULL);
+	if (!g_file_get_contents(path, &contents, &length, NULL))
+	{
+		g_warning("Cannot read %s", path);
+		g_free(path);
+		return NULL;
+	}
+	g_free(path);
+
+	if (length < sizeof(magic))
+	{
+		g_free(contents);
+		return NULL;
+	}
+
+	memcpy(&magic, contents, sizeof(magic));
+	if (magic == TSDL_MAGIC)
+	{
+		swap= false;
+	}
+	else if (magic == GUINT32_SWAP_LE_BE(TSDL_MAGIC))
+	{
+		swap= true;
+	}
+	else
+	{
+		// Plain text metadata
+		return contents;
+	}
+
+	text= g_string_sized_new(length);
+	offset= 0;
+	while (offset + METADATA_PACKET_HEADER_SIZE <= length)
+	{
+		uint32_t contentSize, packetSize;
+
+		memcpy(&contentSize, contents + offset + 24, sizeof(contentSize));
+		memcpy(&packetSize, contents + offset + 28, sizeof(packetSize));
+		if (swap)
+		{
+			contentSize= GUINT32_SWAP_LE_BE(contentSize);
+			packetSize= GUINT32_SWAP_LE_BE(packetSize);
+		}
+		contentSize/= 8;
+		packetSize/= 8;
+
+		if (contentSize < METADATA_PACKET_HEADER_SIZE || packetSize <
+			contentSize || offset + contentSize > length)
+		{
+			break;
+		}
+
+		g_string_append_len(text, contents + offset +
+			METADATA_PACKET_HEADER_SIZE, contentSize -
+			METADATA_PACKET_HEADER_SIZE);
+		offset+= packetSize;
+	}
+	g_free(contents);
+
+	return g_string_free(text, FALSE);
+}
+
+
+/*
+ * Find the stream classes that declare events needed for synchronization
+ *
+ * Only the top level "name" and "stream_id" attributes of the event blocks
+ * are looked at. An event without stream_id belongs to stream class 0.
+ *
+ * Args:
+ *   text:         metadata text
+ *   isSyncEvent:  function telling if an event name is needed for
+ *                 synchronization
+ *   streamIds:    uint64_t streamIds[], the stream ids found are appended
+ *                 to it
+ */
+static void findSyncStreamIds(const char* const text, bool (*isSyncEvent)(const
+		char* const name), GArray* const streamIds)
+{
+	const char* p= text;
+
+	while ((p= strstr(p, "event")) != NULL)
+	{
+		const char* q;
+		char* name= NULL;
+		uint64_t streamId= 0;
+		unsigned int depth= 0;
+		unsigned int i;
+
+		q= p + strlen("event");
+		if ((p > text && (isalnum(p[-1]) || p[-1] == '_')))
+		{
+			p= q;
+			continue;
+		}
+		while (isspace(*q))
+		{
+			q++;
+		}
+		if (*q != '{')
+		{
+			p= q;
+			continue;
+		}
+
+		for (; *q != '\0'; q++)
+		{
+			if (*q == '{')
+			{
+				depth++;
+			}
+			else if (*q == '}')
+			{
+				if (--depth == 0)
+				{
+					break;
+				}
+			}
+			else if (depth == 1 && (isalpha(*q) || *q == '_') &&
+				!isalnum(q[-1]) && q[-1] != '_')
+			{
+				const char* identifier= q;
+				size_t identifierLength;
+				const char* value;
+
+				while (isalnum(*q) || *q == '_')
+				{
+					q++;
+				}
+				identifierLength= q - identifier;
+				while (isspace(*q))
+				{
+					q++;
+				}
+				if (*q != '=')
+				{
+					q--;
+					continue;
+				}
+				q++;
+				while (isspace(*q))
+				{
+					q++;
+				}
+				value= q;
+				while (*q != ';' && *q != '\0' && *q != '}')
+				{
+					q++;
+				}
+
+				if (identifierLength == strlen("name") &&
+					strncmp(identifier, "name", identifierLength) == 0)
+				{
+					const char* end= q;
+
+					while (end > value && isspace(end[-1]))
+					{
+						end--;
+					}
+					if (end - value >= 2 && *value == '"' && end[-1] == '"')
+					{
+						value++;
+						end--;
+					}
+					g_free(name);
+					name= g_strndup(value, end - value);
+				}
+				else if (identifierLength == strlen("stream_id") &&
+					strncmp(identifier, "stream_id", identifierLength) == 0)
+				{
+					streamId= g_ascii_strtoull(value, NULL, 0);
+				}
+				q--;
+			}
+		}
+
+		if (name != NULL && isSyncEvent(name))
+		{
+			for (i= 0; i < streamIds->len; i++)
+			{
+				if (g_array_index(streamIds, uint64_t, i) == streamId)
+				{
+					break;
+				}
+			}
+			if (i == streamIds->len)
+			{
+				g_array_append_val(streamIds, streamId);
+			}
+		}
+		g_free(name);
+
+		if (*q == '\0')
+		{
+			break;
+		}
+		p= q + 1;
+	}
+}
+
+
+/*
+ * Read the stream id in the first packet header of a stream
+ *
+ * The packet header layout is the one of LTTng: magic, uuid, stream_id.
+ *
+ * Args:
+ *   path:         stream file
+ *   streamId:     the stream id is stored there
+ *   uuid:         the 16 bytes of the trace uuid are stored there, may be
+ *                 NULL
+ *
+ * Returns:
+ *   true if the stream id was read, false if the stream is empty or its
+ *   header has another layout
+ */
+static bool getStreamId(const char* const path, uint64_t* const streamId,
+	uint8_t* const uuid)
+{
+	FILE* stream;
+	struct {
+		uint32_t magic;
+		uint8_t uuid[16];
+		uint32_t streamId;
+	} __attribute__((packed)) header;
+	bool result= false;
+
+	stream= g_fopen(path, "rb");
+	if (stream == NULL)
+	{
+		return false;
+	}
+
+	if (fread(&header, sizeof(header), 1, stream) == 1)
+	{
+		if (header.magic == CTF_MAGIC)
+		{
+			*streamId= header.streamId;
+			result= true;
+		}
+		else if (header.magic == GUINT32_SWAP_LE_BE(CTF_MAGIC))
+		{
+			*streamId= GUINT32_SWAP_LE_BE(header.streamId);
+			result= true;
+		}
+
+		if (result && uuid != NULL)
+		{
+			memcpy(uuid, header.uuid, sizeof(header.uuid));
+		}
+	}
+	fclose(stream);
+
+	return result;
+}
+
+
+/*
+ * Link the metadata and the network streams of a trace in a directory
+ *
+ * The links are absolute, the trace path may be relative to the current
+ * directory.
+ *
+ * Args:
+ *   tracePath:    trace directory
+ *   syncPath:     directory where to create the links
+ *   streamIds:    uint64_t streamIds[], stream classes to keep
+ *   skipped:      set to true if a stream is left out
+ *
+ * Returns:
+ *   false if the links could not be created or no stream was kept
+ */
+static bool linkSyncStreams(const char* const tracePath, const char* const
+	syncPath, GArray* const streamIds, bool* const skipped)
+{
+	GDir* dir;
+	const char* entry;
+	unsigned int kept= 0;
+	bool result= true;
+	char* tracePathAbs;
+	char* source;
+	char* destination;
+
+	tracePathAbs= realpath(tracePath, NULL);
+	if (tracePathAbs == NULL)
+	{
+		g_warning("Cannot resolve %s: %s", tracePath, strerror(errno));
+		return false;
+	}
+
+	dir= g_dir_open(tracePathAbs, 0, NULL);
+	if (dir == NULL)
+	{
+		free(tracePathAbs);
+		return false;
+	}
+
+	while (result && (entry= g_dir_read_name(dir)) != NULL)
+	{
+		bool keep;
+		uint64_t streamId;
+
+		if (entry[0] == '.')
+		{
+			continue;
+		}
+
+		source= g_build_filename(tracePathAbs, entry, NULL);
+		if (!g_file_test(source, G_FILE_TEST_IS_REGULAR))
+		{
+			g_free(source);
+			continue;
+		}
+
+		if (strcmp(entry, "metadata") == 0)
+		{
+			keep= true;
+		}
+		else if (getStreamId(source, &streamId, NULL))
+		{
+			unsigned int i;
+
+			keep= false;
+			for (i= 0; i < streamIds->len; i++)
+			{
+				if (g_array_index(streamIds, uint64_t, i) == streamId)
+				{
+					keep= true;
+					kept++;
+					break;
+				}
+			}
+		}
+		else
+		{
+			// Empty streams hold no events, other layouts must be read
+			struct stat buf;
+
+			keep= g_stat(source, &buf) == 0 && buf.st_size > 0;
+			if (keep)
+			{
+				kept++;
+			}
+		}
+
+		if (keep)
+		{
+			destination= g_build_filename(syncPath, entry, NULL);
+			if (symlink(source, destination) != 0)
+			{
+				g_warning("Cannot link %s: %s", destination, strerror(errno));
+				result= false;
+			}
+			g_free(destination);
+		}
+		else
+		{
+			*skipped= true;
+		}
+		g_free(source);
+	}
+	g_dir_close(dir);
+	free(tracePathAbs);
+
+	return result && kept > 0;
+}
+
+
+/*
+ * Remove a directory of links created by linkSyncStreams()
+ *
+ * Args:
+ *   syncPath:     directory
+ */
+static void removeSyncDir(const char* const syncPath)
+{
+	GDir* dir;
+	const char* entry;
+
+	dir= g_dir_open(syncPath, 0, NULL);
+	if (dir != NULL)
+	{
+		while ((entry= g_dir_read_name(dir)) != NULL)
+		{
+			char* path= g_build_filename(syncPath, entry, NULL);
+
+			g_unlink(path);
+			g_free(path);
+		}
+		g_dir_close(dir);
+	}
+
+	g_rmdir(syncPath);
+}
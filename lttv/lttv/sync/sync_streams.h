@@ -0,0 +1,42 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNC_STREAMS_H
+#define SYNC_STREAMS_H
+
+#include <stdbool.h>
+
+#include <lttv/traceset.h>
+
+/* A sync traceset holds the same traces as the analyzed traceset, in the same
+ * order, but each trace is opened with only the streams whose stream class
+ * declares network events. The stream classes are found in the CTF metadata
+ * and the streams are told apart by the stream id of their first packet
+ * header. The other streams are never read by the synchronization pass.
+ *
+ * A sync traceset has its own babeltrace context, so the traces can also be
+ * opened one per traceset to be read from different threads.
+ */
+
+LttvTraceset* createSyncTraceset(LttvTraceset* const traceset, const unsigned
+	int first, const unsigned int count, bool (*isSyncEvent)(const char* const
+		name));
+void destroySyncTraceset(LttvTraceset* const syncTraceset);
+
+// Checksum of the uuid and of the stream sizes of a trace
+char* getTraceIdentity(const char* const tracePath);
+
+#endif
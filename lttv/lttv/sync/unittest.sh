@@ -0,0 +1,37 @@
+#!/bin/sh
+# Run the sync chain unittest on the test cases of testData. The unittest
+# aborts when a check fails.
+
+set -e
+
+srcdir=${srcdir:-.}
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+# Print the factors found by the unittest for a test case
+factors()
+{
+	./unittest -s "$@" | sed -n '/^Resulting synchronization factors:/,/^Synchronization time:/p'
+}
+
+for testCase in "$srcdir"/testData/test*.txt; do
+	./unittest "$testCase" > /dev/null
+
+	# The binary test case written from the messages of a text test case
+	# must give the same factors
+	./unittest --sync-dump-messages="$tmpdir/test.bin" "$testCase" > /dev/null
+	if [ "$(factors "$testCase")" != "$(factors "$tmpdir/test.bin")" ]; then
+		echo "$testCase: the binary test case gives other factors" >&2
+		exit 1
+	fi
+done
+
+# The binary test cases of testData are little endian
+if [ "$(printf '\001\000' | od -An -tu2 | tr -d ' ')" = 1 ]; then
+	for testCase in "$srcdir"/testData/test*.bin; do
+		./unittest -s "$testCase" | grep 'messages/s'
+	done
+fi
+
+# Drifting clocks, the piecewise correction is checked against the messages
+./unittest -S 10 "$srcdir/testData/test13.txt" > /dev/null
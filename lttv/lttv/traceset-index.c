@@ -0,0 +1,363 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <lttv/lttv.h>
+#include <lttv/attribute.h>
+#include <lttv/hook.h>
+#include <lttv/state.h>
+#include <lttv/traceset.h>
+#include <lttv/traceset-process.h>
+#include <lttv/traceset-index.h>
+#include <babeltrace/iterator.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
+
+typedef struct _LttvIndexEntry {
+	guint64 timestamp;	/* first event of this timestamp */
+	guint64 n;		/* its number in the traceset */
+} LttvIndexEntry;
+
+struct _LttvTracesetIndex {
+	guint interval;
+	GArray *entries;	/* LttvIndexEntry, sorted by number and time */
+	guint64 count;		/* number of events indexed */
+	guint64 last_timestamp;	/* timestamp of the last event indexed */
+	gboolean complete;
+	/* Background build, shared by all the users of the index */
+	LttvTraceset *traceset;	/* traceset being indexed */
+	guint nb_traces;	/* traces of the traceset when indexed */
+	guint source_id;	/* idle function building the index, or 0 */
+	LttvHooks *done_hooks;	/* called when the build completes */
+};
+
+LttvTracesetIndex *lttv_traceset_index_new(guint interval)
+{
+	LttvTracesetIndex *self = g_new(LttvTracesetIndex, 1);
+
+	self->interval = MAX(interval, 1);
+	self->entries = g_array_new(FALSE, FALSE, sizeof(LttvIndexEntry));
+	self->count = 0;
+	self->last_timestamp = 0;
+	self->complete = FALSE;
+	self->traceset = NULL;
+	self->nb_traces = 0;
+	self->source_id = 0;
+	self->done_hooks = lttv_hooks_new();
+	return self;
+}
+
+void lttv_traceset_index_destroy(LttvTracesetIndex *self)
+{
+	if(self->source_id != 0)
+		g_source_remove(self->source_id);
+	lttv_hooks_destroy(self->done_hooks);
+	g_array_free(self->entries, TRUE);
+	g_free(self);
+}
+
+void lttv_traceset_index_clear(LttvTracesetIndex *self)
+{
+	g_array_set_size(self->entries, 0);
+	self->count = 0;
+	self->last_timestamp = 0;
+	self->complete = FALSE;
+}
+
+LttvTracesetIndex *lttv_traceset_index_get_from_traceset(
+		LttvTraceset *traceset)
+{
+	LttvAttributeValue value;
+	LttvTracesetIndex *self;
+	gboolean retval;
+
+	retval = lttv_attribute_find(lttv_traceset_attribute(traceset),
+			g_quark_from_static_string("traceset_index"),
+			LTTV_POINTER, &value);
+	g_assert(retval);
+	self = (LttvTracesetIndex *)*(value.v_pointer);
+	if(self == NULL) {
+		self = lttv_traceset_index_new(LTTV_TRACESET_INDEX_INTERVAL);
+		*(value.v_pointer) = self;
+	}
+	return self;
+}
+
+void lttv_traceset_index_destroy_from_traceset(LttvTraceset *traceset)
+{
+	LttvAttributeValue value;
+	LttvAttributeType type;
+
+	type = lttv_attribute_get_by_name(lttv_traceset_attribute(traceset),
+			g_quark_from_static_string("traceset_index"), &value);
+	if(type == LTTV_POINTER && *(value.v_pointer) != NULL) {
+		lttv_traceset_index_destroy(
+				(LttvTracesetIndex *)*(value.v_pointer));
+		*(value.v_pointer) = NULL;
+	}
+}
+
+gboolean lttv_traceset_index_build(LttvTracesetIndex *self,
+		LttvTraceset *traceset, guint nb_events)
+{
+	LttvTracesetPosition *saved_pos;
+	LttvIndexEntry entry, *last = NULL;
+	struct bt_iter_pos begin_pos;
+	struct bt_ctf_event *event;
+	guint64 n, timestamp;
+	guint nb_read = 0;
+
+	if(self->complete)
+		return TRUE;
+
+	saved_pos = lttv_traceset_create_current_position(traceset);
+
+	/* Resume at the last entry, skipping the events already indexed */
+	if(self->entries->len > 0) {
+		last = &g_array_index(self->entries, LttvIndexEntry,
+				self->entries->len - 1);
+		lttv_process_traceset_seek_time(traceset,
+				ltt_time_from_uint64(last->timestamp));
+		n = last->n;
+	} else {
+		begin_pos.type = BT_SEEK_BEGIN;
+		bt_iter_set_pos(bt_ctf_get_iter(traceset->iter), &begin_pos);
+		n = 0;
+	}
+
+	while(TRUE) {
+		event = bt_ctf_iter_read_event(traceset->iter);
+		if(event == NULL) {
+			self->complete = TRUE;
+			break;
+		}
+		if(n >= self->count) {
+			if(nb_read == nb_events)
+				break;
+			timestamp = bt_ctf_get_timestamp(event);
+			if(last == NULL || (n >= last->n + self->interval
+					&& timestamp != self->last_timestamp)) {
+				entry.timestamp = timestamp;
+				entry.n = n;
+				g_array_append_val(self->entries, entry);
+				last = &g_array_index(self->entries, LttvIndexEntry,
+						self->entries->len - 1);
+			}
+			self->last_timestamp = timestamp;
+			self->count++;
+			nb_read++;
+		}
+		n++;
+		if(bt_iter_next(bt_ctf_get_iter(traceset->iter)) < 0) {
+			self->complete = TRUE;
+			break;
+		}
+	}
+
+	lttv_traceset_seek_to_position(saved_pos);
+	lttv_traceset_destroy_position(saved_pos);
+	return self->complete;
+}
+
+static gboolean build_idle(gpointer data)
+{
+	LttvTracesetIndex *self = (LttvTracesetIndex *)data;
+
+	if(!lttv_traceset_index_build(self, self->traceset,
+				LTTV_TRACESET_INDEX_CHUNK))
+		return TRUE;
+
+	self->source_id = 0;
+	lttv_hooks_call(self->done_hooks, self);
+	return FALSE;
+}
+
+void lttv_traceset_index_start(LttvTracesetIndex *self,
+		LttvTraceset *traceset)
+{
+	guint nb_traces = lttv_traceset_number(traceset);
+
+	/* The entries of other traces are of no use */
+	if(self->traceset != traceset || self->nb_traces != nb_traces) {
+		if(self->source_id != 0) {
+			g_source_remove(self->source_id);
+			self->source_id = 0;
+		}
+		lttv_traceset_index_clear(self);
+		self->traceset = traceset;
+		self->nb_traces = nb_traces;
+	}
+
+	if(self->complete || self->source_id != 0)
+		return;
+
+	self->source_id = g_idle_add_full(G_PRIORITY_LOW, build_idle, self,
+			NULL);
+}
+
+LttvHooks *lttv_traceset_index_get_done_hooks(LttvTracesetIndex *self)
+{
+	return self->done_hooks;
+}
+
+gboolean lttv_traceset_index_is_complete(const LttvTracesetIndex *self)
+{
+	return self->complete;
+}
+
+void lttv_traceset_index_grow(LttvTracesetIndex *self)
+{
+	self->complete = FALSE;
+}
+
+guint64 lttv_traceset_index_get_count(const LttvTracesetIndex *self)
+{
+	return self->count;
+}
+
+/* Last entry whose number is at most n */
+static LttvIndexEntry *find_entry_by_number(LttvTracesetIndex *self,
+		guint64 n)
+{
+	guint min = 0, max = self->entries->len, mid;
+
+	while(max - min > 1) {
+		mid = (min + max) / 2;
+		if(g_array_index(self->entries, LttvIndexEntry, mid).n <= n)
+			min = mid;
+		else
+			max = mid;
+	}
+	return &g_array_index(self->entries, LttvIndexEntry, min);
+}
+
+/* Last entry whose timestamp is at most t, NULL if there is none */
+static LttvIndexEntry *find_entry_by_time(LttvTracesetIndex *self,
+		guint64 t)
+{
+	guint min = 0, max = self->entries->len, mid;
+
+	if(self->entries->len == 0
+			|| g_array_index(self->entries, LttvIndexEntry, 0).timestamp > t)
+		return NULL;
+
+	while(max - min > 1) {
+		mid = (min + max) / 2;
+		if(g_array_index(self->entries, LttvIndexEntry, mid).timestamp <= t)
+			min = mid;
+		else
+			max = mid;
+	}
+	return &g_array_index(self->entries, LttvIndexEntry, min);
+}
+
+gboolean lttv_traceset_index_seek_n(LttvTracesetIndex *self,
+		LttvTraceset *traceset, guint64 n)
+{
+	LttvIndexEntry *entry;
+	guint64 i;
+
+	if(n >= self->count)
+		return FALSE;
+
+	entry = find_entry_by_number(self, n);
+	lttv_state_traceset_seek_time(traceset,
+			ltt_time_from_uint64(entry->timestamp));
+
+	for(i = entry->n; i < n; i++) {
+		if(bt_iter_next(bt_ctf_get_iter(traceset->iter)) < 0)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Number of events of timestamp t on the cpu from the current position on */
+static guint count_same_events(LttvTraceset *traceset, guint64 t, guint cpu)
+{
+	struct bt_ctf_event *event;
+	LttvEvent lttv_event;
+	guint count = 0;
+
+	while((event = bt_ctf_iter_read_event(traceset->iter)) != NULL) {
+		if(bt_ctf_get_timestamp(event) > t)
+			break;
+		lttv_event.bt_event = event;
+		if(lttv_traceset_get_cpuid_from_event(&lttv_event) == cpu)
+			count++;
+		if(bt_iter_next(bt_ctf_get_iter(traceset->iter)) < 0)
+			break;
+	}
+	return count;
+}
+
+gboolean lttv_traceset_index_get_number(LttvTracesetIndex *self,
+		LttvTraceset *traceset, const LttvTracesetPosition *pos,
+		guint64 *n)
+{
+	LttvIndexEntry *entry;
+	struct bt_ctf_event *event;
+	LttvEvent lttv_event;
+	GArray *candidates;
+	guint64 t, timestamp, i;
+	guint cpu, remaining;
+	gboolean found = FALSE;
+
+	t = lttv_traceset_position_get_timestamp(pos);
+	cpu = lttv_traceset_position_get_cpuid(pos);
+
+	entry = find_entry_by_time(self, t);
+	if(entry == NULL)
+		return FALSE;
+
+	/* Several events of a stream may have the same timestamp, they are
+	   told apart by their order in the stream : the events of that
+	   timestamp and cpu from the position on give its rank among them */
+	lttv_traceset_seek_to_position(pos);
+	remaining = count_same_events(traceset, t, cpu);
+	if(remaining == 0)
+		return FALSE;
+
+	candidates = g_array_new(FALSE, FALSE, sizeof(guint64));
+	lttv_process_traceset_seek_time(traceset,
+			ltt_time_from_uint64(entry->timestamp));
+	for(i = entry->n; i < self->count; i++) {
+		event = bt_ctf_iter_read_event(traceset->iter);
+		if(event == NULL)
+			break;
+		timestamp = bt_ctf_get_timestamp(event);
+		if(timestamp > t)
+			break;
+		if(timestamp == t) {
+			lttv_event.bt_event = event;
+			if(lttv_traceset_get_cpuid_from_event(&lttv_event) == cpu)
+				g_array_append_val(candidates, i);
+		}
+		if(bt_iter_next(bt_ctf_get_iter(traceset->iter)) < 0)
+			break;
+	}
+
+	if(candidates->len >= remaining) {
+		*n = g_array_index(candidates, guint64,
+				candidates->len - remaining);
+		found = TRUE;
+	}
+	g_array_free(candidates, TRUE);
+	return found;
+}
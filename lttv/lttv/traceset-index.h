@@ -0,0 +1,96 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef TRACESET_INDEX_H
+#define TRACESET_INDEX_H
+
+#include <glib.h>
+#include <lttv/hook.h>
+#include <lttv/traceset.h>
+
+/* The traceset index maps event numbers to positions in the traceset, so
+   seeking to the nth event costs one binary search and a few reads instead
+   of guessing a time and reading until enough events are seen.
+
+   An entry is kept about every interval events. Each entry is the first
+   event of its timestamp, so seeking at the entry time always lands on the
+   entry itself and the entries need no babeltrace position.
+
+   The index is built incrementally, a chunk of events at a time, so it may
+   be extended from an idle function. Building the index reads the events
+   without calling the hooks and restores the traceset position. */
+
+/* Default number of events between entries */
+#define LTTV_TRACESET_INDEX_INTERVAL 1024
+
+/* Number of events indexed by each call of the background build */
+#define LTTV_TRACESET_INDEX_CHUNK 50000
+
+typedef struct _LttvTracesetIndex LttvTracesetIndex;
+
+LttvTracesetIndex *lttv_traceset_index_new(guint interval);
+
+void lttv_traceset_index_destroy(LttvTracesetIndex *self);
+
+/* Forget all the entries, e.g. when the traceset changes */
+void lttv_traceset_index_clear(LttvTracesetIndex *self);
+
+/* The index of a traceset, kept in the traceset attributes and created on
+   first use. */
+LttvTracesetIndex *lttv_traceset_index_get_from_traceset(
+		LttvTraceset *traceset);
+
+/* Destroy the index of a traceset, if it has one */
+void lttv_traceset_index_destroy_from_traceset(LttvTraceset *traceset);
+
+/* Index at most nb_events more events. Returns TRUE when the end of the
+   traceset is reached. */
+gboolean lttv_traceset_index_build(LttvTracesetIndex *self,
+		LttvTraceset *traceset, guint nb_events);
+
+/* Build the index in the background, from an idle function of the main
+   loop. The index of a traceset is shared by its viewers and built once:
+   starting a build that runs or is complete does nothing. The entries are
+   dropped if the traces of the traceset changed since they were indexed. */
+void lttv_traceset_index_start(LttvTracesetIndex *self,
+		LttvTraceset *traceset);
+
+/* Hooks called, with the index as call data, when a background build
+   completes */
+LttvHooks *lttv_traceset_index_get_done_hooks(LttvTracesetIndex *self);
+
+/* TRUE if all the events of the traceset are indexed */
+gboolean lttv_traceset_index_is_complete(const LttvTracesetIndex *self);
+
+/* The traceset grew (live trace) : index the new events on the next build */
+void lttv_traceset_index_grow(LttvTracesetIndex *self);
+
+/* Number of events indexed so far */
+guint64 lttv_traceset_index_get_count(const LttvTracesetIndex *self);
+
+/* Seek the traceset to the event number n, the state being restored at the
+   closest entry. Returns FALSE if n is past the indexed events. */
+gboolean lttv_traceset_index_seek_n(LttvTracesetIndex *self,
+		LttvTraceset *traceset, guint64 n);
+
+/* Number of the event at position pos. Returns FALSE if the position is
+   past the indexed events. Moves the traceset position. */
+gboolean lttv_traceset_index_get_number(LttvTracesetIndex *self,
+		LttvTraceset *traceset, const LttvTracesetPosition *pos,
+		guint64 *n);
+
+#endif // TRACESET_INDEX_H
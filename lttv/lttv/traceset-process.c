@@ -20,8 +20,10 @@
 #include <config.h>
 #endif
 
+#include <string.h>
 #include <lttv/traceset-process.h>
 #include <lttv/traceset.h>
+#include <lttv/traceset-index.h>
 #include <lttv/event.h>
 #include <babeltrace/context.h>
 #include <babeltrace/iterator.h>
@@ -78,7 +80,24 @@ guint lttv_process_traceset_middle(LttvTraceset *traceset,
 
 		if((bt_event = bt_ctf_iter_read_event(traceset->iter)) != NULL) {
 
-			LttTime time = ltt_time_from_uint64(bt_ctf_get_timestamp(bt_event));
+			guint64 timestamp = bt_ctf_get_timestamp(bt_event);
+			LttTime time = ltt_time_from_uint64(timestamp);
+
+			/* Retrieve the associated state */
+			event.state = g_ptr_array_index(traceset->state_trace_handle_index,
+							bt_ctf_event_get_handle_id(bt_event));
+
+			/* The synchronization correction is applied once here, the
+			   hooks read the cached timestamp. The iterator merges the
+			   traces on their raw time, like the positions and the seeks,
+			   so end is a raw time too. */
+			if(event.state != NULL) {
+				event.timestamp = lttv_trace_correct_time(
+						event.state->trace, timestamp);
+			} else {
+				event.timestamp = timestamp;
+			}
+
 			if(ltt_time_compare(end, time) <= 0) {
 				break;
 			}
@@ -88,12 +107,15 @@ guint lttv_process_traceset_middle(LttvTraceset *traceset,
 			}
 			count++;
 
+			if(timestamp == traceset->last_timestamp) {
+				traceset->last_timestamp_count++;
+			} else {
+				traceset->last_timestamp = timestamp;
+				traceset->last_timestamp_count = 1;
+			}
+
 			event.bt_event = bt_event;
 
-			/* Retrieve the associated state */
-			event.state = g_ptr_array_index(traceset->state_trace_handle_index,
-							bt_ctf_event_get_handle_id(bt_event));
-			
 			last_ret = lttv_hooks_call(traceset->event_hooks, &event);
 
 			if(bt_iter_next(bt_ctf_get_iter(traceset->iter)) < 0) {
@@ -110,6 +132,252 @@ guint lttv_process_traceset_middle(LttvTraceset *traceset,
 	return count;
 }
 
+#define CTF_INDEX_MAGIC 0xC1F1DCC1
+
+/* Packet index written by LTTng in the index directory of a trace, all the
+   fields are big endian. An entry is packet_index_len bytes long, later
+   index versions append fields. */
+typedef struct {
+	guint32 magic;
+	guint32 index_major;
+	guint32 index_minor;
+	guint32 packet_index_len;
+} __attribute__((__packed__)) LiveIndexHeader;
+
+typedef struct {
+	guint64 offset;
+	guint64 packet_size;
+	guint64 content_size;
+	guint64 timestamp_begin;	/* in cycles */
+	guint64 timestamp_end;
+	guint64 events_discarded;
+	guint64 stream_id;
+} __attribute__((__packed__)) LiveIndexEntry;
+
+/* End of the last packet in the index of a stream, in cycles. Returns FALSE
+   if the stream has no index. */
+static gboolean get_stream_end(const char *trace_path, const char *name,
+		guint64 *end)
+{
+	char *index_name, *index_path;
+	gchar *data;
+	gsize len, entry_len;
+	const LiveIndexHeader *header;
+	LiveIndexEntry entry;
+	gboolean ret;
+
+	index_name = g_strconcat(name, ".idx", NULL);
+	index_path = g_build_filename(trace_path, "index", index_name, NULL);
+	ret = g_file_get_contents(index_path, &data, &len, NULL);
+	g_free(index_path);
+	g_free(index_name);
+	if(!ret) {
+		return FALSE;
+	}
+
+	header = (const LiveIndexHeader *)data;
+	entry_len = len >= sizeof(*header) ?
+		GUINT32_FROM_BE(header->packet_index_len) : 0;
+	*end = 0;
+	if(entry_len >= sizeof(entry) &&
+			GUINT32_FROM_BE(header->magic) == CTF_INDEX_MAGIC &&
+			len >= sizeof(*header) + entry_len) {
+		/* A packet being written may leave a partial entry */
+		gsize last = sizeof(*header) +
+			(len - sizeof(*header)) / entry_len * entry_len - entry_len;
+
+		memcpy(&entry, data + last, sizeof(entry));
+		*end = GUINT64_FROM_BE(entry.timestamp_end);
+	}
+	g_free(data);
+	return TRUE;
+}
+
+/*
+ * lttv_process_traceset_get_complete_time : time before which every stream of
+ * the traceset has written all its events.
+ *
+ * The streams of a live trace are written packet by packet, each at its own
+ * pace: a cpu may flush its packets long after the others. The events of the
+ * traceset are read in time order, so an event read before the packets of a
+ * late stream are written is followed by older events from that stream. The
+ * complete time is the end of the last packet of the late stream, found in
+ * the packet index that LTTng writes for each stream. A stream that has not
+ * written any packet yet holds it at zero. The cycles of the index are
+ * converted with the first and last events of the trace, as the index has no
+ * clock.
+ *
+ * Streams without an index are not taken into account, and
+ * ltt_time_infinite is returned if no stream has one.
+ */
+LttTime lttv_process_traceset_get_complete_time(LttvTraceset *traceset)
+{
+	guint i, nb_trace;
+	guint64 complete = G_MAXUINT64;
+
+	nb_trace = lttv_traceset_number(traceset);
+	for(i = 0; i < nb_trace; i++) {
+		LttvTrace *trace = lttv_traceset_get(traceset, i);
+		struct bt_context *context = lttv_traceset_get_context(traceset);
+		guint64 cycles_begin, cycles_end, ns_begin, ns_end;
+		GDir *dir;
+		const char *name;
+
+		cycles_begin = bt_trace_handle_get_timestamp_begin(context,
+				trace->id, BT_CLOCK_CYCLES);
+		cycles_end = bt_trace_handle_get_timestamp_end(context,
+				trace->id, BT_CLOCK_CYCLES);
+		ns_begin = bt_trace_handle_get_timestamp_begin(context,
+				trace->id, BT_CLOCK_REAL);
+		ns_end = bt_trace_handle_get_timestamp_end(context,
+				trace->id, BT_CLOCK_REAL);
+
+		dir = g_dir_open(trace->full_path, 0, NULL);
+		if(dir == NULL) {
+			continue;
+		}
+		while((name = g_dir_read_name(dir)) != NULL) {
+			guint64 cycles, ns;
+
+			if(name[0] == '.' || strcmp(name, "metadata") == 0) {
+				continue;
+			}
+			if(!get_stream_end(trace->full_path, name, &cycles)) {
+				continue;
+			}
+			if(cycles == 0) {
+				ns = 0;
+			} else if(cycles_end > cycles_begin) {
+				ns = ns_begin + (gint64)((double)(gint64)(cycles -
+						cycles_begin) * (ns_end - ns_begin) /
+						(cycles_end - cycles_begin));
+			} else {
+				ns = ns_begin + (cycles - cycles_begin);
+			}
+			complete = MIN(complete, ns);
+		}
+		g_dir_close(dir);
+	}
+
+	if(complete == G_MAXUINT64) {
+		return ltt_time_infinite;
+	}
+	return ltt_time_from_uint64(complete);
+}
+
+/*
+ * lttv_process_traceset_update : reopen the traces of a traceset that are
+ * still being written, to read the packets added since they were opened.
+ *
+ * babeltrace indexes the packets of a stream when the trace is opened, so the
+ * traces are added to a new context. The LttvTrace objects and their states
+ * are kept, only the handle ids change. The iterator is placed right after
+ * the last event read by lttv_process_traceset_middle: it seeks to the time
+ * of that event and skips the events of that time already processed.
+ * Positions taken before the update refer to the old iterator and must not
+ * be used anymore.
+ *
+ * The events older than the last event read are skipped, even if their
+ * packets were written after it. The events must thus only be read up to
+ * lttv_process_traceset_get_complete_time between the updates, as
+ * batchAnalysis does, or the late packets of some streams are lost.
+ *
+ * Each update reopens every trace of the traceset, whether it was written
+ * or not, and costs as much as opening them: babeltrace 1.x cannot index
+ * only the packets added to a stream, so it reads the header of every packet
+ * again. Callers should update only when the complete time has moved. The
+ * GUI does not use it, its live update is still disabled with the rest of
+ * the pre-babeltrace code.
+ *
+ * Returns the number of traces whose end time has grown.
+ */
+guint lttv_process_traceset_update(LttvTraceset *traceset)
+{
+	struct bt_context *context;
+	struct bt_iter_pos begin_pos;
+	struct bt_ctf_event *bt_event;
+	guint i, nb_trace, updated_count = 0;
+	guint64 *previous_end;
+	int *ids;
+
+	nb_trace = lttv_traceset_number(traceset);
+	context = bt_context_create();
+	ids = g_new(int, nb_trace);
+	for(i = 0; i < nb_trace; i++) {
+		LttvTrace *trace = lttv_traceset_get(traceset, i);
+
+		ids[i] = bt_context_add_trace(context, trace->full_path, "ctf",
+				NULL, NULL, NULL);
+		if(ids[i] < 0) {
+			g_warning("Cannot reopen trace %s", trace->full_path);
+			g_free(ids);
+			bt_context_put(context);
+			return 0;
+		}
+	}
+
+	previous_end = g_new(guint64, nb_trace);
+	for(i = 0; i < nb_trace; i++) {
+		LttvTrace *trace = lttv_traceset_get(traceset, i);
+
+		previous_end[i] = bt_trace_handle_get_timestamp_end(traceset->context,
+				trace->id, BT_CLOCK_REAL);
+	}
+
+	if(traceset->iter) {
+		bt_ctf_iter_destroy(traceset->iter);
+	}
+	bt_context_put(traceset->context);
+	traceset->context = context;
+
+	g_ptr_array_set_size(traceset->state_trace_handle_index, 0);
+	for(i = 0; i < nb_trace; i++) {
+		LttvTrace *trace = lttv_traceset_get(traceset, i);
+
+		trace->id = ids[i];
+		g_ptr_array_set_size(traceset->state_trace_handle_index,
+				MAX(traceset->state_trace_handle_index->len, ids[i] + 1));
+		g_ptr_array_index(traceset->state_trace_handle_index, ids[i]) =
+			trace->state;
+		/* The layouts are keyed by event declaration, which belong to the
+		   old context */
+		if(trace->print_layouts != NULL) {
+			g_hash_table_remove_all(trace->print_layouts);
+		}
+
+		if(bt_trace_handle_get_timestamp_end(context, ids[i],
+					BT_CLOCK_REAL) > previous_end[i]) {
+			updated_count++;
+		}
+	}
+	g_free(previous_end);
+	g_free(ids);
+
+	begin_pos.type = BT_SEEK_BEGIN;
+	traceset->iter = bt_ctf_iter_create(context, &begin_pos, NULL);
+	traceset->time_span.end_time = ltt_time_from_uint64(
+			lttv_traceset_get_timestamp_last_event(traceset));
+
+	/* Resume after the last event read, skipping the events that share its
+	   timestamp and were already processed */
+	if(traceset->last_timestamp_count > 0) {
+		lttv_process_traceset_seek_time(traceset,
+				ltt_time_from_uint64(traceset->last_timestamp));
+		for(i = 0; i < traceset->last_timestamp_count; i++) {
+			bt_event = bt_ctf_iter_read_event(traceset->iter);
+			if(bt_event == NULL || bt_ctf_get_timestamp(bt_event) !=
+					traceset->last_timestamp) {
+				break;
+			}
+			if(bt_iter_next(bt_ctf_get_iter(traceset->iter)) < 0) {
+				break;
+			}
+		}
+	}
+
+	return updated_count;
+}
+
 void lttv_process_traceset_end(LttvTraceset *traceset,
 			       LttvHooks *after_traceset,
 			       LttvHooks *after_trace,	
@@ -240,6 +508,8 @@ guint lttv_process_traceset_seek_n_backward(LttvTraceset *ts,
         gint extraEvent = 0;
         guint64 initialTimeStamp, previousTimeStamp;
         LttvTracesetPosition *initialPos, *previousPos, *currentPos, beginPos;
+        LttvTracesetIndex *index;
+        guint64 number;
         struct bt_iter_pos pos;
         beginPos.bt_pos = &pos;
         beginPos.iter = ts->iter;
@@ -248,6 +518,16 @@ guint lttv_process_traceset_seek_n_backward(LttvTraceset *ts,
         beginPos.cpu_id = INT_MAX;
         /*Save initial position of the traceset*/
         initialPos = lttv_traceset_create_current_position (ts);
+
+        /* Use the event index when it covers the initial position */
+        index = lttv_traceset_index_get_from_traceset(ts);
+        if(lttv_traceset_index_get_number(index, ts, initialPos, &number)) {
+                lttv_traceset_index_seek_n(index, ts,
+                                number > n ? number - n : 0);
+                lttv_traceset_destroy_position(initialPos);
+                return 0;
+        }
+        lttv_traceset_seek_to_position(initialPos);
         
         /*Get the timespan of the initial position*/
         initialTimeStamp = lttv_traceset_position_get_timestamp(initialPos);
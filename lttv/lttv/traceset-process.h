@@ -37,7 +37,8 @@ void lttv_process_traceset(LttvTraceset *traceset, LttTime end,
 /* Process traceset can also be done in smaller pieces calling begin,
  * then seek and middle repeatedly, and end. The middle function return the
  * number of events processed. It will be smaller than nb_events if the end time
- * or end position is reached. */
+ * or end position is reached. The end time is compared with the raw,
+ * uncorrected, time of the events. */
 
 
 void lttv_process_traceset_begin(LttvTraceset *traceset,
@@ -55,6 +56,8 @@ void lttv_process_traceset_end(LttvTraceset *traceset,
 		LttvHooks *after_trace,
 		LttvHooks *event);
 
+LttTime lttv_process_traceset_get_complete_time(LttvTraceset *traceset);
+
 guint lttv_process_traceset_update(LttvTraceset *traceset);
 
 
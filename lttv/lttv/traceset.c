@@ -23,6 +23,8 @@
 #include <lttv/traceset.h>
 #include <lttv/iattribute.h>
 #include <lttv/state.h>
+#include <lttv/state-intervals.h>
+#include <lttv/traceset-index.h>
 #include <lttv/event.h>
 #include <lttv/hook.h>
 #include <stdio.h>
@@ -67,6 +69,8 @@ LttvTraceset *lttv_traceset_new(void)
 
 	ts->state_trace_handle_index = g_ptr_array_new();
 	ts->has_precomputed_states = FALSE;
+	ts->last_timestamp = 0;
+	ts->last_timestamp_count = 0;
 
 	ts->time_span.start_time = ltt_time_zero;
         ts->time_span.end_time = ltt_time_zero;
@@ -148,6 +152,10 @@ static LttvTrace *lttv_trace_create(LttvTraceset *ts, const char *path)
 	new_trace->ref_count = 0;
 	new_trace->short_name[0] = '\0';
 	new_trace->traceset = ts;
+	new_trace->sync_segments = NULL;
+	lttv_trace_set_sync_factors(new_trace, 1., 0.);
+	new_trace->print_layouts = NULL;
+	new_trace->sync_segment_hint = 0;
 	new_trace->state = g_new(LttvTraceState,1);
 	lttv_trace_state_init(new_trace->state,new_trace);
 
@@ -226,6 +234,8 @@ LttvTraceset *lttv_traceset_copy(LttvTraceset *s_orig)
 	s->context = s_orig->context;
 	bt_context_get(s->context);
 	s->a = LTTV_ATTRIBUTE(lttv_iattribute_deep_copy(LTTV_IATTRIBUTE(s_orig->a)));
+	s->last_timestamp = 0;
+	s->last_timestamp_count = 0;
 	return s;
 }
 
@@ -271,6 +281,8 @@ void lttv_traceset_destroy(LttvTraceset *s)
 	free(s->common_path);
 	g_ptr_array_free(s->traces, TRUE);
 	bt_context_put(s->context);
+	lttv_state_intervals_destroy_from_traceset(s);
+	lttv_traceset_index_destroy_from_traceset(s);
 	g_object_unref(s->a);
 	g_free(s);
 }
@@ -292,6 +304,10 @@ LttvHooks *lttv_traceset_get_hooks(LttvTraceset *s)
 
 void lttv_trace_destroy(LttvTrace *t) 
 {
+	if (t->sync_segments != NULL)
+		g_array_free(t->sync_segments, TRUE);
+	if (t->print_layouts != NULL)
+		g_hash_table_destroy(t->print_layouts);
 	free(t->full_path);
 	g_object_unref(t->a);
 	g_free(t);
@@ -405,6 +421,35 @@ LttvTrace *lttv_traceset_get(LttvTraceset *s, unsigned i)
 	return ((LttvTrace *)s->traces->pdata[i]);
 }
 
+void lttv_trace_set_sync_factors(LttvTrace *t, double drift, double offset)
+{
+	t->drift = drift;
+	t->offset = offset;
+	lttv_sync_fixed_init(&t->sync_fixed, 0, drift, offset);
+}
+
+void lttv_trace_set_sync_segments(LttvTrace *t, GArray *segments)
+{
+	if (t->sync_segments != NULL)
+		g_array_free(t->sync_segments, TRUE);
+	t->sync_segments = segments;
+	t->sync_segment_hint = 0;
+
+	if (segments != NULL)
+		lttv_sync_segments_init(segments);
+}
+
+guint64 lttv_trace_correct_time(LttvTrace *t, guint64 time)
+{
+	if (t->sync_segments == NULL) {
+		if (t->sync_fixed.mult == 0 && t->sync_fixed.offset == 0)
+			return time;
+		return lttv_sync_fixed_apply(&t->sync_fixed, time);
+	}
+	return lttv_sync_segments_apply(t->sync_segments,
+		&t->sync_segment_hint, time);
+}
+
 
 void lttv_traceset_remove(LttvTraceset *s, unsigned i) 
 {
@@ -24,6 +24,7 @@
 #include <lttv/event.h>
 #include <lttv/time.h>
 #include <lttv/trace.h>
+#include <lttv/sync-correction.h>
 
 /* A traceset is a set of traces to be analyzed together. */
 
@@ -46,6 +47,11 @@ struct _LttvTraceset {
 	gboolean has_precomputed_states;
 	TimeInterval time_span;
 	char *common_path;
+	/* Raw timestamp of the last event read by lttv_process_traceset_middle
+	   and number of events read with that timestamp, to resume there when
+	   the traces are reopened */
+	guint64 last_timestamp;
+	guint last_timestamp_count;
 };
 
 #define TRACE_NAME_SIZE 100
@@ -59,6 +65,19 @@ struct _LttvTrace {
 	LttvTraceState *state;
 	char short_name[TRACE_NAME_SIZE];
 	char *full_path;
+	/* Synchronization factors, the corrected time is drift * t + offset
+	   in nanoseconds. 1 and 0 when the traceset is not synchronized. Set
+	   with lttv_trace_set_sync_factors, which also computes sync_fixed. */
+	double drift;
+	double offset;
+	LttvTraceSyncFixed sync_fixed;
+	/* Piecewise correction, used instead of drift and offset when it is not
+	   NULL. Array of LttvTraceSyncSegment sorted by start. */
+	GArray *sync_segments;
+	guint sync_segment_hint;	/* index of the last segment used */
+	/* Field layouts of the event classes, indexed by struct
+	   bt_ctf_event_decl*. Built by print.c as events are printed. */
+	GHashTable *print_layouts;
 };
 
 /* In babeltrace, the position concept is an iterator. */
@@ -114,6 +133,17 @@ unsigned lttv_traceset_number(LttvTraceset *s);
 
 LttvTrace *lttv_traceset_get(LttvTraceset *s, unsigned i);
 
+/* Set the linear synchronization correction of a trace */
+void lttv_trace_set_sync_factors(LttvTrace *t, double drift, double offset);
+
+/* Replace the synchronization correction of a trace by a piecewise one. The
+   trace takes ownership of segments, NULL goes back to drift and offset. */
+void lttv_trace_set_sync_segments(LttvTrace *t, GArray *segments);
+
+/* Apply the synchronization correction of a trace to a time in ns. The event
+   loop applies it once per event, see LttvEvent. */
+guint64 lttv_trace_correct_time(LttvTrace *t, guint64 time);
+
 void lttv_traceset_remove(LttvTraceset *s, unsigned i);
 
 int lttv_traceset_get_trace_index_from_event(LttvEvent *event);
@@ -137,6 +167,8 @@ guint lttv_traceset_get_cpuid_from_event(LttvEvent *event);
 guint64 lttv_traceset_get_timestamp_begin(LttvTraceset *traceset);
 /* Returns the maximum timestamp of the traces in the traceset */
 guint64 lttv_traceset_get_timestamp_end(LttvTraceset *traceset);
+/* Returns the timestamp of the last event of the traceset */
+guint64 lttv_traceset_get_timestamp_last_event(LttvTraceset *ts);
 /* Return a TimeInterval from timestamp of the first event to the last event [experimentale]*/
 TimeInterval lttv_traceset_get_time_span_real(LttvTraceset *ts);
 /* Returns a TimeInterval struct that represents the min and max of the traceset */
@@ -148,6 +180,8 @@ LttvTracesetPosition *lttv_traceset_create_time_position(LttvTraceset *ts, LttTi
 
 guint64 lttv_traceset_position_get_timestamp(const LttvTracesetPosition *pos);
 
+int lttv_traceset_position_get_cpuid(const LttvTracesetPosition *pos);
+
 LttTime  lttv_traceset_position_get_time(const LttvTracesetPosition *pos);
 
 LttTime lttv_traceset_get_current_time(const LttvTraceset *ts);
@@ -27,6 +27,7 @@
 #include <lttv/lttv.h>
 #include <lttvwindow/lttvwindow.h>
 #include <lttv/state.h>
+#include <lttv/state-intervals.h>
 #include <lttv/hook.h>
 
 #include "drawing.h"
@@ -594,6 +595,31 @@ tree_row_activated(GtkTreeModel *treemodel,
 }
 #endif //0
 
+/* Time of the next state change of the process at height y after time, or
+ * of the previous one before it. Returns FALSE if it is not known. */
+static gboolean
+find_state_change(ControlFlowData *control_flow_data, guint y,
+                  gboolean previous, LttTime *time)
+{
+  LttvStateIntervals *intervals;
+  GArray *history;
+  guint pid, cpu, trace_num;
+
+  if(!processlist_get_process_at(control_flow_data->process_list, y,
+                                 &pid, &cpu, &trace_num))
+    return FALSE;
+
+  intervals = lttv_state_intervals_get_from_traceset(
+      lttvwindow_get_traceset(control_flow_data->tab));
+  history = lttv_state_intervals_get_history(intervals,
+      LTTV_RESOURCE_PROCESS, trace_num, pid, cpu);
+
+  if(previous)
+    return lttv_state_intervals_previous_change(history, *time, time);
+  else
+    return lttv_state_intervals_next_change(history, *time, time);
+}
+
 /* mouse click */
 static gboolean
 button_press_event( GtkWidget *widget, GdkEventButton *event, gpointer user_data )
@@ -618,6 +644,13 @@ button_press_event( GtkWidget *widget, GdkEventButton *event, gpointer user_data
         time_window,
         &time);
 
+    /* Shift-click : go to the next state change of the process, or to the
+     * previous one with control */
+    if(event->state & GDK_SHIFT_MASK
+        && !find_state_change(control_flow_data, (guint)event->y,
+                              event->state & GDK_CONTROL_MASK, &time))
+      return FALSE;
+
     lttvwindow_report_current_time(control_flow_data->tab, time);
 
   }
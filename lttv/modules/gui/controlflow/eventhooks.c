@@ -358,7 +358,8 @@ void draw_state_line(HashedProcessData *hashed_process_data,
 
 	/* Draw the line */
 	PropertiesLine prop_line = prepare_s_e_line(process);
-	draw_line((void*)&prop_line, (void*)&draw_context);
+	processlist_draw_line(drawing->control_flow_data->process_list,
+			hashed_process_data, &prop_line, &draw_context);
 		
 	/* become the last x position */
 	hashed_process_data->x.middle = x;
@@ -400,9 +401,10 @@ void draw_state_items(ControlFlowData *control_flow_data,
                 &x);
 
       /* Draw collision indicator */
-      gdk_gc_set_foreground(drawing->gc, &drawing_colors[COL_WHITE]);
-      gdk_draw_point(hashed_process_data->pixmap,
+      processlist_draw_point(control_flow_data->process_list,
+                     hashed_process_data,
                      drawing->gc,
+                     &drawing_colors[COL_WHITE],
                      x,
                      COLLISION_POSITION(hashed_process_data->height));
       hashed_process_data->x.middle_marked = TRUE;
@@ -433,9 +435,10 @@ void draw_state_items(ControlFlowData *control_flow_data,
     {
       if(unlikely(hashed_process_data->x.middle_marked == FALSE)) {
         /* Draw collision indicator */
-        gdk_gc_set_foreground(drawing->gc, &drawing_colors[COL_WHITE]);
-        gdk_draw_point(hashed_process_data->pixmap,
+        processlist_draw_point(control_flow_data->process_list,
+                       hashed_process_data,
                        drawing->gc,
+                       &drawing_colors[COL_WHITE],
                        x,
                        COLLISION_POSITION(hashed_process_data->height));
         hashed_process_data->x.middle_marked = TRUE;
@@ -1871,7 +1874,9 @@ void draw_closure(gpointer key, gpointer value, gpointer user_data)
           /* Draw the line */
           if(dodraw) {
                   PropertiesLine prop_line = prepare_s_e_line(process);
-                  draw_line((void*)&prop_line, (void*)&draw_context);
+                  processlist_draw_line(control_flow_data->process_list,
+                                        hashed_process_data,
+                                        &prop_line, &draw_context);
           }
 
            /* become the last x position */
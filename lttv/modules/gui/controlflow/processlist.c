@@ -36,6 +36,9 @@
 /* Preallocated Size of the index_to_pixmap array */
 #define ALLOCATE_PROCESSES 1000
 
+/* Minimum number of row pixmaps kept in the pool */
+#define PIXMAP_POOL_SIZE 256
+
 /*****************************************************************************
  *                       Methods to synchronize process list                 *
  *****************************************************************************/
@@ -169,52 +172,337 @@ gboolean scroll_event(GtkWidget *widget, GdkEventScroll *event, gpointer data)
 }
 
 
-static void update_index_to_pixmap_each(ProcessInfo *key,
-                                        HashedProcessData *value,
-                                        ProcessList *process_list)
+/*****************************************************************************
+ *                       Pool of row pixmaps                                 *
+ *****************************************************************************/
+
+/* Give the pixmap of a row back to the pool. Its items are kept, so the row
+ * can be rasterized again later. */
+static void release_row_pixmap(ProcessList *process_list,
+                               HashedProcessData *hashed_process_data)
 {
-  guint array_index = processlist_get_index_from_data(process_list, value);
-  
-  g_assert(array_index < process_list->index_to_pixmap->len);
+  if(hashed_process_data->pixmap == NULL) return;
+
+  g_queue_delete_link(process_list->pixmap_lru,
+                      hashed_process_data->pool_link);
+  hashed_process_data->pool_link = NULL;
+  process_list->free_pixmaps = g_slist_prepend(process_list->free_pixmaps,
+                                               hashed_process_data->pixmap);
+  hashed_process_data->pixmap = NULL;
+}
+
+/* Drop every pooled pixmap, used when their size changes */
+static void free_pool_pixmaps(ProcessList *process_list)
+{
+  GSList *iter;
+  HashedProcessData *hashed_process_data;
+
+  while((hashed_process_data = g_queue_peek_head(process_list->pixmap_lru))
+          != NULL)
+    release_row_pixmap(process_list, hashed_process_data);
+
+  for(iter = process_list->free_pixmaps; iter != NULL; iter = iter->next)
+    gdk_pixmap_unref((GdkPixmap*)iter->data);
+  g_slist_free(process_list->free_pixmaps);
+  process_list->free_pixmaps = NULL;
+}
+
+static void replay_row_items(HashedProcessData *hashed_process_data,
+                             GdkGC *gc)
+{
+  DrawContext draw_context;
+  guint i;
+
+  draw_context.drawable = hashed_process_data->pixmap;
+  draw_context.gc = gc;
+  draw_context.pango_layout = NULL;
+  draw_context.drawinfo.y.over = 1;
+  draw_context.drawinfo.y.middle = (hashed_process_data->height/2);
+  draw_context.drawinfo.y.under = hashed_process_data->height;
+
+  for(i = 0; i < hashed_process_data->items->len; i++) {
+    RowItem *item = &g_array_index(hashed_process_data->items, RowItem, i);
+
+    switch(item->type) {
+      case ROW_ITEM_LINE:
+        draw_context.drawinfo.start.x = item->x_begin;
+        draw_context.drawinfo.end.x = item->x_end;
+        draw_line((void*)&item->prop, (void*)&draw_context);
+        break;
+      case ROW_ITEM_POINT:
+        gdk_gc_set_foreground(gc, &item->prop.color);
+        gdk_draw_point(hashed_process_data->pixmap, gc, item->x_begin, item->y);
+        break;
+    }
+  }
+}
+
+/* Make sure a row owns a pixmap which contains its items. The least recently
+ * used row gives its pixmap away when the pool is full. */
+static GdkPixmap *acquire_row_pixmap(ProcessList *process_list,
+                                     HashedProcessData *hashed_process_data,
+                                     GdkGC *gc)
+{
+  Drawing_t *drawing = process_list->drawing;
+  GdkPixmap *pixmap;
+
+  if(hashed_process_data->pixmap != NULL) {
+    /* Most recently used */
+    g_queue_unlink(process_list->pixmap_lru, hashed_process_data->pool_link);
+    g_queue_push_head_link(process_list->pixmap_lru,
+                           hashed_process_data->pool_link);
+    return hashed_process_data->pixmap;
+  }
+
+  if(process_list->pixmap_lru->length >= process_list->pixmap_pool_size)
+    release_row_pixmap(process_list,
+                       g_queue_peek_tail(process_list->pixmap_lru));
+
+  if(process_list->free_pixmaps != NULL) {
+    pixmap = (GdkPixmap*)process_list->free_pixmaps->data;
+    process_list->free_pixmaps = g_slist_delete_link(
+        process_list->free_pixmaps, process_list->free_pixmaps);
+  } else {
+    pixmap = gdk_pixmap_new(drawing->drawing_area->window,
+                            process_list->pixmap_width,
+                            process_list->cell_height,
+                            -1);
+  }
+
+  hashed_process_data->pixmap = pixmap;
+  g_queue_push_head(process_list->pixmap_lru, hashed_process_data);
+  hashed_process_data->pool_link = g_queue_peek_head_link(
+      process_list->pixmap_lru);
+
+  /* Rasterize the row */
+  gdk_draw_rectangle (pixmap,
+        drawing->drawing_area->style->black_gc,
+        TRUE,
+        0, 0,
+        process_list->pixmap_width,
+        hashed_process_data->height);
+  replay_row_items(hashed_process_data, gc);
+
+  return pixmap;
+}
+
+/* Remove the parts of the row items within [x, x+width[, splitting the lines
+ * which cross the range. */
+static void clear_row_items(HashedProcessData *hashed_process_data,
+                            gint x, gint width)
+{
+  GArray *items = hashed_process_data->items;
+  GArray *right_parts = NULL;
+  guint i, j;
+
+  if(x <= 0 && width == -1) {
+    g_array_set_size(items, 0);
+    return;
+  }
+
+  for(i = 0, j = 0; i < items->len; i++) {
+    RowItem item = g_array_index(items, RowItem, i);
+    gboolean left = item.x_begin < x;
+    gboolean right = width != -1 && item.x_end >= x + width;
+
+    if(item.x_end >= x && (width == -1 || item.x_begin < x + width)) {
+      if(right) {
+        RowItem right_part = item;
+
+        right_part.x_begin = x + width;
+        if(!left) {
+          item = right_part;
+        } else {
+          if(right_parts == NULL)
+            right_parts = g_array_new(FALSE, FALSE, sizeof(RowItem));
+          g_array_append_val(right_parts, right_part);
+        }
+      }
+      if(left)
+        item.x_end = x - 1;
+      if(!left && !right)
+        continue;
+    }
+    g_array_index(items, RowItem, j++) = item;
+  }
+  g_array_set_size(items, j);
+
+  if(right_parts != NULL) {
+    g_array_append_vals(items, right_parts->data, right_parts->len);
+    g_array_free(right_parts, TRUE);
+  }
+}
+
+/* Move the row items within [xsrc, xsrc+width[ at xdest, the others are
+ * scrolled out of the drawing. */
+static void shift_row_items(HashedProcessData *hashed_process_data,
+                            gint xsrc, gint xdest, gint width)
+{
+  GArray *items = hashed_process_data->items;
+  gint delta = xdest - xsrc;
+  guint i, j;
+
+  for(i = 0, j = 0; i < items->len; i++) {
+    RowItem item = g_array_index(items, RowItem, i);
+
+    if(item.x_begin < xsrc)
+      item.x_begin = xsrc;
+    if(width != -1 && item.x_end >= xsrc + width)
+      item.x_end = xsrc + width - 1;
+    if(item.x_begin > item.x_end)
+      continue;
+    item.x_begin += delta;
+    item.x_end += delta;
+    if(item.x_end < 0)
+      continue;
+    g_array_index(items, RowItem, j++) = item;
+  }
+  g_array_set_size(items, j);
+}
+
+static void append_row_item(HashedProcessData *hashed_process_data,
+                            RowItem *item)
+{
+  GArray *items = hashed_process_data->items;
+
+  /* Extend the previous line instead of adding a new item when the state
+   * did not change. */
+  if(item->type == ROW_ITEM_LINE && items->len > 0) {
+    RowItem *last = &g_array_index(items, RowItem, items->len - 1);
+
+    if(last->type == ROW_ITEM_LINE
+        && last->x_end == item->x_begin
+        && last->prop.y == item->prop.y
+        && last->prop.line_width == item->prop.line_width
+        && last->prop.style == item->prop.style
+        && gdk_color_equal(&last->prop.color, &item->prop.color)) {
+      last->x_end = item->x_end;
+      return;
+    }
+  }
+  g_array_append_val(items, *item);
+}
+
+void processlist_draw_line(ProcessList *process_list,
+    HashedProcessData *hashed_process_data,
+    PropertiesLine *prop_line,
+    DrawContext *draw_context)
+{
+  RowItem item;
+
+  item.type = ROW_ITEM_LINE;
+  item.x_begin = draw_context->drawinfo.start.x;
+  item.x_end = draw_context->drawinfo.end.x;
+  item.y = 0;
+  item.prop = *prop_line;
+  append_row_item(hashed_process_data, &item);
+
+  if(hashed_process_data->pixmap != NULL) {
+    draw_context->drawable = hashed_process_data->pixmap;
+    draw_line((void*)prop_line, (void*)draw_context);
+  }
+}
+
+void processlist_draw_point(ProcessList *process_list,
+    HashedProcessData *hashed_process_data,
+    GdkGC *gc, GdkColor *color,
+    gint x, gint y)
+{
+  RowItem item;
+
+  item.type = ROW_ITEM_POINT;
+  item.x_begin = x;
+  item.x_end = x;
+  item.y = y;
+  item.prop.color = *color;
+  item.prop.line_width = 0;
+  item.prop.style = GDK_LINE_SOLID;
+  item.prop.y = MIDDLE;
+  append_row_item(hashed_process_data, &item);
+
+  if(hashed_process_data->pixmap != NULL) {
+    gdk_gc_set_foreground(gc, color);
+    gdk_draw_point(hashed_process_data->pixmap, gc, x, y);
+  }
+}
+
+
+static gboolean update_index_to_pixmap_each(GtkTreeModel *model,
+                                            GtkTreePath *path,
+                                            GtkTreeIter *iter,
+                                            ProcessList *process_list)
+{
+  ProcessInfo process_info;
+  HashedProcessData *hashed_process_data;
+  gulong birth_s, birth_ns;
+
+  gtk_tree_model_get(model, iter,
+           PID_COLUMN, &process_info.pid,
+           CPU_COLUMN, &process_info.cpu,
+           BIRTH_S_COLUMN, &birth_s,
+           BIRTH_NS_COLUMN, &birth_ns,
+           TRACE_COLUMN, &process_info.trace_num,
+           -1);
+  if(process_info.pid != 0)
+    process_info.cpu = 0;
+  process_info.birth.tv_sec = birth_s;
+  process_info.birth.tv_nsec = birth_ns;
 
-  GdkPixmap **pixmap = 
-    (GdkPixmap**)&g_ptr_array_index(process_list->index_to_pixmap, array_index);
+  hashed_process_data = g_hash_table_lookup(process_list->process_hash,
+                                            &process_info);
+  g_assert(hashed_process_data != NULL);
+  g_ptr_array_add(process_list->index_to_pixmap, hashed_process_data);
 
-  *pixmap = value->pixmap;
+  return FALSE;
 }
 
 
+/* The list store is walked in order, which is linear instead of looking up
+ * the path of every process. */
 void update_index_to_pixmap(ProcessList *process_list)
 {
-  g_ptr_array_set_size(process_list->index_to_pixmap,
-                       g_hash_table_size(process_list->process_hash));
-  g_hash_table_foreach(process_list->process_hash, 
-                       (GHFunc)update_index_to_pixmap_each,
-                       process_list);
+  g_ptr_array_set_size(process_list->index_to_pixmap, 0);
+  if(g_hash_table_size(process_list->process_hash) != 0)
+    gtk_tree_model_foreach(GTK_TREE_MODEL(process_list->list_store),
+                           (GtkTreeModelForeachFunc)update_index_to_pixmap_each,
+                           process_list);
+  g_assert(process_list->index_to_pixmap->len
+             == g_hash_table_size(process_list->process_hash));
+  process_list->index_to_pixmap_dirty = FALSE;
 }
 
 
-static void update_pixmap_size_each(ProcessInfo *key,
-                                    HashedProcessData *value,
-                                    guint width)
+gboolean processlist_get_process_at(ProcessList *process_list, guint y,
+    guint *pid, guint *cpu, guint *trace_num)
 {
-  GdkPixmap *old_pixmap = value->pixmap;
+  HashedProcessData *hashed_process_data;
+  guint index;
 
-  value->pixmap = 
-        gdk_pixmap_new(old_pixmap,
-                       width,
-                       value->height,
-                       -1);
+  if(process_list->cell_height == 0) return FALSE;
+  if(process_list->index_to_pixmap_dirty)
+    update_index_to_pixmap(process_list);
 
-  gdk_pixmap_unref(old_pixmap);
+  index = y / process_list->cell_height;
+  if(index >= process_list->index_to_pixmap->len) return FALSE;
+
+  hashed_process_data =
+    (HashedProcessData*)g_ptr_array_index(process_list->index_to_pixmap, index);
+  gtk_tree_model_get(GTK_TREE_MODEL(process_list->list_store),
+                     &hashed_process_data->y_iter,
+                     PID_COLUMN, pid,
+                     CPU_COLUMN, cpu,
+                     TRACE_COLUMN, trace_num,
+                     -1);
+  return TRUE;
 }
 
 
+/* Pooled pixmaps are dropped : the visible rows are rasterized again at the
+ * new size on the next expose. */
 void update_pixmap_size(ProcessList *process_list, guint width)
 {
-  g_hash_table_foreach(process_list->process_hash,
-		       (GHFunc)update_pixmap_size_each,
-		       GUINT_TO_POINTER(width));
+  free_pool_pixmaps(process_list);
+  process_list->pixmap_width = width;
 }
 
 
@@ -232,6 +520,12 @@ static void copy_pixmap_region_each(ProcessInfo *key,
   GdkPixmap *src = cp->src;
   GdkPixmap *dest = cp->dest;
   
+  if(src == NULL && dest == NULL)
+    shift_row_items(value, cp->xsrc, cp->xdest, cp->width);
+
+  if(value->pixmap == NULL)
+    return;
+
   if(dest == NULL)
     dest = value->pixmap;
   if(src == NULL)
@@ -274,7 +568,13 @@ static void rectangle_pixmap_each(ProcessInfo *key,
 {
   if(rp->height == -1)
     rp->height = value->height;
-      
+
+  if(rp->filled)
+    clear_row_items(value, rp->x, rp->width);
+
+  if(value->pixmap == NULL)
+    return;
+
   gdk_draw_rectangle (value->pixmap,
       rp->gc,
       rp->filled,
@@ -296,13 +596,16 @@ void rectangle_pixmap(ProcessList *process_list, GdkGC *gc,
 }
 
 
-/* Renders each pixmaps into on big drawable */
+/* Renders each visible row into on big drawable, rasterizing the rows
+ * which do not own a pixmap yet */
 void copy_pixmap_to_screen(ProcessList *process_list,
     GdkDrawable *dest,
     GdkGC *gc,
     gint x, gint y,
     gint width, gint height)
 {
+  if(process_list->index_to_pixmap_dirty)
+    update_index_to_pixmap(process_list);
   if(process_list->index_to_pixmap->len == 0) return;
   guint cell_height = process_list->cell_height;
 
@@ -312,12 +615,17 @@ void copy_pixmap_to_screen(ProcessList *process_list,
                  process_list->index_to_pixmap->len);
   gint i;
 
+  /* The pool must at least hold the exposed rows */
+  if(end > begin && (guint)(end - begin) > process_list->pixmap_pool_size)
+    process_list->pixmap_pool_size = 2 * (end - begin);
+
   for(i=begin; i<end; i++) {
     g_assert(i<process_list->index_to_pixmap->len);
     /* Render the pixmap to the screen */
-    GdkPixmap *pixmap = 
-      //(GdkPixmap*)g_ptr_array_index(process_list->index_to_pixmap, i);
-      GDK_PIXMAP(g_ptr_array_index(process_list->index_to_pixmap, i));
+    HashedProcessData *hashed_process_data =
+      (HashedProcessData*)g_ptr_array_index(process_list->index_to_pixmap, i);
+    GdkPixmap *pixmap =
+      acquire_row_pixmap(process_list, hashed_process_data, gc);
 
     gdk_draw_drawable (dest,
         gc,
@@ -502,6 +810,13 @@ ProcessList *processlist_construct(void)
       (GDestroyNotify)processlist_destroy);
 
   process_list->index_to_pixmap = g_ptr_array_sized_new(ALLOCATE_PROCESSES);
+  process_list->index_to_pixmap_dirty = FALSE;
+
+  process_list->pixmap_lru = g_queue_new();
+  process_list->free_pixmaps = NULL;
+  process_list->pixmap_pool_size = PIXMAP_POOL_SIZE;
+  process_list->pixmap_width = 0;
+  process_list->drawing = NULL;
   
   return process_list;
 }
@@ -509,6 +824,8 @@ ProcessList *processlist_construct(void)
 void processlist_destroy(ProcessList *process_list)
 {
   g_debug("processlist_destroy %p", process_list);
+  free_pool_pixmaps(process_list);
+  g_queue_free(process_list->pixmap_lru);
   g_hash_table_destroy(process_list->process_hash);
   process_list->process_hash = NULL;
   g_ptr_array_free(process_list->index_to_pixmap, TRUE);
@@ -526,7 +843,7 @@ static gboolean remove_hash_item(ProcessInfo *process_info,
   iter = hashed_process_data->y_iter;
 
   gtk_list_store_remove (process_list->list_store, &iter);
-  gdk_pixmap_unref(hashed_process_data->pixmap);
+  release_row_pixmap(process_list, hashed_process_data);
 
   if(likely(process_list->current_hash_data != NULL)) {
     if(likely(hashed_process_data ==
@@ -561,6 +878,7 @@ void destroy_hash_key(gpointer key)
 
 void destroy_hash_data(gpointer data)
 {
+  g_array_free(((HashedProcessData*)data)->items, TRUE);
   g_free(data);
 }
 
@@ -637,6 +955,9 @@ int processlist_add(  ProcessList *process_list,
   hashed_process_data->x.under_used = FALSE;
   hashed_process_data->x.under_marked = FALSE;
   hashed_process_data->next_good_time = ltt_time_zero;
+  hashed_process_data->items = g_array_new(FALSE, FALSE, sizeof(RowItem));
+  hashed_process_data->pixmap = NULL;
+  hashed_process_data->pool_link = NULL;
  
   if (process_list->cell_height == 0) {
     GtkTreePath *path;
@@ -693,21 +1014,12 @@ int processlist_add(  ProcessList *process_list,
 
   *height = hashed_process_data->height * process_list->number_of_process;
 
-  hashed_process_data->pixmap = 
-        gdk_pixmap_new(drawing->drawing_area->window,
-                       drawing->alloc_width,
-                       hashed_process_data->height,
-                       -1);
-  
-  // Clear the image
-  gdk_draw_rectangle (hashed_process_data->pixmap,
-        drawing->drawing_area->style->black_gc,
-        TRUE,
-        0, 0,
-        drawing->alloc_width,
-        hashed_process_data->height);
+  /* The row gets a pixmap from the pool when it is exposed */
+  process_list->drawing = drawing;
+  if(process_list->pixmap_width != drawing->alloc_width)
+    update_pixmap_size(process_list, drawing->alloc_width);
 
-  update_index_to_pixmap(process_list);
+  process_list->index_to_pixmap_dirty = TRUE;
 
 
   return 0;
@@ -741,6 +1053,7 @@ int processlist_remove( ProcessList *process_list,
     iter = hashed_process_data->y_iter;
 
     gtk_list_store_remove (process_list->list_store, &iter);
+    release_row_pixmap(process_list, hashed_process_data);
     
     g_hash_table_remove(process_list->process_hash,
         &process_info);
@@ -751,9 +1064,7 @@ int processlist_remove( ProcessList *process_list,
       }
     }
     
-    gdk_pixmap_unref(hashed_process_data->pixmap);
-    
-    update_index_to_pixmap(process_list);
+    process_list->index_to_pixmap_dirty = TRUE;
 
     process_list->number_of_process--;
 
@@ -69,10 +69,35 @@ typedef struct _ProcessInfo {
 
 } ProcessInfo;
 
+#ifndef TYPE_DRAWING_T_DEFINED
+#define TYPE_DRAWING_T_DEFINED
+typedef struct _Drawing_t Drawing_t;
+#endif //TYPE_DRAWING_T_DEFINED
+
+/* Drawing operation recorded for a process row.
+ *
+ * The items of a row are the reference copy of what is drawn in it : rows
+ * which are not visible do not own a pixmap, their items are rasterized in a
+ * pixmap taken from the pool when the row becomes visible again.
+ */
+typedef enum _RowItemType {
+  ROW_ITEM_LINE, ROW_ITEM_POINT
+} RowItemType;
+
+typedef struct _RowItem {
+  RowItemType type;
+  gint x_begin;
+  gint x_end;           /* x_begin for points */
+  gint y;               /* only used by points */
+  PropertiesLine prop;  /* only the color is used by points */
+} RowItem;
+
 typedef struct _HashedProcessData {
  
-  GdkPixmap *pixmap;  // Pixmap slice containing drawing buffer for the PID
+  GdkPixmap *pixmap;  // Pixmap slice of the row, NULL if not in the pool
   gint height; // height of the pixmap
+  GArray *items; // RowItem drawn in the row, replayed in a pooled pixmap
+  GList *pool_link; // Position in the pixmap pool LRU, NULL if no pixmap
   GtkTreeIter y_iter; // Access quickly to y pos.
  // DrawContext *draw_context;
   /* Information on current drawing */
@@ -109,21 +134,24 @@ struct _ProcessList {
   /* Current process pointer, one per cpu, one per trace */
   HashedProcessData ***current_hash_data;
 
-  /* Array containing index -> pixmap correspondance. Must be updated
-   * every time the process list is reordered, process added or removed */
+  /* Array containing index -> HashedProcessData correspondance. Rebuilt
+   * lazily when the process list is reordered, process added or removed */
   GPtrArray * index_to_pixmap;
+  gboolean index_to_pixmap_dirty;
+
+  /* Pool of row pixmaps. Only recently visible rows own a pixmap, most
+   * recently used first in the LRU queue. */
+  GQueue *pixmap_lru;
+  GSList *free_pixmaps;
+  guint pixmap_pool_size;
+  gint pixmap_width;
+  Drawing_t *drawing;
 
 };
 
 
 typedef struct _ProcessList ProcessList;
 
-
-#ifndef TYPE_DRAWING_T_DEFINED
-#define TYPE_DRAWING_T_DEFINED
-typedef struct _Drawing_t Drawing_t;
-#endif //TYPE_DRAWING_T_DEFINED
-
 ProcessList *processlist_construct(void);
 void processlist_destroy(ProcessList *process_list);
 GtkWidget *processlist_get_widget(ProcessList *process_list);
@@ -155,10 +183,26 @@ void processlist_set_ppid(ProcessList *process_list,
     HashedProcessData *hashed_process_data);
 
 
+/* Draw in a process row. The item is recorded in the row, and only drawn
+ * right away if the row currently owns a pixmap. */
+void processlist_draw_line(ProcessList *process_list,
+    HashedProcessData *hashed_process_data,
+    PropertiesLine *prop_line,
+    DrawContext *draw_context);
+void processlist_draw_point(ProcessList *process_list,
+    HashedProcessData *hashed_process_data,
+    GdkGC *gc, GdkColor *color,
+    gint x, gint y);
+
 /* Synchronize the list at the left and the drawing */
 void update_index_to_pixmap(ProcessList *process_list);
 
-/* Update the width of each pixmap buffer for each process */
+/* Process shown at height y of the drawing. Returns FALSE if there is no row
+ * there. */
+gboolean processlist_get_process_at(ProcessList *process_list, guint y,
+    guint *pid, guint *cpu, guint *trace_num);
+
+/* Update the width of the pooled pixmap buffers */
 void update_pixmap_size(ProcessList *process_list, guint width);
 
 
@@ -172,7 +216,8 @@ void copy_pixmap_region(ProcessList *process_list, GdkDrawable *dest,
 void rectangle_pixmap(ProcessList *process_list, GdkGC *gc,
     gboolean filled, gint x, gint y, gint width, gint height);
 
-/* Renders each pixmaps into on big drawable */
+/* Renders each visible row into on big drawable, rasterizing the rows
+ * which do not own a pixmap yet */
 void copy_pixmap_to_screen(ProcessList *process_list,
     GdkDrawable *dest,
     GdkGC *gc,
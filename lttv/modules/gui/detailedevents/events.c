@@ -77,6 +77,10 @@
 #define g_debug(format...) g_log (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, format)
 #endif
 
+/* Rows kept in the row cache, and rows read ahead of the rows shown */
+#define ROW_CACHE_SIZE 4096
+#define ROW_READ_AHEAD 512
+
 #define abs(a) (((a)<0)?(-a):(a))
 #define max(a,b) ((a)>(b)?(a):(b))
 #define min(a,b) ((a)<(b)?(a):(b))
@@ -139,6 +143,17 @@ static gboolean key_handler(GtkWidget *widget, GdkEventKey *event,
     gpointer user_data);
 
 static void adjust_event_viewer(double time, EventViewerData *event_viewer_data);
+static void start_index(EventViewerData *event_viewer_data);
+static gint index_done(void *hook_data, void *call_data);
+static void scroll_by_time(EventViewerData *event_viewer_data);
+static void set_first_event(EventViewerData *event_viewer_data,
+                            LttvTracesetPosition *pos);
+static void set_last_event(EventViewerData *event_viewer_data,
+                           LttvTracesetPosition *pos, gboolean cached);
+static void rows_clear(EventViewerData *event_viewer_data);
+static void rows_free(EventViewerData *event_viewer_data);
+static gboolean rows_scroll(EventViewerData *event_viewer_data,
+                            gint relative_position);
 
 int event_hook(void *hook_data, void *call_data);
 
@@ -497,11 +512,104 @@ gui_events(LttvPluginTab *ptab)
   
   event_viewer_data->background_info_waiting = 0;
 
+  event_viewer_data->index = NULL;
+  event_viewer_data->scroll_by_count = FALSE;
+
+  event_viewer_data->rows = g_new(EventRow, ROW_CACHE_SIZE);
+  event_viewer_data->rows_head = 0;
+  event_viewer_data->rows_count = 0;
+  event_viewer_data->rows_first = 0;
+  event_viewer_data->rows_shown = FALSE;
+  event_viewer_data->rows_at_begin = FALSE;
+  event_viewer_data->rows_at_end = FALSE;
+  event_viewer_data->first_event_cached = FALSE;
+  event_viewer_data->last_event_cached = FALSE;
+  event_viewer_data->scroll_direction = 1;
+  event_viewer_data->prefetch_source_id = 0;
+  event_viewer_data->prefetching = FALSE;
+  event_viewer_data->rows_read = g_array_sized_new(FALSE, FALSE,
+                                                   sizeof(EventRow),
+                                                   ROW_READ_AHEAD);
+  event_viewer_data->rows_skip = FALSE;
+  event_viewer_data->rows_stop = FALSE;
 
   request_background_data(event_viewer_data);
+  start_index(event_viewer_data);
   return event_viewer_data;
 }
 
+/* Once all the events are numbered, the scrollbar value becomes the number
+ * of the first event shown : the scrollbar is proportional to the events and
+ * any event is reached with one index lookup. */
+static void scroll_by_count(EventViewerData *event_viewer_data)
+{
+  LttvTraceset *ts = lttvwindow_get_traceset(event_viewer_data->tab);
+  guint64 number = 0;
+
+  lttv_traceset_index_get_number(event_viewer_data->index, ts,
+                                 event_viewer_data->first_event, &number);
+
+  event_viewer_data->scroll_by_count = TRUE;
+  event_viewer_data->previous_value = number;
+  event_viewer_data->vadjust_c->upper =
+    lttv_traceset_index_get_count(event_viewer_data->index);
+  gtk_adjustment_changed(event_viewer_data->vadjust_c);
+  gtk_adjustment_set_value(event_viewer_data->vadjust_c, number);
+}
+
+/* Back to a time proportional scrollbar, while the index is incomplete */
+static void scroll_by_time(EventViewerData *event_viewer_data)
+{
+  LttvTraceset *ts = lttvwindow_get_traceset(event_viewer_data->tab);
+  TimeInterval time_span = lttv_traceset_get_time_span_real(ts);
+  LttTime time;
+
+  if(!event_viewer_data->scroll_by_count)
+    return;
+
+  event_viewer_data->scroll_by_count = FALSE;
+  time = ltt_time_sub(lttv_traceset_position_get_time(
+                        event_viewer_data->first_event),
+                      time_span.start_time);
+  event_viewer_data->previous_value = ltt_time_to_double(time);
+  time = ltt_time_sub(time_span.end_time, time_span.start_time);
+  event_viewer_data->vadjust_c->upper = ltt_time_to_double(time);
+  gtk_adjustment_changed(event_viewer_data->vadjust_c);
+  gtk_adjustment_set_value(event_viewer_data->vadjust_c,
+                           event_viewer_data->previous_value);
+}
+
+static gint index_done(void *hook_data, void *call_data)
+{
+  EventViewerData *event_viewer_data = (EventViewerData*)hook_data;
+
+  if(lttv_traceset_index_get_count(event_viewer_data->index) > 0)
+    scroll_by_count(event_viewer_data);
+  return 0;
+}
+
+/* Build the index in the background, the viewer being usable meanwhile.
+ * The index of the traceset is shared with the other viewers, which are
+ * told as well when it is complete. */
+static void start_index(EventViewerData *event_viewer_data)
+{
+  LttvTraceset *ts = lttvwindow_get_traceset(event_viewer_data->tab);
+  LttvTracesetIndex *index = lttv_traceset_index_get_from_traceset(ts);
+
+  if(index != event_viewer_data->index) {
+    if(event_viewer_data->index != NULL)
+      lttv_hooks_remove_data(
+          lttv_traceset_index_get_done_hooks(event_viewer_data->index),
+          index_done, event_viewer_data);
+    event_viewer_data->index = index;
+    lttv_hooks_add(lttv_traceset_index_get_done_hooks(index), index_done,
+                   event_viewer_data, LTTV_PRIO_DEFAULT);
+  }
+  lttv_traceset_index_start(index, ts);
+  if(lttv_traceset_index_is_complete(index))
+    index_done(event_viewer_data, index);
+}
+
 
 
 static gint background_ready(void *hook_data, void *call_data)
@@ -513,6 +621,8 @@ static gint background_ready(void *hook_data, void *call_data)
   if(event_viewer_data->background_info_waiting == 0) {
     g_message("event viewer : background computation data ready.");
 
+    /* The cached rows were formatted without the complete state */
+    rows_clear(event_viewer_data);
     evd_redraw_notify(event_viewer_data, NULL);
   }
 
@@ -1077,6 +1187,38 @@ static void adjust_event_viewer(double new_value, EventViewerData *event_viewer_
     break;
   }
 
+  if(relative_position != 0)
+    event_viewer_data->scroll_direction = relative_position > 0 ? 1 : -1;
+
+  /* Scroll within the cached rows when possible */
+  if(!seek_by_time && rows_scroll(event_viewer_data, relative_position)) {
+    lttvwindow_events_request_enable();
+    redraw(event_viewer_data);
+    return;
+  }
+
+  if(event_viewer_data->scroll_by_count) {
+    /* The value is an event number : one index lookup for any move */
+    gdouble count = lttv_traceset_index_get_count(event_viewer_data->index);
+    gdouble number;
+
+    if(seek_by_time)
+      number = new_value;
+    else
+      number = event_viewer_data->previous_value + relative_position;
+    number = CLAMP(number, 0, count - 1);
+
+    lttv_traceset_index_seek_n(event_viewer_data->index, ts,
+                               (guint64)number);
+    set_first_event(event_viewer_data,
+                    lttv_traceset_create_current_position(ts));
+    event_viewer_data->previous_value = (guint64)number;
+
+    lttvwindow_events_request_enable();
+    redraw(event_viewer_data);
+    return;
+  }
+
   LttTime time = ltt_time_from_double(new_value);
   TimeInterval time_span = lttv_traceset_get_time_span_real(ts);
   time = ltt_time_add(time_span.start_time, time);
@@ -1139,7 +1281,9 @@ static void adjust_event_viewer(double new_value, EventViewerData *event_viewer_
 
     /* Save the first event position */
 
-    event_viewer_data->first_event = lttv_traceset_create_current_position(ts);
+    set_first_event(event_viewer_data,
+                    lttv_traceset_create_current_position(ts));
+    lttv_traceset_destroy_position(timePos);
 
     time = ltt_time_from_uint64(lttv_traceset_position_get_timestamp(
                                             event_viewer_data->first_event));
@@ -1155,34 +1299,212 @@ static void adjust_event_viewer(double new_value, EventViewerData *event_viewer_
     
     LttTime time_val = ltt_time_sub(time,time_span.start_time);
     event_viewer_data->previous_value = ltt_time_to_double(time_val);
-    event_viewer_data->first_event = timePos;
+    set_first_event(event_viewer_data, timePos);
   }
   lttvwindow_events_request_enable();
 
   redraw(event_viewer_data);
 }
 
-static void redraw(EventViewerData *event_viewer_data) {
-  guint i;
+static EventRow *row_at(EventViewerData *event_viewer_data, guint i)
+{
+  return &event_viewer_data->rows[(event_viewer_data->rows_head + i)
+                                  % ROW_CACHE_SIZE];
+}
+
+static void row_free(EventRow *row)
+{
+  lttv_traceset_destroy_position(row->pos);
+  g_free(row->name);
+  g_free(row->desc);
+}
+
+/* Replace the first event shown, freeing it unless it belongs to the cache */
+static void set_first_event(EventViewerData *event_viewer_data,
+                            LttvTracesetPosition *pos)
+{
+  if(!event_viewer_data->first_event_cached)
+    lttv_traceset_destroy_position(event_viewer_data->first_event);
+  event_viewer_data->first_event = pos;
+  event_viewer_data->first_event_cached = FALSE;
+}
+
+/* Replace the last event shown, freeing it unless it belongs to the cache */
+static void set_last_event(EventViewerData *event_viewer_data,
+                           LttvTracesetPosition *pos, gboolean cached)
+{
+  if(!event_viewer_data->last_event_cached)
+    lttv_traceset_destroy_position(event_viewer_data->last_event);
+  event_viewer_data->last_event = pos;
+  event_viewer_data->last_event_cached = cached;
+}
+
+/* Position of the event of a row, which outlives the row */
+static LttvTracesetPosition *row_position_copy(
+    EventViewerData *event_viewer_data, EventRow *row)
+{
   LttvTraceset *ts = lttvwindow_get_traceset(event_viewer_data->tab);
-  
-  g_debug("EventViewer redraw");
+  LttvTracesetPosition *pos;
 
-  //TODO ybrosseau verify its still required
-  lttvwindow_events_request_disable();
-  
-  
-  /* Clear the model (don't forget to free the TCS positions!) */
-  gtk_list_store_clear(event_viewer_data->store_m);
-  for(i=0;i<event_viewer_data->pos->len;i++) {
-    LttvTracesetPosition *cur_pos = 
-      (LttvTracesetPosition*)g_ptr_array_index(event_viewer_data->pos,
-                                                      i);
-    lttv_traceset_destroy_position(cur_pos);
+  pos = lttv_traceset_create_time_position(ts, row->time);
+  /* Compared by time and cpu, like the positions of the rows */
+  pos->timestamp = ltt_time_to_uint64(row->time);
+  pos->cpu_id = row->cpu;
+  return pos;
+}
+
+/* Free a row leaving the cache. The positions of the viewer which refer to
+ * it are replaced by copies. */
+static void row_evict(EventViewerData *event_viewer_data, EventRow *row)
+{
+  if(event_viewer_data->first_event_cached
+      && event_viewer_data->first_event == row->pos) {
+    event_viewer_data->first_event =
+      row_position_copy(event_viewer_data, row);
+    event_viewer_data->first_event_cached = FALSE;
+  }
+  if(event_viewer_data->last_event_cached
+      && event_viewer_data->last_event == row->pos) {
+    event_viewer_data->last_event =
+      row_position_copy(event_viewer_data, row);
+    event_viewer_data->last_event_cached = FALSE;
   }
+  if(event_viewer_data->currently_selected_position == row->pos)
+    event_viewer_data->currently_selected_position =
+      row_position_copy(event_viewer_data, row);
+  row_free(row);
+}
+
+/* Invalidate the row cache, e.g. when the traceset or the filter changes */
+static void rows_clear(EventViewerData *event_viewer_data)
+{
+  guint i;
+
+  gtk_list_store_clear(event_viewer_data->store_m);
   g_ptr_array_set_size(event_viewer_data->pos, 0);
-  
-  lttv_state_traceset_seek_position(ts, event_viewer_data->first_event);
+
+  for(i = 0; i < event_viewer_data->rows_count; i++)
+    row_evict(event_viewer_data, row_at(event_viewer_data, i));
+  event_viewer_data->rows_head = 0;
+  event_viewer_data->rows_count = 0;
+  event_viewer_data->rows_first = 0;
+  event_viewer_data->rows_shown = FALSE;
+  event_viewer_data->rows_at_begin = FALSE;
+  event_viewer_data->rows_at_end = FALSE;
+}
+
+/* Free the row cache and the rows read, with the viewer */
+static void rows_free(EventViewerData *event_viewer_data)
+{
+  guint i;
+
+  if(!event_viewer_data->first_event_cached)
+    lttv_traceset_destroy_position(event_viewer_data->first_event);
+  if(!event_viewer_data->last_event_cached)
+    lttv_traceset_destroy_position(event_viewer_data->last_event);
+  event_viewer_data->first_event = NULL;
+  event_viewer_data->last_event = NULL;
+
+  for(i = 0; i < event_viewer_data->rows_count; i++)
+    row_free(row_at(event_viewer_data, i));
+  g_free(event_viewer_data->rows);
+  event_viewer_data->rows = NULL;
+  event_viewer_data->rows_count = 0;
+
+  for(i = 0; i < event_viewer_data->rows_read->len; i++)
+    row_free(&g_array_index(event_viewer_data->rows_read, EventRow, i));
+  g_array_free(event_viewer_data->rows_read, TRUE);
+  event_viewer_data->rows_read = NULL;
+}
+
+/* Add a row after the cached ones, evicting the first one if the cache is
+ * full. Returns FALSE if that row is shown. */
+static gboolean rows_push_back(EventViewerData *event_viewer_data,
+                               EventRow *row)
+{
+  if(event_viewer_data->rows_count == ROW_CACHE_SIZE) {
+    if(event_viewer_data->rows_shown && event_viewer_data->rows_first == 0)
+      return FALSE;
+    row_evict(event_viewer_data, row_at(event_viewer_data, 0));
+    event_viewer_data->rows_head =
+      (event_viewer_data->rows_head + 1) % ROW_CACHE_SIZE;
+    event_viewer_data->rows_count--;
+    event_viewer_data->rows_at_begin = FALSE;
+    if(event_viewer_data->rows_shown)
+      event_viewer_data->rows_first--;
+  }
+  *row_at(event_viewer_data, event_viewer_data->rows_count) = *row;
+  event_viewer_data->rows_count++;
+  return TRUE;
+}
+
+/* Add a row before the cached ones, evicting the last one if the cache is
+ * full. Returns FALSE if that row is shown. */
+static gboolean rows_push_front(EventViewerData *event_viewer_data,
+                                EventRow *row)
+{
+  if(event_viewer_data->rows_count == ROW_CACHE_SIZE) {
+    if(event_viewer_data->rows_shown
+        && event_viewer_data->rows_first
+           + event_viewer_data->num_visible_events
+           >= event_viewer_data->rows_count)
+      return FALSE;
+    row_evict(event_viewer_data,
+              row_at(event_viewer_data, event_viewer_data->rows_count - 1));
+    event_viewer_data->rows_count--;
+    event_viewer_data->rows_at_end = FALSE;
+  }
+  event_viewer_data->rows_head =
+    (event_viewer_data->rows_head + ROW_CACHE_SIZE - 1) % ROW_CACHE_SIZE;
+  *row_at(event_viewer_data, 0) = *row;
+  event_viewer_data->rows_count++;
+  if(event_viewer_data->rows_shown)
+    event_viewer_data->rows_first++;
+  return TRUE;
+}
+
+/* Find the cached row of a position, comparing the time and cpu as
+ * lttv_traceset_position_compare does. */
+static gboolean rows_find(EventViewerData *event_viewer_data,
+                          const LttvTracesetPosition *pos, guint *index)
+{
+  LttTime time;
+  guint cpu, min, max, mid;
+
+  if(event_viewer_data->rows_count == 0)
+    return FALSE;
+
+  time = lttv_traceset_position_get_time(pos);
+  cpu = lttv_traceset_position_get_cpuid(pos);
+
+  /* First row at or after time */
+  min = 0;
+  max = event_viewer_data->rows_count;
+  while(min < max) {
+    mid = (min + max) / 2;
+    if(ltt_time_compare(row_at(event_viewer_data, mid)->time, time) < 0)
+      min = mid + 1;
+    else
+      max = mid;
+  }
+  for(; min < event_viewer_data->rows_count; min++) {
+    EventRow *row = row_at(event_viewer_data, min);
+
+    if(ltt_time_compare(row->time, time) != 0)
+      break;
+    if(row->cpu == cpu) {
+      *index = min;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* Read and format at most nb events from the current traceset position into
+ * rows_read. Returns TRUE if the end of the traceset was reached. */
+static gboolean read_rows(EventViewerData *event_viewer_data, guint nb)
+{
+  LttvTraceset *ts = lttvwindow_get_traceset(event_viewer_data->tab);
 
   /* Mathieu :
    * I make the choice not to use the mainwindow lttvwindow API here : the idle
@@ -1190,7 +1512,9 @@ static void redraw(EventViewerData *event_viewer_data) {
    * scrolling. However, we call the gdk loop to get events periodically so the
    * processing can be stopped.
    */
-  
+  event_viewer_data->rows_wanted = nb;
+  event_viewer_data->rows_stopped = FALSE;
+  event_viewer_data->read_time = ltt_time_infinite;
   lttv_process_traceset_begin(ts,
       NULL, NULL, event_viewer_data->event_hooks);
 
@@ -1199,15 +1523,272 @@ static void redraw(EventViewerData *event_viewer_data) {
   lttv_process_traceset_middle(ts, ltt_time_infinite, G_MAXUINT, NULL);
   
   lttv_process_traceset_end(ts, NULL, NULL, event_viewer_data->event_hooks);
+
+  return event_viewer_data->rows_read->len < nb
+    && !event_viewer_data->rows_stopped
+    && !event_viewer_data->tab->stop_foreground;
+}
+
+/* Cache nb more rows after the last cached one */
+static void rows_read_forward(EventViewerData *event_viewer_data, guint nb)
+{
+  LttvTraceset *ts = lttvwindow_get_traceset(event_viewer_data->tab);
+  EventRow *last;
+  gboolean at_end;
+  guint i;
+
+  if(event_viewer_data->rows_count == 0 || event_viewer_data->rows_at_end)
+    return;
+
+  /* The seek lands on the first event of the last row timestamp, the events
+   * of that timestamp are skipped up to the rank of the row */
+  last = row_at(event_viewer_data, event_viewer_data->rows_count - 1);
+  event_viewer_data->rows_skip = TRUE;
+  event_viewer_data->skip_time = last->time;
+  event_viewer_data->skip_rank = last->rank;
+  lttv_state_traceset_seek_position(ts, last->pos);
+  at_end = read_rows(event_viewer_data, nb);
+  event_viewer_data->rows_skip = FALSE;
+
+  for(i = 0; i < event_viewer_data->rows_read->len; i++) {
+    EventRow *row = &g_array_index(event_viewer_data->rows_read, EventRow, i);
+
+    if(!rows_push_back(event_viewer_data, row))
+      break;
+  }
+  if(i == event_viewer_data->rows_read->len)
+    event_viewer_data->rows_at_end = at_end;
+  for(; i < event_viewer_data->rows_read->len; i++)
+    row_free(&g_array_index(event_viewer_data->rows_read, EventRow, i));
+  g_array_set_size(event_viewer_data->rows_read, 0);
+}
+
+/* Cache about nb more rows before the first cached one */
+static void rows_read_backward(EventViewerData *event_viewer_data, guint nb)
+{
+  LttvTraceset *ts = lttvwindow_get_traceset(event_viewer_data->tab);
+  LttvTracesetPosition *start;
+  EventRow *first, *last;
+  gdouble ratio;
+  gint i;
+
+  if(event_viewer_data->rows_count == 0 || event_viewer_data->rows_at_begin)
+    return;
+
+  first = row_at(event_viewer_data, 0);
+  last = row_at(event_viewer_data, event_viewer_data->rows_count - 1);
+  ratio = ltt_time_to_double(ltt_time_sub(last->time, first->time))
+            / event_viewer_data->rows_count;
+  if(ratio <= 0)
+    ratio = SEEK_BACK_DEFAULT_RATIO;
+
+  lttv_traceset_seek_to_position(first->pos);
+  lttv_process_traceset_seek_n_backward(ts, nb, ratio,
+      NULL, NULL, NULL, NULL, NULL, NULL);
+  start = lttv_traceset_create_current_position(ts);
+  lttv_state_traceset_seek_position(ts, start);
+  lttv_traceset_destroy_position(start);
+
+  /* Read up to the first cached row */
+  event_viewer_data->rows_stop = TRUE;
+  event_viewer_data->stop_time = first->time;
+  event_viewer_data->stop_rank = first->rank;
+  read_rows(event_viewer_data, nb + ROW_READ_AHEAD);
+  event_viewer_data->rows_stop = FALSE;
+
+  if(event_viewer_data->rows_stopped) {
+    if(event_viewer_data->rows_read->len < nb)
+      event_viewer_data->rows_at_begin = TRUE;
+    for(i = event_viewer_data->rows_read->len - 1; i >= 0; i--) {
+      EventRow *row = &g_array_index(event_viewer_data->rows_read, EventRow, i);
+
+      if(!rows_push_front(event_viewer_data, row))
+        break;
+    }
+    event_viewer_data->rows_at_begin &= (i < 0);
+  } else
+    i = event_viewer_data->rows_read->len - 1;
+
+  for(; i >= 0; i--)
+    row_free(&g_array_index(event_viewer_data->rows_read, EventRow, i));
+  g_array_set_size(event_viewer_data->rows_read, 0);
+}
+
+static gboolean prefetch_rows(gpointer data)
+{
+  EventViewerData *event_viewer_data = (EventViewerData*)data;
+  guint after;
+
+  event_viewer_data->prefetch_source_id = 0;
+  if(!event_viewer_data->rows_shown)
+    return FALSE;
+
+  lttvwindow_events_request_disable();
+  event_viewer_data->prefetching = TRUE;
+
+  after = event_viewer_data->rows_count - event_viewer_data->rows_first;
+  if(event_viewer_data->scroll_direction >= 0) {
+    if(after < event_viewer_data->num_visible_events + ROW_READ_AHEAD)
+      rows_read_forward(event_viewer_data, ROW_READ_AHEAD);
+  } else {
+    if(event_viewer_data->rows_first < ROW_READ_AHEAD)
+      rows_read_backward(event_viewer_data, ROW_READ_AHEAD);
+  }
+
+  event_viewer_data->prefetching = FALSE;
+  lttvwindow_events_request_enable();
+  return FALSE;
+}
+
+/* Move the rows shown within the cache. Returns FALSE if the rows before are
+ * not cached. */
+static gboolean rows_scroll(EventViewerData *event_viewer_data,
+                            gint relative_position)
+{
+  LttvTraceset *ts = lttvwindow_get_traceset(event_viewer_data->tab);
+  TimeInterval time_span;
+  EventRow *row;
+  gint first;
+
+  if(!event_viewer_data->rows_shown || !event_viewer_data->first_event_cached)
+    return FALSE;
+
+  first = (gint)event_viewer_data->rows_first + relative_position;
+  if(first < 0) {
+    if(!event_viewer_data->rows_at_begin)
+      return FALSE;
+    first = 0;
+  }
+  if(first >= (gint)event_viewer_data->rows_count) {
+    rows_read_forward(event_viewer_data,
+        first - event_viewer_data->rows_count + ROW_READ_AHEAD);
+    first = MIN(first, (gint)event_viewer_data->rows_count - 1);
+  }
+
+  if(event_viewer_data->scroll_by_count)
+    event_viewer_data->previous_value +=
+      first - (gint)event_viewer_data->rows_first;
+  row = row_at(event_viewer_data, first);
+  event_viewer_data->rows_first = first;
+  event_viewer_data->first_event = row->pos;
+  if(!event_viewer_data->scroll_by_count) {
+    time_span = lttv_traceset_get_time_span_real(ts);
+    event_viewer_data->previous_value =
+      ltt_time_to_double(ltt_time_sub(row->time, time_span.start_time));
+  }
+  return TRUE;
+}
+
+/* Fill the list with the cached rows, from the first one shown */
+static void rows_show(EventViewerData *event_viewer_data)
+{
+  LttTime selected_time;
+  guint selected_cpu, i, end;
+  GtkTreeIter iter;
+
+  gtk_list_store_clear(event_viewer_data->store_m);
+  g_ptr_array_set_size(event_viewer_data->pos, 0);
+
+  selected_time = lttv_traceset_position_get_time(
+                    event_viewer_data->currently_selected_position);
+  selected_cpu = lttv_traceset_position_get_cpuid(
+                    event_viewer_data->currently_selected_position);
+
+  end = MIN(event_viewer_data->rows_count,
+            event_viewer_data->rows_first
+            + event_viewer_data->num_visible_events);
+  for(i = event_viewer_data->rows_first; i < end; i++) {
+    EventRow *row = row_at(event_viewer_data, i);
+
+    gtk_list_store_append (event_viewer_data->store_m, &iter);
+
+    gtk_list_store_set (event_viewer_data->store_m, &iter,
+          TRACE_NAME_COLUMN, row->trace_name,
+          CPUID_COLUMN, row->cpu,
+          EVENT_COLUMN, row->name,
+          TIME_S_COLUMN, row->time.tv_sec,
+          TIME_NS_COLUMN, row->time.tv_nsec,
+          PID_COLUMN, row->pid,
+          EVENT_DESCR_COLUMN, row->desc,
+          POSITION_COLUMN, row->pos,
+          -1);
+
+    g_ptr_array_add(event_viewer_data->pos, row->pos);
+
+    if(event_viewer_data->update_cursor
+        && ltt_time_compare(row->time, selected_time) == 0
+        && row->cpu == selected_cpu) {
+      GtkTreePath *path = gtk_tree_path_new_from_indices(
+                          event_viewer_data->pos->len - 1, -1);
+			if(path) {
+	      gtk_tree_view_set_cursor(GTK_TREE_VIEW(event_viewer_data->tree_v),
+  	                           path, NULL, FALSE);
+    	  gtk_tree_path_free(path);
+			}
+    }
+  }
+}
+
+static void redraw(EventViewerData *event_viewer_data) {
+  guint first = 0;
+  LttvTraceset *ts = lttvwindow_get_traceset(event_viewer_data->tab);
+  
+  g_debug("EventViewer redraw");
+
+  //TODO ybrosseau verify its still required
+  lttvwindow_events_request_disable();
+  
+  if(event_viewer_data->first_event_cached) {
+    first = event_viewer_data->rows_first;
+  } else if(!rows_find(event_viewer_data, event_viewer_data->first_event,
+                       &first)) {
+    /* Not cached : start the cache at the first event shown */
+    gboolean at_end;
+    guint i;
+
+    rows_clear(event_viewer_data);
+    lttv_state_traceset_seek_position(ts, event_viewer_data->first_event);
+    at_end = read_rows(event_viewer_data,
+                  event_viewer_data->num_visible_events + ROW_READ_AHEAD);
+    for(i = 0; i < event_viewer_data->rows_read->len; i++)
+      rows_push_back(event_viewer_data,
+                     &g_array_index(event_viewer_data->rows_read, EventRow, i));
+    g_array_set_size(event_viewer_data->rows_read, 0);
+    event_viewer_data->rows_at_end = at_end;
+
+    if(!rows_find(event_viewer_data, event_viewer_data->first_event, &first))
+      first = 0;
+  }
+
+  if(event_viewer_data->rows_count > 0) {
+    event_viewer_data->rows_first = first;
+    event_viewer_data->rows_shown = TRUE;
+
+    /* Make sure the rows shown are cached */
+    if(event_viewer_data->rows_first + event_viewer_data->num_visible_events
+        > event_viewer_data->rows_count)
+      rows_read_forward(event_viewer_data, ROW_READ_AHEAD);
+
+    if(!event_viewer_data->first_event_cached) {
+      set_first_event(event_viewer_data,
+          row_at(event_viewer_data, event_viewer_data->rows_first)->pos);
+      event_viewer_data->first_event_cached = TRUE;
+    }
+    rows_show(event_viewer_data);
+  } else {
+    gtk_list_store_clear(event_viewer_data->store_m);
+    g_ptr_array_set_size(event_viewer_data->pos, 0);
+  }
   
   /* Get the end position */
   if(event_viewer_data->pos->len > 0) {
     LttvTracesetPosition *cur_pos = 
       (LttvTracesetPosition*)g_ptr_array_index(event_viewer_data->pos,
                                                event_viewer_data->pos->len - 1);
-    event_viewer_data->last_event = cur_pos;
+    set_last_event(event_viewer_data, cur_pos, event_viewer_data->rows_shown);
   } else
-        event_viewer_data->last_event =lttv_traceset_create_current_position(ts);
+    set_last_event(event_viewer_data,
+                   lttv_traceset_create_current_position(ts), FALSE);
   
   gtk_adjustment_set_value(event_viewer_data->vadjust_c,
       event_viewer_data->previous_value);
@@ -1220,6 +1801,11 @@ static void redraw(EventViewerData *event_viewer_data) {
         gtk_widget_get_parent_window(event_viewer_data->tree_v));
 
   lttvwindow_events_request_enable();
+
+  /* Read ahead in the scrolling direction */
+  if(event_viewer_data->rows_shown && event_viewer_data->prefetch_source_id == 0)
+    event_viewer_data->prefetch_source_id =
+      g_idle_add(prefetch_rows, event_viewer_data);
   
   return;
 }
@@ -1232,7 +1818,8 @@ int event_hook(void *hook_data, void *call_data)
   
   LttvEvent * e = (LttvEvent *)call_data;
 
-  if(event_viewer_data->num_events % CHECK_GDK_INTERVAL == 0) {
+  if(!event_viewer_data->prefetching
+      && event_viewer_data->num_events % CHECK_GDK_INTERVAL == 0) {
     GdkEvent *event;
     GtkWidget *widget;
     while((event = gdk_event_get()) != NULL) {
@@ -1270,53 +1857,59 @@ int event_hook(void *hook_data, void *call_data)
 //  LttEventType *event_type = ltt_event_eventtype(e);
   LttTime time = lttv_event_get_timestamp(e);
   gint cpu = lttv_traceset_get_cpuid_from_event(e);
+  gint ret;
+
+  /* The reads start at the first event of a timestamp, so the rank tells
+   * apart the events of the same timestamp, whatever their cpu */
+  if(ltt_time_compare(time, event_viewer_data->read_time) == 0)
+    event_viewer_data->read_rank++;
+  else {
+    event_viewer_data->read_time = time;
+    event_viewer_data->read_rank = 0;
+  }
+
+  /* Skip up to the last row already cached */
+  if(event_viewer_data->rows_skip) {
+    ret = ltt_time_compare(time, event_viewer_data->skip_time);
+    if(ret < 0 || (ret == 0
+          && event_viewer_data->read_rank <= event_viewer_data->skip_rank))
+      return FALSE;
+    event_viewer_data->rows_skip = FALSE;
+  }
+  /* Stop at the first row already cached */
+  if(event_viewer_data->rows_stop) {
+    ret = ltt_time_compare(time, event_viewer_data->stop_time);
+    if(ret > 0 || (ret == 0
+          && event_viewer_data->read_rank >= event_viewer_data->stop_rank)) {
+      event_viewer_data->rows_stopped = TRUE;
+      return TRUE;
+    }
+  }
 
   LttvTraceState *traceState = e->state;
   LttvProcessState *process = traceState->running_process[cpu];
 
-  GtkTreeIter iter;
+  EventRow row;
 
   GString *desc = g_string_new("");
   GString *name = g_string_new("");
   
-  LttvTracesetPosition *pos = lttv_traceset_create_current_position(traceState->trace->traceset);
-
   lttv_event_to_string(e, desc, TRUE, FALSE);
   lttv_event_get_name(e,name);
 
   g_info("detail : %s", desc->str);
 
-  gtk_list_store_append (event_viewer_data->store_m, &iter);
-
-  gtk_list_store_set (event_viewer_data->store_m, &iter,
-        TRACE_NAME_COLUMN, traceState->trace->short_name,
-        CPUID_COLUMN, cpu,
-        EVENT_COLUMN,name->str,
-        TIME_S_COLUMN, time.tv_sec,
-        TIME_NS_COLUMN, time.tv_nsec,
-        PID_COLUMN, process->pid,
-        EVENT_DESCR_COLUMN, desc->str,
-        POSITION_COLUMN, pos,
-        -1);
-
-  g_ptr_array_add(event_viewer_data->pos, pos);
-  
-  g_string_free(desc, TRUE);
-  g_string_free(name, TRUE);
-
-  if(event_viewer_data->update_cursor) {
-    if(lttv_traceset_position_compare(pos, 
-          event_viewer_data->currently_selected_position) == 0) {
-      GtkTreePath *path = gtk_tree_path_new_from_indices(
-                          event_viewer_data->pos->len - 1, -1);
-			if(path) {
-	      gtk_tree_view_set_cursor(GTK_TREE_VIEW(event_viewer_data->tree_v),
-  	                           path, NULL, FALSE);
-    	  gtk_tree_path_free(path);
-			}
-    }
-  }
-  if(event_viewer_data->pos->len >= event_viewer_data->num_visible_events )
+  row.pos = lttv_traceset_create_current_position(traceState->trace->traceset);
+  row.trace_name = traceState->trace->short_name;
+  row.cpu = cpu;
+  row.name = g_string_free(name, FALSE);
+  row.time = time;
+  row.pid = process->pid;
+  row.desc = g_string_free(desc, FALSE);
+  row.rank = event_viewer_data->read_rank;
+  g_array_append_val(event_viewer_data->rows_read, row);
+
+  if(event_viewer_data->rows_read->len >= event_viewer_data->rows_wanted)
     return TRUE;
   else
     return FALSE;
@@ -1360,6 +1953,15 @@ static void event_update_selection(EventViewerData *event_viewer_data)
   LttTime time;
   
   LttvTraceset * ts = lttvwindow_get_traceset(event_viewer_data->tab);
+  if(event_viewer_data->scroll_by_count) {
+    guint64 number;
+
+    if(lttv_traceset_index_get_number(event_viewer_data->index, ts,
+              event_viewer_data->currently_selected_position, &number))
+      gtk_adjustment_set_value(event_viewer_data->vadjust_c, number);
+    gtk_widget_grab_focus(event_viewer_data->tree_v );
+    return;
+  }
   TimeInterval time_span = lttv_traceset_get_time_span_real(ts);
   time = ltt_time_sub(currentTime, time_span.start_time);
   gtk_adjustment_set_value(event_viewer_data->vadjust_c,
@@ -1459,6 +2061,12 @@ gboolean timespan_changed(void * hook_data, void * call_data)
  
   LttTime end;
 
+  /* Number and cache the new events */
+  event_viewer_data->rows_at_end = FALSE;
+  scroll_by_time(event_viewer_data);
+  lttv_traceset_index_grow(event_viewer_data->index);
+  start_index(event_viewer_data);
+
   end = ltt_time_sub(time_span.end_time, time_span.start_time);
   event_viewer_data->vadjust_c->upper = ltt_time_to_double(end);
 
@@ -1480,8 +2088,12 @@ gboolean traceset_changed(void * hook_data, void * call_data)
   TimeInterval time_span = lttv_traceset_get_time_span_real(ts);
   
   LttTime end;
-  gtk_list_store_clear(event_viewer_data->store_m);
-  g_ptr_array_set_size(event_viewer_data->pos, 0);
+  rows_clear(event_viewer_data);
+
+  /* The positions shown belong to the previous traceset */
+  event_viewer_data->scroll_by_count = FALSE;
+  event_viewer_data->previous_value = 0;
+  start_index(event_viewer_data);
   
   end = ltt_time_sub(time_span.end_time, time_span.start_time);
   event_viewer_data->vadjust_c->upper = ltt_time_to_double(end);
@@ -1514,6 +2126,7 @@ gboolean filter_changed(void * hook_data, void * call_data)
 
   event_viewer_data->main_win_filter = 
     (LttvFilter*)call_data;
+  rows_clear(event_viewer_data);
   redraw(event_viewer_data);
 
   return FALSE;
@@ -1530,8 +2143,16 @@ gint evd_redraw_notify(void *hook_data, void *call_data)
 
 void gui_events_free(gpointer data)
 {
-#ifdef BABEL_CLEANUP
   LttvPluginEVD *plugin_evd = (LttvPluginEVD*)data;
+
+  if(plugin_evd->evd->index != NULL)
+    lttv_hooks_remove_data(
+        lttv_traceset_index_get_done_hooks(plugin_evd->evd->index),
+        index_done, plugin_evd->evd);
+  if(plugin_evd->evd->prefetch_source_id != 0)
+    g_source_remove(plugin_evd->evd->prefetch_source_id);
+  rows_free(plugin_evd->evd);
+#ifdef BABEL_CLEANUP
   Tab *tab = plugin_evd->evd->tab;
   EventViewerData *event_viewer_data = plugin_evd->evd;
   guint i;
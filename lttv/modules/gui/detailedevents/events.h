@@ -3,9 +3,22 @@
 
 #include <lttvwindow/lttvwindow.h>
 #include <lttvwindow/lttv_plugin_tab.h>
+#include <lttv/traceset-index.h>
 
 typedef struct _EventViewerData EventViewerData;
 
+/* A formatted row of the list, kept in the row cache */
+typedef struct _EventRow {
+  LttvTracesetPosition *pos;  /* owned by the row cache */
+  const gchar *trace_name;
+  guint cpu;
+  gchar *name;
+  LttTime time;
+  gint pid;
+  gchar *desc;
+  guint rank;                 /* Events of the same timestamp before it */
+} EventRow;
+
 struct _EventViewerData {
   
 
@@ -25,7 +38,7 @@ struct _EventViewerData {
   /* Model containing list data */
   GtkListStore *store_m;
 
-  GPtrArray *pos; /* Array of LttvTracesetContextPosition * */
+  GPtrArray *pos; /* Positions of the rows shown, owned by the row cache */
  
   GtkWidget *top_widget;
   GtkWidget *hbox_v;
@@ -68,6 +81,40 @@ struct _EventViewerData {
   GtkToolItem *button_filter;
 
   guint init_done;
+
+  LttvTracesetIndex *index;   /* Event numbers, built in the background,
+                                 shared by the viewers of the traceset */
+  gboolean scroll_by_count;   /* The scrollbar value is the number of the
+                                 first event shown instead of its time */
+
+  /* Row cache : ring buffer of consecutive formatted events around the rows
+   * shown, so scrolling neither seeks nor formats the events again. It is
+   * filled ahead in the scrolling direction from an idle function. */
+  EventRow *rows;
+  guint rows_head;            /* Index in rows of the first cached event */
+  guint rows_count;
+  guint rows_first;           /* Cached row shown first, if rows_shown */
+  gboolean rows_shown;        /* The rows shown come from the cache */
+  gboolean rows_at_begin;     /* The first cached row is the first event */
+  gboolean rows_at_end;       /* The last cached row is the last event */
+  gboolean first_event_cached;/* first_event belongs to the row cache */
+  gboolean last_event_cached; /* last_event belongs to the row cache */
+  gint scroll_direction;      /* Read ahead after (1) or before (-1) */
+  guint prefetch_source_id;
+  gboolean prefetching;
+
+  /* Rows read by event_hook before they enter the cache */
+  GArray *rows_read;
+  guint rows_wanted;
+  LttTime read_time;          /* Timestamp of the last event read */
+  guint read_rank;            /* Rank of the last event read at read_time */
+  gboolean rows_skip;         /* Ignore the events up to skip_time/skip_rank */
+  LttTime skip_time;
+  guint skip_rank;
+  gboolean rows_stop;         /* Stop before the event stop_time/stop_rank */
+  gboolean rows_stopped;
+  LttTime stop_time;
+  guint stop_rank;
 };
 
 extern gint evd_redraw_notify(void *hook_data, void *call_data);
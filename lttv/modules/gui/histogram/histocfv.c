@@ -76,6 +76,7 @@ guihistocontrolflow(LttvPluginTab *ptab)
   drawing_area = histo_drawing_get_drawing_area(drawing);
 
   histo_control_flow_data->number_of_process = 0;
+  histo_control_flow_data->event_index = NULL;
   
   ///histo_control_flow_data->background_info_waiting = 0;
 
@@ -217,6 +218,7 @@ void guihistocontrolflow_destructor(HistoControlFlowData *histo_control_flow_dat
          g_slist_remove(g_histo_control_flow_data_list,histo_control_flow_data);
 
   g_array_free(histo_control_flow_data->number_of_process, TRUE);
+  histo_index_release(histo_control_flow_data);
 
   g_info("HISTOCFV.c : guihistocontrolflow_destructor end, %p", histo_control_flow_data);
   g_free(histo_control_flow_data);
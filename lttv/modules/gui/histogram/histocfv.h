@@ -25,6 +25,8 @@
 #include <lttvwindow/mainwindow.h>
 #include <lttvwindow/lttv_plugin_tab.h>
 
+#include "histoindex.h"
+
 //#include "histobuttonwidget.h"
 
 extern GQuark LTT_NAME_CPU;
@@ -72,6 +74,11 @@ struct _HistoControlFlowData {
 
   LttvFilter *histo_main_win_filter;
   gboolean chunk_has_begun;
+
+  /* Event density index of the traceset, NULL until requested */
+  HistoEventIndex *event_index;
+  /* Time window of the pending events requests */
+  TimeWindow request_time_window;
 } ;
 
 /* Control Flow Data constructor */
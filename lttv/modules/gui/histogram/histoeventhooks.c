@@ -132,6 +132,140 @@ h_guihistocontrolflow(LttvPlugin *plugin)
 
  
 
+/* Event density index: built by one request over the whole traceset, owned
+ * by the index itself so the viewer requests do not cancel it. */
+static int histo_index_count_event(void *hook_data, void *call_data)
+{
+  HistoEventIndex *index = (HistoEventIndex*)hook_data;
+  LttvEvent *e = (LttvEvent*)call_data;
+
+  histo_index_add_event(index, histo_index_event_type(index, e),
+                        lttv_event_get_timestamp(e));
+  return 0;
+}
+
+static int histo_index_after_request(void *hook_data, void *call_data)
+{
+  EventsRequest *events_request = (EventsRequest*)hook_data;
+  HistoControlFlowData *histocontrol_flow_data = events_request->viewer_data;
+  HistoEventIndex *index = histocontrol_flow_data->event_index;
+  LttvTraceset *traceset =
+        lttvwindow_get_traceset(histocontrol_flow_data->tab);
+  gchar *path;
+
+  g_assert(index == events_request->owner);
+  histo_index_finalize(index);
+  path = histo_index_cache_path(traceset);
+  histo_index_save(index, path);
+  g_free(path);
+
+  /* Redraw from the index */
+  histo_redraw_notify(histocontrol_flow_data, NULL);
+  return 0;
+}
+
+static void histo_index_request(HistoControlFlowData *histocontrol_flow_data)
+{
+  Tab *tab = histocontrol_flow_data->tab;
+  LttvTraceset *traceset = lttvwindow_get_traceset(tab);
+  TimeInterval time_span;
+  HistoEventIndex *index;
+  gchar *path;
+
+  if(histocontrol_flow_data->event_index != NULL
+      || lttv_traceset_number(traceset) == 0)
+    return;
+
+  time_span = lttv_traceset_get_time_span_real(traceset);
+  path = histo_index_cache_path(traceset);
+  index = histo_index_load(path, time_span);
+  g_free(path);
+  histocontrol_flow_data->event_index = index;
+  if(index != NULL)
+    return;
+
+  index = histo_index_new(time_span);
+  histocontrol_flow_data->event_index = index;
+
+  EventsRequest *events_request = g_new(EventsRequest, 1);
+  LttvHooks *event_hooks = lttv_hooks_new();
+  lttv_hooks_add(event_hooks, histo_index_count_event, index,
+                 LTTV_PRIO_DEFAULT);
+  LttvHooks *after_request_hooks = lttv_hooks_new();
+  lttv_hooks_add(after_request_hooks, histo_index_after_request,
+                 events_request, LTTV_PRIO_DEFAULT);
+
+  events_request->owner                 = index;
+  events_request->viewer_data           = histocontrol_flow_data;
+  events_request->servicing             = FALSE;
+  events_request->start_time            = time_span.start_time;
+  events_request->start_position        = NULL;
+  events_request->stop_flag             = FALSE;
+  events_request->end_time              = ltt_time_infinite;
+  events_request->num_events            = G_MAXUINT;
+  events_request->end_position          = NULL;
+  events_request->trace                 = -1;
+  events_request->hooks                 = NULL;
+  events_request->before_chunk_traceset = NULL;
+  events_request->before_chunk_trace    = NULL;
+  events_request->before_chunk_tracefile= NULL;
+  events_request->event                 = event_hooks;
+  events_request->after_chunk_tracefile = NULL;
+  events_request->after_chunk_trace     = NULL;
+  events_request->after_chunk_traceset  = NULL;
+  events_request->before_request        = NULL;
+  events_request->after_request         = after_request_hooks;
+
+  lttvwindow_events_request(tab, events_request);
+}
+
+/* Forget the index, e.g. when the traceset changes */
+void histo_index_release(HistoControlFlowData *histocontrol_flow_data)
+{
+  HistoEventIndex *index = histocontrol_flow_data->event_index;
+
+  if(index == NULL)
+    return;
+
+  if(!index->ready)
+    lttvwindow_events_request_remove_all(histocontrol_flow_data->tab, index);
+  histo_index_destroy(index);
+  histocontrol_flow_data->event_index = NULL;
+}
+
+/* Fill the histogram from the index without reading events. Returns FALSE
+ * if the index is not ready or too coarse for the time window. */
+static gboolean histo_index_show(HistoControlFlowData *histocontrol_flow_data,
+                                 guint x, guint width)
+{
+  histoDrawing_t *drawing = histocontrol_flow_data->drawing;
+  TimeWindow time_window =
+        lttvwindow_get_time_window(histocontrol_flow_data->tab);
+  GArray *counts = histocontrol_flow_data->number_of_process;
+  guint i, end;
+  LttTime t1, t2;
+
+  if(!histo_index_usable(histocontrol_flow_data->event_index, &time_window,
+                         drawing->width))
+    return FALSE;
+
+  lttvwindow_events_request_remove_all(histocontrol_flow_data->tab,
+                                       histocontrol_flow_data);
+
+  end = MIN(x + width, counts->len);
+  histo_convert_pixels_to_time(drawing->width, x, time_window, &t1);
+  for(i = x; i < end; i++) {
+    histo_convert_pixels_to_time(drawing->width, i + 1, time_window, &t2);
+    g_array_index(counts, guint, i) =
+      histo_index_count(histocontrol_flow_data->event_index, 0, t1, t2);
+    t1 = t2;
+  }
+
+  drawing->damage_begin = x + width;
+  histogram_show(histocontrol_flow_data, x, x + width);
+  return TRUE;
+}
+
 /// added for histogram.
 void histo_request_event( HistoControlFlowData *histocontrol_flow_data, guint x, guint width)
 {
@@ -142,6 +276,13 @@ void histo_request_event( HistoControlFlowData *histocontrol_flow_data, guint x,
   TimeWindow time_window = lttvwindow_get_time_window( tab );
   LttTime time_start, time_end;
 
+  histo_index_request(histocontrol_flow_data);
+  if(histo_index_show(histocontrol_flow_data, x, width))
+    return;
+
+  /* Counted by histo_count_event */
+  histocontrol_flow_data->request_time_window = time_window;
+
   //find the tracehooks 
   LttvTraceset *traceset = lttvwindow_get_traceset(tab);
   
@@ -247,11 +388,10 @@ int histo_count_event(void *hook_data, void *call_data){
           tfc->t_context->t,tfc,NULL,NULL))
       return FALSE;
 #endif
-  TimeWindow time_window  =  lttvwindow_get_time_window(histocontrol_flow_data->tab);
   event_time = lttv_event_get_timestamp(e);
   
   histo_convert_time_to_pixels(
-          time_window,
+          histocontrol_flow_data->request_time_window,
           event_time,
           width,
           &x);
@@ -533,6 +673,7 @@ gint histo_traceset_notify(void *hook_data, void *call_data)
   }
 
   histo_drawing_clear(drawing,0,drawing->width);
+  histo_index_release(histocontrol_flow_data);
   
   guint i;
   for(i=0;i < histocontrol_flow_data->number_of_process->len;i++) 
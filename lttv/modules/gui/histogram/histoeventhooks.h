@@ -120,6 +120,7 @@ void histo_request_event( HistoControlFlowData *histocontrol_flow_data,guint x,
 int histo_count_event(void *hook_data, void *call_data);
 int histo_before_trace(void *hook_data, void *call_data);//replaced for histo_before_request
 int histo_after_trace(void *hook_data, void *call_data);//replaced for histo_after_request
+void histo_index_release(HistoControlFlowData *histocontrol_flow_data);
 
 gboolean histo_filter_changed(void * hook_data, void * call_data);
 
@@ -0,0 +1,355 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lttv/lttv.h>
+#include <lttv/compiler.h>
+#include <lttv/traceset.h>
+#include <lttv/event.h>
+#include <babeltrace/ctf/events.h>
+
+#include "histoindex.h"
+
+#define HISTO_INDEX_MAGIC "LTTVHIDX"
+#define HISTO_INDEX_VERSION 1
+
+typedef struct _HistoIndexHeader {
+  char magic[8];
+  guint32 version;
+  guint32 nb_types;
+  guint64 start;
+  guint64 end;
+  guint64 bucket_width;
+  guint32 nb_buckets;
+  guint32 pad;
+} HistoIndexHeader;
+
+
+HistoEventIndex *histo_index_new(TimeInterval time_span)
+{
+  HistoEventIndex *index = g_new(HistoEventIndex, 1);
+  guint64 duration;
+
+  index->start = ltt_time_to_uint64(time_span.start_time);
+  index->end = ltt_time_to_uint64(time_span.end_time);
+  duration = index->end - index->start + 1;
+  index->bucket_width = MAX(1, (duration + HISTO_INDEX_BUCKETS - 1)
+                                 / HISTO_INDEX_BUCKETS);
+  index->nb_buckets = (duration + index->bucket_width - 1)
+                        / index->bucket_width;
+  index->type_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+  index->decl_types = g_hash_table_new(g_direct_hash, g_direct_equal);
+  index->type_names = g_array_new(FALSE, FALSE, sizeof(GQuark));
+  index->types = g_ptr_array_new();
+  index->total = g_new0(guint64, index->nb_buckets + 1);
+  index->ready = FALSE;
+
+  return index;
+}
+
+void histo_index_destroy(HistoEventIndex *index)
+{
+  guint i;
+
+  for(i = 0; i < index->types->len; i++)
+    g_free(g_ptr_array_index(index->types, i));
+  g_ptr_array_free(index->types, TRUE);
+  g_array_free(index->type_names, TRUE);
+  g_hash_table_destroy(index->type_ids);
+  g_hash_table_destroy(index->decl_types);
+  g_free(index->total);
+  g_free(index);
+}
+
+static guint64 *get_type_counts(HistoEventIndex *index, GQuark type)
+{
+  guint id = GPOINTER_TO_UINT(g_hash_table_lookup(index->type_ids,
+                                                  GUINT_TO_POINTER(type)));
+  guint64 *counts;
+
+  if(likely(id != 0))
+    return (guint64*)g_ptr_array_index(index->types, id - 1);
+
+  counts = g_new0(guint64, index->nb_buckets + 1);
+  g_ptr_array_add(index->types, counts);
+  g_array_append_val(index->type_names, type);
+  g_hash_table_insert(index->type_ids, GUINT_TO_POINTER(type),
+                      GUINT_TO_POINTER(index->types->len));
+  return counts;
+}
+
+GQuark histo_index_event_type(HistoEventIndex *index, LttvEvent *e)
+{
+  const struct bt_ctf_event_decl *decl = bt_ctf_event_get_decl(e->bt_event);
+  GQuark type = GPOINTER_TO_UINT(g_hash_table_lookup(index->decl_types,
+                                                     decl));
+
+  if(likely(type != 0))
+    return type;
+
+  type = g_quark_from_string(lttv_traceset_get_name_from_event(e));
+  g_hash_table_insert(index->decl_types, (gpointer)decl,
+                      GUINT_TO_POINTER(type));
+  return type;
+}
+
+/* Counts are stored at bucket+1, the prefix sum of bucket b being the
+ * number of events before the beginning of b. */
+void histo_index_add_event(HistoEventIndex *index, GQuark type,
+    LttTime time)
+{
+  guint64 t = ltt_time_to_uint64(time);
+  guint bucket;
+
+  if(unlikely(t < index->start || t > index->end))
+    return;
+
+  bucket = (t - index->start) / index->bucket_width;
+  get_type_counts(index, type)[bucket + 1]++;
+  index->total[bucket + 1]++;
+}
+
+static void prefix_sum(guint64 *counts, guint nb_buckets)
+{
+  guint i;
+
+  for(i = 1; i <= nb_buckets; i++)
+    counts[i] += counts[i - 1];
+}
+
+void histo_index_finalize(HistoEventIndex *index)
+{
+  guint i;
+
+  for(i = 0; i < index->types->len; i++)
+    prefix_sum(g_ptr_array_index(index->types, i), index->nb_buckets);
+  prefix_sum(index->total, index->nb_buckets);
+  index->ready = TRUE;
+}
+
+gboolean histo_index_usable(HistoEventIndex *index,
+    TimeWindow *time_window, guint width)
+{
+  if(index == NULL || !index->ready || width == 0)
+    return FALSE;
+
+  /* A live trace may have grown since the index was built */
+  if(ltt_time_to_uint64(time_window->end_time) > index->end)
+    return FALSE;
+
+  /* Each pixel must cover at least one bucket, otherwise the interpolation
+   * of the partial buckets would show a flat histogram. */
+  return ltt_time_to_uint64(time_window->time_width) / width
+           >= index->bucket_width;
+}
+
+/* Number of events before t, interpolating within the bucket */
+static double prefix_at(HistoEventIndex *index, guint64 *prefix, guint64 t)
+{
+  guint64 offset;
+  guint bucket;
+  double fraction;
+
+  if(t <= index->start)
+    return 0;
+  offset = t - index->start;
+  bucket = offset / index->bucket_width;
+  if(bucket >= index->nb_buckets)
+    return prefix[index->nb_buckets];
+
+  fraction = (double)(offset % index->bucket_width) / index->bucket_width;
+  return prefix[bucket]
+           + fraction * (prefix[bucket + 1] - prefix[bucket]);
+}
+
+guint64 histo_index_count(HistoEventIndex *index, GQuark type,
+    LttTime t1, LttTime t2)
+{
+  guint64 *prefix;
+  double count;
+
+  if(type == 0) {
+    prefix = index->total;
+  } else {
+    guint id = GPOINTER_TO_UINT(g_hash_table_lookup(index->type_ids,
+                                                    GUINT_TO_POINTER(type)));
+    if(id == 0)
+      return 0;
+    prefix = (guint64*)g_ptr_array_index(index->types, id - 1);
+  }
+
+  count = prefix_at(index, prefix, ltt_time_to_uint64(t2))
+            - prefix_at(index, prefix, ltt_time_to_uint64(t1));
+  return (guint64)(count + 0.5);
+}
+
+/* The cache file name is a checksum of the trace paths and time span */
+gchar *histo_index_cache_path(LttvTraceset *traceset)
+{
+  GString *key = g_string_new("");
+  TimeInterval time_span = lttv_traceset_get_time_span_real(traceset);
+  gchar *checksum, *filename, *path;
+  guint i;
+
+  for(i = 0; i < lttv_traceset_number(traceset); i++)
+    g_string_append_printf(key, "%s\n",
+                           lttv_traceset_get(traceset, i)->full_path);
+  g_string_append_printf(key, "%lu.%09lu-%lu.%09lu",
+                         time_span.start_time.tv_sec,
+                         time_span.start_time.tv_nsec,
+                         time_span.end_time.tv_sec,
+                         time_span.end_time.tv_nsec);
+
+  checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5, key->str, -1);
+  filename = g_strdup_printf("histogram-%s.idx", checksum);
+  path = g_build_filename(g_get_user_cache_dir(), "lttv", filename, NULL);
+
+  g_free(filename);
+  g_free(checksum);
+  g_string_free(key, TRUE);
+  return path;
+}
+
+gboolean histo_index_save(HistoEventIndex *index, const gchar *path)
+{
+  HistoIndexHeader header;
+  gchar *dir, *tmp_path;
+  FILE *fp;
+  guint i;
+  gboolean ret = TRUE;
+
+  g_assert(index->ready);
+
+  dir = g_path_get_dirname(path);
+  g_mkdir_with_parents(dir, 0700);
+  g_free(dir);
+
+  /* Write in a temporary file so a concurrent reader never sees a partial
+   * index */
+  tmp_path = g_strdup_printf("%s.%d", path, getpid());
+  fp = g_fopen(tmp_path, "wb");
+  if(fp == NULL) {
+    g_warning("Cannot write histogram index %s", tmp_path);
+    g_free(tmp_path);
+    return FALSE;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, HISTO_INDEX_MAGIC, sizeof(header.magic));
+  header.version = HISTO_INDEX_VERSION;
+  header.nb_types = index->types->len;
+  header.start = index->start;
+  header.end = index->end;
+  header.bucket_width = index->bucket_width;
+  header.nb_buckets = index->nb_buckets;
+
+  if(fwrite(&header, sizeof(header), 1, fp) != 1)
+    ret = FALSE;
+  if(ret && fwrite(index->total, sizeof(guint64), index->nb_buckets + 1, fp)
+              != index->nb_buckets + 1)
+    ret = FALSE;
+  for(i = 0; ret && i < index->types->len; i++) {
+    const gchar *name = g_quark_to_string(
+        g_array_index(index->type_names, GQuark, i));
+    guint32 len = strlen(name);
+
+    if(fwrite(&len, sizeof(len), 1, fp) != 1
+        || fwrite(name, 1, len, fp) != len
+        || fwrite(g_ptr_array_index(index->types, i), sizeof(guint64),
+                  index->nb_buckets + 1, fp) != index->nb_buckets + 1)
+      ret = FALSE;
+  }
+
+  if(fclose(fp) != 0)
+    ret = FALSE;
+  if(ret)
+    ret = (g_rename(tmp_path, path) == 0);
+  if(!ret) {
+    g_warning("Cannot write histogram index %s", path);
+    g_unlink(tmp_path);
+  }
+  g_free(tmp_path);
+  return ret;
+}
+
+HistoEventIndex *histo_index_load(const gchar *path, TimeInterval time_span)
+{
+  HistoIndexHeader header;
+  HistoEventIndex *index;
+  FILE *fp;
+  guint i;
+
+  fp = g_fopen(path, "rb");
+  if(fp == NULL)
+    return NULL;
+
+  if(fread(&header, sizeof(header), 1, fp) != 1
+      || memcmp(header.magic, HISTO_INDEX_MAGIC, sizeof(header.magic)) != 0
+      || header.version != HISTO_INDEX_VERSION) {
+    fclose(fp);
+    return NULL;
+  }
+
+  index = histo_index_new(time_span);
+  if(index->start != header.start || index->end != header.end
+      || index->bucket_width != header.bucket_width
+      || index->nb_buckets != header.nb_buckets)
+    goto error;
+
+  if(fread(index->total, sizeof(guint64), index->nb_buckets + 1, fp)
+       != index->nb_buckets + 1)
+    goto error;
+
+  for(i = 0; i < header.nb_types; i++) {
+    guint32 len;
+    gchar *name;
+    guint64 *counts;
+
+    if(fread(&len, sizeof(len), 1, fp) != 1 || len > 4096)
+      goto error;
+    name = g_malloc(len + 1);
+    if(fread(name, 1, len, fp) != len) {
+      g_free(name);
+      goto error;
+    }
+    name[len] = '\0';
+    counts = get_type_counts(index, g_quark_from_string(name));
+    g_free(name);
+    if(fread(counts, sizeof(guint64), index->nb_buckets + 1, fp)
+         != index->nb_buckets + 1)
+      goto error;
+  }
+
+  fclose(fp);
+  index->ready = TRUE;
+  return index;
+
+error:
+  g_warning("Ignoring invalid histogram index %s", path);
+  fclose(fp);
+  histo_index_destroy(index);
+  return NULL;
+}
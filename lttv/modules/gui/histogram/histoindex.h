@@ -0,0 +1,80 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* The event density index
+ *
+ * The time span of the traceset is cut in HISTO_INDEX_BUCKETS buckets. One
+ * pass over the traceset counts the events of each type in each bucket, the
+ * counts are then turned into prefix sums. The number of events between two
+ * times is then the difference of two prefix sums, so the histogram of any
+ * time window coarser than a bucket is computed without reading events.
+ *
+ * The index is saved in the user cache directory and reloaded the next time
+ * the same traceset is opened.
+ */
+
+#ifndef _HISTO_INDEX_H
+#define _HISTO_INDEX_H
+
+#include <glib.h>
+#include <lttv/time.h>
+#include <lttv/traceset.h>
+#include <lttvwindow/lttvwindow.h>
+
+/* Number of buckets of the index, independently of the trace duration */
+#define HISTO_INDEX_BUCKETS 32768
+
+typedef struct _HistoEventIndex {
+  guint64 start;          /* start of the first bucket, in ns */
+  guint64 end;            /* end of the traceset time span, in ns */
+  guint64 bucket_width;   /* in ns */
+  guint nb_buckets;
+  GHashTable *type_ids;   /* event name GQuark -> index in types + 1 */
+  GHashTable *decl_types; /* bt_ctf_event_decl -> event name GQuark */
+  GArray *type_names;     /* event name GQuark of each type */
+  GPtrArray *types;       /* per type guint64[nb_buckets+1] prefix sums */
+  guint64 *total;         /* all types guint64[nb_buckets+1] prefix sums */
+  gboolean ready;         /* prefix sums are computed */
+} HistoEventIndex;
+
+HistoEventIndex *histo_index_new(TimeInterval time_span);
+void histo_index_destroy(HistoEventIndex *index);
+
+/* Type of an event, the name GQuark cached per event declaration */
+GQuark histo_index_event_type(HistoEventIndex *index, LttvEvent *e);
+
+/* Build the index: count each event, then compute the prefix sums */
+void histo_index_add_event(HistoEventIndex *index, GQuark type,
+    LttTime time);
+void histo_index_finalize(HistoEventIndex *index);
+
+/* TRUE if the index resolution is enough to draw the window on width
+ * pixels */
+gboolean histo_index_usable(HistoEventIndex *index,
+    TimeWindow *time_window, guint width);
+
+/* Number of events of a type (0 for all types) in [t1, t2[. Partial
+ * buckets are interpolated. */
+guint64 histo_index_count(HistoEventIndex *index, GQuark type,
+    LttTime t1, LttTime t2);
+
+/* Persistence, in the user cache directory */
+gchar *histo_index_cache_path(LttvTraceset *traceset);
+gboolean histo_index_save(HistoEventIndex *index, const gchar *path);
+HistoEventIndex *histo_index_load(const gchar *path, TimeInterval time_span);
+
+#endif //_HISTO_INDEX_H
@@ -37,6 +37,7 @@
 #include <lttv/iattribute.h>
 #include <lttv/traceset.h>
 #include <lttv/state.h>
+#include <lttv/state-intervals.h>
 #ifdef BABEL_CLEANUP
 #include <lttv/stats.h>
 #include <lttv/sync/sync_chain_lttv.h>
@@ -313,6 +314,8 @@ int SetTraceset(Tab * tab, LttvTraceset *traceset)
                                             new_time_window.time_width) ;
   }
   lttv_state_add_event_hooks(traceset);
+  /* Keep the state history for the queries of the viewers */
+  lttv_state_intervals_add_event_hooks(traceset);
 
   //TODO ybrosseau 2012-08-03 Temporarly compute checkpoints right at the adding
   // of the traceset
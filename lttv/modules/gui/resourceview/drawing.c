@@ -27,6 +27,7 @@
 #include <lttv/lttv.h>
 #include <lttvwindow/lttvwindow.h>
 #include <lttv/state.h>
+#include <lttv/state-intervals.h>
 #include <lttv/hook.h>
 
 #include "drawing.h"
@@ -596,6 +597,48 @@ tree_row_activated(GtkTreeModel *treemodel,
 }
 #endif //0
 
+/* Time of the next state change of the resource at height y after time, or
+ * of the previous one before it. Returns FALSE if it is not known. */
+static gboolean
+find_state_change(ControlFlowData *control_flow_data, guint y,
+                  gboolean previous, LttTime *time)
+{
+  LttvStateIntervals *intervals;
+  LttvResourceType resource_type;
+  GArray *history;
+  guint type, trace_num, id;
+
+  if(!resourcelist_get_resource_at(control_flow_data->process_list, y,
+                                   &type, &trace_num, &id))
+    return FALSE;
+
+  switch(type) {
+    case RV_RESOURCE_CPU:
+      resource_type = LTTV_RESOURCE_CPU;
+      break;
+    case RV_RESOURCE_IRQ:
+      resource_type = LTTV_RESOURCE_IRQ;
+      break;
+    case RV_RESOURCE_SOFT_IRQ:
+      resource_type = LTTV_RESOURCE_SOFT_IRQ;
+      break;
+    default:
+      /* The machines have no state, the traps and block devices are not
+       * recorded */
+      return FALSE;
+  }
+
+  intervals = lttv_state_intervals_get_from_traceset(
+      lttvwindow_get_traceset(control_flow_data->tab));
+  history = lttv_state_intervals_get_history(intervals, resource_type,
+      trace_num, id, 0);
+
+  if(previous)
+    return lttv_state_intervals_previous_change(history, *time, time);
+  else
+    return lttv_state_intervals_next_change(history, *time, time);
+}
+
 /* mouse click */
 static gboolean
 button_press_event( GtkWidget *widget, GdkEventButton *event, gpointer user_data )
@@ -620,6 +663,13 @@ button_press_event( GtkWidget *widget, GdkEventButton *event, gpointer user_data
         time_window,
         &time);
 
+    /* Shift-click : go to the next state change of the resource, or to the
+     * previous one with control */
+    if(event->state & GDK_SHIFT_MASK
+        && !find_state_change(control_flow_data, (guint)event->y,
+                              event->state & GDK_CONTROL_MASK, &time))
+      return FALSE;
+
     lttvwindow_report_current_time(control_flow_data->tab, time);
 
   }
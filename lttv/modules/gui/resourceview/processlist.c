@@ -222,6 +222,63 @@ void update_index_to_pixmap(ProcessList *process_list)
   g_ptr_array_set_size(process_list->index_to_pixmap, arg.count);
 }
 
+typedef struct _ResourceAtArg {
+  guint index;
+  guint count;
+  HashedResourceData *hdata;
+} ResourceAtArg;
+
+static gboolean find_resource_at_each(GtkTreeModel *model, GtkTreePath *path,
+    GtkTreeIter *iter, ResourceAtArg *arg)
+{
+  HashedResourceData *hdata;
+
+  gtk_tree_model_get(model, iter, DATA_COLUMN, &hdata, -1);
+
+  if(hdata->hidden != 0)
+    return FALSE;
+
+  if(arg->count++ == arg->index) {
+    arg->hdata = hdata;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+gboolean resourcelist_get_resource_at(ProcessList *process_list, guint y,
+    guint *type, guint *trace_num, guint *id)
+{
+  ResourceAtArg arg;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  if(process_list->cell_height == 0)
+    return FALSE;
+
+  /* The rows are counted like in update_index_to_pixmap */
+  arg.index = y / process_list->cell_height;
+  arg.count = 0;
+  arg.hdata = NULL;
+  gtk_tree_model_foreach(GTK_TREE_MODEL(process_list->list_store),
+      (GtkTreeModelForeachFunc)find_resource_at_each, &arg);
+  if(arg.hdata == NULL)
+    return FALSE;
+
+  g_hash_table_iter_init(&iter,
+      process_list->restypes[arg.hdata->type].hash_table);
+  while(g_hash_table_iter_next(&iter, &key, &value)) {
+    if(value == arg.hdata) {
+      ResourceUniqueNumeric *ru = (ResourceUniqueNumeric *)key;
+
+      *type = arg.hdata->type;
+      *trace_num = ru->trace_num;
+      *id = ru->id;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
 
 static void update_pixmap_size_each(void *key,
                                     HashedResourceData *value,
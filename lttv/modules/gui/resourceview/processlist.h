@@ -180,6 +180,11 @@ void processlist_set_ppid(ProcessList *process_list,
 /* Synchronize the list at the left and the drawing */
 void update_index_to_pixmap(ProcessList *process_list);
 
+/* Resource shown at height y of the drawing, type being one of the
+ * RV_RESOURCE_* values. Returns FALSE if there is no row there. */
+gboolean resourcelist_get_resource_at(ProcessList *process_list, guint y,
+    guint *type, guint *trace_num, guint *id);
+
 /* Update the width of each pixmap buffer for each process */
 void update_pixmap_size(ProcessList *process_list, guint width);
 
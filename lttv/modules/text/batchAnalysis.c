@@ -25,6 +25,9 @@
 
 #include <glib.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
 #include <lttv/lttv.h>
 #include <lttv/attribute.h>
 #include <lttv/hook.h>
@@ -36,9 +39,7 @@
 #include <lttv/stats.h>
 #include <lttv/filter.h>
 #endif
-#ifdef BABEL_CLEANUP_SYNC
 #include <lttv/sync/sync_chain_lttv.h>
-#endif
 #include <babeltrace/context.h>
 
 static LttvTraceset *traceset;
@@ -61,6 +62,13 @@ static int a_live_update_period;
 
 #define DEFAULT_LIVE_UPDATE_PERIOD 1
 
+/* Time given to the tracer to finish writing a burst of packets before the
+   traces are reopened, in ms */
+#define LIVE_SETTLE_DELAY 10
+/* Longest wait after the first write of a burst, in ms, for when the tracer
+   never stops writing */
+#define LIVE_SETTLE_MAX 50
+
 void lttv_trace_option(void *hook_data)
 { 
   //LttTrace *trace;
@@ -82,6 +90,60 @@ void lttv_trace_option(void *hook_data)
 }
 
 
+/* Watch the directories of the traces, the events of the stream files they
+   contain are reported. Returns the inotify descriptor or -1. */
+static int live_watch_traceset(LttvTraceset *ts)
+{
+  guint i;
+  int fd;
+
+  fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if(fd < 0) {
+    g_warning("Cannot watch the live traces: %s", g_strerror(errno));
+    return -1;
+  }
+  for(i = 0; i < lttv_traceset_number(ts); i++) {
+    LttvTrace *trace = lttv_traceset_get(ts, i);
+
+    if(inotify_add_watch(fd, trace->full_path,
+          IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) < 0) {
+      g_warning("Cannot watch trace %s: %s", trace->full_path,
+          g_strerror(errno));
+    }
+  }
+  return fd;
+}
+
+
+/* Wait until a trace file changes. Returns FALSE if nothing was written
+   during timeout ms. */
+static gboolean live_wait(int fd, int timeout)
+{
+  struct pollfd pfd;
+  char buf[4096];
+  GTimer *timer;
+  int remaining;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  if(poll(&pfd, 1, timeout) <= 0) {
+    return FALSE;
+  }
+
+  /* The streams are usually flushed together, reopen the traces once for
+     the whole burst */
+  timer = g_timer_new();
+  do {
+    while(read(fd, buf, sizeof(buf)) > 0);
+    remaining = LIVE_SETTLE_MAX - g_timer_elapsed(timer, NULL) * 1000;
+  } while(remaining > 0
+      && poll(&pfd, 1, MIN(remaining, LIVE_SETTLE_DELAY)) > 0);
+  g_timer_destroy(timer);
+
+  return TRUE;
+}
+
+
 static gboolean process_traceset(void *hook_data, void *call_data)
 {
 #ifdef BABEL_CLEANUP
@@ -114,9 +176,6 @@ static gboolean process_traceset(void *hook_data, void *call_data)
 
   lttv_context_init(tc, traceset);
 
-
-  syncTraceset(tc);
-
   lttv_state_add_event_hooks(tss);
   if(a_stats) lttv_stats_add_event_hooks(tscs);
 
@@ -145,6 +204,10 @@ static gboolean process_traceset(void *hook_data, void *call_data)
   //before_traceset, after_traceset, NULL, before_trace, after_trace,
   //NULL, before_tracefile, after_tracefile, NULL, before_event, after_event);
 
+  /* Synchronize before the state hooks are added, the sync pass reads the
+     whole traceset on its own */
+  syncTraceset(traceset);
+
   lttv_state_add_event_hooks(traceset);
   lttv_process_traceset_begin(traceset,
                               before_traceset,
@@ -159,27 +222,33 @@ static gboolean process_traceset(void *hook_data, void *call_data)
   g_info("BatchAnalysis process traceset");
  
   lttv_process_traceset_seek_time(traceset, start);
-  /* Read as long a we do not reach the end (0) */
-  unsigned int count;
-#ifdef BABEL_CLEANUP
-  unsigned int updated_count;
-#endif
-  do {
-	  count = lttv_process_traceset_middle(traceset,
-							  end,
-							  G_MAXULONG,
-							  NULL);
-	  
-#ifdef BABEL_CLEANUP
-	  updated_count = lttv_process_traceset_update(tc);
-#endif
-		
-	  sleep(a_live_update_period);
-  } while(count != 0
-#ifdef BABEL_CLEANUP
-      || updated_count > 0
-#endif
-      );
+
+  /* Follow the live traces until nothing is written to them for a whole
+     period. The events are only read up to the time where every stream has
+     written its packets, an update skips the late events older than those
+     already read. The traces are reopened, all of them, only when this time
+     moves. The rest of the events is read at the end. */
+  if(a_live) {
+    int fd = live_watch_traceset(traceset);
+
+    if(fd >= 0) {
+      LttTime complete = lttv_process_traceset_get_complete_time(traceset);
+
+      lttv_process_traceset_middle(traceset, complete, G_MAXULONG, NULL);
+      while(live_wait(fd, a_live_update_period * 1000)) {
+        LttTime next = lttv_process_traceset_get_complete_time(traceset);
+
+        if(ltt_time_compare(next, complete) > 0) {
+          complete = next;
+          lttv_process_traceset_update(traceset);
+          lttv_process_traceset_middle(traceset, complete, G_MAXULONG, NULL);
+        }
+      }
+      close(fd);
+      lttv_process_traceset_update(traceset);
+    }
+  }
+  lttv_process_traceset_middle(traceset, end, G_MAXULONG, NULL);
 
 
   //lttv_traceset_context_remove_hooks(tc,
@@ -236,7 +305,7 @@ static void init()
   
   a_live_update_period = DEFAULT_LIVE_UPDATE_PERIOD;
   lttv_option_add("live-period", 0,
-		  "period to update a live trace",
+		  "stop following a live trace after this period without new data",
 		  "in seconds",
 		  LTTV_OPT_INT,
 		  &a_live_update_period,
@@ -336,5 +405,5 @@ static void destroy()
 
 LTTV_MODULE("batchAnalysis", "Batch processing of a trace", \
     "Run through a trace calling all the registered hooks", \
-    init, destroy, "state", "option")
-//TODO ybrosseau 2012-05-15 reenable textFilter, stats, sync
+    init, destroy, "state", "option", "sync")
+//TODO ybrosseau 2012-05-15 reenable textFilter, stats
@@ -0,0 +1,492 @@
+/*
+ * This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * Column dump plugin exports the events, with the process state at each
+ * event, in a binary columnar format meant to be loaded by analysis tools
+ * without parsing text.
+ *
+ * The file starts with the 8 bytes "LTTVCOL\2" followed by records. A record
+ * is a tag byte, the length of its body as a varint and the body. Varints are
+ * unsigned LEB128, signed values are zigzag encoded before, fixed size
+ * integers are little endian. Strings are a varint length and the bytes.
+ *
+ * 'S' schema of an event type, written before its first event:
+ *	varint type id, string event name, varint trace id,
+ *	varint field count, then for each field: string name, byte kind
+ *	(COLUMN_KIND_*)
+ * 'N' name, written before the first event that uses it:
+ *	varint name id, string
+ *	The names are the process names, the execution modes and the values
+ *	of the string fields. The ids are numbered from 0 in the file.
+ * 'C' chunk of at most COLUMN_CHUNK_EVENTS consecutive events:
+ *	varint event count, u64 min time, u64 max time, u64 first time,
+ *	then the columns, each one is a varint byte length and the values:
+ *	time (signed difference with the previous event), trace id, cpu,
+ *	type id, pid, tid, ppid, process name id, execution mode name id.
+ *	Then, for each event type of the chunk in type id order: varint type
+ *	id, varint row count and one column per field of the schema. The
+ *	string fields hold the varint id of their value, the fields of
+ *	COLUMN_KIND_NONE the id of the empty string.
+ *
+ * The times are in ns, with the synchronization correction. A reader can skip
+ * a chunk from its time stats and a column from its length.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <lttv/lttv.h>
+#include <lttv/option.h>
+#include <lttv/module.h>
+#include <lttv/hook.h>
+#include <lttv/attribute.h>
+#include <lttv/iattribute.h>
+#include <lttv/traceset.h>
+#include <lttv/event.h>
+#include <lttv/state.h>
+#include <babeltrace/ctf/events.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "columnformat.h"
+
+/* A chunk is written when it has this many events or this many bytes of
+   payload fields */
+#define COLUMN_CHUNK_EVENTS 65536
+#define COLUMN_CHUNK_BYTES (16 * 1024 * 1024)
+
+typedef enum {
+	COLUMN_KIND_UNSIGNED,	/* varint */
+	COLUMN_KIND_SIGNED,	/* zigzag varint */
+	COLUMN_KIND_STRING,	/* name id, also char arrays */
+	COLUMN_KIND_NONE,	/* other types, the id of the empty string */
+} ColumnKind;
+
+typedef enum {
+	COLUMN_TIME,
+	COLUMN_TRACE,
+	COLUMN_CPU,
+	COLUMN_TYPE,
+	COLUMN_PID,
+	COLUMN_TID,
+	COLUMN_PPID,
+	COLUMN_NAME,
+	COLUMN_MODE,
+	COLUMN_NB,
+} ColumnId;
+
+/* An event type, the payload columns hold its events of the current chunk */
+typedef struct {
+	guint id;
+	guint nb_fields;
+	ColumnKind *kinds;
+	GByteArray **columns;
+	guint rows;
+} ColumnType;
+
+static char *a_file_name;
+
+static LttvHooks *before_traceset;
+static LttvHooks *after_traceset;
+static LttvHooks *event_hook;
+
+static FILE *a_file;
+
+/* ColumnType by struct bt_ctf_event_decl*, and by id */
+static GHashTable *types_by_decl;
+static GPtrArray *types;
+
+/* Name ids by string, and by GQuark for the process fields */
+static ColumnNames *names;
+static GHashTable *name_ids;
+
+static GByteArray *columns[COLUMN_NB];
+static GByteArray *record;
+static guint chunk_events;
+static gsize chunk_bytes;
+static guint64 chunk_min, chunk_max, chunk_first, previous_time;
+
+static void write_record(char tag, GByteArray *body)
+{
+	GByteArray *header = g_byte_array_sized_new(11);
+
+	g_byte_array_append(header, (const guint8 *) &tag, 1);
+	column_put_varint(header, body->len);
+	if (fwrite(header->data, 1, header->len, a_file) != header->len ||
+			fwrite(body->data, 1, body->len, a_file) != body->len) {
+		g_error("cannot write to file %s", a_file_name);
+	}
+	g_byte_array_free(header, TRUE);
+}
+
+/* Append a column with its length to the record */
+static void put_column(GByteArray *column)
+{
+	column_put_varint(record, column->len);
+	g_byte_array_append(record, column->data, column->len);
+	g_byte_array_set_size(column, 0);
+}
+
+static void write_chunk(void)
+{
+	guint i, j;
+
+	if (chunk_events == 0) {
+		return;
+	}
+
+	g_byte_array_set_size(record, 0);
+	column_put_varint(record, chunk_events);
+	column_put_u64(record, chunk_min);
+	column_put_u64(record, chunk_max);
+	column_put_u64(record, chunk_first);
+	for (i = 0; i < COLUMN_NB; i++) {
+		put_column(columns[i]);
+	}
+	for (i = 0; i < types->len; i++) {
+		ColumnType *type = g_ptr_array_index(types, i);
+
+		if (type->rows == 0) {
+			continue;
+		}
+		column_put_varint(record, type->id);
+		column_put_varint(record, type->rows);
+		for (j = 0; j < type->nb_fields; j++) {
+			put_column(type->columns[j]);
+		}
+		type->rows = 0;
+	}
+	write_record('C', record);
+
+	chunk_events = 0;
+	chunk_bytes = 0;
+}
+
+/* Find the id of a string, its record is written the first time */
+static guint get_string_id(const char *str)
+{
+	guint id;
+
+	if (column_names_get_id(names, str, &id)) {
+		g_byte_array_set_size(record, 0);
+		column_put_varint(record, id);
+		column_put_string(record, str);
+		write_record('N', record);
+	}
+	return id;
+}
+
+static guint get_name_id(GQuark name)
+{
+	gpointer id;
+
+	if (g_hash_table_lookup_extended(name_ids, GUINT_TO_POINTER(name), NULL,
+				&id)) {
+		return GPOINTER_TO_UINT(id);
+	}
+
+	id = GUINT_TO_POINTER(get_string_id(g_quark_to_string(name)));
+	g_hash_table_insert(name_ids, GUINT_TO_POINTER(name), id);
+	return GPOINTER_TO_UINT(id);
+}
+
+static ColumnKind get_kind(const struct bt_definition *field)
+{
+	const struct bt_declaration *decl = bt_ctf_get_decl_from_def(field);
+
+	switch (bt_ctf_field_type(decl)) {
+	case CTF_TYPE_INTEGER:
+		return bt_ctf_get_int_signedness(decl) == 1 ?
+			COLUMN_KIND_SIGNED : COLUMN_KIND_UNSIGNED;
+	case CTF_TYPE_STRING:
+	case CTF_TYPE_ARRAY:
+		return COLUMN_KIND_STRING;
+	default:
+		return COLUMN_KIND_NONE;
+	}
+}
+
+/* Find the type of an event, its schema is written the first time */
+static ColumnType *get_type(LttvEvent *event,
+		struct bt_definition const * const *list, unsigned int count)
+{
+	const struct bt_ctf_event_decl *event_decl;
+	ColumnType *type;
+	guint i;
+
+	event_decl = bt_ctf_event_get_decl(event->bt_event);
+	type = g_hash_table_lookup(types_by_decl, event_decl);
+	if (type != NULL) {
+		return type;
+	}
+
+	type = g_new(ColumnType, 1);
+	type->id = types->len;
+	type->nb_fields = count;
+	type->kinds = g_new(ColumnKind, count);
+	type->columns = g_new(GByteArray *, count);
+	type->rows = 0;
+	g_ptr_array_add(types, type);
+	g_hash_table_insert(types_by_decl, (gpointer) event_decl, type);
+
+	g_byte_array_set_size(record, 0);
+	column_put_varint(record, type->id);
+	column_put_string(record, bt_ctf_event_name(event->bt_event));
+	column_put_varint(record, event->state->trace->id);
+	column_put_varint(record, count);
+	for (i = 0; i < count; i++) {
+		guint8 kind;
+
+		type->kinds[i] = get_kind(list[i]);
+		type->columns[i] = g_byte_array_new();
+		kind = type->kinds[i];
+		column_put_string(record, bt_ctf_field_name(list[i]));
+		g_byte_array_append(record, &kind, 1);
+	}
+	write_record('S', record);
+
+	return type;
+}
+
+static void free_type(gpointer data)
+{
+	ColumnType *type = data;
+	guint i;
+
+	for (i = 0; i < type->nb_fields; i++) {
+		g_byte_array_free(type->columns[i], TRUE);
+	}
+	g_free(type->columns);
+	g_free(type->kinds);
+	g_free(type);
+}
+
+static void put_fields(ColumnType *type, struct bt_ctf_event *ctf_event,
+		struct bt_definition const * const *list, unsigned int count)
+{
+	guint i;
+
+	for (i = 0; i < type->nb_fields; i++) {
+		GByteArray *column = type->columns[i];
+		const struct bt_definition *field = i < count ? list[i] : NULL;
+		guint len = column->len;
+
+		switch (type->kinds[i]) {
+		case COLUMN_KIND_UNSIGNED:
+			column_put_varint(column, field ? bt_ctf_get_uint64(field) : 0);
+			break;
+		case COLUMN_KIND_SIGNED:
+			column_put_signed(column, field ? bt_ctf_get_int64(field) : 0);
+			break;
+		case COLUMN_KIND_STRING:
+			if (field == NULL) {
+				column_put_varint(column, get_string_id(NULL));
+			} else if (bt_ctf_field_type(bt_ctf_get_decl_from_def(field)) ==
+					CTF_TYPE_ARRAY) {
+				column_put_varint(column,
+						get_string_id(bt_ctf_get_char_array(field)));
+			} else {
+				column_put_varint(column,
+						get_string_id(bt_ctf_get_string(field)));
+			}
+			break;
+		case COLUMN_KIND_NONE:
+			column_put_varint(column, get_string_id(NULL));
+			break;
+		}
+		chunk_bytes += column->len - len;
+	}
+	type->rows++;
+}
+
+static gboolean open_output_file(void *hook_data, void *call_data)
+{
+	if (a_file_name == NULL) {
+		return FALSE;
+	}
+
+	g_info("Open the column output file");
+	a_file = fopen(a_file_name, "w");
+	if (a_file == NULL) {
+		g_error("cannot open file %s", a_file_name);
+	}
+	fwrite(COLUMN_MAGIC, 1, 8, a_file);
+
+	chunk_events = 0;
+	chunk_bytes = 0;
+	return FALSE;
+}
+
+static gboolean close_output_file(void *hook_data, void *call_data)
+{
+	if (a_file == NULL) {
+		return FALSE;
+	}
+
+	write_chunk();
+	fclose(a_file);
+	a_file = NULL;
+
+	/* Types and names are written again in the next file */
+	g_hash_table_remove_all(types_by_decl);
+	g_ptr_array_set_size(types, 0);
+	column_names_clear(names);
+	g_hash_table_remove_all(name_ids);
+	return FALSE;
+}
+
+static int write_event_content(void *hook_data, void *call_data)
+{
+	LttvEvent *event = (LttvEvent *)call_data;
+	struct bt_ctf_event *ctf_event = event->bt_event;
+	struct bt_definition const * const *list = NULL;
+	const struct bt_definition *scope;
+	unsigned int count = 0;
+	LttvProcessState *process;
+	ColumnType *type;
+	guint64 timestamp = event->timestamp;
+	guint cpu;
+
+	if (a_file == NULL) {
+		return FALSE;
+	}
+
+	scope = bt_ctf_get_top_level_scope(ctf_event, BT_EVENT_FIELDS);
+	if (scope == NULL ||
+			bt_ctf_get_field_list(ctf_event, scope, &list, &count) < 0) {
+		count = 0;
+	}
+	type = get_type(event, list, count);
+
+	cpu = lttv_traceset_get_cpuid_from_event(event);
+	process = event->state->running_process[cpu];
+
+	if (chunk_events == 0) {
+		chunk_min = chunk_max = chunk_first = previous_time = timestamp;
+	}
+	if (timestamp < chunk_min) {
+		chunk_min = timestamp;
+	}
+	if (timestamp > chunk_max) {
+		chunk_max = timestamp;
+	}
+
+	column_put_signed(columns[COLUMN_TIME], timestamp - previous_time);
+	column_put_varint(columns[COLUMN_TRACE], event->state->trace->id);
+	column_put_varint(columns[COLUMN_CPU], cpu);
+	column_put_varint(columns[COLUMN_TYPE], type->id);
+	column_put_varint(columns[COLUMN_PID], process->tgid);
+	column_put_varint(columns[COLUMN_TID], process->pid);
+	column_put_varint(columns[COLUMN_PPID], process->ppid);
+	column_put_varint(columns[COLUMN_NAME], get_name_id(process->name));
+	column_put_varint(columns[COLUMN_MODE], get_name_id(process->state->t));
+	previous_time = timestamp;
+
+	put_fields(type, ctf_event, list, count);
+
+	chunk_events++;
+	if (chunk_events == COLUMN_CHUNK_EVENTS ||
+			chunk_bytes >= COLUMN_CHUNK_BYTES) {
+		write_chunk();
+	}
+
+	return FALSE;
+}
+
+static void init()
+{
+	gboolean result;
+	guint i;
+
+	LttvAttributeValue value;
+
+	LttvIAttribute *attributes = LTTV_IATTRIBUTE(lttv_global_attributes());
+
+	g_info("Init columnDump.c");
+
+	types_by_decl = g_hash_table_new(g_direct_hash, g_direct_equal);
+	types = g_ptr_array_new_with_free_func(free_type);
+	names = column_names_new();
+	name_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < COLUMN_NB; i++) {
+		columns[i] = g_byte_array_new();
+	}
+	record = g_byte_array_new();
+
+	a_file = NULL;
+	a_file_name = NULL;
+	lttv_option_add("column-output", '\0',
+			"file where the events are written in columns",
+			"file name",
+			LTTV_OPT_STRING, &a_file_name, NULL, NULL);
+
+	result = lttv_iattribute_find_by_path(attributes, "hooks/event",
+			LTTV_POINTER, &value);
+	g_assert(result);
+	event_hook = *(value.v_pointer);
+	g_assert(event_hook);
+	lttv_hooks_add(event_hook, write_event_content, NULL, LTTV_PRIO_DEFAULT);
+
+	result = lttv_iattribute_find_by_path(attributes, "hooks/traceset/before",
+			LTTV_POINTER, &value);
+	g_assert(result);
+	before_traceset = *(value.v_pointer);
+	g_assert(before_traceset);
+	lttv_hooks_add(before_traceset, open_output_file, NULL,
+			LTTV_PRIO_DEFAULT);
+
+	result = lttv_iattribute_find_by_path(attributes, "hooks/traceset/after",
+			LTTV_POINTER, &value);
+	g_assert(result);
+	after_traceset = *(value.v_pointer);
+	g_assert(after_traceset);
+	lttv_hooks_add(after_traceset, close_output_file, NULL,
+			LTTV_PRIO_DEFAULT);
+}
+
+static void destroy()
+{
+	guint i;
+
+	g_info("Destroy columnDump");
+
+	lttv_option_remove("column-output");
+
+	g_hash_table_destroy(types_by_decl);
+	g_ptr_array_free(types, TRUE);
+	column_names_destroy(names);
+	g_hash_table_destroy(name_ids);
+	for (i = 0; i < COLUMN_NB; i++) {
+		g_byte_array_free(columns[i], TRUE);
+	}
+	g_byte_array_free(record, TRUE);
+
+	lttv_hooks_remove_data(event_hook, write_event_content, NULL);
+
+	lttv_hooks_remove_data(before_traceset, open_output_file, NULL);
+
+	lttv_hooks_remove_data(after_traceset, close_output_file, NULL);
+}
+
+
+LTTV_MODULE("columnDump", "Export events in a columnar binary file",
+		"Write the events and the process state at each event in "
+		"compact columns, chunk by chunk",
+		init, destroy, "batchAnalysis", "option")
@@ -0,0 +1,163 @@
+/*
+ * This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "columnformat.h"
+
+struct _ColumnNames {
+	GHashTable *ids;	/* id by name */
+};
+
+void column_put_varint(GByteArray *a, guint64 value)
+{
+	guint8 buf[10];
+	guint len = 0;
+
+	while (value >= 0x80) {
+		buf[len++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	buf[len++] = value;
+	g_byte_array_append(a, buf, len);
+}
+
+void column_put_signed(GByteArray *a, gint64 value)
+{
+	column_put_varint(a, ((guint64) value << 1) ^ (guint64) (value >> 63));
+}
+
+void column_put_u64(GByteArray *a, guint64 value)
+{
+	guint8 buf[8];
+	guint i;
+
+	for (i = 0; i < 8; i++) {
+		buf[i] = value >> (8 * i);
+	}
+	g_byte_array_append(a, buf, 8);
+}
+
+void column_put_string(GByteArray *a, const char *str)
+{
+	gsize len = str != NULL ? strlen(str) : 0;
+
+	column_put_varint(a, len);
+	g_byte_array_append(a, (const guint8 *) str, len);
+}
+
+gboolean column_get_varint(const guint8 *data, gsize len, gsize *pos,
+		guint64 *value)
+{
+	guint shift = 0;
+
+	*value = 0;
+	while (*pos < len && shift < 64) {
+		guint8 byte = data[(*pos)++];
+
+		*value |= (guint64) (byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return TRUE;
+		}
+		shift += 7;
+	}
+	return FALSE;
+}
+
+gboolean column_get_signed(const guint8 *data, gsize len, gsize *pos,
+		gint64 *value)
+{
+	guint64 zigzag;
+
+	if (!column_get_varint(data, len, pos, &zigzag)) {
+		return FALSE;
+	}
+	*value = (gint64) (zigzag >> 1) ^ -(gint64) (zigzag & 1);
+	return TRUE;
+}
+
+gboolean column_get_u64(const guint8 *data, gsize len, gsize *pos,
+		guint64 *value)
+{
+	guint i;
+
+	if (*pos > len || len - *pos < 8) {
+		return FALSE;
+	}
+	*value = 0;
+	for (i = 0; i < 8; i++) {
+		*value |= (guint64) data[*pos + i] << (8 * i);
+	}
+	*pos += 8;
+	return TRUE;
+}
+
+gboolean column_get_string(const guint8 *data, gsize len, gsize *pos,
+		const char **str, gsize *str_len)
+{
+	guint64 length;
+
+	if (!column_get_varint(data, len, pos, &length) || length > len - *pos) {
+		return FALSE;
+	}
+	*str = (const char *) data + *pos;
+	*str_len = length;
+	*pos += length;
+	return TRUE;
+}
+
+ColumnNames *column_names_new(void)
+{
+	ColumnNames *names = g_new(ColumnNames, 1);
+
+	names->ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			NULL);
+	return names;
+}
+
+void column_names_destroy(ColumnNames *names)
+{
+	g_hash_table_destroy(names->ids);
+	g_free(names);
+}
+
+void column_names_clear(ColumnNames *names)
+{
+	g_hash_table_remove_all(names->ids);
+}
+
+gboolean column_names_get_id(ColumnNames *names, const char *name, guint *id)
+{
+	gpointer value;
+
+	if (name == NULL) {
+		name = "";
+	}
+	if (g_hash_table_lookup_extended(names->ids, name, NULL, &value)) {
+		*id = GPOINTER_TO_UINT(value);
+		return FALSE;
+	}
+
+	*id = g_hash_table_size(names->ids);
+	g_hash_table_insert(names->ids, g_strdup(name), GUINT_TO_POINTER(*id));
+	return TRUE;
+}
@@ -0,0 +1,59 @@
+/*
+ * This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef COLUMNFORMAT_H
+#define COLUMNFORMAT_H
+
+#include <glib.h>
+
+/* Values and names of the columnar file written by columnDump, whose format
+   is described in columnDump.c */
+
+#define COLUMN_MAGIC "LTTVCOL\2"
+
+void column_put_varint(GByteArray *a, guint64 value);
+void column_put_signed(GByteArray *a, gint64 value);
+void column_put_u64(GByteArray *a, guint64 value);
+/* NULL is written as the empty string */
+void column_put_string(GByteArray *a, const char *str);
+
+/* Read a value at *pos in the len bytes of data and move *pos after it.
+   Returns FALSE if the value does not fit in the data. */
+gboolean column_get_varint(const guint8 *data, gsize len, gsize *pos,
+		guint64 *value);
+gboolean column_get_signed(const guint8 *data, gsize len, gsize *pos,
+		gint64 *value);
+gboolean column_get_u64(const guint8 *data, gsize len, gsize *pos,
+		guint64 *value);
+/* The string is not null terminated, it points into data */
+gboolean column_get_string(const guint8 *data, gsize len, gsize *pos,
+		const char **str, gsize *str_len);
+
+/* The names of a file, numbered in the order they are added. Each name is
+   written once in a 'N' record and the columns hold its id. */
+typedef struct _ColumnNames ColumnNames;
+
+ColumnNames *column_names_new(void);
+void column_names_destroy(ColumnNames *names);
+/* Forget the names, for a new file */
+void column_names_clear(ColumnNames *names);
+/* Find the id of a name, NULL is the empty string. Returns TRUE if the name
+   is new, its 'N' record must then be written before it is used. */
+gboolean column_names_get_id(ColumnNames *names, const char *name, guint *id);
+
+#endif // COLUMNFORMAT_H
@@ -0,0 +1,182 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Write values and a dictionary encoded string column like columnDump does,
+ * then read them back. The program aborts if a check fails.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "columnformat.h"
+
+static const guint64 unsigned_values[] = {
+	0, 1, 127, 128, 300, G_MAXUINT32, G_MAXUINT64,
+};
+
+static const gint64 signed_values[] = {
+	0, 1, -1, 63, -64, 64, G_MAXINT64, G_MININT64,
+};
+
+/* Values of a string field, NULL stands for a missing field */
+static const char *strings[] = {
+	"sshd", "bash", NULL, "sshd", "", "/usr/bin/make", "bash", "sshd",
+};
+
+#define NB_STRINGS (sizeof(strings) / sizeof(strings[0]))
+/* Distinct values of strings, "" and NULL are the same name */
+#define NB_NAMES 4
+
+static void put_record(GByteArray *file, char tag, GByteArray *body)
+{
+	g_byte_array_append(file, (const guint8 *) &tag, 1);
+	column_put_varint(file, body->len);
+	g_byte_array_append(file, body->data, body->len);
+}
+
+static void check_values(void)
+{
+	GByteArray *a = g_byte_array_new();
+	gsize pos = 0;
+	guint64 u;
+	gint64 s;
+	const char *str;
+	gsize len;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(unsigned_values); i++) {
+		column_put_varint(a, unsigned_values[i]);
+		column_put_u64(a, unsigned_values[i]);
+	}
+	for (i = 0; i < G_N_ELEMENTS(signed_values); i++) {
+		column_put_signed(a, signed_values[i]);
+	}
+	column_put_string(a, "name");
+	column_put_string(a, NULL);
+
+	for (i = 0; i < G_N_ELEMENTS(unsigned_values); i++) {
+		g_assert(column_get_varint(a->data, a->len, &pos, &u));
+		g_assert(u == unsigned_values[i]);
+		g_assert(column_get_u64(a->data, a->len, &pos, &u));
+		g_assert(u == unsigned_values[i]);
+	}
+	for (i = 0; i < G_N_ELEMENTS(signed_values); i++) {
+		g_assert(column_get_signed(a->data, a->len, &pos, &s));
+		g_assert(s == signed_values[i]);
+	}
+	g_assert(column_get_string(a->data, a->len, &pos, &str, &len));
+	g_assert(len == 4 && memcmp(str, "name", 4) == 0);
+	g_assert(column_get_string(a->data, a->len, &pos, &str, &len));
+	g_assert(len == 0);
+	g_assert(pos == a->len);
+
+	/* Nothing can be read past the end */
+	g_assert(!column_get_varint(a->data, a->len, &pos, &u));
+	pos = a->len - 2;
+	g_assert(!column_get_u64(a->data, a->len, &pos, &u));
+	g_byte_array_set_size(a, 0);
+	column_put_string(a, "truncated");
+	pos = 0;
+	g_assert(!column_get_string(a->data, a->len - 1, &pos, &str, &len));
+
+	g_byte_array_free(a, TRUE);
+}
+
+static void check_names(void)
+{
+	ColumnNames *names = column_names_new();
+	GByteArray *file = g_byte_array_new();
+	GByteArray *body = g_byte_array_new();
+	GByteArray *column = g_byte_array_new();
+	GPtrArray *read_names = g_ptr_array_new();
+	guint i, id, nb_records = 0;
+	gsize pos, len;
+	guint64 value;
+
+	/* Write the names before the column that uses them */
+	for (i = 0; i < NB_STRINGS; i++) {
+		if (column_names_get_id(names, strings[i], &id)) {
+			g_byte_array_set_size(body, 0);
+			column_put_varint(body, id);
+			column_put_string(body, strings[i]);
+			put_record(file, 'N', body);
+			nb_records++;
+		}
+		column_put_varint(column, id);
+	}
+	g_assert(nb_records == NB_NAMES);
+	put_record(file, 'C', column);
+
+	/* Read the records back */
+	pos = 0;
+	while (pos < file->len) {
+		char tag = file->data[pos++];
+		guint64 body_len;
+		gsize end;
+
+		g_assert(column_get_varint(file->data, file->len, &pos, &body_len));
+		g_assert(body_len <= file->len - pos);
+		end = pos + body_len;
+		if (tag == 'N') {
+			const char *str;
+			guint64 name_id;
+
+			g_assert(column_get_varint(file->data, end, &pos, &name_id));
+			g_assert(column_get_string(file->data, end, &pos, &str, &len));
+			/* The ids are numbered in the order of the records */
+			g_assert(name_id == read_names->len);
+			g_ptr_array_add(read_names, g_strndup(str, len));
+		} else {
+			g_assert(tag == 'C');
+			for (i = 0; i < NB_STRINGS; i++) {
+				const char *expected = strings[i] ? strings[i] : "";
+
+				g_assert(column_get_varint(file->data, end, &pos, &value));
+				g_assert(value < read_names->len);
+				g_assert(strcmp(g_ptr_array_index(read_names, value),
+						expected) == 0);
+			}
+		}
+		g_assert(pos == end);
+	}
+	g_assert(read_names->len == NB_NAMES);
+
+	/* A name already numbered keeps its id until the names are cleared */
+	g_assert(!column_names_get_id(names, "bash", &id));
+	g_assert(id == 1);
+	column_names_clear(names);
+	g_assert(column_names_get_id(names, "bash", &id));
+	g_assert(id == 0);
+
+	for (i = 0; i < read_names->len; i++) {
+		g_free(g_ptr_array_index(read_names, i));
+	}
+	g_ptr_array_free(read_names, TRUE);
+	g_byte_array_free(column, TRUE);
+	g_byte_array_free(body, TRUE);
+	g_byte_array_free(file, TRUE);
+	column_names_destroy(names);
+}
+
+int main(int argc, char **argv)
+{
+	check_values();
+	check_names();
+
+	return EXIT_SUCCESS;
+}
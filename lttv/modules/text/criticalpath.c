@@ -0,0 +1,375 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Resolution of the critical paths of depanalysis, from the high-level
+ * state histories of the processes. It does not depend on the tracefile
+ * API, so it is tested even though depanalysis is not built.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <glib.h>
+
+#include "criticalpath.h"
+
+/* Find the first state of the history of a process that ends after t. The
+ * states of a history follow each other, so it is also the state covering t.
+ * Returns -1 if all the states end at or before t.
+ */
+static int search_state_ending_after(struct process *p, LttTime t)
+{
+	const guint64 *ends = (const guint64 *) p->hlev_ends->data;
+	guint64 target = ltt_time_to_uint64(t);
+	int under = 0;
+	int over = p->hlev_ends->len;
+
+	while(under < over) {
+		int middle = under + (over - under) / 2;
+
+		if(ends[middle] <= target)
+			under = middle + 1;
+		else
+			over = middle;
+	}
+
+	if(under == p->hlev_ends->len)
+		return -1;
+	return under;
+}
+
+/* FIXME: this shouldn't be based on pids in case of reuse
+ */
+
+static struct process_state *find_state_ending_after(GHashTable *processes, int pid, LttTime t)
+{
+	struct process *p;
+	int result;
+
+
+	p = g_hash_table_lookup(processes, &pid);
+	if(!p)
+		return NULL;
+
+	result = search_state_ending_after(p, t);
+
+	if(result == -1)
+		return NULL;
+	else
+		return g_array_index(p->hlev_history, struct process_state *, result);
+}
+
+static guint critical_path_key_hash(gconstpointer key)
+{
+	const struct critical_path_key *k = key;
+
+	return k->pid ^ (k->t1.tv_sec * 31 + k->t1.tv_nsec) ^
+		((k->t2.tv_sec * 31 + k->t2.tv_nsec) << 1);
+}
+
+static gboolean critical_path_key_equal(gconstpointer a, gconstpointer b)
+{
+	const struct critical_path_key *k1 = a;
+	const struct critical_path_key *k2 = b;
+
+	return k1->pid == k2->pid && ltt_time_compare(k1->t1, k2->t1) == 0 &&
+		ltt_time_compare(k1->t2, k2->t2) == 0;
+}
+
+void critical_path_unref(struct critical_path *path)
+{
+	int i;
+
+	if(--path->refs > 0)
+		return;
+
+	for(i=0; i<path->steps->len; i++) {
+		struct critical_path *waker_path = g_array_index(path->steps, struct critical_path_step, i).waker_path;
+
+		if(waker_path)
+			critical_path_unref(waker_path);
+	}
+	g_array_free(path->steps, TRUE);
+	g_array_free(path->cuts, TRUE);
+	g_free(path);
+}
+
+static void critical_path_destroy_notify(gpointer data)
+{
+	critical_path_unref(data);
+}
+
+struct critical_path_cache *critical_path_cache_new(GHashTable *processes)
+{
+	struct critical_path_cache *cache = g_new(struct critical_path_cache, 1);
+
+	cache->processes = processes;
+	/* The keys are those of the paths */
+	cache->paths = g_hash_table_new_full(critical_path_key_hash,
+		critical_path_key_equal, NULL, critical_path_destroy_notify);
+	cache->resolving = g_hash_table_new(critical_path_key_hash,
+		critical_path_key_equal);
+	return cache;
+}
+
+void critical_path_cache_destroy(struct critical_path_cache *cache)
+{
+	g_hash_table_destroy(cache->paths);
+	g_hash_table_destroy(cache->resolving);
+	g_free(cache);
+}
+
+static void add_cut(GArray *cuts, const struct critical_path_key *key)
+{
+	int i;
+
+	for(i=0; i<cuts->len; i++) {
+		if(critical_path_key_equal(&g_array_index(cuts, struct critical_path_key, i), key))
+			return;
+	}
+	g_array_append_val(cuts, *key);
+}
+
+static void add_cuts(GArray *cuts, GArray *added)
+{
+	int i;
+
+	for(i=0; i<added->len; i++)
+		add_cut(cuts, &g_array_index(added, struct critical_path_key, i));
+}
+
+/* Check that none of the keys resolved inside a path with loops cut is being
+ * resolved now: it would be cut instead.
+ */
+static gboolean resolved_inside_free(struct critical_path_cache *cache, struct critical_path *path)
+{
+	int i;
+
+	if(path->context_free)
+		return TRUE;
+	if(g_hash_table_lookup(cache->resolving, &path->key))
+		return FALSE;
+	for(i=0; i<path->steps->len; i++) {
+		struct critical_path *waker_path = g_array_index(path->steps, struct critical_path_step, i).waker_path;
+
+		if(waker_path && !resolved_inside_free(cache, waker_path))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Check that resolving the key of a path again would give the same steps */
+static gboolean critical_path_reusable(struct critical_path_cache *cache, struct critical_path *path)
+{
+	int i;
+
+	for(i=0; i<path->cuts->len; i++) {
+		if(!g_hash_table_lookup(cache->resolving, &g_array_index(path->cuts, struct critical_path_key, i)))
+			return FALSE;
+	}
+	return resolved_inside_free(cache, path);
+}
+
+/* Resolve the critical path of a process between t1 and t2, following the
+ * wakers of its blocked states. Returns NULL if the process is unknown or if
+ * the path is already being resolved higher in the recursion. The keys being
+ * resolved where the path, or the loop, was cut are added to cuts.
+ */
+static struct critical_path *resolve(struct critical_path_cache *cache, int pid, LttTime t1, LttTime t2, GArray *cuts)
+{
+	struct critical_path_key key;
+	struct critical_path *path;
+	struct process *p;
+	int i;
+
+	key.pid = pid;
+	key.t1 = t1;
+	key.t2 = t2;
+	if(g_hash_table_lookup(cache->resolving, &key)) {
+		add_cut(cuts, &key);
+		return NULL;
+	}
+
+	path = g_hash_table_lookup(cache->paths, &key);
+	if(path && critical_path_reusable(cache, path)) {
+		add_cuts(cuts, path->cuts);
+		path->refs++;
+		return path;
+	}
+
+	p = g_hash_table_lookup(cache->processes, &pid);
+	if(!p)
+		return NULL;
+
+	path = g_new(struct critical_path, 1);
+	path->key = key;
+	path->steps = g_array_new(FALSE, FALSE, sizeof(struct critical_path_step));
+	path->cuts = g_array_new(FALSE, FALSE, sizeof(struct critical_path_key));
+	path->context_free = TRUE;
+	path->refs = 1;
+	g_hash_table_insert(cache->resolving, &path->key, path);
+
+	i = search_state_ending_after(p, t1);
+	if(i < 0)
+		i = p->hlev_history->len;
+	for(; i<p->hlev_history->len; i++) {
+		struct process_state *pstate = g_array_index(p->hlev_history, struct process_state *, i);
+		struct hlev_state_info_blocked *state_private_blocked;
+		struct critical_path_step step;
+
+		if(ltt_time_compare(pstate->time_end, t2) > 0)
+			break;
+		if(pstate->bstate != HLEV_BLOCKED)
+			continue;
+
+		state_private_blocked = pstate->private;
+		step.blocked = pstate;
+		step.waker_state = find_state_ending_after(cache->processes, state_private_blocked->pid_exit, state_private_blocked->time_woken);
+		step.waker_path = NULL;
+
+		/* if in irq or softirq, we don't care what the waking process was doing because they are asynchroneous events */
+		if(step.waker_state &&
+				step.waker_state->bstate != HLEV_INTERRUPTED_IRQ &&
+				step.waker_state->bstate != HLEV_INTERRUPTED_SOFTIRQ) {
+			LttTime t1prime=t1;
+			LttTime t2prime=t2;
+
+			if(ltt_time_compare(t1prime, pstate->time_begin) < 0)
+				t1prime = pstate->time_begin;
+			if(ltt_time_compare(t2prime, pstate->time_end) > 0)
+				t2prime = pstate->time_end;
+
+			step.waker_path = resolve(cache, state_private_blocked->pid_exit, t1prime, t2prime, path->cuts);
+			if(step.waker_path && !step.waker_path->context_free)
+				path->context_free = FALSE;
+		}
+
+		g_array_append_val(path->steps, step);
+	}
+
+	g_hash_table_remove(cache->resolving, &path->key);
+
+	/* The loops cut at the path itself are resolved inside it, whoever
+	 * resolves it
+	 */
+	for(i=0; i<path->cuts->len; i++) {
+		if(critical_path_key_equal(&g_array_index(path->cuts, struct critical_path_key, i), &path->key)) {
+			g_array_remove_index_fast(path->cuts, i);
+			break;
+		}
+	}
+	if(path->cuts->len > 0)
+		path->context_free = FALSE;
+	add_cuts(cuts, path->cuts);
+
+	/* Keep the last path resolved for the key */
+	g_hash_table_remove(cache->paths, &path->key);
+	g_hash_table_insert(cache->paths, &path->key, path);
+	path->refs++;
+	return path;
+}
+
+struct critical_path *critical_path_get(struct critical_path_cache *cache,
+	int pid, LttTime t1, LttTime t2)
+{
+	GArray *cuts = g_array_new(FALSE, FALSE, sizeof(struct critical_path_key));
+	struct critical_path *path;
+
+	path = resolve(cache, pid, t1, t2, cuts);
+	/* Nothing is being resolved above the path */
+	g_assert(cuts->len == 0);
+	g_array_free(cuts, TRUE);
+	return path;
+}
+
+struct critical_path_jobs {
+	GHashTable *processes;
+	struct critical_path_report *reports;
+	int nb_reports;
+	critical_path_render_func render;
+	/* next report to render, shared by the threads */
+	int next;
+	pthread_mutex_t lock;
+};
+
+/* Render reports until none is left. The processes are taken one at a time,
+ * so a thread that gets short reports takes more of them. Each thread
+ * memoizes the paths it resolves in its own cache, the histories are only
+ * read. A path is reused only where it would be resolved the same way, so a
+ * report is the same whatever thread renders it and whatever it rendered
+ * before.
+ */
+static void *critical_path_worker(void *arg)
+{
+	struct critical_path_jobs *jobs = arg;
+	struct critical_path_cache *cache = critical_path_cache_new(jobs->processes);
+
+	for(;;) {
+		struct critical_path_report *report;
+		FILE *out;
+		int i;
+
+		pthread_mutex_lock(&jobs->lock);
+		i = jobs->next++;
+		pthread_mutex_unlock(&jobs->lock);
+		if(i >= jobs->nb_reports)
+			break;
+
+		report = &jobs->reports[i];
+		out = open_memstream(&report->text, &report->size);
+		if(out == NULL)
+			g_error("depanalysis: cannot allocate a report buffer");
+		jobs->render(out, cache, report->pinfo);
+		fclose(out);
+	}
+
+	critical_path_cache_destroy(cache);
+	return NULL;
+}
+
+void critical_path_render_reports(GHashTable *processes,
+	struct critical_path_report *reports, int nb_reports, int nb_threads,
+	critical_path_render_func render)
+{
+	struct critical_path_jobs jobs;
+	pthread_t *threads;
+	int i;
+
+	jobs.processes = processes;
+	jobs.reports = reports;
+	jobs.nb_reports = nb_reports;
+	jobs.render = render;
+	jobs.next = 0;
+	pthread_mutex_init(&jobs.lock, NULL);
+
+	/* The calling thread renders reports too */
+	nb_threads = MIN(MAX(nb_threads, 1), MAX(nb_reports, 1));
+	threads = g_new(pthread_t, nb_threads - 1);
+	for(i=0; i<nb_threads-1; i++) {
+		if(pthread_create(&threads[i], NULL, critical_path_worker, &jobs) != 0)
+			g_error("depanalysis: cannot create a report thread");
+	}
+	critical_path_worker(&jobs);
+	for(i=0; i<nb_threads-1; i++)
+		pthread_join(threads[i], NULL);
+	g_free(threads);
+	pthread_mutex_destroy(&jobs.lock);
+}
@@ -0,0 +1,102 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CRITICALPATH_H
+#define CRITICALPATH_H
+
+#include <stdio.h>
+#include <glib.h>
+#include <lttv/time.h>
+
+#include "depanalysis.h"
+
+/* Critical path of a process over a time range: its blocked states and what
+ * woke it up from each of them. A wakeup loop is cut where the path reaches
+ * a (pid, range) that is already being resolved above it.
+ */
+struct critical_path_key {
+	int pid;
+	LttTime t1;
+	LttTime t2;
+};
+
+struct critical_path_step {
+	struct process_state *blocked;
+	/* state of the waker when the process was woken, NULL if unknown */
+	struct process_state *waker_state;
+	/* path of the waker during the blocked state, NULL if the process was
+	 * woken by an interrupt or if following the waker loops */
+	struct critical_path *waker_path;
+};
+
+struct critical_path {
+	struct critical_path_key key;
+	GArray *steps;
+	/* Keys resolved above the path where a loop was cut in it or in its
+	 * waker paths. The path can only be reused while they are being
+	 * resolved. */
+	GArray *cuts;
+	/* TRUE if no loop was cut in the path nor in its waker paths, it can
+	 * then be reused anywhere */
+	gboolean context_free;
+	/* References from the cache and the steps of other paths */
+	int refs;
+};
+
+/* Paths resolved by one thread. The same wakers are reached from many
+ * processes, so the paths are memoized by (pid, range). A path is reused only
+ * where resolving it again would give the same steps: the keys where its
+ * loops were cut are being resolved, and none of the keys resolved inside it
+ * is. The paths thus do not depend on what was resolved before.
+ */
+struct critical_path_cache {
+	/* processes by pid, only read */
+	GHashTable *processes;
+	GHashTable *paths;
+	/* keys being resolved */
+	GHashTable *resolving;
+};
+
+struct critical_path_cache *critical_path_cache_new(GHashTable *processes);
+void critical_path_cache_destroy(struct critical_path_cache *cache);
+
+/* Resolve the critical path of a process between t1 and t2. Returns NULL if
+ * the process is unknown. The path must be released with
+ * critical_path_unref.
+ */
+struct critical_path *critical_path_get(struct critical_path_cache *cache,
+	int pid, LttTime t1, LttTime t2);
+void critical_path_unref(struct critical_path *path);
+
+/* Report of a process rendered in memory by one of the report threads */
+struct critical_path_report {
+	struct process *pinfo;
+	char *text;
+	size_t size;
+};
+
+typedef void (*critical_path_render_func)(FILE *out,
+	struct critical_path_cache *cache, struct process *pinfo);
+
+/* Render the reports with nb_threads threads, the calling one included. Each
+ * thread has its own cache. The text of a report must be freed with free.
+ */
+void critical_path_render_reports(GHashTable *processes,
+	struct critical_path_report *reports, int nb_reports, int nb_threads,
+	critical_path_render_func render);
+
+#endif /* CRITICALPATH_H */
@@ -0,0 +1,318 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Check the resolution of the critical paths: the wakeup loops are cut, the
+ * paths are reused across the reports, and a report is the same whatever was
+ * resolved before it and whatever thread rendered it. The program aborts if a
+ * check fails.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "criticalpath.h"
+
+#define END 100
+
+static GHashTable *processes;
+
+static LttTime seconds(int s)
+{
+	LttTime t;
+
+	t.tv_sec = s;
+	t.tv_nsec = 0;
+	return t;
+}
+
+static struct process *new_process(int pid)
+{
+	struct process *p = g_new0(struct process, 1);
+
+	p->pid = pid;
+	p->hlev_history = g_array_new(FALSE, FALSE, sizeof(struct process_state *));
+	p->hlev_ends = g_array_new(FALSE, FALSE, sizeof(guint64));
+	g_hash_table_insert(processes, &p->pid, p);
+	return p;
+}
+
+/* Append a state to the history of a process. A blocked state is woken by
+ * waker at time woken.
+ */
+static void add_state(struct process *p, enum hlev_state bstate, int begin,
+	int end, int waker, int woken)
+{
+	struct process_state *pstate = g_new0(struct process_state, 1);
+	guint64 end_ns = ltt_time_to_uint64(seconds(end));
+
+	pstate->bstate = bstate;
+	pstate->time_begin = seconds(begin);
+	pstate->time_end = seconds(end);
+	if(bstate == HLEV_BLOCKED) {
+		struct hlev_state_info_blocked *blocked = g_new0(struct hlev_state_info_blocked, 1);
+
+		blocked->pid_exit = waker;
+		blocked->time_woken = seconds(woken);
+		pstate->private = blocked;
+	}
+	g_array_append_val(p->hlev_history, pstate);
+	g_array_append_val(p->hlev_ends, end_ns);
+}
+
+static void free_process(gpointer data)
+{
+	struct process *p = data;
+	int i;
+
+	for(i=0; i<p->hlev_history->len; i++) {
+		struct process_state *pstate = g_array_index(p->hlev_history, struct process_state *, i);
+
+		g_free(pstate->private);
+		g_free(pstate);
+	}
+	g_array_free(p->hlev_history, TRUE);
+	g_array_free(p->hlev_ends, TRUE);
+	g_free(p);
+}
+
+/* Print the steps of a path, the waker paths indented */
+static void dump_path(FILE *out, struct critical_path *path, int depth)
+{
+	int i;
+
+	for(i=0; path && i<path->steps->len; i++) {
+		struct critical_path_step *step = &g_array_index(path->steps, struct critical_path_step, i);
+		struct hlev_state_info_blocked *blocked = step->blocked->private;
+
+		fprintf(out, "%*sblocked %ld-%ld woken by %d%s\n", 2*depth, "",
+			(long)step->blocked->time_begin.tv_sec,
+			(long)step->blocked->time_end.tv_sec, blocked->pid_exit,
+			step->waker_state ? "" : " (unknown)");
+		dump_path(out, step->waker_path, depth+1);
+	}
+}
+
+static void render(FILE *out, struct critical_path_cache *cache, struct process *p)
+{
+	struct critical_path *path;
+
+	path = critical_path_get(cache, p->pid, seconds(0), seconds(END));
+	fprintf(out, "process %d\n", p->pid);
+	dump_path(out, path, 1);
+	if(path)
+		critical_path_unref(path);
+}
+
+static char *report(struct critical_path_cache *cache, int pid)
+{
+	char *text;
+	size_t size;
+	FILE *out = open_memstream(&text, &size);
+
+	g_assert(out != NULL);
+	render(out, cache, g_hash_table_lookup(processes, &pid));
+	fclose(out);
+	return text;
+}
+
+/* The report of a process resolved with an empty cache */
+static char *fresh_report(int pid)
+{
+	struct critical_path_cache *cache = critical_path_cache_new(processes);
+	char *text = report(cache, pid);
+
+	critical_path_cache_destroy(cache);
+	return text;
+}
+
+#define NB_PIDS 5
+
+/* Processes that wake each other at random, for the report threads */
+#define FIRST_RANDOM_PID 100
+#define NB_RANDOM_PIDS 60
+#define RANDOM_SLICE 10
+#define NB_THREADS 4
+
+static guint32 random_state = 1;
+
+static int random_below(int n)
+{
+	random_state = random_state * 1103515245 + 12345;
+	return (random_state >> 16) % n;
+}
+
+/* Alternate running and blocked slices, each blocked one woken by a random
+ * process of the set
+ */
+static void add_random_processes(void)
+{
+	int i, t;
+
+	for(i=0; i<NB_RANDOM_PIDS; i++) {
+		struct process *p = new_process(FIRST_RANDOM_PID + i);
+
+		for(t=0; t<END; t+=RANDOM_SLICE) {
+			if(random_below(2)) {
+				add_state(p, HLEV_BLOCKED, t, t + RANDOM_SLICE,
+					FIRST_RANDOM_PID + random_below(NB_RANDOM_PIDS),
+					t + random_below(RANDOM_SLICE));
+			} else {
+				add_state(p, HLEV_RUNNING, t, t + RANDOM_SLICE, 0, 0);
+			}
+		}
+	}
+}
+
+static void add_report(gpointer key, gpointer value, gpointer user_data)
+{
+	GArray *reports = user_data;
+	struct critical_path_report report;
+
+	report.pinfo = value;
+	report.text = NULL;
+	report.size = 0;
+	g_array_append_val(reports, report);
+}
+
+/* Render the reports of all the processes with nb_threads threads */
+static GArray *render_all(int nb_threads)
+{
+	GArray *reports = g_array_new(FALSE, FALSE, sizeof(struct critical_path_report));
+
+	g_hash_table_foreach(processes, add_report, reports);
+	critical_path_render_reports(processes,
+		(struct critical_path_report *) reports->data, reports->len,
+		nb_threads, render);
+	return reports;
+}
+
+/* Orders in which the reports are resolved with a shared cache */
+static const int orders[][NB_PIDS] = {
+	{ 1, 2, 3, 4, 5 },
+	{ 5, 4, 3, 2, 1 },
+	{ 2, 4, 1, 5, 3 },
+	{ 3, 1, 4, 2, 5 },
+};
+
+int main(int argc, char **argv)
+{
+	struct critical_path_cache *cache;
+	struct critical_path *path3, *path4;
+	struct process *p;
+	char *expected[NB_PIDS + 1];
+	char *text;
+	GArray *single, *multi;
+	int i, j;
+
+	processes = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, free_process);
+
+	/* 1 and 2 wake each other, 3 is woken by 1 and 4 by 3. 5 is woken by
+	 * 7 while it handles an irq, and by a process that is not traced.
+	 */
+	p = new_process(1);
+	add_state(p, HLEV_BLOCKED, 0, 10, 2, 5);
+	add_state(p, HLEV_RUNNING, 10, END, 0, 0);
+	p = new_process(2);
+	add_state(p, HLEV_BLOCKED, 0, 10, 1, 4);
+	add_state(p, HLEV_RUNNING, 10, END, 0, 0);
+	p = new_process(3);
+	add_state(p, HLEV_BLOCKED, 0, 20, 1, 15);
+	add_state(p, HLEV_RUNNING, 20, END, 0, 0);
+	p = new_process(4);
+	add_state(p, HLEV_BLOCKED, 0, END, 3, 50);
+	p = new_process(5);
+	add_state(p, HLEV_RUNNING, 0, 10, 0, 0);
+	add_state(p, HLEV_BLOCKED, 10, 30, 7, 20);
+	add_state(p, HLEV_BLOCKED, 30, 40, 6, 35);
+	add_state(p, HLEV_RUNNING, 40, END, 0, 0);
+	p = new_process(7);
+	add_state(p, HLEV_RUNNING, 0, 15, 0, 0);
+	add_state(p, HLEV_INTERRUPTED_IRQ, 15, 25, 0, 0);
+	add_state(p, HLEV_RUNNING, 25, END, 0, 0);
+
+	for(i=1; i<=NB_PIDS; i++)
+		expected[i] = fresh_report(i);
+
+	/* The loop between 1 and 2 is cut where it comes back */
+	g_assert(strcmp(expected[3],
+		"process 3\n"
+		"  blocked 0-20 woken by 1\n"
+		"    blocked 0-10 woken by 2\n"
+		"      blocked 0-10 woken by 1\n"
+		"        blocked 0-10 woken by 2\n") == 0);
+	g_assert(strcmp(expected[2],
+		"process 2\n"
+		"  blocked 0-10 woken by 1\n"
+		"    blocked 0-10 woken by 2\n"
+		"      blocked 0-10 woken by 1\n") == 0);
+	/* The waker of 5 in an irq is not followed, nor an unknown waker */
+	g_assert(strcmp(expected[5],
+		"process 5\n"
+		"  blocked 10-30 woken by 7\n"
+		"  blocked 30-40 woken by 6 (unknown)\n") == 0);
+
+	/* A path with a loop cut inside is reused: 4 is woken by 3 over the
+	 * range of the report of 3.
+	 */
+	cache = critical_path_cache_new(processes);
+	path3 = critical_path_get(cache, 3, seconds(0), seconds(END));
+	path4 = critical_path_get(cache, 4, seconds(0), seconds(END));
+	g_assert(path3 != NULL && path4 != NULL);
+	g_assert(g_array_index(path4->steps, struct critical_path_step, 0).waker_path == path3);
+	critical_path_unref(path4);
+	critical_path_unref(path3);
+	critical_path_cache_destroy(cache);
+
+	/* The reports do not depend on the paths already in the cache */
+	for(i=0; i<G_N_ELEMENTS(orders); i++) {
+		cache = critical_path_cache_new(processes);
+		for(j=0; j<NB_PIDS; j++) {
+			text = report(cache, orders[i][j]);
+			g_assert(strcmp(text, expected[orders[i][j]]) == 0);
+			free(text);
+		}
+		critical_path_cache_destroy(cache);
+	}
+
+	/* The reports are the same with one thread and with several, the
+	 * processes are taken in the same order
+	 */
+	add_random_processes();
+	single = render_all(1);
+	multi = render_all(NB_THREADS);
+	g_assert(single->len == multi->len);
+	for(i=0; i<single->len; i++) {
+		struct critical_path_report *r1 = &g_array_index(single, struct critical_path_report, i);
+		struct critical_path_report *rn = &g_array_index(multi, struct critical_path_report, i);
+
+		g_assert(r1->pinfo == rn->pinfo);
+		g_assert(r1->size == rn->size);
+		g_assert(memcmp(r1->text, rn->text, r1->size) == 0);
+		free(r1->text);
+		free(rn->text);
+	}
+	g_array_free(single, TRUE);
+	g_array_free(multi, TRUE);
+
+	for(i=1; i<=NB_PIDS; i++)
+		free(expected[i]);
+	g_hash_table_destroy(processes);
+
+	return EXIT_SUCCESS;
+}
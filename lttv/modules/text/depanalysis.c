@@ -39,6 +39,8 @@
 #include <stdlib.h>
 
 #include "sstack.h"
+#include "depanalysis.h"
+#include "criticalpath.h"
 
 static LttvHooks
   *before_traceset,
@@ -50,6 +52,8 @@ static int depanalysis_range_pid_searching = -1;
 static int depanalysis_use_time=0;
 static int depanalysis_event_limit = -1;
 static int a_print_simple_summary = 0;
+static gboolean a_print_sstack_stats = FALSE;
+static int a_depanalysis_threads = 1;
 static LttTime depanalysis_time1, depanalysis_time2;
 static char *arg_t1_str,*arg_t2_str;
 static int statedump_finished = 0;
@@ -87,24 +91,6 @@ struct llev_state_info_preempted {
 	int prev_state;
 };
 
-struct hlev_state_info_blocked {
-	int syscall_id;
-	unsigned char trap; /* flag */
-	int substate;
-
-	/* Garray of pointers to struct process_state that reflect the
-         * low-level state stack when respectively entering and exiting the blocked
-         * state.
-         */
-	GArray *llev_state_entry;
-	GArray *llev_state_exit;
-
-	int pid_exit; /* FIXME: it's not pretty to have this here; find this info elsewhere */
-	LttTime time_woken;
-
-	void *private;
-};
-
 struct hlev_state_info_blocked__open {
 	GQuark filename;
 };
@@ -180,16 +166,6 @@ enum hlev_event {
 	HLEV_EVENT_TRY_WAKEUP=0,
 };
 
-enum hlev_state {
-	HLEV_UNKNOWN=0,
-	HLEV_RUNNING,
-	HLEV_BLOCKED,
-	HLEV_INTERRUPTED_IRQ,
-	HLEV_INTERRUPTED_SOFTIRQ,
-	HLEV_INTERRUPTED_CPU,
-	HLEV_INTERRUPTED_POST_BLOCK,
-};
-
 enum hlev_state_blocked {
 	HLEV_BLOCKED__UNDEFINED,
 	HLEV_BLOCKED__OPEN,
@@ -208,33 +184,11 @@ struct try_wakeup_event {
 	struct process *waker;
 };
 
-struct process_state {
-	int bstate;
-	int cause_type;
-	void *private;
-
-	LttTime time_begin;
-	LttTime time_end;
-};
-
 struct process_with_state {
 	struct process *process;
 	struct process_state state;
 };
 
-#define PROCESS_STATE_STACK_SIZE 10
-struct process {
-	int pid;
-	GQuark name;
-	int parent;
-
-	struct sstack *stack;
-	struct process_state *llev_state_stack[PROCESS_STATE_STACK_SIZE];
-	int stack_current;
-	struct process_state *hlev_state;
-	GArray *hlev_history;
-};
-
 static inline void *old_process_state_private_data(struct process *p)
 {
 	return p->llev_state_stack[p->stack_current]->private;
@@ -286,24 +240,51 @@ static struct process_state *find_in_stack(enum llev_state lls, struct process *
 
 static void delete_data_val(struct process_with_state *pwstate)
 {
-	// FIXME: Free this also
-	//g_free(pwstate->state.private);
+	/* The llev states in the stacks of the hlev blocked states are kept
+	 * until the end of the analysis.
+	 */
+	if(pwstate->state.kept)
+		return;
 
 	// FIXME: this is really ugly. Don't free the pwstate if the state is LLEV_RUNNING.
 	// LLEV_RUNNING is a special case that's being processed and deleted immediately after
 	// being inserted on the sstack, to prevent state begin accumulated because it couldn't
 	// be processed before the end of the trace. If we free the state, we get invalid memory
 	// reads when looking at it on the state_stack.
-	//if(pwstate->state.bstate != LLEV_RUNNING)
-	//	g_free(pwstate);
+	if(pwstate->state.bstate == LLEV_RUNNING)
+		return;
+
+	if(pwstate->state.bstate == LLEV_SYSCALL) {
+		struct llev_state_info_syscall *llev_syscall_private = pwstate->state.private;
+
+		if(llev_syscall_private->substate != LLEV_SYSCALL__UNDEFINED)
+			g_free(llev_syscall_private->private);
+	}
+	g_free(pwstate->state.private);
+	g_free(pwstate);
 }
 
-inline void print_time(LttTime t)
+/* called back from sstack on deletion of a data_val which is
+ * a struct sstack_event
+ */
+
+static void delete_sstack_event(struct sstack_event *se)
+{
+	g_free(se->private);
+	g_free(se);
+}
+
+inline void fprint_time(FILE *out, LttTime t)
 {
 	//printf("%lu.%lu", t.tv_sec, t.tv_nsec);
 	double f;
 	f = (double)t.tv_sec + ((double)t.tv_nsec)/1000000000.0;
-	printf("%.9f", f);
+	fprintf(out, "%.9f", f);
+}
+
+inline void print_time(LttTime t)
+{
+	fprint_time(stdout, t);
 }
 
 static struct sstack_item *prepare_push_item(struct process *p, enum llev_state st, LttTime t)
@@ -329,9 +310,11 @@ static struct sstack_item *prepare_push_item(struct process *p, enum llev_state
 	pwstate->state.bstate = st;
 	pwstate->state.time_begin = t;
 	pwstate->state.private = g_malloc(llev_state_infos[st].size_priv);
+	pwstate->state.kept = 0;
 
 	item->data_val = pwstate;
 	item->delete_data_val = (void (*)(void*))delete_data_val;
+	item->data_size = sizeof(struct process_with_state) + llev_state_infos[st].size_priv;
 
 	return item;
 }
@@ -368,6 +351,15 @@ static void live_complete_process_push_llev_state(struct process *p, enum llev_s
 	old_process_push_llev_state(p, pstate);
 }
 
+/* called back from sstack on deletion of the data_val of a pop without
+ * push, which has no private data and is not referred to once processed
+ */
+
+static void free_unmatched_pop_data_val(struct process_with_state *pwstate)
+{
+	g_free(pwstate);
+}
+
 static void prepare_pop_item_commit_nocheck(struct process *p, enum llev_state st, LttTime t)
 {
 	struct process_with_state *pwstate;
@@ -392,6 +384,8 @@ static void prepare_pop_item_commit_nocheck(struct process *p, enum llev_state s
 		pwstate = g_malloc(sizeof(struct process_with_state));
 		pwstate->process = p;
 		item->data_val = pwstate;
+		item->delete_data_val = (void (*)(void*))free_unmatched_pop_data_val;
+		item->data_size = sizeof(struct process_with_state);
 		pwstate->state.time_end = t;
 		pwstate->state.bstate = st;
 	}
@@ -490,6 +484,7 @@ static void old_process_pop_llev_state(struct process *p, struct process_state *
 }
 
 static GHashTable *process_hash_table;
+static struct critical_path_cache *critical_paths;
 static GHashTable *syscall_table;
 static GHashTable *irq_table;
 static GHashTable *softirq_table;
@@ -516,6 +511,7 @@ GArray *oldstyle_stack_to_garray(struct process_state **oldstyle_stack, int curr
 	retval = g_array_new(FALSE, FALSE, sizeof(struct process_state *));
 
 	for(i=0; i<current; i++) {
+		oldstyle_stack[i]->kept = 1;
 		g_array_append_val(retval, oldstyle_stack[i]);
 	}
 
@@ -578,8 +574,12 @@ static void update_hlev_state(struct process *p, LttTime t)
 	 * having a UNKNOWN state of duration 0 in the summary, we don't add it. This isn't as elegant
 	 * as it ought to be.
 	 */
-	if(ltt_time_compare(p->hlev_state->time_begin, p->hlev_state->time_end) != 0)
+	if(ltt_time_compare(p->hlev_state->time_begin, p->hlev_state->time_end) != 0) {
+		guint64 end = ltt_time_to_uint64(p->hlev_state->time_end);
+
 		g_array_append_val(p->hlev_history, p->hlev_state);
+		g_array_append_val(p->hlev_ends, end);
+	}
 	p->hlev_state = g_malloc(sizeof(struct process_state));
 	p->hlev_state->bstate = new_hlev;
 	p->hlev_state->time_begin = t;
@@ -727,17 +727,17 @@ static void print_summary_item(struct summary_tree_node *node, int depth)
 	g_list_free(vals);
 }
 
-static inline void print_irq(int irq)
+static inline void print_irq(FILE *out, int irq)
 {
-	printf("IRQ %d [%s]", irq, g_quark_to_string((GQuark)(unsigned long)g_hash_table_lookup(irq_table, &irq)));
+	fprintf(out, "IRQ %d [%s]", irq, g_quark_to_string((GQuark)(unsigned long)g_hash_table_lookup(irq_table, &irq)));
 }
 
-static inline void print_softirq(int softirq)
+static inline void print_softirq(FILE *out, int softirq)
 {
-	printf("SoftIRQ %d [%s]", softirq, g_quark_to_string((GQuark)(unsigned long)g_hash_table_lookup(softirq_table, &softirq)));
+	fprintf(out, "SoftIRQ %d [%s]", softirq, g_quark_to_string((GQuark)(unsigned long)g_hash_table_lookup(softirq_table, &softirq)));
 }
 
-static inline void print_pid(int pid)
+static inline void print_pid(FILE *out, int pid)
 {
 	struct process *event_process_info = g_hash_table_lookup(process_hash_table, &pid);
 
@@ -747,7 +747,7 @@ static inline void print_pid(int pid)
 		pname = "?";
 	else
 		pname = g_quark_to_string(event_process_info->name);
-	printf("%d [%s]", pid, pname);
+	fprintf(out, "%d [%s]", pid, pname);
 }
 
 static void modify_path_with_private(GArray *path, struct process_state *pstate)
@@ -810,7 +810,7 @@ static void modify_path_with_private(GArray *path, struct process_state *pstate)
 	};
 }
 
-void print_stack_garray_horizontal(GArray *stack)
+void print_stack_garray_horizontal(FILE *out, GArray *stack)
 {
 	/* FIXME: this function doesn't work if we delete the states as we process them because we
 	 * try to read those states here to print the low level stack.
@@ -819,202 +819,106 @@ void print_stack_garray_horizontal(GArray *stack)
 
 	for(i=0; i<stack->len; i++) {
 		struct process_state *pstate = g_array_index(stack, struct process_state *, i);
-		printf("%s", llev_state_infos[pstate->bstate].name);
+		fprintf(out, "%s", llev_state_infos[pstate->bstate].name);
 
 		if(pstate->bstate == LLEV_SYSCALL) {
 			struct llev_state_info_syscall *llev_syscall_private = pstate->private;
-			printf(" %d [%s]", llev_syscall_private->syscall_id, g_quark_to_string((GQuark)(unsigned long)g_hash_table_lookup(syscall_table, &llev_syscall_private->syscall_id)));
+			fprintf(out, " %d [%s]", llev_syscall_private->syscall_id, g_quark_to_string((GQuark)(unsigned long)g_hash_table_lookup(syscall_table, &llev_syscall_private->syscall_id)));
 		}
 
-		printf(", ");
+		fprintf(out, ", ");
 		
 	}
 }
 
-static int dicho_search_state_ending_after(struct process *p, LttTime t)
-{
-	int under = 0;
-	int over = p->hlev_history->len-1;
-	struct process_state *pstate;
-	int result;
-
-	if(over < 1)
-		return -1;
-
-	/* If the last element is smaller or equal than the time we are searching for,
-	 * no match
-	 */
-	pstate = g_array_index(p->hlev_history, struct process_state *, over);
-	if(ltt_time_compare(pstate->time_end, t) <= 0) {
-		return -1;
-	}
-	/* no need to check for the equal case */
-
-	pstate = g_array_index(p->hlev_history, struct process_state *, under);
-	result = ltt_time_compare(pstate->time_end, t);
-	if(result >= 1) {
-		/* trivial match at the first element if it is greater or equal
-		 * than the time we want
-		 */
-		return under;
-	}
-
-	while(1) {
-		int dicho;
-
-		dicho = (under+over)/2;
-		pstate = g_array_index(p->hlev_history, struct process_state *, dicho);
-		result = ltt_time_compare(pstate->time_end, t);
-
-		if(result == -1) {
-			under = dicho;
-		}
-		else if(result == 1) {
-			over = dicho;
-		}
-		else {
-			/* exact match */
-			return dicho+1;
-		}
-
-		if(over-under == 1) {
-			/* we have converged */
-			return over;
-		}
-	}
-
-}
-
-/* FIXME: this shouldn't be based on pids in case of reuse
- * FIXME: should add a list of processes used to avoid loops
- */
-
-static struct process_state *find_state_ending_after(int pid, LttTime t)
-{
-	struct process *p;
-	int result;
-
-
-	p = g_hash_table_lookup(process_hash_table, &pid);
-	if(!p)
-		return NULL;
-
-	result = dicho_search_state_ending_after(p, t);
-
-	if(result == -1)
-		return NULL;
-	else
-		return g_array_index(p->hlev_history, struct process_state *, result);
-}
-
-static void print_indent(int offset)
+static void print_indent(FILE *out, int offset)
 {
 	if (offset > 2) {
 		int i;
 
-		printf("%*s", 8, "");
+		fprintf(out, "%*s", 8, "");
 		for (i = 3; i < offset; i++) {
-			printf("|");
-			printf("%*s", 4, "");
+			fprintf(out, "|");
+			fprintf(out, "%*s", 4, "");
 		}
 	} else
-		printf("%*s", 4*offset, "");
+		fprintf(out, "%*s", 4*offset, "");
 }
 
-static void print_delay_pid(int pid, LttTime t1, LttTime t2, int offset)
+static void print_critical_path(FILE *out, struct critical_path *path, int offset)
 {
-	struct process *p;
 	int i;
 
-	p = g_hash_table_lookup(process_hash_table, &pid);
-	if(!p)
+	if(!path)
 		return;
 
-	i = dicho_search_state_ending_after(p, t1);
-	for(; i<p->hlev_history->len; i++) {
-		struct process_state *pstate = g_array_index(p->hlev_history, struct process_state *, i);
-		if(ltt_time_compare(pstate->time_end, t2) > 0)
-			break;
-			
-		if(pstate->bstate == HLEV_BLOCKED) {
-			struct hlev_state_info_blocked *state_private_blocked;
-			state_private_blocked = pstate->private;
-			struct process_state *state_unblocked;
+	for(i=0; i<path->steps->len; i++) {
+		struct critical_path_step *step = &g_array_index(path->steps, struct critical_path_step, i);
+		struct process_state *pstate = step->blocked;
+		struct process_state *state_unblocked = step->waker_state;
+		struct hlev_state_info_blocked *state_private_blocked;
 
-			print_indent(offset);
-			printf("--> Blocked in ");
-			print_stack_garray_horizontal(state_private_blocked->llev_state_entry);
+		state_private_blocked = pstate->private;
 
-			printf("(times: ");
-			print_time(pstate->time_begin);
-			printf("-");
-			print_time(pstate->time_end);
-
-			printf(", dur: %f)\n", 1e-9*ltt_time_to_double(ltt_time_sub(pstate->time_end, pstate->time_begin)));
-
-			state_unblocked = find_state_ending_after(state_private_blocked->pid_exit, state_private_blocked->time_woken);
-			if(state_unblocked) {
-				if(state_unblocked->bstate == HLEV_INTERRUPTED_IRQ) {
-					struct hlev_state_info_interrupted_irq *priv = state_unblocked->private;
-					/* if in irq or softirq, we don't care what the waking process was doing because they are asynchroneous events */
-					print_indent(offset);
-					printf("--- Woken up by an IRQ: ");
-					print_irq(priv->irq);
-					printf("\n");
-				}
-				else if(state_unblocked->bstate == HLEV_INTERRUPTED_SOFTIRQ) {
-					struct hlev_state_info_interrupted_softirq *priv = state_unblocked->private;
-					print_indent(offset);
-					printf("--- Woken up by a SoftIRQ: ");
-					print_softirq(priv->softirq);
-					printf("\n");
-				}
-				else {
-					LttTime t1prime=t1;
-					LttTime t2prime=t2;
-
-					if(ltt_time_compare(t1prime, pstate->time_begin) < 0)
-						t1prime = pstate->time_begin;
-					if(ltt_time_compare(t2prime, pstate->time_end) > 0)
-						t2prime = pstate->time_end;
-
-					print_delay_pid(state_private_blocked->pid_exit, t1prime, t2prime, offset+1);
-					print_indent(offset);
-					printf("--- Woken up in context of ");
-					print_pid(state_private_blocked->pid_exit);
-					if(state_private_blocked->llev_state_exit) {
-						print_stack_garray_horizontal(state_private_blocked->llev_state_exit);
-					}
-					else {
-					}
-					printf(" in high-level state %s", hlev_state_infos[state_unblocked->bstate].name);
-					printf("\n");
-				}
+		print_indent(out, offset);
+		fprintf(out, "--> Blocked in ");
+		print_stack_garray_horizontal(out, state_private_blocked->llev_state_entry);
+
+		fprintf(out, "(times: ");
+		fprint_time(out, pstate->time_begin);
+		fprintf(out, "-");
+		fprint_time(out, pstate->time_end);
+
+		fprintf(out, ", dur: %f)\n", 1e-9*ltt_time_to_double(ltt_time_sub(pstate->time_end, pstate->time_begin)));
+
+		if(state_unblocked) {
+			if(state_unblocked->bstate == HLEV_INTERRUPTED_IRQ) {
+				struct hlev_state_info_interrupted_irq *priv = state_unblocked->private;
+				print_indent(out, offset);
+				fprintf(out, "--- Woken up by an IRQ: ");
+				print_irq(out, priv->irq);
+				fprintf(out, "\n");
+			}
+			else if(state_unblocked->bstate == HLEV_INTERRUPTED_SOFTIRQ) {
+				struct hlev_state_info_interrupted_softirq *priv = state_unblocked->private;
+				print_indent(out, offset);
+				fprintf(out, "--- Woken up by a SoftIRQ: ");
+				print_softirq(out, priv->softirq);
+				fprintf(out, "\n");
 			}
 			else {
-				print_indent(offset);
-				printf("Weird... cannot find in what state the waker (%d) was\n", state_private_blocked->pid_exit);
+				print_critical_path(out, step->waker_path, offset+1);
+				print_indent(out, offset);
+				fprintf(out, "--- Woken up in context of ");
+				print_pid(out, state_private_blocked->pid_exit);
+				if(state_private_blocked->llev_state_exit) {
+					print_stack_garray_horizontal(out, state_private_blocked->llev_state_exit);
+				}
+				fprintf(out, " in high-level state %s", hlev_state_infos[state_unblocked->bstate].name);
+				fprintf(out, "\n");
 			}
-
-
-			//print_delay_pid(state_private_blocked->pid_exit, pstate->time_start, pstate->time_end);
-			//printf("\t\t Woken up in context of %d: ", state_private_blocked->pid_exit);
-			//if(state_private_blocked->llev_state_exit) {
-			//	print_stack_garray_horizontal(state_private_blocked->llev_state_exit);
-			//	printf("here3 (%d)\n", state_private_blocked->llev_state_exit->len);
-			//}
-			//else
-			//	printf("the private_blocked %p had a null exit stack\n", state_private_blocked);
-			//printf("\n");
+		}
+		else {
+			print_indent(out, offset);
+			fprintf(out, "Weird... cannot find in what state the waker (%d) was\n", state_private_blocked->pid_exit);
 		}
 	}
 }
 
+static void print_delay_pid(FILE *out, struct critical_path_cache *paths, int pid, LttTime t1, LttTime t2, int offset)
+{
+	struct critical_path *path = critical_path_get(paths, pid, t1, t2);
+
+	print_critical_path(out, path, offset);
+	if(path)
+		critical_path_unref(path);
+}
+
 static void print_range_critical_path(int process, LttTime t1, LttTime t2)
 {
 	printf("Critical path for requested range:\n");
 	printf("Final process is %d\n", process);
-	print_delay_pid(process, t1, t2, 2);
+	print_delay_pid(stdout, critical_paths, process, t1, t2, 2);
 }
 
 /*
@@ -1028,10 +932,20 @@ static void print_range_critical_path(int process, LttTime t1, LttTime t2)
  *           --- Woken up in context of PID [appname] in high-level state RUNNING
  */
 
+/* Render the critical path summary of a process in a report */
+static void render_critical_path_report(FILE *out, struct critical_path_cache *paths, struct process *pinfo)
+{
+	fprintf(out, "\tProcess %d [%s]\n", pinfo->pid, g_quark_to_string(pinfo->name));
+	if(pinfo->hlev_history->len >= 1)
+		print_delay_pid(out, paths, pinfo->pid, g_array_index(pinfo->hlev_history, struct process_state *, 0)->time_begin, g_array_index(pinfo->hlev_history, struct process_state *, pinfo->hlev_history->len - 1)->time_end, 2);
+}
+
 static void print_process_critical_path_summary()
 {
-	struct process *pinfo;
-	GList *pinfos;
+	struct critical_path_report *reports;
+	int nb_reports = 0;
+	GList *pinfos, *l;
+	int i;
 
 	pinfos = g_hash_table_get_values(process_hash_table);
 	if(pinfos == NULL) {
@@ -1041,25 +955,27 @@ static void print_process_critical_path_summary()
 
 	printf("Process Critical Path Summary:\n");
 
-	for(;;) {
+	reports = g_new(struct critical_path_report, g_list_length(pinfos));
+	for(l = pinfos; l; l = l->next) {
+		struct process *pinfo = (struct process *)l->data;
 
-		pinfo = (struct process *)pinfos->data;
 		if (depanalysis_range_pid_searching != -1 && pinfo->pid != depanalysis_range_pid_searching)
-			goto next_iter;
-		printf("\tProcess %d [%s]\n", pinfo->pid, g_quark_to_string(pinfo->name));
-
-		if(pinfo->hlev_history->len < 1)
-			goto next_iter;
-
-		print_delay_pid(pinfo->pid, g_array_index(pinfo->hlev_history, struct process_state *, 0)->time_begin, g_array_index(pinfo->hlev_history, struct process_state *, pinfo->hlev_history->len - 1)->time_end, 2);
+			continue;
+		reports[nb_reports].pinfo = pinfo;
+		reports[nb_reports].text = NULL;
+		nb_reports++;
+	}
+	g_list_free(pinfos);
 
-		next_iter:
+	critical_path_render_reports(process_hash_table, reports, nb_reports,
+		a_depanalysis_threads, render_critical_path_report);
 
-		if(pinfos->next)
-			pinfos = pinfos->next;
-		else
-			break;
+	/* Print in the order of the processes, whatever thread rendered them */
+	for(i=0; i<nb_reports; i++) {
+		fwrite(reports[i].text, 1, reports[i].size, stdout);
+		free(reports[i].text);
 	}
+	g_free(reports);
 }
 
 gint compare_states_length(gconstpointer a, gconstpointer b)
@@ -1310,6 +1226,36 @@ static void flush_process_sstacks(void)
 	g_list_free(pinfos);
 }
 
+/* Print the memory used by the sstacks and the process whose sstack grew the
+ * most
+ */
+static void print_sstack_stats(void)
+{
+	struct sstack_stats stats;
+	struct process *largest = NULL;
+	GList *pinfos, *l;
+
+	sstack_get_stats(&stats);
+	pinfos = g_hash_table_get_values(process_hash_table);
+	for(l = pinfos; l; l = l->next) {
+		struct process *pinfo = l->data;
+
+		if(largest == NULL || pinfo->stack->peak_len > largest->stack->peak_len)
+			largest = pinfo;
+	}
+	g_list_free(pinfos);
+
+	printf("Sstack memory:\n");
+	printf("\tpeak: %lu bytes\n", stats.peak_bytes);
+	printf("\tcompactions: %lu, bytes freed by compaction: %lu\n",
+		stats.compactions, stats.compacted_bytes);
+	if(largest) {
+		printf("\tlargest sstack: %d items, process %d [%s]\n",
+			largest->stack->peak_len, largest->pid,
+			g_quark_to_string(largest->name));
+	}
+}
+
 struct family_item {
 	int pid;
 	LttTime creation;
@@ -1383,6 +1329,9 @@ static gboolean write_traceset_footer(void *hook_data, void *call_data)
          */
 	flush_process_sstacks();
 
+	if(a_print_sstack_stats)
+		print_sstack_stats();
+
 	/* print the reports */
 	print_simple_summary();
 	print_process_critical_path_summary();
@@ -1528,6 +1477,7 @@ static struct process *get_or_init_process_info(struct LttEvent *e, GQuark name,
 		pinfo->pid = pid;
 		pinfo->parent = -1; /* unknown parent */
 		pinfo->hlev_history = g_array_new(FALSE, FALSE, sizeof(struct process_state *));
+		pinfo->hlev_ends = g_array_new(FALSE, FALSE, sizeof(guint64));
 		pinfo->stack = sstack_new();
 		pinfo->stack_current=-1;
 		pinfo->stack->process_func = process_delayed_stack_action;
@@ -1882,11 +1832,16 @@ static int process_event(void *hook_data, void *call_data)
 
 		/* FIXME: the target could not yet have an entry in the hash table, we would then lose data */
 		target_pinfo = g_hash_table_lookup(process_hash_table, &target);
-		if(!target_pinfo)
+		if(!target_pinfo) {
+			g_free(twe);
+			g_free(se);
+			g_free(item);
 			goto next_iter;
+		}
 
 		item->data_val = se;
-		item->delete_data_val = (void (*)(void *))delete_data_val;
+		item->delete_data_val = (void (*)(void *))delete_sstack_event;
+		item->data_size = sizeof(struct sstack_event) + sizeof(struct try_wakeup_event);
 
 		sstack_add_item(target_pinfo->stack, item);
 
@@ -1989,8 +1944,14 @@ static void init()
       LTTV_OPT_INT, &depanalysis_event_limit, arg_limit, NULL);
   lttv_option_add("print-summary", 0, "print simple summary", "sum",
       LTTV_OPT_INT, &a_print_simple_summary, arg_sum, NULL);
+  lttv_option_add("sstack-stats", 0, "print the memory used by the sstacks", "",
+      LTTV_OPT_NONE, &a_print_sstack_stats, NULL, NULL);
+  lttv_option_add("depanalysis-threads", 0,
+      "threads computing the critical path summary", "number of threads",
+      LTTV_OPT_INT, &a_depanalysis_threads, NULL, NULL);
 
   process_hash_table = g_hash_table_new(g_int_hash, g_int_equal);
+  critical_paths = critical_path_cache_new(process_hash_table);
   syscall_table = g_hash_table_new(g_int_hash, g_int_equal);
   irq_table = g_hash_table_new(g_int_hash, g_int_equal);
   softirq_table = g_hash_table_new(g_int_hash, g_int_equal);
@@ -2028,8 +1989,11 @@ static void destroy()
   lttv_option_remove("dep-pid");
   lttv_option_remove("limit-events");
   lttv_option_remove("print-summary");
+  lttv_option_remove("sstack-stats");
+  lttv_option_remove("depanalysis-threads");
 
   g_hash_table_destroy(process_hash_table);
+  critical_path_cache_destroy(critical_paths);
   g_hash_table_destroy(syscall_table);
   g_hash_table_destroy(irq_table);
   g_hash_table_destroy(softirq_table);
@@ -0,0 +1,86 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef DEPANALYSIS_H
+#define DEPANALYSIS_H
+
+#include <glib.h>
+#include <lttv/time.h>
+
+#include "sstack.h"
+
+/* The process states of depanalysis that the critical paths are resolved
+ * from. They do not depend on the tracefile API.
+ */
+
+enum hlev_state {
+	HLEV_UNKNOWN=0,
+	HLEV_RUNNING,
+	HLEV_BLOCKED,
+	HLEV_INTERRUPTED_IRQ,
+	HLEV_INTERRUPTED_SOFTIRQ,
+	HLEV_INTERRUPTED_CPU,
+	HLEV_INTERRUPTED_POST_BLOCK,
+};
+
+struct hlev_state_info_blocked {
+	int syscall_id;
+	unsigned char trap; /* flag */
+	int substate;
+
+	/* Garray of pointers to struct process_state that reflect the
+         * low-level state stack when respectively entering and exiting the blocked
+         * state.
+         */
+	GArray *llev_state_entry;
+	GArray *llev_state_exit;
+
+	int pid_exit; /* FIXME: it's not pretty to have this here; find this info elsewhere */
+	LttTime time_woken;
+
+	void *private;
+};
+
+struct process_state {
+	int bstate;
+	int cause_type;
+	void *private;
+	/* set when an hlev state refers to this llev state, which must then
+	 * outlive its sstack item */
+	int kept;
+
+	LttTime time_begin;
+	LttTime time_end;
+};
+
+#define PROCESS_STATE_STACK_SIZE 10
+struct process {
+	int pid;
+	GQuark name;
+	int parent;
+
+	struct sstack *stack;
+	struct process_state *llev_state_stack[PROCESS_STATE_STACK_SIZE];
+	int stack_current;
+	struct process_state *hlev_state;
+	GArray *hlev_history;
+	/* time_end of each state of hlev_history in ns, contiguous so that the
+	 * searches by time do not follow the state pointers */
+	GArray *hlev_ends;
+};
+
+#endif /* DEPANALYSIS_H */
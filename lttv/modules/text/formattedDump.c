@@ -36,44 +36,164 @@
 #include <lttv/hook.h>
 #include <lttv/attribute.h>
 #include <lttv/iattribute.h>
-#include <lttv/stats.h>
-#include <lttv/filter.h>
+#include <lttv/traceset.h>
+#include <lttv/event.h>
 #include <lttv/print.h>
-#include <ltt/ltt.h>
-#include <ltt/event.h>
-#include <ltt/trace.h>
+#include <babeltrace/ctf/events.h>
 #include <stdio.h>
 #include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 
+/*
+ * The format is compiled into a list of operations before the first event.
+ * Printing an event runs the list, without scanning the format again.
+ */
+typedef enum {
+	FORMAT_TEXT,		/* literal text, text and len */
+	FORMAT_CHANNEL,		/* %c */
+	FORMAT_EVENT,		/* %e */
+	FORMAT_TRACE_PATH,	/* %r */
+	FORMAT_TIME,		/* %t */
+	FORMAT_SECONDS,		/* %s */
+	FORMAT_NANOSECONDS,	/* %n */
+	FORMAT_ELAPSED,		/* %l */
+	FORMAT_CPU,		/* %u */
+	FORMAT_PID,		/* %d */
+	FORMAT_PPID,		/* %i */
+	FORMAT_TGID,		/* %g */
+	FORMAT_PROCESS,		/* %p */
+	FORMAT_STATE,		/* %a */
+	FORMAT_FIELDS,		/* %m */
+} FormatOpType;
+
+typedef struct {
+	FormatOpType type;
+	const char *text;
+	gsize len;
+} FormatOp;
+
+static const struct {
+	char conversion;
+	FormatOpType type;
+} conversions[] = {
+	{ 'c', FORMAT_CHANNEL },
+	{ 'e', FORMAT_EVENT },
+	{ 'r', FORMAT_TRACE_PATH },
+	{ 't', FORMAT_TIME },
+	{ 's', FORMAT_SECONDS },
+	{ 'n', FORMAT_NANOSECONDS },
+	{ 'l', FORMAT_ELAPSED },
+	{ 'u', FORMAT_CPU },
+	{ 'd', FORMAT_PID },
+	{ 'i', FORMAT_PPID },
+	{ 'g', FORMAT_TGID },
+	{ 'p', FORMAT_PROCESS },
+	{ 'a', FORMAT_STATE },
+	{ 'm', FORMAT_FIELDS },
+};
+
 static gboolean a_no_field_names;
 static gboolean a_state;
 static gboolean a_text;
 static gboolean a_strace;
-static gboolean a_meta;
 static char *a_file_name;
 static char *a_format;
 
 static LttvHooks *before_traceset;
+static LttvHooks *after_traceset;
 static LttvHooks *event_hook;
 
 static const char default_format[] =
 		"channel:%c event:%e timestamp:%t elapsed:%l cpu:%u pid:%d "
 		"ppid:%i tgpid:%g process:%p state:%a payload:{ %m }";
 static const char textDump_format[] =
-		"%c.%e: %s.%n (%r/%c_%u), %d, %g, %p, %i, %y, %a { %m }";
+		"%c.%e: %s.%n (%r/%c_%u), %d, %g, %p, %i, %a { %m }";
 static const char strace_format[] = "%e(%m) %s.%n";
-static const char *fmt;
 
 static FILE *a_file;
 
 static GString *a_string;
 
-static int output_format_len;
+/* FormatOp, the compiled format */
+static GArray *format_ops;
+/* TRUE if the format prints the running process */
+static gboolean format_needs_process;
+/* guint64 timestamp of the previous event of each trace, indexed by trace
+   id, 0 before the first one. Used by %l. */
+static GArray *previous_timestamps;
+
+static void add_text_op(const char *text, gsize len)
+{
+	FormatOp op = { FORMAT_TEXT, text, len };
+
+	g_array_append_val(format_ops, op);
+}
+
+/*
+ * Compile the format into format_ops. Unknown conversions are ignored. The
+ * format string must outlive format_ops.
+ */
+static void compile_format(const char *format)
+{
+	const char *p = format, *text = format;
+	unsigned int i;
+
+	g_array_set_size(format_ops, 0);
+	format_needs_process = FALSE;
+
+	while (*p != '\0') {
+		if (*p != '%') {
+			p++;
+			continue;
+		}
+
+		if (p > text)
+			add_text_op(text, p - text);
+		p++;
+		if (*p == '\0') {
+			text = p;
+			break;
+		}
+
+		if (*p == '%') {
+			add_text_op(p, 1);
+		} else {
+			for (i = 0; i < G_N_ELEMENTS(conversions); i++) {
+				if (conversions[i].conversion == *p) {
+					FormatOp op = { conversions[i].type, NULL, 0 };
+
+					g_array_append_val(format_ops, op);
+					if (op.type >= FORMAT_PID &&
+							op.type <= FORMAT_STATE)
+						format_needs_process = TRUE;
+					break;
+				}
+			}
+		}
+		p++;
+		text = p;
+	}
+	if (p > text)
+		add_text_op(text, p - text);
+}
+
+static void append_padded(GString *s, guint64 value, guint width)
+{
+	char buf[20];
+	char *p = buf + sizeof(buf);
+
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value != 0 || (guint) (buf + sizeof(buf) - p) < width);
+	g_string_append_len(s, p, buf + sizeof(buf) - p);
+}
 
 static gboolean open_output_file(void *hook_data, void *call_data)
 {
+	const char *fmt;
+
 	if (a_text) {
 		/* textDump format (used with -T command option) */
 		fmt = textDump_format;
@@ -91,7 +211,9 @@ static gboolean open_output_file(void *hook_data, void *call_data)
 		fmt = a_format;
 	}
 
-	output_format_len = strlen(fmt);
+	/* The options are only known once the traceset is about to be read */
+	compile_format(fmt);
+	g_array_set_size(previous_timestamps, 0);
 
 	g_info("Open the output file");
 	if (a_file_name == NULL) {
@@ -105,206 +227,125 @@ static gboolean open_output_file(void *hook_data, void *call_data)
 	return FALSE;
 }
 
-static int write_event_content(void *hook_data, void *call_data)
+static gboolean close_output_file(void *hook_data, void *call_data)
 {
-	gboolean result;
-
-	LttvIAttribute *attributes = LTTV_IATTRIBUTE(lttv_global_attributes());
-
-	LttvTracefileContext *tfc = (LttvTracefileContext *)call_data;
-
-	LttvTracefileState *tfs = (LttvTracefileState *)call_data;
-
-	LttEvent *e;
-
-	LttvAttributeValue value_filter;
-
-	LttvFilter *filter;
-
-	guint cpu = tfs->cpu;
-	LttvTraceState *ts = (LttvTraceState *)tfc->t_context;
-	LttvProcessState *process = ts->running_process[cpu];
-
-	e = ltt_tracefile_get_event(tfc->tf);
-
-	result = lttv_iattribute_find_by_path(attributes, "filter/lttv_filter",
-			LTTV_POINTER, &value_filter);
-	g_assert(result);
-	filter = (LttvFilter *)*(value_filter.v_pointer);
-
-	/* call to the filter if available */
-	if (filter->head != NULL) {
-		if (!lttv_filter_tree_parse(filter->head, e, tfc->tf,
-				tfc->t_context->t, tfc, NULL, NULL)) {
-			return FALSE;
-		}
+	if (a_file_name != NULL) {
+		fclose(a_file);
 	}
+	return FALSE;
+}
 
-	/*
-	 * By default, metadata's channel won't be display: it goes directly
-	 * to the next event. You can have metadata's information with -M
-	 * switch (a_meta option).
-	 */
-	if (!a_meta && ltt_tracefile_name(tfs->parent.tf) ==
-			g_quark_from_string("metadata")) {
-		return FALSE;
-		/*
-		 * TODO:
-		 * Investigate the use of filter to do it.
-		 */
+static int write_event_content(void *hook_data, void *call_data)
+{
+	LttvEvent *event = (LttvEvent *)call_data;
+	LttvTrace *trace = event->state->trace;
+	LttvProcessState *process = NULL;
+	guint64 timestamp = event->timestamp;
+	guint64 elapsed = 0;
+	guint64 *previous;
+	guint cpu;
+	guint i;
+
+	cpu = lttv_traceset_get_cpuid_from_event(event);
+	if (format_needs_process || a_state) {
+		process = event->state->running_process[cpu];
 	}
 
-	lttv_event_to_string(e, a_string, TRUE, !a_no_field_names, tfs);
+	/* Elapsed time since the previous event of the same trace */
+	if (trace->id >= previous_timestamps->len) {
+		g_array_set_size(previous_timestamps, trace->id + 1);
+	}
+	previous = &g_array_index(previous_timestamps, guint64, trace->id);
+	if (*previous != 0 && timestamp > *previous) {
+		elapsed = timestamp - *previous;
+	}
+	*previous = timestamp;
+
+	g_string_set_size(a_string, 0);
+	for (i = 0; i < format_ops->len; i++) {
+		const FormatOp *op = &g_array_index(format_ops, FormatOp, i);
+
+		switch (op->type) {
+		case FORMAT_TEXT:
+			g_string_append_len(a_string, op->text, op->len);
+			break;
+		case FORMAT_CHANNEL:
+			g_string_append(a_string, trace->short_name);
+			break;
+		case FORMAT_EVENT:
+			g_string_append(a_string,
+					bt_ctf_event_name(event->bt_event));
+			break;
+		case FORMAT_TRACE_PATH:
+			g_string_append(a_string, trace->full_path);
+			break;
+		case FORMAT_TIME:
+			lttv_string_append_uint64(a_string,
+					timestamp / NANOSECONDS_PER_SECOND / 3600);
+			g_string_append_c(a_string, ':');
+			append_padded(a_string,
+					timestamp / NANOSECONDS_PER_SECOND % 3600 / 60, 2);
+			g_string_append_c(a_string, ':');
+			append_padded(a_string,
+					timestamp / NANOSECONDS_PER_SECOND % 60, 2);
+			g_string_append_c(a_string, '.');
+			append_padded(a_string,
+					timestamp % NANOSECONDS_PER_SECOND, 9);
+			break;
+		case FORMAT_SECONDS:
+			lttv_string_append_uint64(a_string,
+					timestamp / NANOSECONDS_PER_SECOND);
+			break;
+		case FORMAT_NANOSECONDS:
+			lttv_string_append_uint64(a_string,
+					timestamp % NANOSECONDS_PER_SECOND);
+			break;
+		case FORMAT_ELAPSED:
+			lttv_string_append_uint64(a_string,
+					elapsed / NANOSECONDS_PER_SECOND);
+			g_string_append_c(a_string, '.');
+			append_padded(a_string,
+					elapsed % NANOSECONDS_PER_SECOND, 9);
+			break;
+		case FORMAT_CPU:
+			lttv_string_append_uint64(a_string, cpu);
+			break;
+		case FORMAT_PID:
+			lttv_string_append_uint64(a_string, process->pid);
+			break;
+		case FORMAT_PPID:
+			lttv_string_append_uint64(a_string, process->ppid);
+			break;
+		case FORMAT_TGID:
+			lttv_string_append_uint64(a_string, process->tgid);
+			break;
+		case FORMAT_PROCESS:
+			g_string_append(a_string,
+					g_quark_to_string(process->name));
+			break;
+		case FORMAT_STATE:
+			g_string_append(a_string,
+					g_quark_to_string(process->state->t));
+			break;
+		case FORMAT_FIELDS:
+			lttv_event_append_fields(event, a_string,
+					!a_no_field_names);
+			break;
+		}
+	}
 
 	if (a_state) {
-		g_string_append_printf(a_string, "%s ",
+		g_string_append(a_string,
 				g_quark_to_string(process->state->s));
+		g_string_append_c(a_string, ' ');
 	}
 
-	g_string_append_printf(a_string, "\n");
+	g_string_append_c(a_string, '\n');
 
-	fputs(a_string->str, a_file);
+	fwrite(a_string->str, 1, a_string->len, a_file);
 	return FALSE;
 }
 
-void lttv_event_to_string(LttEvent *e, GString *string_buffer, gboolean mandatory_fields,
-		gboolean field_names, LttvTracefileState *tfs)
-{
-	struct marker_field *field;
-	struct marker_info *info;
-
-	LttTime time;
-	LttTime elapse;
-	static LttTime time_prev = {0, 0};
-	/*
-	 * TODO:
-	 * Added this static value into state.c and reset each time you do a
-	 * seek for using it in the GUI.
-	 */
-
-	int i;
-	guint cpu = tfs->cpu;
-	LttvTraceState *ts = (LttvTraceState *)tfs->parent.t_context;
-	LttvProcessState *process = ts->running_process[cpu];
-
-	info = marker_get_info_from_id(tfs->parent.tf->mdata, e->event_id);
-	if (mandatory_fields) {
-		time = ltt_event_time(e);
-		/* Calculate elapsed time between current and previous event */
-		if (time_prev.tv_sec == 0 && time_prev.tv_nsec == 0) {
-			time_prev = ltt_event_time(e);
-			elapse.tv_sec = 0;
-			elapse.tv_nsec = 0;
-			/*
-			 * TODO:
-			 * Keep in mind that you should add the ability to
-			 * restore the previous event time to state.c if you
-			 * want to reuse this code into the GUI.
-			 */
-		} else {
-			elapse = ltt_time_sub(time, time_prev);
-			time_prev = time;
-		}
-	}
-	g_string_set_size(string_buffer, 0);
-	/*
-	 * Switch case:
-	 * all '%-' are replaced by the desired value in 'string_buffer'
-	 */
-	for (i = 0; i < output_format_len; i++) {
-		if (fmt[i] == '%') {
-			switch (fmt[++i]) {
-			case 't':
-				g_string_append_printf(string_buffer,
-						"%ld:%02ld:%02ld.%09ld",
-						time.tv_sec/3600,
-						(time.tv_sec%3600)/60,
-						time.tv_sec%60,
-						time.tv_nsec);
-				break;
-			case 'c':
-				g_string_append(string_buffer,
-						g_quark_to_string(ltt_tracefile_name(tfs->parent.tf)));
-				break;
-			case 'e':
-				g_string_append(string_buffer,
-						g_quark_to_string(info->name));
-				break;
-			case 'd':
-				g_string_append_printf(string_buffer, "%u",
-						process->pid);
-				break;
-			case 's':
-				g_string_append_printf(string_buffer, "%ld",
-						time.tv_sec);
-				break;
-			case 'n':
-				g_string_append_printf(string_buffer, "%ld",
-						time.tv_nsec);
-				break;
-			case 'i':
-				g_string_append_printf(string_buffer, "%u",
-						process->ppid);
-				break;
-			case 'g':
-				g_string_append_printf(string_buffer, "%u",
-						process->tgid);
-				break;
-			case 'p':
-				g_string_append(string_buffer,
-						g_quark_to_string(process->name));
-				break;
-			case 'u':
-				g_string_append_printf(string_buffer, "%u", cpu);
-				break;
-			case 'l':
-				g_string_append_printf(string_buffer,
-						"%ld.%09ld",
-						elapse.tv_sec, elapse.tv_nsec);
-				break;
-			case 'a':
-				g_string_append(string_buffer,
-						g_quark_to_string(process->state->t));
-				break;
-			case 'm':
-				{
-				/*
-				 * Get and print markers and tracepoints fields
-				 * into 'string_buffer'
-				 */
-				if (marker_get_num_fields(info) == 0)
-					break;
-					for (field = marker_get_field(info, 0);
-							field != marker_get_field(info, marker_get_num_fields(info));
-							field++) {
-						if (field != marker_get_field(info, 0)) {
-							g_string_append(string_buffer, ", ");
-						}
-
-						lttv_print_field(e, field, string_buffer, field_names, tfs);
-					}
-				}
-				break;
-			case 'r':
-				g_string_append(string_buffer, g_quark_to_string(
-						ltt_trace_name(ltt_tracefile_get_trace(tfs->parent.tf))));
-				break;
-			case '%':
-				g_string_append_c(string_buffer, '%');
-				break;
-			case 'y':
-				g_string_append_printf(string_buffer,
-						"0x%" PRIx64,
-						process->current_function);
-				break;
-			}
-		} else {
-			/* Copy every character if different of '%' */
-			g_string_append_c(string_buffer, fmt[i]);
-		}
-	}
-}
-
 static void init()
 {
 	gboolean result;
@@ -316,6 +357,8 @@ static void init()
 	g_info("Init formattedDump.c");
 
 	a_string = g_string_new("");
+	format_ops = g_array_new(FALSE, FALSE, sizeof(FormatOp));
+	previous_timestamps = g_array_new(FALSE, TRUE, sizeof(guint64));
 
 	a_file_name = NULL;
 	lttv_option_add("output", 'o',
@@ -335,33 +378,28 @@ static void init()
 			"",
 			LTTV_OPT_NONE, &a_strace, NULL, NULL);
 
-	a_meta = FALSE;
-	lttv_option_add("metadata", 'M',
-			"add metadata information",
-			"",
-			LTTV_OPT_NONE, &a_meta, NULL, NULL);
-
 	a_format = NULL;
 	lttv_option_add("format", 'F',
 			"output the desired format\n"
 			"		FORMAT controls the output. "
 			"Interpreted sequences are:\n"
 			"\n"
-			"		%c   channel name\n"
+			"		%c   channel name (name of the trace)\n"
 			"		%p   process name\n"
 			"		%e   event name\n"
 			"		%r   path to trace\n"
 			"		%t   timestamp  (e.g., 2:08:54.025684145)\n"
 			"		%s   seconds\n"
 			"		%n   nanoseconds\n"
-			"		%l   elapsed time with the previous event\n"
+			"		%l   elapsed time with the previous event of "
+			"the trace\n"
 			"		%d   pid\n"
 			"		%i   ppid\n"
 			"		%g   tgid\n"
 			"		%u   cpu\n"
 			"		%a   state\n"
-			"		%y   memory address\n"
-			"		%m   markers and tracepoints fields\n",
+			"		%m   tracepoint fields\n"
+			"		%%   a literal %\n",
 			"format string (e.g., \"channel:%c event:%e process:%p\")",
 			LTTV_OPT_STRING, &a_format, NULL, NULL);
 
@@ -380,6 +418,13 @@ static void init()
 	lttv_hooks_add(before_traceset, open_output_file, NULL,
 			LTTV_PRIO_DEFAULT);
 
+	result = lttv_iattribute_find_by_path(attributes, "hooks/traceset/after",
+			LTTV_POINTER, &value);
+	g_assert(result);
+	after_traceset = *(value.v_pointer);
+	g_assert(after_traceset);
+	lttv_hooks_add(after_traceset, close_output_file, NULL,
+			LTTV_PRIO_DEFAULT);
 }
 
 static void destroy()
@@ -394,14 +439,17 @@ static void destroy()
 
 	lttv_option_remove("strace");
 
-	lttv_option_remove("metadata");
-
 	g_string_free(a_string, TRUE);
 
+	g_array_free(format_ops, TRUE);
+
+	g_array_free(previous_timestamps, TRUE);
+
 	lttv_hooks_remove_data(event_hook, write_event_content, NULL);
 
 	lttv_hooks_remove_data(before_traceset, open_output_file, NULL);
 
+	lttv_hooks_remove_data(after_traceset, close_output_file, NULL);
 }
 
 
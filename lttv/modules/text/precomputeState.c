@@ -31,20 +31,18 @@
 #include <lttv/hook.h>
 #include <lttv/attribute.h>
 #include <lttv/iattribute.h>
-#include <lttv/stats.h>
-#include <lttv/filter.h>
-#include <lttv/print.h>
-#include <ltt/ltt.h>
-#include <ltt/event.h>
-#include <ltt/trace.h>
+#include <lttv/traceset.h>
+#include <lttv/state.h>
+#include <lttv/state-file.h>
+#include <lttv/event.h>
+#include <babeltrace/ctf/events.h>
 #include <stdio.h>
 
 static gboolean
   a_raw;
 
 static char
-  *a_file_name = NULL,
-  *a_quark_file_name = NULL;
+  *a_file_name = NULL;
 
 static LttvHooks
   *before_traceset,
@@ -53,7 +51,16 @@ static LttvHooks
   *after_trace,
   *event_hook;
 
-static guint a_event_count = 0;
+/* The states are saved before the state hooks see the event */
+#define PRECOMPUTE_PRIO (LTTV_PRIO_STATE-5)
+
+/* Events since the last saved state and raw time of the last event */
+static guint a_event_count;
+static guint64 a_last_time;
+
+/* With the raw output, state file of each trace, indexed by the babeltrace
+   handle of the trace */
+static GPtrArray *a_writers;
 
 /* Insert the hooks before and after each trace and tracefile, and for each
    event. Print a global header. */
@@ -64,7 +71,43 @@ static GString *a_string;
 
 static gboolean write_traceset_header(void *hook_data, void *call_data)
 {
-  LttvTracesetContext *tc = (LttvTracesetContext *)call_data;
+  LttvTraceset *traceset = (LttvTraceset *)call_data;
+  guint i, nb_trace;
+
+  nb_trace = lttv_traceset_number(traceset);
+  a_event_count = 0;
+  a_last_time = 0;
+
+  /* The binary states go to one file per trace, the files are mapped when
+     they are read so they cannot be written to stdout. Without an output
+     file name, they are written in the trace directories, where LTTV loads
+     them with the traces. */
+  if(a_raw) {
+    g_ptr_array_set_size(a_writers, 0);
+    for(i = 0 ; i < nb_trace ; i++) {
+      LttvTrace *trace = lttv_traceset_get(traceset, i);
+      LttvStateFileWriter *writer;
+      guint8 uuid[LTTV_STATE_FILE_UUID_LEN];
+      gboolean has_uuid;
+      char *path;
+
+      if(a_file_name == NULL)
+        path = g_build_filename(trace->full_path, LTTV_STATE_FILE_NAME, NULL);
+      else if(nb_trace == 1) path = g_strdup(a_file_name);
+      else path = g_strdup_printf("%s.%u", a_file_name, i);
+
+      if(trace->id >= a_writers->len)
+        g_ptr_array_set_size(a_writers, trace->id + 1);
+
+      has_uuid = lttv_state_file_get_trace_uuid(trace->full_path, uuid);
+      writer = lttv_state_file_writer_new(path,
+          lttv_trace_get_num_cpu(trace), has_uuid ? uuid : NULL);
+      if(writer == NULL) g_error("cannot open file %s", path);
+      g_ptr_array_index(a_writers, trace->id) = writer;
+      g_free(path);
+    }
+    return FALSE;
+  }
 
   if(a_file_name == NULL) a_file = stdout;
   else a_file = fopen(a_file_name, "w");
@@ -72,14 +115,7 @@ static gboolean write_traceset_header(void *hook_data, void *call_data)
   if(a_file == NULL) g_error("cannot open file %s", a_file_name);
 
   /* Print the trace set header */
-  if(a_raw) {
-  /* TODO : Write a header that will check for ILP size and endianness */
-    //fputc(HDR_TRACESET, a_file);
-    g_assert(lttv_traceset_number(tc->ts) == 1); /* Only one trace in traceset */
-  } else  {
-    fprintf(a_file,"<TRACESET NUM_TRACES=%d/>\n", 
-        lttv_traceset_number(tc->ts));
-  }
+  fprintf(a_file,"<TRACESET NUM_TRACES=%d/>\n", nb_trace);
 
   return FALSE;
 }
@@ -87,42 +123,22 @@ static gboolean write_traceset_header(void *hook_data, void *call_data)
 
 static gboolean write_traceset_footer(void *hook_data, void *call_data)
 {
-  GQuark q;
-  const gchar *string;
+  guint i;
 
   if(a_raw) {
+    for(i = 0 ; i < a_writers->len ; i++) {
+      LttvStateFileWriter *writer = g_ptr_array_index(a_writers, i);
 
-  } else {
-    fprintf(a_file,"</TRACESET>\n");
-  }
-
-  if(a_file_name != NULL) fclose(a_file);
-
-  if(a_raw) {
-    if(a_quark_file_name == NULL) {
-      if(a_file_name == NULL) a_file = stdout;
-      else a_file = fopen(a_file_name, "a");
-    } else {
-      if(a_quark_file_name == NULL) a_file = stdout;
-      else a_file = fopen(a_quark_file_name, "w");
+      if(writer != NULL && !lttv_state_file_writer_close(writer))
+        g_warning("error while writing the state file of trace %u", i);
     }
+    g_ptr_array_set_size(a_writers, 0);
+    return FALSE;
+  }
 
-    if(a_file == NULL) g_error("cannot open file %s", a_quark_file_name);
-
-    fputc(HDR_QUARKS, a_file);
-    q = 1;
-    do {
-      string = g_quark_to_string(q);
-      if(string == NULL) break;
-      fputc(HDR_QUARK, a_file);
-      // increment. fwrite(&q, sizeof(GQuark), 1, a_file);
-      fwrite(string, sizeof(char), strlen(string)+1, a_file);
-      q++;
-    } while(1);
-   
-    if(a_quark_file_name != NULL || a_file_name != NULL) fclose(a_file);
+  fprintf(a_file,"</TRACESET>\n");
 
-  }
+  if(a_file_name != NULL) fclose(a_file);
 
   return FALSE;
 }
@@ -130,13 +146,10 @@ static gboolean write_traceset_footer(void *hook_data, void *call_data)
 
 static gboolean write_trace_header(void *hook_data, void *call_data)
 {
-  LttvTraceContext *tc = (LttvTraceContext *)call_data;
+  LttvTrace *trace = (LttvTrace *)call_data;
 
-  if(a_raw) {
-    fputc(HDR_TRACE, a_file);
-  } else {
-    fprintf(a_file,"<TRACE TRACE_NUMBER=%d/>\n", 
-        tc->index);
+  if(!a_raw) {
+    fprintf(a_file,"<TRACE TRACE_NUMBER=%d/>\n", trace->id);
   }
   
   return FALSE;
@@ -145,9 +158,7 @@ static gboolean write_trace_header(void *hook_data, void *call_data)
 static gboolean write_trace_footer(void *hook_data, void *call_data)
 {
 
-  if(a_raw) {
-
-  } else {
+  if(!a_raw) {
     fprintf(a_file,"</TRACE>\n");
   }
 
@@ -155,26 +166,44 @@ static gboolean write_trace_footer(void *hook_data, void *call_data)
 }
 
 
+/* Save the state of all the traces, at the same time so that a seek can
+   restore them together. The time is the raw time of the event, like the
+   seeks, and the event is not in the state yet. A state is only saved at the
+   first event of its time, the others are not in the state either. */
 static int for_each_event(void *hook_data, void *call_data)
 {
-  guint *event_count = (guint*)hook_data;
+  LttvEvent *event = (LttvEvent *)call_data;
+  LttvTraceset *traceset;
+  guint64 timestamp;
+  guint i, nb_trace;
+  LttTime t;
 
-  LttvTracefileContext *tfc = (LttvTracefileContext *)call_data;
+  if(event->state == NULL) return FALSE;
 
-  LttvTracefileState *tfs = (LttvTracefileState *)call_data;
+  timestamp = bt_ctf_get_timestamp(event->bt_event);
 
   /* Only save at LTTV_STATE_SAVE_INTERVAL */
-  if(likely((*event_count)++ < LTTV_STATE_SAVE_INTERVAL))
+  if(likely(a_event_count < LTTV_STATE_SAVE_INTERVAL ||
+      timestamp == a_last_time)) {
+    a_event_count++;
+    a_last_time = timestamp;
     return FALSE;
-  else
-    *event_count = 0;
-
-  LttvTraceState *ts = (LttvTraceState*)tfc->t_context;
-
-  if(a_raw) {
-    lttv_state_write_raw(ts, tfs->parent.timestamp, a_file);
-  } else {
-    lttv_state_write(ts, tfs->parent.timestamp, a_file);
+  }
+  a_event_count = 1;
+  a_last_time = timestamp;
+
+  t = ltt_time_from_uint64(timestamp);
+  traceset = lttv_trace_get_traceset(event->state->trace);
+  nb_trace = lttv_traceset_number(traceset);
+  for(i = 0 ; i < nb_trace ; i++) {
+    LttvTrace *trace = lttv_traceset_get(traceset, i);
+
+    if(a_raw) {
+      lttv_state_file_write(g_ptr_array_index(a_writers, trace->id),
+          trace->state, t);
+    } else {
+      lttv_state_write(trace->state, t, a_file);
+    }
   }
   
   return FALSE;
@@ -198,22 +227,18 @@ static void init()
       "file name", 
       LTTV_OPT_STRING, &a_file_name, NULL, NULL);
 
-  a_quark_file_name = NULL;
-  lttv_option_add("qoutput", 'q', 
-      "output file where the quarks (tuples integer, string) are to be written", 
-      "file name", 
-      LTTV_OPT_STRING, &a_quark_file_name, NULL, NULL);
-
   lttv_option_add("raw", 'r', 
-      "Output in raw binary",
+      "Output in a binary state file per trace, by default in the trace",
       "Raw binary", 
       LTTV_OPT_NONE, &a_raw, NULL, NULL);
 
+  a_writers = g_ptr_array_new();
+
   retval= lttv_iattribute_find_by_path(attributes, "hooks/event",
     LTTV_POINTER, &value);
   g_assert(retval);
   g_assert((event_hook = *(value.v_pointer)) != NULL);
-  lttv_hooks_add(event_hook, for_each_event, &a_event_count, LTTV_PRIO_DEFAULT);
+  lttv_hooks_add(event_hook, for_each_event, NULL, PRECOMPUTE_PRIO);
 
   retval= lttv_iattribute_find_by_path(attributes, "hooks/trace/before",
     LTTV_POINTER, &value);
@@ -248,23 +273,25 @@ static void destroy()
 
   lttv_option_remove("output");
 
-  lttv_option_remove("qoutput");
-
   lttv_option_remove("raw");
 
   g_string_free(a_string, TRUE);
 
+  g_ptr_array_free(a_writers, TRUE);
+
   lttv_hooks_remove_data(event_hook, for_each_event, NULL);
 
   lttv_hooks_remove_data(before_trace, write_trace_header, NULL);
 
-  lttv_hooks_remove_data(before_trace, write_traceset_header, NULL);
+  lttv_hooks_remove_data(after_trace, write_trace_footer, NULL);
+
+  lttv_hooks_remove_data(before_traceset, write_traceset_header, NULL);
 
-  lttv_hooks_remove_data(before_trace, write_traceset_footer, NULL);
+  lttv_hooks_remove_data(after_traceset, write_traceset_footer, NULL);
 }
 
 
 LTTV_MODULE("precomputeState", "Precompute states", \
 	    "Precompute states in a trace, XML or binary output.", \
-	    init, destroy, "stats", "batchAnalysis", "option", "print")
+	    init, destroy, "batchAnalysis", "option", "print")
 
@@ -0,0 +1,464 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* This module extracts a time window of a traceset into a new traceset. The
+   packets of each stream that overlap the window are copied as they are,
+   found with the packet index that LTTng writes in the index directory of
+   the traces. The metadata is copied whole. The state of each trace at the
+   start of the window is written in the state file of the sliced trace,
+   since the packets kept also hold some events before the window. LTTV
+   loads it with the trace and restores it when seeking in the window, or at
+   the start of the trace: the events before the window, which only come
+   from some of the streams, are then skipped instead of being replayed on
+   the initial state. */
+
+#define _GNU_SOURCE
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <lttv/lttv.h>
+#include <lttv/attribute.h>
+#include <lttv/hook.h>
+#include <lttv/option.h>
+#include <lttv/module.h>
+#include <lttv/traceset.h>
+#include <lttv/traceset-process.h>
+#include <lttv/state.h>
+#include <lttv/state-file.h>
+#include <babeltrace/context.h>
+#include <babeltrace/trace-handle.h>
+
+#define CTF_INDEX_MAGIC 0xC1F1DCC1
+
+/* Conversions from cycles to ns are rounded, the window is widened by this
+   many ns so that no packet is missed */
+#define SLICE_MARGIN 1000
+
+/* Packet index file, all the fields are big endian. An entry is
+   packet_index_len bytes long, later index versions append fields. */
+typedef struct {
+  guint32 magic;
+  guint32 index_major;
+  guint32 index_minor;
+  guint32 packet_index_len;
+} __attribute__((__packed__)) SliceIndexHeader;
+
+typedef struct {
+  guint64 offset;		/* in bytes */
+  guint64 packet_size;		/* in bits */
+  guint64 content_size;		/* in bits */
+  guint64 timestamp_begin;	/* in cycles */
+  guint64 timestamp_end;
+  guint64 events_discarded;
+  guint64 stream_id;
+} __attribute__((__packed__)) SliceIndexEntry;
+
+/* Linear conversion from the cycles of a trace clock to ns, from the times of
+   the first and last events in both units */
+typedef struct {
+  guint64 cycles_begin, cycles_end;
+  guint64 ns_begin, ns_end;
+} SliceClock;
+
+static LttvHooks *main_hooks;
+
+static char *a_trace_path;
+static char *a_output;
+static char *a_start;
+static char *a_end;
+
+static gboolean parse_time(const char *str, guint64 *time)
+{
+  const char *p;
+  char *end;
+  guint64 sec, nsec = 0;
+  guint digits = 0;
+
+  sec = g_ascii_strtoull(str, &end, 10);
+  if(end == str) return FALSE;
+  p = end;
+  if(*p == '.') {
+    for(p++ ; g_ascii_isdigit(*p) ; p++) {
+      if(digits < 9) {
+        nsec = nsec * 10 + (*p - '0');
+        digits++;
+      }
+    }
+    for( ; digits < 9 ; digits++) nsec *= 10;
+  }
+  if(*p != '\0') return FALSE;
+
+  *time = sec * NANOSECONDS_PER_SECOND + nsec;
+  return TRUE;
+}
+
+static guint64 cycles_to_ns(const SliceClock *clock, guint64 cycles)
+{
+  double ratio;
+
+  if(clock->cycles_end <= clock->cycles_begin) return clock->ns_begin;
+
+  ratio = (double)(clock->ns_end - clock->ns_begin) /
+    (clock->cycles_end - clock->cycles_begin);
+  return clock->ns_begin +
+    (gint64)((double)(gint64)(cycles - clock->cycles_begin) * ratio);
+}
+
+/* Copy len bytes of in from offset to the end of out, without going through
+   user space */
+static gboolean copy_range(int in, int out, off_t offset, size_t len)
+{
+  ssize_t ret;
+
+#ifdef HAVE_COPY_FILE_RANGE
+  loff_t in_offset = offset;
+
+  if(len == 0) return TRUE;
+  while(len > 0) {
+    ret = copy_file_range(in, &in_offset, out, NULL, len, 0);
+    if(ret <= 0) break;
+    len -= ret;
+  }
+  if(len == 0) return TRUE;
+  /* Some file systems or kernels cannot copy between these files */
+  if(ret < 0 && errno != ENOSYS && errno != EXDEV && errno != EINVAL)
+    return FALSE;
+  offset = in_offset;
+#endif
+  while(len > 0) {
+    ret = sendfile(out, in, &offset, len);
+    if(ret <= 0) return FALSE;
+    len -= ret;
+  }
+  return TRUE;
+}
+
+static gboolean copy_file(const char *in_path, const char *out_path)
+{
+  int in, out;
+  struct stat buf;
+  gboolean ret = FALSE;
+
+  in = open(in_path, O_RDONLY);
+  if(in < 0) return FALSE;
+  out = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(out >= 0) {
+    ret = fstat(in, &buf) == 0 && copy_range(in, out, 0, buf.st_size);
+    close(out);
+  }
+  close(in);
+  return ret;
+}
+
+/* Copy the packets of a stream that overlap [start, end] and write their
+   index */
+static void slice_stream(const char *trace_path, const char *out_path,
+    const char *name, const SliceClock *clock, guint64 start, guint64 end)
+{
+  char *index_name, *in_path, *index_path, *stream_path;
+  gchar *index_data;
+  gsize index_len, entry_len, pos;
+  const SliceIndexHeader *header;
+  GByteArray *out_index = NULL;
+  guint64 out_offset = 0, range_offset = 0, range_len = 0;
+  int in = -1, out = -1;
+
+  in_path = g_build_filename(trace_path, name, NULL);
+  stream_path = g_build_filename(out_path, name, NULL);
+  index_name = g_strconcat(name, ".idx", NULL);
+  index_path = g_build_filename(trace_path, "index", index_name, NULL);
+
+  if(!g_file_get_contents(index_path, &index_data, &index_len, NULL)) {
+    g_warning("No packet index for stream %s, it is copied whole", in_path);
+    if(!copy_file(in_path, stream_path))
+      g_error("Cannot copy %s", in_path);
+    goto end;
+  }
+
+  header = (const SliceIndexHeader *)index_data;
+  entry_len = index_len >= sizeof(*header) ?
+    GUINT32_FROM_BE(header->packet_index_len) : 0;
+  if(entry_len < sizeof(SliceIndexEntry) ||
+      GUINT32_FROM_BE(header->magic) != CTF_INDEX_MAGIC)
+    g_error("Invalid packet index %s", index_path);
+
+  in = open(in_path, O_RDONLY);
+  if(in < 0) g_error("Cannot open %s: %s", in_path, strerror(errno));
+
+  for(pos = sizeof(*header) ; pos + entry_len <= index_len ;
+      pos += entry_len) {
+    SliceIndexEntry entry;
+    guint64 offset, size;
+
+    memcpy(&entry, index_data + pos, sizeof(entry));
+    if(cycles_to_ns(clock, GUINT64_FROM_BE(entry.timestamp_end)) +
+          SLICE_MARGIN < start ||
+        cycles_to_ns(clock, GUINT64_FROM_BE(entry.timestamp_begin)) >
+          end + SLICE_MARGIN)
+      continue;
+
+    if(out < 0) {
+      char *index_dir = g_build_filename(out_path, "index", NULL);
+
+      g_mkdir_with_parents(index_dir, 0755);
+      g_free(index_dir);
+      out = open(stream_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if(out < 0) g_error("Cannot create %s: %s", stream_path,
+          strerror(errno));
+      out_index = g_byte_array_new();
+      g_byte_array_append(out_index, (const guint8 *)index_data,
+          sizeof(*header));
+    }
+
+    /* Consecutive packets are copied at once */
+    offset = GUINT64_FROM_BE(entry.offset);
+    size = GUINT64_FROM_BE(entry.packet_size) / 8;
+    if(range_len > 0 && range_offset + range_len != offset) {
+      if(!copy_range(in, out, range_offset, range_len))
+        g_error("Cannot copy the packets of %s", in_path);
+      range_len = 0;
+    }
+    if(range_len == 0) range_offset = offset;
+    range_len += size;
+
+    entry.offset = GUINT64_TO_BE(out_offset);
+    out_offset += size;
+    g_byte_array_append(out_index, (const guint8 *)&entry, sizeof(entry));
+    g_byte_array_append(out_index,
+        (const guint8 *)index_data + pos + sizeof(entry),
+        entry_len - sizeof(entry));
+  }
+
+  if(out >= 0) {
+    char *out_index_path;
+
+    if(range_len > 0 && !copy_range(in, out, range_offset, range_len))
+      g_error("Cannot copy the packets of %s", in_path);
+    close(out);
+
+    out_index_path = g_build_filename(out_path, "index", index_name, NULL);
+    if(!g_file_set_contents(out_index_path, (const gchar *)out_index->data,
+          out_index->len, NULL))
+      g_error("Cannot write %s", out_index_path);
+    g_free(out_index_path);
+    g_byte_array_free(out_index, TRUE);
+  }
+  close(in);
+  g_free(index_data);
+
+end:
+  g_free(index_path);
+  g_free(index_name);
+  g_free(stream_path);
+  g_free(in_path);
+}
+
+static void slice_trace(LttvTraceset *traceset, LttvTrace *trace,
+    const char *out_path, guint64 start, guint64 end)
+{
+  GDir *dir;
+  const char *name;
+  char *in_path, *metadata_path;
+  SliceClock clock;
+  struct bt_context *context = lttv_traceset_get_context(traceset);
+
+  clock.cycles_begin = bt_trace_handle_get_timestamp_begin(context, trace->id,
+      BT_CLOCK_CYCLES);
+  clock.cycles_end = bt_trace_handle_get_timestamp_end(context, trace->id,
+      BT_CLOCK_CYCLES);
+  clock.ns_begin = bt_trace_handle_get_timestamp_begin(context, trace->id,
+      BT_CLOCK_REAL);
+  clock.ns_end = bt_trace_handle_get_timestamp_end(context, trace->id,
+      BT_CLOCK_REAL);
+
+  if(g_mkdir_with_parents(out_path, 0755) < 0)
+    g_error("Cannot create %s: %s", out_path, strerror(errno));
+
+  in_path = g_build_filename(trace->full_path, "metadata", NULL);
+  metadata_path = g_build_filename(out_path, "metadata", NULL);
+  if(!copy_file(in_path, metadata_path))
+    g_error("Cannot copy %s", in_path);
+  g_free(metadata_path);
+  g_free(in_path);
+
+  dir = g_dir_open(trace->full_path, 0, NULL);
+  if(dir == NULL) g_error("Cannot open %s", trace->full_path);
+  while((name = g_dir_read_name(dir)) != NULL) {
+    char *path;
+
+    if(name[0] == '.' || strcmp(name, "metadata") == 0) continue;
+    path = g_build_filename(trace->full_path, name, NULL);
+    if(g_file_test(path, G_FILE_TEST_IS_REGULAR))
+      slice_stream(trace->full_path, out_path, name, &clock, start, end);
+    g_free(path);
+  }
+  g_dir_close(dir);
+}
+
+/* Directory of a trace relative to the top of the output */
+static char *get_relative_path(LttvTrace *trace)
+{
+  gsize len = strlen(a_trace_path);
+
+  while(len > 1 && a_trace_path[len - 1] == '/') len--;
+  if(strncmp(trace->full_path, a_trace_path, len) == 0 &&
+      trace->full_path[len] == '/')
+    return g_strdup(trace->full_path + len + 1);
+  return g_path_get_basename(trace->full_path);
+}
+
+/* Run the state engine up to start and write the state of each trace, before
+   the events at start */
+static void write_initial_state(LttvTraceset *traceset, guint64 start)
+{
+  guint i, nb_trace;
+  LttTime time = ltt_time_from_uint64(start);
+
+  lttv_state_add_event_hooks(traceset);
+  lttv_process_traceset_begin(traceset, NULL, NULL, NULL);
+  lttv_process_traceset_seek_time(traceset, ltt_time_zero);
+  lttv_process_traceset_middle(traceset, time, G_MAXULONG, NULL);
+  lttv_process_traceset_end(traceset, NULL, NULL, NULL);
+  lttv_state_remove_event_hooks(traceset);
+
+  nb_trace = lttv_traceset_number(traceset);
+  for(i = 0 ; i < nb_trace ; i++) {
+    LttvTrace *trace = lttv_traceset_get(traceset, i);
+    char *relative_path = get_relative_path(trace);
+    char *path = g_build_filename(a_output, relative_path,
+        LTTV_STATE_FILE_NAME, NULL);
+    LttvStateFileWriter *writer;
+    guint8 uuid[LTTV_STATE_FILE_UUID_LEN];
+    gboolean has_uuid;
+
+    /* The slice keeps the packet headers, and the uuid, of the trace */
+    has_uuid = lttv_state_file_get_trace_uuid(trace->full_path, uuid);
+    writer = lttv_state_file_writer_new(path, lttv_trace_get_num_cpu(trace),
+        has_uuid ? uuid : NULL);
+    if(writer == NULL) g_error("Cannot create %s", path);
+    lttv_state_file_write_start(writer, trace->state, time);
+    if(!lttv_state_file_writer_close(writer))
+      g_error("Cannot write %s", path);
+    g_free(path);
+    g_free(relative_path);
+  }
+}
+
+static gboolean slice_traceset(void *hook_data, void *call_data)
+{
+  guint i, nb_trace;
+  guint64 start, end;
+  LttvTraceset *traceset;
+
+  if(a_trace_path == NULL) return FALSE;
+
+  if(a_output == NULL) g_error("The slice output directory is missing");
+  if(a_start == NULL || !parse_time(a_start, &start))
+    g_error("Invalid slice start time");
+  if(a_end == NULL || !parse_time(a_end, &end) || end < start)
+    g_error("Invalid slice end time");
+
+  traceset = lttv_traceset_new();
+  if(lttv_traceset_add_path(traceset, a_trace_path) < 0)
+    g_error("Cannot add trace %s", a_trace_path);
+
+  g_info("SliceTrace copy the packets");
+  nb_trace = lttv_traceset_number(traceset);
+  for(i = 0 ; i < nb_trace ; i++) {
+    LttvTrace *trace = lttv_traceset_get(traceset, i);
+    char *relative_path = get_relative_path(trace);
+    char *out_path = g_build_filename(a_output, relative_path, NULL);
+
+    slice_trace(traceset, trace, out_path, start, end);
+    g_free(out_path);
+    g_free(relative_path);
+  }
+
+  g_info("SliceTrace compute the initial state");
+  write_initial_state(traceset, start);
+
+  lttv_traceset_destroy(traceset);
+  return FALSE;
+}
+
+static void init()
+{
+  LttvAttributeValue value;
+
+  LttvIAttribute *attributes = LTTV_IATTRIBUTE(lttv_global_attributes());
+  gboolean retval;
+
+  g_info("Init sliceTrace.c");
+
+  a_trace_path = NULL;
+  lttv_option_add("slice-trace", 0,
+      "trace or directory of traces to slice",
+      "pathname of the directory containing the traces",
+      LTTV_OPT_STRING, &a_trace_path, NULL, NULL);
+
+  a_output = NULL;
+  lttv_option_add("slice-output", 0,
+      "directory where the slice is written",
+      "pathname of the new directory",
+      LTTV_OPT_STRING, &a_output, NULL, NULL);
+
+  a_start = NULL;
+  lttv_option_add("slice-start", 0,
+      "start of the slice",
+      "time in seconds (e.g., 1331674821.4005)",
+      LTTV_OPT_STRING, &a_start, NULL, NULL);
+
+  a_end = NULL;
+  lttv_option_add("slice-end", 0,
+      "end of the slice",
+      "time in seconds",
+      LTTV_OPT_STRING, &a_end, NULL, NULL);
+
+  retval= lttv_iattribute_find_by_path(attributes, "hooks/main/before",
+    LTTV_POINTER, &value);
+  g_assert(retval);
+  g_assert((main_hooks = *(value.v_pointer)) != NULL);
+  lttv_hooks_add(main_hooks, slice_traceset, NULL, LTTV_PRIO_DEFAULT);
+}
+
+static void destroy()
+{
+  g_info("Destroy sliceTrace.c");
+
+  lttv_option_remove("slice-trace");
+  lttv_option_remove("slice-output");
+  lttv_option_remove("slice-start");
+  lttv_option_remove("slice-end");
+
+  lttv_hooks_remove_data(main_hooks, slice_traceset, NULL);
+}
+
+
+LTTV_MODULE("sliceTrace", "Extract a time window of traces", \
+	    "Copy the packets of a time window and the state at its start " \
+	    "in a new traceset", \
+	    init, destroy, "option")
@@ -27,6 +27,13 @@
 
 void (*print_sstack_item_data)(struct sstack_item *);
 
+/* The array is compacted when at least this many processed items, and at
+ * least half of the array, are deletable
+ */
+#define SSTACK_COMPACT_MIN 64
+
+static struct sstack_stats stats;
+
 /* Debugging function: print a queue item */
 
 static void print_item(struct sstack_item *item)
@@ -65,6 +72,28 @@ void print_stack(struct sstack *stack)
 	printf("\n");
 }
 
+static inline unsigned long item_bytes(struct sstack_item *item)
+{
+	return sizeof(struct sstack_item) + item->data_size;
+}
+
+/* Free an item and the data it owns. Returns the bytes released. */
+
+static unsigned long free_item(struct sstack_item *item)
+{
+	unsigned long bytes = item_bytes(item);
+
+	if(item->delete_data_val)
+		item->delete_data_val(item->data_val);
+
+	//g_array_free(item->depends, FALSE);
+	//g_array_free(item->rev_depends, FALSE);
+	g_free(item);
+
+	stats.live_bytes -= bytes;
+	return bytes;
+}
+
 static void try_start_deleting(struct sstack *stack)
 {
 	int index = stack->array->len-1;
@@ -72,12 +101,10 @@ static void try_start_deleting(struct sstack *stack)
 	while(index >= 0 && g_array_index(stack->array, struct sstack_item *, index)->deletable) {
 		struct sstack_item *item = g_array_index(stack->array, struct sstack_item *, index);
 
-		if(item->delete_data_val)
-			item->delete_data_val(item->data_val);
-
-		//g_array_free(item->depends, FALSE);
-		//g_array_free(item->rev_depends, FALSE);
-		g_free(item);
+		/* Items at or above proc_index are not counted yet */
+		if(index < stack->proc_index)
+			stack->nb_deletable--;
+		free_item(item);
 
 		g_array_remove_index(stack->array, index);
 		index--;
@@ -87,8 +114,62 @@ static void try_start_deleting(struct sstack *stack)
 		stack->proc_index = stack->array->len;
 }
 
+/* Delete all the processed items that are deletable, wherever they are in the
+ * array. A push that waits for its pop keeps all the items above it alive in
+ * try_start_deleting; here only the unpopped pushes and the items not yet
+ * processed are kept. The indexes of the kept items are renumbered.
+ */
+
+static void compact(struct sstack *stack)
+{
+	GArray *array;
+	int *new_index;
+	int i;
+
+	new_index = g_new(int, stack->array->len);
+	array = g_array_sized_new(FALSE, FALSE, sizeof(struct sstack_item *),
+		stack->array->len - stack->nb_deletable);
+
+	for(i=0; i<stack->array->len; i++) {
+		struct sstack_item *item = g_array_index(stack->array, struct sstack_item *, i);
+
+		if(i < stack->proc_index && item->deletable) {
+			new_index[i] = -1;
+			stats.compacted_bytes += free_item(item);
+		}
+		else {
+			new_index[i] = array->len;
+			g_array_append_val(array, item);
+		}
+	}
+
+	/* A kept item never refers to a deleted one: a push is deletable only
+	 * once its pop is processed, and then both are deleted
+	 */
+	for(i=0; i<array->len; i++) {
+		struct sstack_item *item = g_array_index(array, struct sstack_item *, i);
+
+		if(item->pushpop >= 0) {
+			item->pushpop = new_index[item->pushpop];
+			g_assert(item->pushpop >= 0);
+		}
+	}
+	for(i=0; i<stack->pushes->len; i++) {
+		g_array_index(stack->pushes, int, i) = new_index[g_array_index(stack->pushes, int, i)];
+	}
+	stack->proc_index -= stack->nb_deletable;
+
+	g_array_free(stack->array, TRUE);
+	stack->array = array;
+	stack->nb_deletable = 0;
+	stats.compactions++;
+
+	g_free(new_index);
+}
+
 /* An item is deletable as soon as it is processed. However, all the items after it
- * in the list must be deleted before it can be deleted.
+ * in the list must be deleted before it can be deleted, or it waits for the
+ * array to be compacted.
  *
  * After this function, try_start_deleting must be called.
  */
@@ -97,6 +178,8 @@ static void mark_deletable(struct sstack *stack, int index)
 {
 	struct sstack_item *item = g_array_index(stack->array, struct sstack_item *, index);
 
+	if(!item->deletable)
+		stack->nb_deletable++;
 	item->deletable = 1;
 
 //	if(index == stack->array->len - 1) {
@@ -226,6 +309,9 @@ static void try_advance_processing(struct sstack *stack)
 
 		stack->proc_index++;
 
+		/* events are created deletable, count them once processed */
+		if(item->data_type == SSTACK_TYPE_EVENT)
+			stack->nb_deletable++;
 		if(item->data_type == SSTACK_TYPE_POP)
 			mark_deletable(stack, stack->proc_index-1);
 		if(item->pushpop >= 0 && item->pushpop < stack->proc_index-1) {
@@ -233,6 +319,10 @@ static void try_advance_processing(struct sstack *stack)
 		}
 	}
 	try_start_deleting(stack);
+
+	if(stack->nb_deletable >= SSTACK_COMPACT_MIN &&
+			stack->nb_deletable * 2 >= stack->array->len)
+		compact(stack);
 	//printf("sstack: stopping processing\n");
 }
 
@@ -245,6 +335,12 @@ void sstack_add_item(struct sstack *stack, struct sstack_item *item)
 
 	g_array_append_val(stack->array, item);
 
+	if(stack->array->len > stack->peak_len)
+		stack->peak_len = stack->array->len;
+	stats.live_bytes += item_bytes(item);
+	if(stats.live_bytes > stats.peak_bytes)
+		stats.peak_bytes = stats.live_bytes;
+
 	//printf("stack after adding\n");
 	//print_stack(stack);
 
@@ -341,11 +437,20 @@ struct sstack *sstack_new(void)
 	retval->pushes = g_array_new(FALSE, FALSE, sizeof(int));
 	retval->wait_pop_stack = g_array_new(FALSE, FALSE, sizeof(int));
 	retval->proc_index = 0;
+	retval->nb_deletable = 0;
+	retval->peak_len = 0;
 	retval->process_func = NULL;
 
 	return retval;
 }
 
+/* Get the memory statistics of all the sstacks */
+
+void sstack_get_stats(struct sstack_stats *out)
+{
+	*out = stats;
+}
+
 /* Create a new sstack_item. Normally not invoked directly. See other functions below. */
 
 struct sstack_item *sstack_item_new(void)
@@ -359,6 +464,7 @@ struct sstack_item *sstack_item_new(void)
 	retval->data_type = 0;
 	retval->data_val = NULL;
 	retval->delete_data_val = NULL;
+	retval->data_size = 0;
 	retval->pushpop = -1;
 	retval->wait_pop = 0;
 	//retval->depends = g_array_new(FALSE, FALSE, sizeof(int));
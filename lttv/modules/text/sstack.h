@@ -22,6 +22,8 @@ struct sstack_item {
 
 	/* Function to call to delete data_val */
 	void (*delete_data_val)(void *data_val);
+	/* Bytes of data_val owned by the item, for the statistics */
+	unsigned long data_size;
 
 	/* The index of the corresponding push (for a pop) or pop (for a push) */
 	int pushpop;
@@ -55,10 +57,29 @@ struct sstack {
 	/* Next item we must try to process */
 	int proc_index;
 
+	/* Number of processed items that are deletable but still in the array
+	 * because an unpopped push is above them
+	 */
+	int nb_deletable;
+	/* Largest length reached by the array */
+	int peak_len;
+
 	void (*process_func)(void *arg, struct sstack_item *item);
 	void *process_func_arg; /* the pointer passed as the "arg" argument of process_func */
 };
 
+/* Memory statistics of all the sstacks */
+
+struct sstack_stats {
+	/* Bytes held by the sstacks in their items and the data they own, now
+	 * and at the peak */
+	unsigned long live_bytes;
+	unsigned long peak_bytes;
+	/* Compactions done and bytes they released */
+	unsigned long compactions;
+	unsigned long compacted_bytes;
+};
+
 struct sstack_item *sstack_new_item();
 
 void sstack_add_item(struct sstack *stack, struct sstack_item *item);
@@ -69,6 +90,7 @@ struct sstack_item *sstack_item_new_push(unsigned char finished);
 struct sstack_item *sstack_item_new_pop(void);
 struct sstack_item *sstack_item_new_event(void);
 void sstack_force_flush(struct sstack *stack);
+void sstack_get_stats(struct sstack_stats *stats);
 
 extern void print_stack(struct sstack *stack);
 
@@ -0,0 +1,161 @@
+/* This file is part of the Linux Trace Toolkit viewer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License Version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Check the compaction of a sstack: a push that is never popped stays at the
+ * bottom while processed events pile up above it, between other pushes. The
+ * data of the compacted events must be deleted. The program aborts if a check
+ * fails.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sstack.h"
+
+/* Pushes above the bottom one, with EVENTS_PER_PUSH events before each. The
+ * array is compacted when the events reach the threshold of sstack.c.
+ */
+#define NB_PUSHES 32
+#define EVENTS_PER_PUSH 2
+/* Bytes owned by the data of an event */
+#define EVENT_DATA_SIZE 24
+
+/* Number of the next item created, stored in data_val */
+static long item_count;
+/* Order in which the items are processed */
+static GArray *processed;
+/* Index of the push matched by the last pop processed */
+static int last_pop_push = -1;
+/* Number of event data deleted */
+static int deleted_events;
+
+static void process_item(void *arg, struct sstack_item *item)
+{
+	long id = (long)item->data_val;
+
+	g_array_append_val(processed, id);
+	if(item->data_type == SSTACK_TYPE_POP)
+		last_pop_push = item->pushpop;
+}
+
+static void print_item_data(struct sstack_item *item)
+{
+	printf("%ld\n", (long)item->data_val);
+}
+
+static struct sstack_item *numbered(struct sstack_item *item)
+{
+	item->data_val = (void *)item_count++;
+	return item;
+}
+
+static void delete_event_data(void *data_val)
+{
+	deleted_events++;
+}
+
+static struct sstack_item *new_event(void)
+{
+	struct sstack_item *item = numbered(sstack_item_new_event());
+
+	item->delete_data_val = delete_event_data;
+	item->data_size = EVENT_DATA_SIZE;
+	return item;
+}
+
+static long item_id(struct sstack *stack, int index)
+{
+	return (long)g_array_index(stack->array, struct sstack_item *, index)->data_val;
+}
+
+int main(int argc, char **argv)
+{
+	struct sstack *stack;
+	long pop_id;
+	struct sstack_stats stats;
+	unsigned long push_bytes, event_bytes;
+	long push_ids[NB_PUSHES + 1];
+	int i, j;
+
+	print_sstack_item_data = print_item_data;
+	processed = g_array_new(FALSE, FALSE, sizeof(long));
+	stack = sstack_new();
+	stack->process_func = process_item;
+	push_bytes = sizeof(struct sstack_item);
+	event_bytes = sizeof(struct sstack_item) + EVENT_DATA_SIZE;
+
+	/* The long-blocked push, never popped */
+	push_ids[0] = item_count;
+	sstack_add_item(stack, numbered(sstack_item_new_push(0)));
+
+	for(i = 1; i <= NB_PUSHES; i++) {
+		for(j = 0; j < EVENTS_PER_PUSH; j++)
+			sstack_add_item(stack, new_event());
+		push_ids[i] = item_count;
+		sstack_add_item(stack, numbered(sstack_item_new_push(0)));
+
+		if(i < NB_PUSHES) {
+			/* The events are processed but held by the push above them */
+			g_assert(stack->nb_deletable == i * EVENTS_PER_PUSH);
+			g_assert(stack->array->len == 1 + i * (EVENTS_PER_PUSH + 1));
+		}
+	}
+
+	/* Every item was processed, in order */
+	g_assert(processed->len == item_count);
+	for(i = 0; i < processed->len; i++)
+		g_assert(g_array_index(processed, long, i) == i);
+
+	/* The last push compacted the array: only the pushes are left, the data
+	 * of the events is deleted */
+	sstack_get_stats(&stats);
+	g_assert(deleted_events == NB_PUSHES * EVENTS_PER_PUSH);
+	g_assert(stats.compactions == 1);
+	g_assert(stats.compacted_bytes ==
+		NB_PUSHES * EVENTS_PER_PUSH * event_bytes);
+	g_assert(stats.live_bytes == (NB_PUSHES + 1) * push_bytes);
+	g_assert(stats.peak_bytes == stats.live_bytes + stats.compacted_bytes);
+	g_assert(stack->peak_len == item_count);
+	g_assert(stack->nb_deletable == 0);
+	g_assert(stack->array->len == NB_PUSHES + 1);
+	g_assert(stack->proc_index == NB_PUSHES + 1);
+	g_assert(stack->pushes->len == NB_PUSHES + 1);
+	for(i = 0; i <= NB_PUSHES; i++) {
+		g_assert(item_id(stack, i) == push_ids[i]);
+		g_assert(g_array_index(stack->pushes, int, i) == i);
+		g_assert(g_array_index(stack->array, struct sstack_item *,
+			i)->pushpop == -1);
+	}
+
+	/* A pop finds its push at the renumbered index. Both are processed and
+	 * deleted from the top of the array.
+	 */
+	pop_id = item_count;
+	sstack_add_item(stack, numbered(sstack_item_new_pop()));
+	g_assert(last_pop_push == NB_PUSHES);
+	g_assert(g_array_index(processed, long, processed->len - 1) == pop_id);
+	g_assert(stack->array->len == NB_PUSHES);
+	g_assert(stack->pushes->len == NB_PUSHES);
+	g_assert(item_id(stack, NB_PUSHES - 1) == push_ids[NB_PUSHES - 1]);
+
+	sstack_get_stats(&stats);
+	g_assert(stats.live_bytes == NB_PUSHES * push_bytes);
+	g_assert(stats.compactions == 1);
+
+	return EXIT_SUCCESS;
+}
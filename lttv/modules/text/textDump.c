@@ -37,10 +37,18 @@
 #endif
 #include <lttv/traceset.h>
 #include <lttv/print.h>
+#include <lttv/state.h>
+#include <lttv/state-file.h>
+#include <lttv/traceset-process.h>
 #include <stdio.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #include <lttv/event.h>
+#include <babeltrace/ctf/events.h>
+
+/* Number of events after which the parallel dump starts a new slice */
+#define DUMP_SLICE_EVENTS 50000
 
 static gboolean
   a_noevent,
@@ -53,6 +61,9 @@ static gboolean
 static char
   *a_file_name = NULL;
 
+static gint
+  a_dump_threads;
+
 static LttvHooks
   *before_traceset,
   *after_traceset,
@@ -253,6 +264,389 @@ static FILE *a_file;
 
 static GString *a_string;
 
+/* Parallel dump. The traceset is split in slices. Each worker thread has
+   its own traceset on the same traces: it seeks to the start of a slice,
+   restores the state of the traces there and formats the events of the
+   slice in a buffer. The main thread writes the buffers in order as they
+   are completed.
+
+   When all the traces have a state file, the slices are cut at the times of
+   their snapshots before the main pass, and the workers restore the
+   snapshots themselves: the main pass only writes the buffers. Otherwise
+   the main pass saves the state of the traces every DUMP_SLICE_EVENTS
+   events, where the uncorrected timestamp changes. */
+
+typedef struct _DumpSlice {
+  guint64 start;		/* uncorrected timestamp of the first event */
+  gulong nb_events;
+  LttvAttribute **states;	/* saved state of each trace */
+  gint64 *snapshots;		/* or snapshot of each trace in its state file,
+				   NULL for the initial state */
+  LttTime end;			/* uncorrected time of the next slice */
+  GString *text;
+  gboolean done;
+} DumpSlice;
+
+typedef struct _DumpWorker {
+  pthread_t thread;
+  LttvTraceset *traceset;
+  GString *line;
+  DumpSlice *slice;
+} DumpWorker;
+
+static pthread_mutex_t a_slices_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t a_slices_cond = PTHREAD_COND_INITIALIZER;
+
+/* Slices in trace order, the slices written are replaced by NULL. The
+   workers take the slices that are ready, whose number of events is known. */
+static GPtrArray *a_slices;
+static guint a_slices_ready, a_slices_taken, a_slices_written;
+static gboolean a_slices_end;
+
+/* The slices are cut at the snapshots of the state files */
+static gboolean a_slices_planned;
+
+static DumpWorker *a_workers;
+static LttvTraceset *a_traceset;
+static guint64 a_last_timestamp;
+static gulong a_slice_events;
+
+static gboolean write_slice_event(void *hook_data, void *call_data)
+{
+  DumpWorker *worker = (DumpWorker *)hook_data;
+  LttvEvent *event = (LttvEvent *)call_data;
+
+  lttv_event_to_string(event, worker->line, !a_no_field_names, TRUE);
+  g_string_append_len(worker->slice->text, worker->line->str,
+      worker->line->len);
+  g_string_append_c(worker->slice->text, '\n');
+
+  return FALSE;
+}
+
+static void dump_slice(DumpWorker *worker, DumpSlice *slice)
+{
+  guint i, nb_trace;
+  LttvTraceState *state;
+
+  nb_trace = lttv_traceset_number(worker->traceset);
+  if(a_slices_planned) {
+    /* The first slice is the first one taken by a worker, whose traces are
+       still in their initial state */
+    if(slice->snapshots != NULL) {
+      for(i = 0 ; i < nb_trace ; i++) {
+        state = lttv_traceset_get(worker->traceset, i)->state;
+        lttv_state_file_restore(state->state_file, slice->snapshots[i], state);
+      }
+      g_free(slice->snapshots);
+      slice->snapshots = NULL;
+    }
+    lttv_process_traceset_seek_time(worker->traceset,
+        ltt_time_from_uint64(slice->start));
+
+    worker->slice = slice;
+    lttv_process_traceset_middle(worker->traceset, slice->end, G_MAXULONG,
+        NULL);
+    worker->slice = NULL;
+    return;
+  }
+
+  lttv_process_traceset_seek_time(worker->traceset,
+      ltt_time_from_uint64(slice->start));
+  for(i = 0 ; i < nb_trace ; i++) {
+    state = lttv_traceset_get(worker->traceset, i)->state;
+    lttv_state_restore(state, slice->states[i]);
+    lttv_state_saved_free(state, slice->states[i]);
+    g_object_unref(slice->states[i]);
+  }
+  g_free(slice->states);
+  slice->states = NULL;
+
+  worker->slice = slice;
+  lttv_process_traceset_middle(worker->traceset, ltt_time_infinite,
+      slice->nb_events, NULL);
+  worker->slice = NULL;
+}
+
+static void *dump_worker(void *arg)
+{
+  DumpWorker *worker = (DumpWorker *)arg;
+  DumpSlice *slice;
+
+  pthread_mutex_lock(&a_slices_mutex);
+  while(TRUE) {
+    /* The planned slices are all ready, bound the memory used by the ones
+       not written yet */
+    while((a_slices_taken == a_slices_ready && !a_slices_end) ||
+        (a_slices_planned && a_slices_taken < a_slices_ready &&
+         a_slices_taken - a_slices_written >= 2 * a_dump_threads))
+      pthread_cond_wait(&a_slices_cond, &a_slices_mutex);
+    if(a_slices_taken == a_slices_ready) break;
+
+    slice = g_ptr_array_index(a_slices, a_slices_taken);
+    a_slices_taken++;
+    pthread_mutex_unlock(&a_slices_mutex);
+
+    dump_slice(worker, slice);
+
+    pthread_mutex_lock(&a_slices_mutex);
+    slice->done = TRUE;
+    pthread_cond_broadcast(&a_slices_cond);
+  }
+  pthread_mutex_unlock(&a_slices_mutex);
+
+  return NULL;
+}
+
+/* Open the traces of traceset again for a worker, with the same
+   synchronization correction */
+static LttvTraceset *open_worker_traceset(LttvTraceset *traceset)
+{
+  guint i, nb_trace;
+  LttvTraceset *copy;
+  LttvTrace *trace, *trace_copy;
+  GArray *segments;
+
+  copy = lttv_traceset_new();
+  nb_trace = lttv_traceset_number(traceset);
+  for(i = 0 ; i < nb_trace ; i++) {
+    trace = lttv_traceset_get(traceset, i);
+    if(lttv_traceset_add_path(copy, trace->full_path) < 0 ||
+        lttv_traceset_number(copy) != i + 1)
+      g_error("cannot open trace %s for the parallel dump", trace->full_path);
+
+    trace_copy = lttv_traceset_get(copy, i);
+    lttv_trace_set_sync_factors(trace_copy, trace->drift, trace->offset);
+    if(trace->sync_segments != NULL) {
+      segments = g_array_sized_new(FALSE, FALSE, sizeof(LttvTraceSyncSegment),
+          trace->sync_segments->len);
+      g_array_append_vals(segments, trace->sync_segments->data,
+          trace->sync_segments->len);
+      lttv_trace_set_sync_segments(trace_copy, segments);
+    }
+  }
+  lttv_process_traceset_begin(copy, NULL, NULL, NULL);
+
+  return copy;
+}
+
+static DumpSlice *new_slice(guint64 start)
+{
+  DumpSlice *slice;
+
+  slice = g_new(DumpSlice, 1);
+  slice->start = start;
+  slice->nb_events = 0;
+  slice->states = NULL;
+  slice->snapshots = NULL;
+  slice->end = ltt_time_infinite;
+  slice->text = g_string_sized_new(DUMP_SLICE_EVENTS * 128);
+  slice->done = FALSE;
+
+  return slice;
+}
+
+/* Cut the slices at the times where all the traces have a snapshot in their
+   state file. Returns FALSE if there is no such time. */
+static gboolean plan_slices(LttvTraceset *traceset)
+{
+  guint i, nb_trace;
+  guint64 j, nb_snapshots;
+  LttvStateFile *file;
+  LttTime time;
+  gint64 *snapshots;
+  gint64 snapshot;
+  DumpSlice *slice;
+
+  nb_trace = lttv_traceset_number(traceset);
+  for(i = 0 ; i < nb_trace ; i++) {
+    if(lttv_traceset_get(traceset, i)->state->state_file == NULL)
+      return FALSE;
+  }
+  if(nb_trace == 0)
+    return FALSE;
+
+  /* The first slice starts from the initial state */
+  slice = new_slice(0);
+  g_ptr_array_add(a_slices, slice);
+
+  file = lttv_traceset_get(traceset, 0)->state->state_file;
+  nb_snapshots = lttv_state_file_get_nb_snapshots(file);
+  snapshots = g_new(gint64, nb_trace);
+  for(j = 0 ; j < nb_snapshots ; j++) {
+    time = lttv_state_file_get_time(file, j);
+    snapshots[0] = j;
+    for(i = 1 ; i < nb_trace ; i++) {
+      LttvStateFile *other = lttv_traceset_get(traceset, i)->state->state_file;
+
+      snapshot = lttv_state_file_find(other, time);
+      if(snapshot < 0 ||
+          ltt_time_compare(lttv_state_file_get_time(other, snapshot), time) != 0)
+        break;
+      snapshots[i] = snapshot;
+    }
+    if(i < nb_trace || ltt_time_compare(time, ltt_time_zero) == 0)
+      continue;
+
+    slice->end = time;
+    slice = new_slice(ltt_time_to_uint64(time));
+    slice->snapshots = g_memdup(snapshots, nb_trace * sizeof(gint64));
+    g_ptr_array_add(a_slices, slice);
+  }
+  g_free(snapshots);
+
+  if(a_slices->len == 1) {
+    g_string_free(slice->text, TRUE);
+    g_free(slice);
+    g_ptr_array_set_size(a_slices, 0);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void start_workers(LttvTraceset *traceset)
+{
+  gint i;
+
+  a_traceset = traceset;
+  a_slices = g_ptr_array_new();
+  a_slices_ready = a_slices_taken = a_slices_written = 0;
+  a_slices_end = FALSE;
+  a_slice_events = 0;
+  a_slices_planned = plan_slices(traceset);
+  if(a_slices_planned) {
+    g_info("TextDump %u slices cut at the state file snapshots",
+        a_slices->len);
+    a_slices_ready = a_slices->len;
+  }
+
+  a_workers = g_new(DumpWorker, a_dump_threads);
+  for(i = 0 ; i < a_dump_threads ; i++) {
+    a_workers[i].traceset = open_worker_traceset(traceset);
+    a_workers[i].line = g_string_new("");
+    a_workers[i].slice = NULL;
+    lttv_state_add_event_hooks(a_workers[i].traceset);
+    lttv_hooks_add(lttv_traceset_get_hooks(a_workers[i].traceset),
+        write_slice_event, &a_workers[i], LTTV_PRIO_DEFAULT);
+  }
+  for(i = 0 ; i < a_dump_threads ; i++) {
+    if(pthread_create(&a_workers[i].thread, NULL, dump_worker,
+          &a_workers[i]) != 0)
+      g_error("cannot create dump thread");
+  }
+}
+
+/* Write the slices that are done, in order, waiting for the workers while
+   more than keep slices are not written */
+static void write_slices(guint keep)
+{
+  DumpSlice *slice;
+
+  pthread_mutex_lock(&a_slices_mutex);
+  while(a_slices_written < a_slices->len) {
+    slice = g_ptr_array_index(a_slices, a_slices_written);
+    if(!slice->done) {
+      if(a_slices->len - a_slices_written <= keep) break;
+      pthread_cond_wait(&a_slices_cond, &a_slices_mutex);
+      continue;
+    }
+    g_ptr_array_index(a_slices, a_slices_written) = NULL;
+    a_slices_written++;
+    pthread_cond_broadcast(&a_slices_cond);
+    pthread_mutex_unlock(&a_slices_mutex);
+
+    fwrite(slice->text->str, 1, slice->text->len, a_file);
+    g_string_free(slice->text, TRUE);
+    g_free(slice);
+
+    pthread_mutex_lock(&a_slices_mutex);
+  }
+  pthread_mutex_unlock(&a_slices_mutex);
+}
+
+static void stop_workers(void)
+{
+  gint i;
+
+  pthread_mutex_lock(&a_slices_mutex);
+  if(a_slices->len > 0 && !a_slices_planned) {
+    ((DumpSlice *)g_ptr_array_index(a_slices, a_slices->len - 1))->nb_events =
+      a_slice_events;
+  }
+  a_slices_ready = a_slices->len;
+  a_slices_end = TRUE;
+  pthread_cond_broadcast(&a_slices_cond);
+  pthread_mutex_unlock(&a_slices_mutex);
+
+  write_slices(0);
+
+  for(i = 0 ; i < a_dump_threads ; i++) {
+    pthread_join(a_workers[i].thread, NULL);
+    lttv_state_remove_event_hooks(a_workers[i].traceset);
+    lttv_hooks_remove_data(lttv_traceset_get_hooks(a_workers[i].traceset),
+        write_slice_event, &a_workers[i]);
+    lttv_traceset_destroy(a_workers[i].traceset);
+    g_string_free(a_workers[i].line, TRUE);
+  }
+  g_free(a_workers);
+  a_workers = NULL;
+  g_ptr_array_free(a_slices, TRUE);
+  a_slices = NULL;
+  a_traceset = NULL;
+}
+
+/* Called before the state hooks, the state of the traces is the one after
+   the previous event */
+static gboolean save_slice_state(void *hook_data, void *call_data)
+{
+  LttvEvent *event = (LttvEvent *)call_data;
+  DumpSlice *slice;
+  guint i, nb_trace;
+  guint64 timestamp;
+
+  if(a_dump_threads <= 1) return FALSE;
+
+  /* Only write the slices done by the workers */
+  if(a_slices_planned) {
+    if(++a_slice_events >= DUMP_SLICE_EVENTS) {
+      write_slices(G_MAXUINT);
+      a_slice_events = 0;
+    }
+    return FALSE;
+  }
+
+  timestamp = bt_ctf_get_timestamp(event->bt_event);
+  if(a_slices->len == 0 || (a_slice_events >= DUMP_SLICE_EVENTS &&
+        timestamp > a_last_timestamp)) {
+    nb_trace = lttv_traceset_number(a_traceset);
+    slice = new_slice(timestamp);
+    slice->states = g_new(LttvAttribute *, nb_trace);
+    for(i = 0 ; i < nb_trace ; i++) {
+      slice->states[i] = g_object_new(LTTV_ATTRIBUTE_TYPE, NULL);
+      lttv_state_save(lttv_traceset_get(a_traceset, i)->state,
+          slice->states[i]);
+    }
+    pthread_mutex_lock(&a_slices_mutex);
+    if(a_slices->len > 0) {
+      ((DumpSlice *)g_ptr_array_index(a_slices, a_slices->len - 1))->nb_events =
+        a_slice_events;
+      a_slices_ready = a_slices->len;
+      pthread_cond_broadcast(&a_slices_cond);
+    }
+    g_ptr_array_add(a_slices, slice);
+    pthread_mutex_unlock(&a_slices_mutex);
+
+    a_slice_events = 0;
+
+    /* Bound the memory used by the slices not written yet */
+    write_slices(2 * a_dump_threads);
+  }
+  a_slice_events++;
+  a_last_timestamp = timestamp;
+
+  return FALSE;
+}
+
 static gboolean write_traceset_header(void *hook_data, void *call_data)
 {
   LttvTraceset *traceset = (LttvTraceset *)call_data;
@@ -268,6 +662,8 @@ static gboolean write_traceset_header(void *hook_data, void *call_data)
   fprintf(a_file,"Trace set contains %d traces\n\n", 
       lttv_traceset_number(traceset));
 
+  if(a_dump_threads > 1) start_workers(traceset);
+
   return FALSE;
 }
 
@@ -279,6 +675,8 @@ static gboolean write_traceset_footer(void *hook_data, void *call_data)
 #endif
   g_info("TextDump traceset footer");
 
+  if(a_dump_threads > 1) stop_workers();
+
   fprintf(a_file,"End trace set\n\n");
 #ifdef BABEL_CLEANUP
   if(LTTV_IS_TRACESET_STATS(tc)) {
@@ -314,6 +712,10 @@ static int write_event_content(void *hook_data, void *call_data)
   LttvIAttribute *attributes = LTTV_IATTRIBUTE(lttv_global_attributes());
 #endif   
   LttvEvent *event = (LttvEvent *)call_data;
+
+  /* The workers format the events of the parallel dump */
+  if(a_dump_threads > 1)
+    return FALSE;
 #ifdef BABEL_CLEANUP  
   LttvTracefileContext *tfc = (LttvTracefileContext *)call_data;
 
@@ -423,12 +825,19 @@ static void init()
       "",
       LTTV_OPT_NONE, &a_path_output, NULL, NULL);
 
+  a_dump_threads = 1;
+  lttv_option_add("dump_threads", '\0',
+      "number of threads formatting the events, the output is the same",
+      "number of threads",
+      LTTV_OPT_INT, &a_dump_threads, NULL, NULL);
+
   result = lttv_iattribute_find_by_path(attributes, "hooks/event",
       LTTV_POINTER, &value);
   g_assert(result);
   event_hook = *(value.v_pointer);
   g_assert(event_hook);
   lttv_hooks_add(event_hook, write_event_content, NULL, LTTV_PRIO_DEFAULT);
+  lttv_hooks_add(event_hook, save_slice_state, NULL, LTTV_PRIO_HIGH);
 
   result = lttv_iattribute_find_by_path(attributes, "hooks/trace/before",
       LTTV_POINTER, &value);
@@ -472,10 +881,14 @@ static void destroy()
 
   lttv_option_remove("path_output");
 
+  lttv_option_remove("dump_threads");
+
   g_string_free(a_string, TRUE);
 
   lttv_hooks_remove_data(event_hook, write_event_content, NULL);
 
+  lttv_hooks_remove_data(event_hook, save_slice_state, NULL);
+
   lttv_hooks_remove_data(before_trace, write_trace_header, NULL);
 
   lttv_hooks_remove_data(before_traceset, write_traceset_header, NULL);